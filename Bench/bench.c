@@ -0,0 +1,376 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  bench.c
+ * Purpose: speed and memory of the standalone program and the libraries
+ *
+ * 19/10/26: Created
+ *
+ *   USAGE: mbrola-bench [-j workers] [-r runs] [-o results] bindir voice corpus.pho
+ *
+ *   Runs bindir/mbrola, bindir/bench-lib1 and bindir/bench-lib2 on the
+ *   voice (see mkvoice for a synthetic one) as child processes, runs
+ *   times each, and prints one JSON object per line and per program:
+ *
+ *     startup_ms          wall time of the synthesis of 10 ms of silence
+ *                         (process start and loading of the database)
+ *     wall_s, cpu_s       wall and CPU (user+system) time for the corpus
+ *     audio_s, samples    duration of the speech synthesized
+ *     rtf                 real-time factor, wall_s/audio_s
+ *     samples_per_s_core  samples per CPU second
+ *     peak_rss_kb         largest resident set (ru_maxrss, kilobytes on
+ *                         Linux, bytes on Mac OS X)
+ *
+ *   Times are the best of the runs, the memory the largest. With -j N>1,
+ *   mbrola gets -J N and bench-lib2 -j N: the corpus is split at its
+ *   flushes on N threads, the audio is the same. The lines are appended
+ *   to the results file too.
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "common.h"
+
+/* Measures of one run of a program */
+typedef struct
+{
+	double wall;        /* seconds */
+	double cpu;         /* user + system seconds */
+	long peak_rss;      /* ru_maxrss */
+	int status;         /* 0 means success */
+} Measure;
+
+/* Description of the voice, from its header */
+typedef struct
+{
+	int nb_diphones;
+	int freq;
+	int period;
+} VoiceInfo;
+
+static double now(void)
+/* Monotonic clock in seconds */
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double seconds(struct timeval* tv)
+{ return (double) tv->tv_sec + tv->tv_usec / 1e6; }
+
+static int run(char** args, Measure* measure)
+/*
+ * Run args[0] with its stdout thrown away, and wait for it. The
+ * RUSAGE_CHILDREN of an intermediate process only account for that run.
+ * 0 means the run couldn't be measured
+ */
+{
+	int channel[2];
+	pid_t pid;
+	int status;
+
+	if (pipe(channel) != 0)
+		return 0;
+
+	pid= fork();
+	if (pid < 0)
+		return 0;
+
+	if (pid == 0)
+	{
+		Measure result;
+		struct rusage usage;
+		double start= now();
+		pid_t target= fork();
+
+		if (target == 0)
+		{
+			int null= open("/dev/null", O_WRONLY);
+
+			if (null >= 0)
+				dup2(null, 1);
+			execv(args[0], args);
+			fprintf(stderr, "Can't run %s\n", args[0]);
+			_exit(127);
+		}
+
+		result.status= -1;
+		if ((target > 0) && (waitpid(target, &status, 0) == target))
+			result.status= (WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+		result.wall= now() - start;
+
+		getrusage(RUSAGE_CHILDREN, &usage);
+		result.cpu= seconds(&usage.ru_utime) + seconds(&usage.ru_stime);
+		result.peak_rss= usage.ru_maxrss;
+
+		if (write(channel[1], &result, sizeof(result)) != sizeof(result))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(channel[1]);
+	status= (read(channel[0], measure, sizeof(*measure)) == sizeof(*measure));
+	close(channel[0]);
+	waitpid(pid, NULL, 0);
+	return status;
+}
+
+static int best_of(char** args, int nb_runs, Measure* best)
+/* Shortest of nb_runs runs, with the largest memory. 0 means failure */
+{
+	int i;
+
+	for (i=0; i<nb_runs; i++)
+	{
+		Measure measure;
+
+		if (!run(args, &measure) || (measure.status != 0))
+		{
+			fprintf(stderr, "%s failed\n", args[0]);
+			return 0;
+		}
+
+		if ((i == 0) || (measure.wall < best->wall))
+		{
+			long peak_rss= (i == 0) ? measure.peak_rss : best->peak_rss;
+
+			*best= measure;
+			best->peak_rss= peak_rss;
+		}
+		if (measure.peak_rss > best->peak_rss)
+			best->peak_rss= measure.peak_rss;
+	}
+	return 1;
+}
+
+static int little_endian(unsigned char* bytes, int nb)
+{
+	int value=0;
+
+	while (nb-- > 0)
+		value= (value << 8) | bytes[nb];
+	return value;
+}
+
+static int read_voice(char* name, VoiceInfo* info)
+/* Fields of a database header, 0 means it's not a database */
+{
+	FILE* input= fopen(name, "rb");
+	unsigned char header[27];
+	int ok;
+
+	if (!input)
+		return 0;
+	ok= (fread(header, 1, sizeof(header), input) == sizeof(header))
+		&& (strncmp((char*) header, "MBROLA", 6) == 0);
+	fclose(input);
+
+	if (ok)
+	{
+		/* SizeMrk on 16 bits in the old format, 32 bits after a 0 */
+		int shift= (little_endian(&header[13], 2) == 0) ? 4 : 0;
+
+		info->nb_diphones= little_endian(&header[11], 2);
+		info->freq= little_endian(&header[19+shift], 2);
+		info->period= header[21+shift];
+	}
+	return ok;
+}
+
+static long file_size(char* name)
+{
+	struct stat st;
+
+	if (stat(name, &st) != 0)
+		return -1;
+	return (long) st.st_size;
+}
+
+static void print_string(FILE* out, char* str)
+/* JSON string */
+{
+	fputc('"', out);
+	for ( ; *str; str++)
+	{
+		if ((*str == '"') || (*str == '\\'))
+			fputc('\\', out);
+		fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+static void print_result(FILE* out, char* target, char* voice, VoiceInfo* info,
+						 int nb_workers, int nb_runs, double startup,
+						 Measure* measure, long nb_samples)
+/* One JSON object on one line */
+{
+	double audio= (double) nb_samples / info->freq;
+
+	fprintf(out, "{\"target\":");
+	print_string(out, target);
+	fprintf(out, ",\"version\":");
+	print_string(out, SYNTH_VERSION);
+	fprintf(out, ",\"voice\":");
+	print_string(out, voice);
+	fprintf(out, ",\"diphones\":%i,\"freq\":%i,\"period\":%i,\"workers\":%i,\"runs\":%i,"
+			"\"startup_ms\":%.3f,\"wall_s\":%.4f,\"cpu_s\":%.4f,\"audio_s\":%.3f,"
+			"\"samples\":%li,\"rtf\":%.6f,\"samples_per_s_core\":%.0f,\"peak_rss_kb\":%li}\n",
+			info->nb_diphones, info->freq, info->period, nb_workers, nb_runs,
+			startup * 1000.0, measure->wall, measure->cpu, audio,
+			nb_samples, (audio > 0) ? measure->wall / audio : 0.0,
+			(measure->cpu > 0) ? nb_samples / measure->cpu : 0.0,
+			measure->peak_rss);
+	fflush(out);
+}
+
+int main(int argc, char **argv)
+{
+	static char* targets[]= { "cli", "lib1", "lib2" };
+	static char* programs[]= { "mbrola", "bench-lib1", "bench-lib2" };
+	char* results= NULL;
+	int nb_workers=1;
+	int nb_runs=3;
+	char* bindir;
+	char* voice;
+	char* corpus;
+	char* startup_pho;
+	char* output;
+	char workers[16];
+	VoiceInfo info;
+	FILE* out;
+	int failed=0;
+	int i, t;
+
+	for (i=1; (i < argc-3) && (argv[i][0] == '-'); i+=2)
+	{
+		switch (argv[i][1])
+		{
+		case 'j': nb_workers= atoi(argv[i+1]); break;
+		case 'r': nb_runs= atoi(argv[i+1]); break;
+		case 'o': results= argv[i+1]; break;
+		default: i= argc; break;
+		}
+	}
+
+	if ((i != argc-3) || (nb_workers < 1) || (nb_runs < 1))
+	{
+		fprintf(stderr, "USAGE: %s [-j workers] [-r runs] [-o results] bindir voice corpus.pho\n",
+				argv[0]);
+		return 1;
+	}
+	bindir= argv[argc-3];
+	voice= argv[argc-2];
+	corpus= argv[argc-1];
+
+	if (!read_voice(voice, &info))
+	{
+		fprintf(stderr, "%s is not a database\n", voice);
+		return 1;
+	}
+
+	/* Scratch files next to the corpus */
+	startup_pho= (char*) malloc(strlen(corpus) + 16);
+	output= (char*) malloc(strlen(corpus) + 16);
+	sprintf(startup_pho, "%s.startup", corpus);
+	sprintf(output, "%s.raw", corpus);
+
+	out= fopen(startup_pho, "w");
+	if (!out)
+	{
+		fprintf(stderr, "Can't write %s\n", startup_pho);
+		return 1;
+	}
+	fprintf(out, "_ 10\n");
+	fclose(out);
+
+	out= NULL;
+	if (results && !(out= fopen(results, "a")))
+	{
+		fprintf(stderr, "Can't write %s\n", results);
+		return 1;
+	}
+
+	sprintf(workers, "%i", nb_workers);
+	for (t=0; t<3; t++)
+	{
+		char* program= (char*) malloc(strlen(bindir) + 16);
+		char* args[8];
+		Measure startup, synthesis;
+		int nb=0;
+
+		sprintf(program, "%s/%s", bindir, programs[t]);
+		args[nb++]= program;
+		if ((t == 0) && (nb_workers > 1))
+		{
+			args[nb++]= "-J";
+			args[nb++]= workers;
+		}
+		else if (t == 2)
+		{
+			args[nb++]= "-j";
+			args[nb++]= workers;
+		}
+		args[nb++]= voice;
+		args[nb+1]= output;
+		args[nb+2]= NULL;
+
+		args[nb]= startup_pho;
+		if (best_of(args, nb_runs, &startup))
+		{
+			args[nb]= corpus;
+			if (best_of(args, nb_runs, &synthesis))
+			{
+				long nb_samples= file_size(output) / 2;
+
+				print_result(stdout, targets[t], voice, &info, (t == 1) ? 1 : nb_workers,
+							 nb_runs, startup.wall, &synthesis, nb_samples);
+				if (out)
+					print_result(out, targets[t], voice, &info, (t == 1) ? 1 : nb_workers,
+								 nb_runs, startup.wall, &synthesis, nb_samples);
+			}
+			else
+				failed=1;
+		}
+		else
+			failed=1;
+		free(program);
+	}
+
+	if (out)
+		fclose(out);
+	remove(startup_pho);
+	remove(output);
+	free(startup_pho);
+	free(output);
+	return failed;
+}
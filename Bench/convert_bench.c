@@ -0,0 +1,203 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  convert_bench.c
+ * Purpose: throughput of the output conversions of move_convert
+ *
+ * 19/10/26: Created
+ *
+ *   USAGE: convert-bench [nb_samples [nb_runs]]
+ *
+ *   For LIN8, ULAW and ALAW, first checks that move_convert gives the same
+ *   bytes as the sample per sample reference (linear2lin8, linear2ulaw,
+ *   linear2alaw) on the 65536 possible samples, then times both on a
+ *   buffer of nb_samples speech-like samples converted nb_runs times.
+ *   The figures depend on the optimization flags of the Makefile.
+ */
+
+#define LIBRARY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+#include "audio.h"
+#include "g711.h"
+
+/* From audio.c, not exported by audio.h */
+int8 linear2lin8(int16 lin);
+
+typedef struct
+{
+	char* name;
+	AudioType type;
+} Conversion;
+
+static Conversion conversions[]= {
+	{ "LIN8", LIN8 },
+	{ "ULAW", ULAW },
+	{ "ALAW", ALAW },
+	{ NULL, LIN16 }
+};
+
+static void reference_convert(uint8* out, int16* in, int nb, AudioType type)
+/* The per sample conversions move_convert used before the tables */
+{
+	int i;
+
+	switch (type)
+    {
+    case LIN8:
+		for (i=0; i<nb; i++)
+			out[i]= (uint8) linear2lin8(in[i]);
+		break;
+    case ULAW:
+		for (i=0; i<nb; i++)
+			out[i]= linear2ulaw(in[i]);
+		break;
+    case ALAW:
+		for (i=0; i<nb; i++)
+			out[i]= linear2alaw(in[i]);
+		break;
+    default:
+		break;
+    }
+}
+
+static int check_all_samples(AudioType type)
+/* Number of the 65536 samples move_convert gets wrong */
+{
+	int16* in= (int16*) malloc(65536 * sizeof(int16));
+	uint8* ref= (uint8*) malloc(65536);
+	uint8* out= (uint8*) malloc(65536);
+	int i, errors=0;
+
+	for (i=0; i<65536; i++)
+		in[i]= (int16) (i - 32768);
+
+	reference_convert(ref, in, 65536, type);
+	move_convert(out, in, 65536, type);
+
+	for (i=0; i<65536; i++)
+		if (ref[i] != out[i])
+		{
+			if (errors < 5)
+				fprintf(stderr, "  sample %i: %02x instead of %02x\n",
+						in[i], out[i], ref[i]);
+			errors++;
+		}
+
+	free(in);
+	free(ref);
+	free(out);
+	return errors;
+}
+
+static void speech_like(int16* buffer, int nb)
+/*
+ * Deterministic noise under a slowly varying envelope: most samples are
+ * small, a few reach the saturation, as in a synthesized voice
+ */
+{
+	unsigned long seed= 12345;
+	double envelope= 0.0;
+	int i;
+
+	for (i=0; i<nb; i++)
+    {
+		double noise;
+
+		seed= (seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+		noise= ((double) (seed >> 8) / (double) 0x7FFFFF) - 1.0;
+
+		if ((i % 4000) == 0)
+			envelope= (double) ((i / 4000) % 9) / 8.0;
+		buffer[i]= (int16) (noise * envelope * 32767.0);
+    }
+}
+
+static double seconds(clock_t start)
+/* CPU time since start */
+{ return (double) (clock() - start) / CLOCKS_PER_SEC; }
+
+int main(int argc, char **argv)
+{
+	int nb_samples= (argc > 1) ? atoi(argv[1]) : (1 << 20);
+	int nb_runs= (argc > 2) ? atoi(argv[2]) : 50;
+	int16* in;
+	uint8* out;
+	unsigned long checksum=0;
+	int failed=0;
+	int c, run;
+
+	if ((nb_samples <= 0) || (nb_runs <= 0))
+    {
+		fprintf(stderr, "USAGE: %s [nb_samples [nb_runs]]\n", argv[0]);
+		return 1;
+    }
+
+	in= (int16*) malloc(nb_samples * sizeof(int16));
+	out= (uint8*) malloc(nb_samples);
+	speech_like(in, nb_samples);
+
+	printf("%-6s %12s %12s %8s\n", "type", "ref Msamp/s", "new Msamp/s", "speedup");
+	for (c=0; conversions[c].name; c++)
+    {
+		AudioType type= conversions[c].type;
+		int errors= check_all_samples(type);
+		double ref_time, new_time;
+		double total= (double) nb_samples * nb_runs / 1e6;
+		clock_t start;
+
+		if (errors)
+		{
+			printf("%-6s %i samples differ from the reference\n",
+				   conversions[c].name, errors);
+			failed=1;
+			continue;
+		}
+
+		start= clock();
+		for (run=0; run<nb_runs; run++)
+		{
+			reference_convert(out, in, nb_samples, type);
+			checksum+= out[run % nb_samples];
+		}
+		ref_time= seconds(start);
+
+		start= clock();
+		for (run=0; run<nb_runs; run++)
+		{
+			move_convert(out, in, nb_samples, type);
+			checksum+= out[run % nb_samples];
+		}
+		new_time= seconds(start);
+
+		printf("%-6s %12.1f %12.1f %7.1fx\n", conversions[c].name,
+			   (ref_time > 0) ? total / ref_time : 0.0,
+			   (new_time > 0) ? total / new_time : 0.0,
+			   (new_time > 0) ? ref_time / new_time : 0.0);
+    }
+
+	/* Keeps the conversions alive whatever the optimizer */
+	printf("checksum %lu\n", checksum);
+
+	free(in);
+	free(out);
+	return failed;
+}
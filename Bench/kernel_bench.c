@@ -0,0 +1,733 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  kernel_bench.c
+ * Purpose: speed of the kernels of the engine, one at a time
+ *
+ * 19/10/26: Created
+ *
+ *   USAGE: kernel-bench [-p period] [-f freq] [-F pitch] [-n frames]
+ *                       [-t v|u|m] [-d diphones] [-u phones] [-b block]
+ *                       [-m ms] [-k level] [-w 0|1] [-o results] [kernel...]
+ *
+ *   Times OverLapAdd, OverLapAddFrames, MatchProsody, GetPitchPeriod,
+ *   Concat, search_HashTab, FillCommandBuffer and move_convert (one line
+ *   per AudioType) on inputs built in memory, without a voice: an engine
+ *   on a database of MBRPeriod -p and Freq -f, whose diphones have -n
+ *   frames of type -t (voiced, unvoiced, or mixed: unvoiced, then a
+ *   transition and voiced frames), synthesized at -F Hz. search_HashTab looks up the -d diphones of a
+ *   table, FillCommandBuffer reads -u phones (the last one has the pitch
+ *   point), move_convert converts blocks of -b samples.
+ *
+ *   Each kernel runs until -m milliseconds are spent (200 by default),
+ *   and the best of 3 runs is printed: ns per call, and cycles per call
+ *   and per sample when the CPU has a time stamp counter (rdtsc, reference
+ *   cycles: turbo and power saving make them differ from the core clock).
+ *   The samples of a call are the samples it produces: the shift of an
+ *   OverLapAdd frame, the frames of an OverLapAddFrames run (several
+ *   when -F is -f/-p), the length of the diphone for MatchProsody, the
+ *   period returned by GetPitchPeriod, the smoothing vector of Concat, the
+ *   block of move_convert. With -o, one JSON object per kernel is appended
+ *   to the results file, to follow the figures over time. Only the named
+ *   kernels run if any (e.g. "OverLapAdd move_convert").
+ *
+ *   OverLapAdd runs with the inner loops the engine selects for the CPU,
+ *   or those of -k (scalar, sse4.1, avx2, avx512), to compare them. With
+ *   -w 1 it adds frames windowed by the database (window_Database).
+ *
+ * 19/10/26: OverLapAddFrames, runs of frames at the period of the database
+ */
+
+#define LIBRARY
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "audio.h"
+#include "diphone.h"
+#include "database.h"
+#include "hash_tab.h"
+#include "mbrola.h"
+#include "fifo.h"
+#include "input_fifo.h"
+#include "phonbuff.h"
+
+/* From phonbuff.c, not exported by phonbuff.h */
+StatePhone FillCommandBuffer(PhoneBuff *pt);
+
+/* Frame types of the diphones (-t) */
+#define VOICED 'v'
+#define UNVOICED 'u'
+#define MIXED 'm'
+
+/* Options of the run */
+typedef struct
+{
+	int period;          /* MBRPeriod of the database */
+	int freq;            /* Freq of the database */
+	float pitch;         /* F0 of the phones, in Hz */
+	int nb_frames;       /* Analysis frames of a diphone */
+	int type;            /* VOICED, UNVOICED or MIXED */
+	int nb_diphones;     /* Size of the hash table */
+	int nb_phones;       /* Phones read by a FillCommandBuffer call */
+	int block;           /* Samples of a move_convert call */
+	double min_time;     /* Seconds of a run */
+	int level;           /* KernelLevel of the engine, -1 for its default */
+	int windowed;        /* True for the frames of window_Database */
+} Shape;
+
+/* Everything the kernels work on */
+typedef struct
+{
+	Shape shape;
+
+	/* Engine and diphones */
+	Database dba;
+	DiphoneInfo info;
+	uint8* pmrk;
+	float* frames;       /* Windowed frames of the database, NULL if none */
+	Mbrola* mb;
+	int length1;         /* Length1 and Length2 of the diphones */
+	int length2;
+	int cur_sample;      /* GetPitchPeriod position */
+	int frame;           /* Next OverLapAdd frame */
+
+	/* search_HashTab */
+	HashTab* table;
+	char** lefts;
+	char** rights;
+	int next_lookup;
+	int found;
+
+	/* FillCommandBuffer */
+	Fifo* fifo;
+	Input* input;
+	PhoneBuff* phones;
+	char* pho;
+
+	/* move_convert */
+	int16* samples;
+	void* converted;
+	AudioType sample_type;
+} Bench;
+
+/* Runs nb_calls calls of a kernel, returns the samples produced */
+typedef double (*KernelFunction)(Bench* b, long nb_calls);
+
+typedef struct
+{
+	char* name;
+	KernelFunction run;
+	AudioType sample_type;   /* For move_convert */
+} Kernel;
+
+static unsigned long seed=12345;
+
+static int random_int(int range)
+/* Same inputs on any machine */
+{
+	seed= (seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+	return (int) ((seed >> 8) % (unsigned long) range);
+}
+
+static double now(void)
+/* Monotonic clock in seconds */
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define HAS_TICKS True
+
+static double ticks(void)
+/* Time stamp counter */
+{
+	unsigned int low, high;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (low), "=d" (high));
+	return (double) high * 4294967296.0 + low;
+}
+
+#else
+
+#define HAS_TICKS False
+
+static double ticks(void)
+{ return 0.0; }
+
+#endif
+
+static FrameType frame_type(Shape* shape, int i)
+/* Type of the frame i of the diphones, from 0 */
+{
+	switch (shape->type)
+    {
+    case UNVOICED:
+		return NV_REG;
+    case MIXED:
+		if (i < shape->nb_frames/4)
+			return NV_REG;
+		if (i == shape->nb_frames/4)
+			return V_TRA;
+		return V_REG;
+    default:
+		return V_REG;
+    }
+}
+
+static Phone* make_phone(Bench* b, char* name)
+/* Phone of two half diphones, flat pitch */
+{
+	Phone* ph= init_Phone(name, (b->length1 + b->length2) * 1000.0f / b->shape.freq);
+
+	appendf0_Phone(ph, 0.0f, b->shape.pitch);
+	appendf0_Phone(ph, 100.0f, b->shape.pitch);
+	return ph;
+}
+
+static void fill_diphone(Bench* b, DiphoneSynthesis* ds, Phone* left, Phone* right)
+/* What getdiphone_Database and NextDiphone give for the synthetic diphone */
+{
+	Shape* shape= &b->shape;
+	int i, k;
+
+	LeftPhone(ds)= left;
+	RightPhone(ds)= right;
+	Length1(ds)= b->length1;
+	Length2(ds)= b->length2;
+	Descriptor(ds)= &b->info;
+	ds->p_pmrk= b->pmrk;
+	ds->p_pmrk_offset= 0;
+	smooth(ds)= False;
+	tot_frame(ds)= shape->nb_frames;
+
+	for (i=1; i<=shape->nb_frames; i++)
+		real_frame(ds)[i]= i;
+
+	/* A pulse per voiced frame, noise in the unvoiced ones, and a spare frame */
+	for (i=0; i<=shape->nb_frames; i++)
+		for (k=0; k<shape->period; k++)
+		{
+			int16* sample= &buffer(ds)[i*shape->period + k];
+
+			if ((i < shape->nb_frames) && (frame_type(shape, i) & VOICING_MASK))
+				*sample= (int16) ((k < shape->period/4) ? 6000 - 24000 * k / shape->period
+								  : -1000 * (k % 7) + 3000);
+			else
+				*sample= (int16) (random_int(8001) - 4000);
+		}
+}
+
+static void window_frames(Bench* b)
+/* What window_Database gives for the synthetic diphone */
+{
+	int period= b->shape.period;
+	float* hanning= (float*) MBR_malloc(2 * period * sizeof(float));
+	int16* samples= buffer(prev_diph(b->mb));
+	int i, k;
+
+	init_Hanning(hanning, 2*period, 1.0f);
+	for (i=0; i<b->shape.nb_frames; i++)
+		for (k=0; k<2*period; k++)
+			b->frames[i*2*period + k]= hanning[k] * (float)
+				samples[i*period + ((frame_type(&b->shape, i) & VOICING_MASK) ? k % period : k)];
+	MBR_free(hanning);
+}
+
+static void init_engine(Bench* b)
+/* Engine on a database of one diphone, prosody matched once */
+{
+	Shape* shape= &b->shape;
+	Database* dba= &b->dba;
+	Phone *a, *m, *z;
+	int nb_bytes= (shape->nb_frames + 3) / 4;
+	int i;
+
+	memset(dba, 0, sizeof(Database));
+	Freq(dba)= shape->freq;
+	MBRPeriod(dba)= shape->period;
+	max_frame(dba)= shape->nb_frames;
+	max_samples(dba)= (shape->nb_frames + 1) * shape->period;
+	sil_phon(dba)= "_";
+
+	/* 4 frame types of 2 bits in each byte */
+	b->pmrk= (uint8*) MBR_malloc(nb_bytes);
+	memset(b->pmrk, 0, nb_bytes);
+	for (i=0; i<shape->nb_frames; i++)
+		b->pmrk[i/4]|= frame_type(shape, i) << (2 * (i%4));
+
+	b->info.nb_frame= shape->nb_frames;
+	b->info.halfseg= shape->nb_frames * shape->period / 2;
+	b->length1= b->info.halfseg;
+	b->length2= shape->nb_frames * shape->period - b->info.halfseg;
+
+	/* Filled with the diphone, the engine only checks them at init_Mbrola */
+	if (shape->windowed)
+		b->frames= (float*) MBR_malloc(shape->nb_frames * 2 * shape->period * sizeof(float));
+	windowed(dba)= b->frames;
+
+	b->mb= init_Mbrola(dba);
+	if (shape->level >= 0)
+		set_kernels_Mbrola(b->mb, (KernelLevel) shape->level);
+
+	/* prev_diph a-m and cur_diph m-z share the phone m */
+	a= make_phone(b, "a");
+	m= make_phone(b, "m");
+	z= make_phone(b, "z");
+	fill_diphone(b, prev_diph(b->mb), a, m);
+	fill_diphone(b, cur_diph(b->mb), m, z);
+	if (b->frames)
+		window_frames(b);
+
+	MatchProsody(b->mb);
+	nb_pm(cur_diph(b->mb))= nb_pm(prev_diph(b->mb));
+	Concat(b->mb);
+	b->frame= 1;
+}
+
+static void close_engine(Bench* b)
+{
+	close_Mbrola(b->mb);
+	MBR_free(b->pmrk);
+	if (b->frames)
+		MBR_free(b->frames);
+}
+
+static double run_MatchProsody(Bench* b, long nb_calls)
+{
+	Mbrola* mb= b->mb;
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+    {
+		/* No time drift from a call to the next */
+		last_time_crumb(mb)= 0;
+		Length1(prev_diph(mb))= b->length1;
+		MatchProsody(mb);
+    }
+	return (double) nb_calls * (b->length1 + b->length2);
+}
+
+static double run_GetPitchPeriod(Bench* b, long nb_calls)
+{
+	DiphoneSynthesis* ds= prev_diph(b->mb);
+	int end= b->length1 + b->length2;
+	double nb_samples=0.0;
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+    {
+		int period= GetPitchPeriod(ds, b->cur_sample, b->shape.freq);
+
+		nb_samples+= period;
+		b->cur_sample+= period;
+		if (b->cur_sample >= end)
+			b->cur_sample= 0;
+    }
+	return nb_samples;
+}
+
+static double run_Concat(Bench* b, long nb_calls)
+{
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+		Concat(b->mb);
+	return (smooth(cur_diph(b->mb))) ? (double) nb_calls * 2 * b->shape.period : 0.0;
+}
+
+static double run_OverLapAdd(Bench* b, long nb_calls)
+{
+	Mbrola* mb= b->mb;
+	double nb_samples=0.0;
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+    {
+		OverLapAdd(mb, b->frame);
+		nb_samples+= frame_pos(mb)[b->frame] - frame_pos(mb)[b->frame-1];
+		if (++b->frame > nb_pm(prev_diph(mb)))
+			b->frame= 1;
+    }
+	return nb_samples;
+}
+
+static double run_OverLapAddFrames(Bench* b, long nb_calls)
+{
+	Mbrola* mb= b->mb;
+	double nb_samples=0.0;
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+    {
+		int nb= OverLapAddFrames(mb, b->frame);
+
+		nb_samples+= frame_pos(mb)[b->frame+nb-1] - frame_pos(mb)[b->frame-1];
+		b->frame+= nb;
+		if (b->frame > nb_pm(prev_diph(mb)))
+			b->frame= 1;
+    }
+	return nb_samples;
+}
+
+static void init_table(Bench* b)
+/* Hash table of nb_diphones diphones, looked up in a random order */
+{
+	int nb= b->shape.nb_diphones;
+	int nb_names=1;
+	int i;
+
+	while (nb_names * nb_names < nb)
+		nb_names++;
+
+	b->table= init_HashTab(nb + nb/4);
+	b->lefts= (char**) MBR_malloc(nb * sizeof(char*));
+	b->rights= (char**) MBR_malloc(nb * sizeof(char*));
+	for (i=0; i<nb; i++)
+    {
+		b->lefts[i]= (char*) MBR_malloc(8);
+		b->rights[i]= (char*) MBR_malloc(8);
+		sprintf(b->lefts[i], "p%i", i / nb_names);
+		sprintf(b->rights[i], "p%i", i % nb_names);
+		add_HashTab(b->table, b->lefts[i], b->rights[i], 0, 0, 0, 0);
+    }
+
+	for (i=nb-1; i>0; i--)
+    {
+		int j= random_int(i+1);
+		char* left= b->lefts[i];
+		char* right= b->rights[i];
+
+		b->lefts[i]= b->lefts[j];
+		b->rights[i]= b->rights[j];
+		b->lefts[j]= left;
+		b->rights[j]= right;
+    }
+}
+
+static void close_table(Bench* b)
+{
+	int i;
+
+	for (i=0; i<b->shape.nb_diphones; i++)
+    {
+		MBR_free(b->lefts[i]);
+		MBR_free(b->rights[i]);
+    }
+	MBR_free(b->lefts);
+	MBR_free(b->rights);
+	close_HashTab(b->table);
+}
+
+static double run_search_HashTab(Bench* b, long nb_calls)
+{
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+    {
+		if (search_HashTab(b->table, b->lefts[b->next_lookup], b->rights[b->next_lookup]) >= 0)
+			b->found++;
+		if (++b->next_lookup == b->shape.nb_diphones)
+			b->next_lookup= 0;
+    }
+	return 0.0;
+}
+
+static void init_phones(Bench* b)
+/* Parser on a fifo, and the phones of a call */
+{
+	int i;
+
+	b->fifo= init_Fifo(FIFO_SIZE);
+	b->input= init_InputFifo(b->fifo);
+	b->phones= init_PhoneBuff(b->input, "_", b->shape.pitch, 1.0f, 1.0f, NULL, NULL);
+
+	b->pho= (char*) MBR_malloc(b->shape.nb_phones * 32 + 1);
+	b->pho[0]= 0;
+	for (i=1; i<b->shape.nb_phones; i++)
+		strcat(b->pho, "a 80\n");
+	sprintf(b->pho + strlen(b->pho), "a 80 50 %i\n", (int) b->shape.pitch);
+}
+
+static void close_phones(Bench* b)
+{
+	close_PhoneBuff(b->phones);
+	b->input->close_Input(b->input);
+	close_Fifo(b->fifo);
+	MBR_free(b->pho);
+}
+
+static double run_FillCommandBuffer(Bench* b, long nb_calls)
+{
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+    {
+		write_Fifo(b->fifo, b->pho);
+		FillCommandBuffer(b->phones);
+		reset_PhoneBuff(b->phones);
+    }
+	return 0.0;
+}
+
+static double run_move_convert(Bench* b, long nb_calls)
+{
+	long i;
+
+	for (i=0; i<nb_calls; i++)
+		move_convert(b->converted, b->samples, b->shape.block, b->sample_type);
+	return (double) nb_calls * b->shape.block;
+}
+
+static Kernel kernels[]= {
+	{ "OverLapAdd", run_OverLapAdd, LIN16 },
+	{ "OverLapAddFrames", run_OverLapAddFrames, LIN16 },
+	{ "MatchProsody", run_MatchProsody, LIN16 },
+	{ "GetPitchPeriod", run_GetPitchPeriod, LIN16 },
+	{ "Concat", run_Concat, LIN16 },
+	{ "search_HashTab", run_search_HashTab, LIN16 },
+	{ "FillCommandBuffer", run_FillCommandBuffer, LIN16 },
+	{ "move_convert", run_move_convert, LIN16 },
+	{ "move_convert", run_move_convert, LIN8 },
+	{ "move_convert", run_move_convert, ULAW },
+	{ "move_convert", run_move_convert, ALAW },
+	{ "move_convert", run_move_convert, FLOAT32 },
+	{ "move_convert", run_move_convert, LIN24 },
+	{ NULL, NULL, LIN16 }
+};
+
+static char* type_name(AudioType type)
+{
+	static char* names[]= { "LIN16", "LIN8", "ULAW", "ALAW", "FLOAT32", "LIN24" };
+	return names[type];
+}
+
+static void measure(Bench* b, Kernel* k, double* ns_call, double* ticks_call, double* samples_call)
+/*
+ * Best of 3 runs of at least min_time seconds. The number of calls of a
+ * run doubles until it is long enough
+ */
+{
+	long nb_calls=1;
+	int run;
+
+	*ns_call= -1.0;
+	for (run=0; run<3; run++)
+    {
+		double start, start_ticks, elapsed, elapsed_ticks, nb_samples;
+
+		for (;;)
+		{
+			start_ticks= ticks();
+			start= now();
+			nb_samples= k->run(b, nb_calls);
+			elapsed= now() - start;
+			elapsed_ticks= ticks() - start_ticks;
+
+			if ((elapsed >= b->shape.min_time) || (nb_calls > (1L << 40)))
+				break;
+			nb_calls*= 2;
+		}
+
+		if ((*ns_call < 0.0) || (elapsed * 1e9 / nb_calls < *ns_call))
+		{
+			*ns_call= elapsed * 1e9 / nb_calls;
+			*ticks_call= elapsed_ticks / nb_calls;
+			*samples_call= nb_samples / nb_calls;
+		}
+    }
+}
+
+static void print_result(FILE* out, Bench* b, char* name, double ns_call,
+						 double ticks_call, double samples_call)
+/* One JSON object on one line */
+{
+	Shape* shape= &b->shape;
+
+	fprintf(out, "{\"kernel\":\"%s\",\"version\":\"%s\",\"period\":%i,\"freq\":%i,"
+			"\"pitch\":%g,\"frames\":%i,\"type\":\"%c\",\"diphones\":%i,\"phones\":%i,"
+			"\"block\":%i,\"kernels\":\"%s\",\"windowed\":%s,\"ns_per_call\":%.3f,"
+			"\"samples_per_call\":%.2f",
+			name, SYNTH_VERSION, shape->period, shape->freq, shape->pitch,
+			shape->nb_frames, shape->type, shape->nb_diphones, shape->nb_phones,
+			shape->block, name_KernelLevel(get_kernels_Mbrola(b->mb)),
+			shape->windowed ? "true" : "false", ns_call, samples_call);
+	if (HAS_TICKS)
+    {
+		fprintf(out, ",\"cycles_per_call\":%.2f", ticks_call);
+		if (samples_call > 0)
+			fprintf(out, ",\"cycles_per_sample\":%.4f", ticks_call / samples_call);
+    }
+	fprintf(out, "}\n");
+}
+
+static bool selected(Kernel* k, char** names, int nb_names)
+/* No names means all the kernels */
+{
+	int i;
+
+	for (i=0; i<nb_names; i++)
+		if (strcmp(names[i], k->name) == 0)
+			return True;
+	return nb_names == 0;
+}
+
+int main(int argc, char **argv)
+{
+	Bench b;
+	Shape* shape= &b.shape;
+	char* results=NULL;
+	FILE* out=NULL;
+	int first_name;
+	int i;
+
+	memset(&b, 0, sizeof(b));
+	shape->period= 80;
+	shape->freq= 16000;
+	shape->pitch= 120.0f;
+	shape->nb_frames= 20;
+	shape->type= VOICED;
+	shape->nb_diphones= 1024;
+	shape->nb_phones= 4;
+	shape->block= 4096;
+	shape->min_time= 0.2;
+	shape->level= -1;
+
+	for (i=1; (i+1 < argc) && (argv[i][0] == '-'); i+=2)
+    {
+		switch (argv[i][1])
+		{
+		case 'p': shape->period= atoi(argv[i+1]); break;
+		case 'f': shape->freq= atoi(argv[i+1]); break;
+		case 'F': shape->pitch= (float) atof(argv[i+1]); break;
+		case 'n': shape->nb_frames= atoi(argv[i+1]); break;
+		case 't': shape->type= argv[i+1][0]; break;
+		case 'd': shape->nb_diphones= atoi(argv[i+1]); break;
+		case 'u': shape->nb_phones= atoi(argv[i+1]); break;
+		case 'b': shape->block= atoi(argv[i+1]); break;
+		case 'm': shape->min_time= atof(argv[i+1]) / 1000.0; break;
+		case 'k': shape->level= parse_KernelLevel(argv[i+1]); if (shape->level < 0) i= argc; break;
+		case 'w': shape->windowed= atoi(argv[i+1]); break;
+		case 'o': results= argv[i+1]; break;
+		default: i= argc; break;
+		}
+    }
+
+	first_name= i;
+
+	/* Sizes on 16 and 8 bits of the database, NBRE_PM_MAX frames */
+	if ((i > argc) || (shape->period < 8) || (shape->period > 255)
+		|| (shape->freq < 1000) || (shape->freq > 32767)
+		|| (shape->pitch < 20.0f) || (shape->pitch > 1000.0f)
+		|| (shape->nb_frames < 4) || (shape->nb_frames > 255)
+		|| ((shape->nb_frames + 1) * shape->period > 32767)
+		|| (shape->nb_frames * shape->period * shape->pitch / shape->freq > NBRE_PM_MAX - 4)
+		|| ((shape->type != VOICED) && (shape->type != UNVOICED) && (shape->type != MIXED))
+		|| (shape->nb_diphones < 1) || (shape->nb_diphones > 26000)
+		|| (shape->nb_phones < 1) || (shape->nb_phones > MAXNPHONESINONESHOT - 8)
+		|| (shape->block < 1) || (shape->min_time <= 0.0)
+		|| (shape->windowed < 0) || (shape->windowed > 1))
+    {
+		fprintf(stderr, "USAGE: %s [-p period] [-f freq] [-F pitch] [-n frames] [-t v|u|m]\n"
+				"       [-d diphones] [-u phones] [-b block] [-m ms] [-k level] [-w 0|1]\n"
+				"       [-o results] [kernel...]\n",
+				argv[0]);
+		return 1;
+    }
+
+	if ((shape->level >= 0) && !supported_KernelLevel((KernelLevel) shape->level))
+    {
+		fprintf(stderr, "This CPU has no %s kernels\n", name_KernelLevel((KernelLevel) shape->level));
+		return 1;
+    }
+
+	if (results && !(out= fopen(results, "a")))
+    {
+		fprintf(stderr, "Can't write %s\n", results);
+		return 1;
+    }
+
+	init_engine(&b);
+	init_table(&b);
+	init_phones(&b);
+	b.samples= (int16*) MBR_malloc(shape->block * sizeof(int16));
+	b.converted= MBR_malloc(shape->block * sizeof(float));
+	for (i=0; i<shape->block; i++)
+		b.samples[i]= buffer(prev_diph(b.mb))[i % (shape->nb_frames * shape->period)];
+
+	printf("Inner loops: %s%s\n", name_KernelLevel(get_kernels_Mbrola(b.mb)),
+		   shape->windowed ? ", windowed frames" : "");
+	printf("%-26s %12s %12s %12s %12s\n", "kernel", "ns/call", "cycles/call",
+		   "samples/call", "cycles/samp");
+	for (i=0; kernels[i].name; i++)
+    {
+		Kernel* k= &kernels[i];
+		char name[64];
+		double ns_call=0.0, ticks_call=0.0, samples_call=0.0;
+
+		if (!selected(k, &argv[first_name], argc - first_name))
+			continue;
+
+		strcpy(name, k->name);
+		if (k->run == run_move_convert)
+			sprintf(name, "%s %s", k->name, type_name(k->sample_type));
+		b.sample_type= k->sample_type;
+
+		measure(&b, k, &ns_call, &ticks_call, &samples_call);
+
+		printf("%-26s %12.1f", name, ns_call);
+		if (HAS_TICKS)
+			printf(" %12.1f", ticks_call);
+		else
+			printf(" %12s", "-");
+		if (samples_call > 0)
+			printf(" %12.1f", samples_call);
+		else
+			printf(" %12s", "-");
+		if (HAS_TICKS && (samples_call > 0))
+			printf(" %12.3f\n", ticks_call / samples_call);
+		else
+			printf(" %12s\n", "-");
+
+		if (out)
+			print_result(out, &b, name, ns_call, ticks_call, samples_call);
+    }
+
+	/* Keeps the lookups alive whatever the optimizer */
+	if (b.found < 0)
+		printf("%i\n", b.found);
+
+	if (out)
+		fclose(out);
+	MBR_free(b.samples);
+	MBR_free(b.converted);
+	close_phones(&b);
+	close_table(&b);
+	close_engine(&b);
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  lib_bench.c
+ * Purpose: library counterpart of "mbrola voice input.pho output.raw"
+ *
+ * 19/10/26: Created
+ *
+ *   USAGE: bench-lib1 voice input.pho output.raw
+ *          bench-lib2 [-j workers] voice input.pho output.raw
+ *
+ *   Synthesizes a pho file in 16 bits raw samples, as the standalone
+ *   program does, through one of the libraries: bench-lib1 is built
+ *   with LibOneChannel (write_MBR then push_MBR), bench-lib2 with
+ *   MULTI_CHANNEL and LibMultiChannel (synthesizeSplit_MBR2 on the
+ *   workers of a Scheduler). mbrola-bench times them as processes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#ifdef MULTI_CHANNEL
+#include "multichannel.h"
+#include "scheduler.h"
+#else
+#include "parser_export.h"
+#include "onechannel.h"
+#endif
+
+static char* read_file(char* name)
+/* Whole content of a text file, NULL if it can't be read */
+{
+	FILE* input= fopen(name, "rb");
+	char* text;
+	long size;
+
+	if (!input)
+		return NULL;
+
+	fseek(input, 0, SEEK_END);
+	size= ftell(input);
+	fseek(input, 0, SEEK_SET);
+
+	text= (char*) malloc(size + 1);
+	if (fread(text, 1, size, input) != (size_t) size)
+	{
+		free(text);
+		text= NULL;
+	}
+	else
+		text[size]= 0;
+
+	fclose(input);
+	return text;
+}
+
+#ifdef MULTI_CHANNEL
+
+static int file_sink(void* sink_data, void* buffer, int nb_samples, AudioType sample_type)
+/* Segments delivered in order by synthesizeSplit_MBR2 */
+{
+	if (fwrite(buffer, sizeof(int16), nb_samples, (FILE*) sink_data) != (size_t) nb_samples)
+		return -1;
+	return nb_samples;
+}
+
+static long synthesize(char* voice, char* pho, FILE* output, int nb_workers)
+/* Number of samples, negative means error */
+{
+	Database* dba;
+	Scheduler* sched;
+	long result;
+
+	dba= init_DatabaseMBR2(voice, NULL, NULL);
+	if (!dba)
+		return lastError_MBR2();
+
+	sched= init_SchedulerMBR2(nb_workers);
+	if (!sched)
+	{
+		close_DatabaseMBR2(dba);
+		return lastError_MBR2();
+	}
+
+	result= synthesizeSplit_MBR2(sched, dba, pho, NULL, LIN16, file_sink, output);
+
+	/* The scheduler MUST be closed before the database */
+	close_SchedulerMBR2(sched);
+	close_DatabaseMBR2(dba);
+	return result;
+}
+
+static void print_error(void)
+{
+	char err[255];
+
+	lastErrorStr_MBR2(err, sizeof(err));
+	fprintf(stderr, "Code %i\n%s\n", lastError_MBR2(), err);
+}
+
+#else
+
+static int file_push(void* user_data, PushEvent event, void* buffer, int nb_samples, AudioType sample_type)
+/* Audio of each diphone, as soon as it is rendered */
+{
+	if ((event == PUSH_AUDIO)
+		&& (fwrite(buffer, sizeof(int16), nb_samples, (FILE*) user_data) != (size_t) nb_samples))
+		return 1;
+	return 0;
+}
+
+static long synthesize(char* voice, char* pho, FILE* output, int nb_workers)
+/* Number of samples, negative means error */
+{
+	long result;
+
+	if (init_MBR(voice) < 0)
+		return lastError_MBR();
+
+	/* The input buffer grows on demand */
+	if (write_MBR(pho) != (int) strlen(pho))
+		result= lastError_MBR();
+	else
+		result= push_MBR(file_push, output, LIN16);
+
+	close_MBR();
+	return result;
+}
+
+static void print_error(void)
+{
+	char err[255];
+
+	lastErrorStr_MBR(err, sizeof(err));
+	fprintf(stderr, "Code %i\n%s\n", lastError_MBR(), err);
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+	int nb_workers=0;
+	int first=1;
+	char* pho;
+	FILE* output;
+	long result;
+
+#ifdef MULTI_CHANNEL
+	if ((argc > 2) && (strcmp(argv[1], "-j") == 0))
+	{
+		nb_workers= atoi(argv[2]);
+		first=3;
+	}
+#endif
+
+	if (argc - first != 3)
+	{
+#ifdef MULTI_CHANNEL
+		fprintf(stderr, "USAGE: %s [-j workers] voice input.pho output.raw\n", argv[0]);
+#else
+		fprintf(stderr, "USAGE: %s voice input.pho output.raw\n", argv[0]);
+#endif
+		return 1;
+	}
+
+	pho= read_file(argv[first+1]);
+	if (!pho)
+	{
+		fprintf(stderr, "Can't read %s\n", argv[first+1]);
+		return 1;
+	}
+
+	output= fopen(argv[first+2], "wb");
+	if (!output)
+	{
+		fprintf(stderr, "Can't write %s\n", argv[first+2]);
+		free(pho);
+		return 1;
+	}
+
+	result= synthesize(argv[first], pho, output, nb_workers);
+	if (result < 0)
+		print_error();
+
+	fclose(output);
+	free(pho);
+	return (result < 0) ? 1 : 0;
+}
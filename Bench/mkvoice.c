@@ -0,0 +1,475 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  mkvoice.c
+ * Purpose: synthetic diphone database and pho corpus for the benchmarks
+ *
+ * 19/10/26: Created
+ *
+ *   USAGE: mkvoice [-d diphones] [-p period] [-f freq] [-s seconds]
+ *                  [-u phones] [-S seed] voice corpus.pho
+ *
+ *   Writes a DIPHONE_RAW database of the 2.06 format with the given
+ *   number of diphones, MBRPeriod and Freq, and a pho corpus of about
+ *   the given number of seconds that only uses diphones of that voice:
+ *   utterances of -u phones between silences, ended by a flush. The
+ *   phones are "_" (the silence) and names made of lowercase letters,
+ *   voiced, plosive or unvoiced in turn. The waveforms are periodic or
+ *   noise, they don't sound like speech but go through the same code as
+ *   a real voice. Both files only depend on the options: the same seed
+ *   gives the same files on any machine.
+ *
+ * 19/10/26: voiced phones stable at the junctions, and coloured by the
+ *   other phone of the diphone, so that the engine smooths the junctions
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Kinds of phones, and the frames of their half diphones */
+#define SILENCE 0
+#define VOICED 1
+#define PLOSIVE 2
+#define UNVOICED 3
+
+/* Pitchmark types, see VOICING_MASK in database.h */
+#define UNVOICED_TRANSITION 1
+#define VOICED_STABLE 2
+#define VOICED_TRANSITION 3
+
+/* init_HashTab takes 125% of the diphones on 16 bits */
+#define MAX_DIPHONES 26213
+
+typedef struct
+{
+	int nb_phones;        /* "_" and the letter phones */
+	int nb_diphones;
+	int period;           /* MBRPeriod */
+	int freq;             /* Freq */
+	unsigned long seed;   /* Deterministic noise and corpus */
+} Voice;
+
+static unsigned long next_random(Voice* v)
+/* Portable linear congruential generator, 31 bits */
+{
+	v->seed= (v->seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+	return v->seed >> 8;
+}
+
+static int kind(int phone)
+/* Silence, then voiced, plosive and unvoiced phones in turn */
+{
+	if (phone == 0)
+		return SILENCE;
+	return VOICED + (phone - 1) % 3;
+}
+
+static void phone_name(int phone, char* name)
+/* "_" for the silence, then a, b ... z, ba, bb ... */
+{
+	char digits[8];
+	int nb=0, i;
+
+	if (phone == 0)
+	{
+		strcpy(name, "_");
+		return;
+	}
+
+	phone--;
+	do
+	{
+		digits[nb++]= (char) ('a' + phone % 26);
+		phone/= 26;
+	}
+	while (phone > 0);
+
+	for (i=0; i<nb; i++)
+		name[i]= digits[nb-1-i];
+	name[nb]= 0;
+}
+
+static int half_frames(int phone)
+/* Number of pitchmarks of a half diphone */
+{
+	switch (kind(phone))
+	{
+	case SILENCE: return 6;
+	case VOICED: return 10;
+	case PLOSIVE: return 6;
+	default: return 8;
+	}
+}
+
+static int pitchmark(int phone, int k, int nb, int left_half)
+/*
+ * Type of the pitchmark k out of nb of a half diphone, left_half if the
+ * phone is the left one of the diphone. The voiced phones are stable in
+ * their middle, where the diphones are joined and smoothed
+ */
+{
+	switch (kind(phone))
+	{
+	case VOICED:
+		if (k == ((left_half) ? nb-1 : 0))
+			return VOICED_TRANSITION;
+		return VOICED_STABLE;
+	case PLOSIVE:
+		return (k < nb/2) ? UNVOICED_TRANSITION : VOICED_TRANSITION;
+	default:
+		return (k == 0) ? UNVOICED_TRANSITION : 0;
+	}
+}
+
+/*
+ * The diphones in the order of the database: the ones with a silence
+ * first, so that any phone can be followed by "_", then the others row
+ * by row until nb_diphones, and "_-_" last (the engine expects it there)
+ */
+
+static void diphone_pair(Voice* v, int index, int* left, int* right)
+/* Phones of the diphone number index */
+{
+	int nb_silent= 2 * (v->nb_phones - 1);
+
+	if (index == v->nb_diphones - 1)
+	{
+		*left= *right= 0;
+	}
+	else if (index < nb_silent)
+	{
+		if (index < v->nb_phones - 1)
+		{ *left= 0; *right= index + 1; }
+		else
+		{ *left= index - (v->nb_phones - 1) + 1; *right= 0; }
+	}
+	else
+	{
+		index-= nb_silent;
+		*left= index / (v->nb_phones - 1) + 1;
+		*right= index % (v->nb_phones - 1) + 1;
+	}
+}
+
+static int nb_followers(Voice* v, int left)
+/* Number of phones that can follow left in the corpus ("_" included) */
+{
+	int others= v->nb_diphones - 1 - 2 * (v->nb_phones - 1);
+	int row;
+
+	if (left == 0)
+		return v->nb_phones - 1;
+
+	row= others - (left - 1) * (v->nb_phones - 1);
+	if (row < 0)
+		row= 0;
+	if (row > v->nb_phones - 1)
+		row= v->nb_phones - 1;
+	return row + 1;
+}
+
+static void write_int16(FILE* out, int value)
+/* Little endian, as the databases on file */
+{
+	fputc(value & 0xFF, out);
+	fputc((value >> 8) & 0xFF, out);
+}
+
+static void write_int32(FILE* out, long value)
+{
+	write_int16(out, (int) (value & 0xFFFF));
+	write_int16(out, (int) ((value >> 16) & 0xFFFF));
+}
+
+static int diphone_frames(Voice* v, int left, int right, int* types, int* nb_left, int* nb)
+/*
+ * The nb pitchmarks of a diphone in types, nb_left of them for the left
+ * phone. Return the number of frames of the waveform, the
+ * engine counts an extra one at each unvoiced to voiced transition and
+ * after a final unvoiced pitchmark
+ */
+{
+	int nb_right, nb_wave=0, pred=VOICED_STABLE;
+	int k;
+
+	*nb_left= half_frames(left);
+	nb_right= half_frames(right);
+	if ((left == 0) && (right == 0))
+		*nb_left= nb_right= 4;
+
+	*nb=0;
+	for (k=0; k<*nb_left; k++)
+		types[(*nb)++]= pitchmark(left, k, *nb_left, 1);
+	for (k=0; k<nb_right; k++)
+		types[(*nb)++]= pitchmark(right, k, nb_right, 0);
+
+	for (k=0; k<*nb; k++)
+	{
+		if (!(pred & VOICED_STABLE) && (types[k] & VOICED_STABLE))
+			nb_wave++;
+		nb_wave++;
+		pred= types[k];
+	}
+	if (!(pred & VOICED_STABLE))
+		nb_wave++;
+	return nb_wave;
+}
+
+static void write_frame(Voice* v, FILE* out, int phone, int other)
+/*
+ * One MBRPeriod of waveform: a period of a harmonic signal or noise. The
+ * other phone of the diphone colours the voiced periods, as coarticulation
+ * does, so that two diphones differ where they are joined
+ */
+{
+	int harmonic= 1 + phone % 7;
+	int colour= 2 + other % 5;
+	int k;
+
+	for (k=0; k<v->period; k++)
+	{
+		double value;
+
+		if (kind(phone) == VOICED)
+			value= 3000.0 * sin(2.0 * M_PI * k / v->period)
+				+ 2000.0 * sin(2.0 * M_PI * k * harmonic / v->period) * exp(-k / 40.0)
+				+ 600.0 * sin(2.0 * M_PI * k * colour / v->period + other);
+		else
+			value= (double) (next_random(v) % 3001) - 1500.0;
+		write_int16(out, (int) value);
+	}
+}
+
+static int write_voice(Voice* v, char* name)
+/* The database, 0 means error */
+{
+	FILE* out= fopen(name, "wb");
+	int types[64];
+	long size_mrk=0, size_raw=0;
+	int i, k, pass;
+	char info[128];
+
+	if (!out)
+	{
+		fprintf(stderr, "Can't write %s\n", name);
+		return 0;
+	}
+
+	/* Sizes first, the header needs them */
+	for (i=0; i<v->nb_diphones; i++)
+	{
+		int left, right, nb_left, nb, nb_wave;
+
+		diphone_pair(v, i, &left, &right);
+		nb_wave= diphone_frames(v, left, right, types, &nb_left, &nb);
+		size_mrk+= nb;
+		size_raw+= (long) nb_wave * v->period;
+	}
+
+	fwrite("MBROLA", 1, 6, out);
+	fwrite("2.06", 1, 5, out);
+	write_int16(out, v->nb_diphones);
+	write_int16(out, 0);              /* New format, SizeMrk on 32 bits */
+	write_int32(out, size_mrk);
+	write_int32(out, size_raw * 2);
+	write_int16(out, v->freq);
+	fputc(v->period, out);
+	fputc(1, out);                    /* Coding: DIPHONE_RAW */
+
+	/* Index, pitchmarks 4 in one byte, then waveforms */
+	for (pass=0; pass<3; pass++)
+	{
+		int packed=0, nb_packed=0;
+
+		for (i=0; i<v->nb_diphones; i++)
+		{
+			int left, right, nb_left, nb_wave, nb;
+			char left_name[8], right_name[8];
+
+			diphone_pair(v, i, &left, &right);
+			nb_wave= diphone_frames(v, left, right, types, &nb_left, &nb);
+
+			switch (pass)
+			{
+			case 0:
+				phone_name(left, left_name);
+				phone_name(right, right_name);
+				fwrite(left_name, 1, strlen(left_name) + 1, out);
+				fwrite(right_name, 1, strlen(right_name) + 1, out);
+				write_int16(out, nb_left * v->period);
+				fputc(nb, out);
+				fputc(nb_wave, out);
+				break;
+
+			case 1:
+				for (k=0; k<nb; k++)
+				{
+					packed|= types[k] << (2 * nb_packed);
+					if (++nb_packed == 4)
+					{
+						fputc(packed, out);
+						packed= nb_packed= 0;
+					}
+				}
+				break;
+
+			default:
+				for (k=0; k<nb_wave; k++)
+				{
+					if (k < nb_left)
+						write_frame(v, out, left, right);
+					else
+						write_frame(v, out, right, left);
+				}
+				break;
+			}
+		}
+		if ((pass == 1) && (nb_packed > 0))
+			fputc(packed, out);
+	}
+
+	sprintf(info, "Synthetic benchmark voice: %i diphones, %i Hz, period %i",
+			v->nb_diphones, v->freq, v->period);
+	fwrite(info, 1, strlen(info) + 1, out);
+
+	if (fclose(out) != 0)
+	{
+		fprintf(stderr, "Can't write %s\n", name);
+		return 0;
+	}
+	return 1;
+}
+
+static int write_corpus(Voice* v, char* name, double seconds, int nb_per_utterance)
+/*
+ * Utterances of random walks on the diphones of the voice, with
+ * durations from 50 to 150 ms and pitch targets on the voiced phones.
+ * 0 means error
+ */
+{
+	FILE* out= fopen(name, "w");
+	double total=0.0;
+	char phone[8];
+
+	if (!out)
+	{
+		fprintf(stderr, "Can't write %s\n", name);
+		return 0;
+	}
+
+	fprintf(out, "; Synthetic corpus, %i diphones, about %.0f s\n",
+			v->nb_diphones, seconds);
+	while (total < seconds * 1000.0)
+	{
+		int current=0, i;
+
+		fprintf(out, "_ 100\n");
+		total+= 100.0;
+		for (i=0; i<nb_per_utterance; i++)
+		{
+			int duration= 50 + (int) (next_random(v) % 101);
+			int choice= (int) (next_random(v) % nb_followers(v, current));
+
+			/* The followers of a phone are its row, then "_" */
+			if (current == 0)
+				current= choice + 1;
+			else if (choice == nb_followers(v, current) - 1)
+				current= 0;
+			else
+				current= choice + 1;
+
+			phone_name(current, phone);
+			if (kind(current) == VOICED)
+				fprintf(out, "%s %i 50 %i\n", phone, duration,
+						80 + (int) (next_random(v) % 121));
+			else
+				fprintf(out, "%s %i\n", phone, duration);
+			total+= duration;
+		}
+		fprintf(out, "_ 200\n#\n");
+		total+= 200.0;
+	}
+
+	if (fclose(out) != 0)
+	{
+		fprintf(stderr, "Can't write %s\n", name);
+		return 0;
+	}
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	Voice voice;
+	double seconds= 300.0;
+	int nb_per_utterance= 30;
+	int i;
+
+	voice.nb_diphones= 1024;
+	voice.period= 160;
+	voice.freq= 16000;
+	voice.seed= 12345;
+
+	for (i=1; (i < argc-2) && (argv[i][0] == '-'); i+=2)
+	{
+		switch (argv[i][1])
+		{
+		case 'd': voice.nb_diphones= atoi(argv[i+1]); break;
+		case 'p': voice.period= atoi(argv[i+1]); break;
+		case 'f': voice.freq= atoi(argv[i+1]); break;
+		case 's': seconds= atof(argv[i+1]); break;
+		case 'u': nb_per_utterance= atoi(argv[i+1]); break;
+		case 'S': voice.seed= (unsigned long) atol(argv[i+1]) & 0x7FFFFFFFUL; break;
+		default: i= argc; break;
+		}
+	}
+
+	/* The smallest phone set with that many diphones */
+	voice.nb_phones= 1;
+	while (voice.nb_phones * voice.nb_phones < voice.nb_diphones)
+		voice.nb_phones++;
+
+	if ((i != argc-2)
+		|| (voice.nb_diphones < 4) || (voice.nb_diphones > MAX_DIPHONES)
+		|| (voice.nb_diphones < 2 * voice.nb_phones - 1)
+		|| (voice.period < 16) || (voice.period > 255)
+		|| (voice.freq < 1000) || (voice.freq > 32767)
+		|| (seconds <= 0.0) || (nb_per_utterance < 1))
+	{
+		fprintf(stderr,
+				"USAGE: %s [-d diphones] [-p period] [-f freq] [-s seconds]\n"
+				"          [-u phones] [-S seed] voice corpus.pho\n"
+				"  4 <= diphones <= %i (1024), 16 <= period <= 255 (160),\n"
+				"  1000 <= freq <= 32767 (16000), 300 seconds of 30 phone utterances\n",
+				argv[0], MAX_DIPHONES);
+		return 1;
+	}
+
+	if (!write_voice(&voice, argv[argc-2])
+		|| !write_corpus(&voice, argv[argc-1], seconds, nb_per_utterance))
+		return 1;
+
+	printf("%s: %i diphones on %i phones, %i Hz, period %i\n",
+		   argv[argc-2], voice.nb_diphones, voice.nb_phones, voice.freq, voice.period);
+	return 0;
+}
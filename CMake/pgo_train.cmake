@@ -0,0 +1,39 @@
+# Training run of the MBROLA_PGO=GENERATE build (target pgo-train): the
+# instrumented programs synthesize the bench corpus of Bench/mkvoice.c
+# as the Makefile "bench" target does, the standalone program and both
+# libraries, sequential and split on threads. Their profiles are written
+# in PGO_DIR, and merged for Clang.
+#
+# Variables: MKVOICE MBROLA BENCH_LIB1 BENCH_LIB2 BENCH_VOICE WORKDIR
+#            PGO_DIR THREADS LLVM_PROFDATA
+
+function(run)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+  if(result)
+    message(FATAL_ERROR "Training failed (${result}): ${ARGN}")
+  endif()
+endfunction()
+
+file(MAKE_DIRECTORY ${WORKDIR})
+separate_arguments(voice_options UNIX_COMMAND "${BENCH_VOICE}")
+set(voice ${WORKDIR}/voice)
+set(corpus ${WORKDIR}/corpus.pho)
+set(output ${WORKDIR}/output.raw)
+
+run(${MKVOICE} ${voice_options} ${voice} ${corpus})
+run(${MBROLA} ${voice} ${corpus} ${output})
+run(${BENCH_LIB1} ${voice} ${corpus} ${output})
+if(THREADS)
+  run(${MBROLA} -J 4 ${voice} ${corpus} ${output})
+  run(${BENCH_LIB2} -j 4 ${voice} ${corpus} ${output})
+else()
+  run(${BENCH_LIB2} ${voice} ${corpus} ${output})
+endif()
+file(REMOVE ${output})
+
+if(LLVM_PROFDATA)
+  file(GLOB raw_profiles ${PGO_DIR}/*.profraw)
+  run(${LLVM_PROFDATA} merge -output=${PGO_DIR}/default.profdata ${raw_profiles})
+endif()
+
+message(STATUS "Profiles in ${PGO_DIR}")
@@ -61,11 +61,26 @@
  *            25% extra space in the hashtable enhances search
  *     
  *            Pitchmark in memory are kept compressed (4 in on byte)
+ *
+ * 19/10/26 : copyconstructor also for THREADS builds (parallel standalone)
+ *
+ * 19/10/26 : rom_image field for the databases mapped from shared images
+ *
+ * 19/10/26 : init_rename_Database maps ROM images (.rom or shm:/name)
+ *
+ * 19/10/26 : getdiphone_DatabaseBasic counts the fetches and disk reads
+ *
+ * 19/10/26 : window_Database, frames windowed once for all the synthesis
  */
 #include "common.h"
 #include "little_big.h"
 #include "database.h"
 #include "database_old.h"
+#include "mbrola.h"     /* init_Hanning */
+
+#if defined(ROMDATABASE_IMAGE) && defined(ROMDATABASE_INIT)
+#include "rom_image.h"
+#endif
 
 #ifdef BACON
 #include "database_bacon.h"
@@ -456,6 +471,10 @@ void close_DatabaseBasic(Database* dba)
 	if (sil_phon(dba))
 		MBR_free(sil_phon(dba)); /* silence phoneme, string */
   
+	if (windowed(dba))
+		MBR_free(windowed(dba)); /* close window_Database */
+
+	MBR_free(metrics(dba));
 	MBR_free(dba);
 	debug_message1("done close_DatabaseBasic\n");
 }
@@ -512,10 +531,13 @@ Database* init_Database(char* dbaname)
 	 */
 	dbaname(mydba)=  MBR_strdup(dbaname);
 	mydba->database= NULL;
+	rom_image(mydba)= NULL;
+	windowed(mydba)= NULL;
 	sil_phon(mydba)= NULL;
 	max_frame(mydba)=  0;
 	pmrk(mydba)= NULL;
 	diphone_table(mydba)= NULL;
+	metrics(mydba)= init_DatabaseMetrics();
 	mydba->close_Database= close_DatabaseBasic; /* will be changed depending on the dba type */
 	info(mydba)= init_ZStringList();
   
@@ -552,10 +574,27 @@ Database* init_rename_Database(char* dbaname, ZStringList* rename, ZStringList*
  * but nothing else at run-time
  */
 {
-	Database* mydba= init_Database(dbaname);
+	Database* mydba;
 	PhonemeName new_sil= NULL;
   
 	debug_message1("init_rename_Database\n");
+
+#if defined(ROMDATABASE_IMAGE) && defined(ROMDATABASE_INIT)
+	/* ROM images are used in place, their hash table can't change */
+	if (is_ROM_Image(dbaname))
+    {
+		if ( (rename && nb_elem(rename)) || (clone && nb_elem(clone)) )
+		{
+			fatal_message(ERROR_RENAMING,
+						  "Renaming or cloning is not possible in ROM image %s\n"
+						  "Apply them when building the image\n", dbaname);
+			return NULL;
+		}
+		return init_ROM_Image(dbaname);
+    }
+#endif
+
+	mydba= init_Database(dbaname);
   
 	/* Standard initialization failed ? */
 	if (!mydba)
@@ -627,8 +666,12 @@ bool getdiphone_DatabaseBasic(Database* dba, DiphoneSynthesis *diph)
 				   name_Phone(LeftPhone(diph)),
 				   name_Phone(RightPhone(diph)));
 
+	add_Counter(metrics(dba)->fetches, 1);
 	if (! init_common_Database(dba,diph))
+    {
+		add_Counter(metrics(dba)->missing, 1);
 		return False;
+    }
   
 	debug_message3(" Nbframe : %d,    add : %ld ",
 				   nb_frame_diphone(diph), 
@@ -640,6 +683,7 @@ bool getdiphone_DatabaseBasic(Database* dba, DiphoneSynthesis *diph)
        * We're in ROM, it's as simple as that 
        */
 		buffer(diph)= (int16*) rom_wave_ptr(dba) + pos_wave_diphone(diph);
+		add_Counter(metrics(dba)->memory_hits, 1);
     }
 	else
 #endif /* ROMDATABASE_INIT */
@@ -672,6 +716,7 @@ bool getdiphone_DatabaseBasic(Database* dba, DiphoneSynthesis *diph)
 						  name_Phone(RightPhone(diph)));
 			return False;
 		}
+		add_Counter(metrics(dba)->bytes_read, tot_frame(diph)*MBRPeriod(dba)*sizeof(int16));
 #endif /* ROMDATABASE_PURE */
     }
   
@@ -679,6 +724,96 @@ bool getdiphone_DatabaseBasic(Database* dba, DiphoneSynthesis *diph)
 	return True;
 }
 
+bool window_Database(Database* dba)
+/*
+ * Window all the frames once with a unit Hanning window, the engine then
+ * adds them and applies the volume to its output. Return False in case of
+ * error
+ */
+{
+	int period= MBRPeriod(dba);
+	HashTab* tab= diphone_table(dba);
+	DiphoneSynthesis* ds;
+	float* hanning;
+	float* frames;
+	bool ok=True;
+	int i;
+
+	if (windowed(dba))
+		return True;
+
+	debug_message1("window_Database\n");
+
+	frames= (float*) MBR_malloc(sizeof(float) * SizeMrk(dba) * 2*period);
+	hanning= (float*) MBR_malloc(sizeof(float) * 2*period);
+	init_Hanning(hanning, 2*period, 1.0f);
+	ds= init_DiphoneSynthesis(period, max_frame(dba), max_samples(dba));
+
+	/* Replacement diphones are windowed again, they share their frames */
+	for (i=0; ok && (i<nb_item(tab)); i++)
+    {
+		DiphoneInfo* cell= content(tab, i);
+		int j, k;
+
+		if (hit(tab, i)==EMPTY)
+			continue;
+
+		LeftPhone(ds)= init_Phone(auxiliary_tab_val(tab, left(*cell)), 0.0f);
+		RightPhone(ds)= init_Phone(auxiliary_tab_val(tab, right(*cell)), 0.0f);
+
+		ok= dba->getdiphone_Database(dba, ds);
+
+		/* The same frames as OverLapAdd: voiced ones loop on one period */
+		for (j=1; ok && (j<=nb_frame_diphone(ds)); j++)
+		{
+			float* frame= &frames[ (pos_pm(*cell)+j-1) * 2*period ];
+			int16* samples= &buffer(ds)[ period * (real_frame(ds)[j]-1) ];
+
+			if (pmrk_DiphoneSynthesis(ds, j) & VOICING_MASK)
+				for (k=0; k<2*period; k++)
+					frame[k]= hanning[k] * (float) samples[k % period];
+			else
+				for (k=0; k<2*period; k++)
+					frame[k]= hanning[k] * (float) samples[k];
+		}
+
+		reset_DiphoneSynthesis(ds);
+    }
+
+	close_DiphoneSynthesis(ds);
+	MBR_free(hanning);
+
+	if (!ok)
+    {
+		MBR_free(frames);
+		return False;
+    }
+
+	/* Loading the waves isn't activity of the synthesis */
+	memset(metrics(dba), 0, sizeof(DatabaseMetrics));
+
+	windowed(dba)= frames;
+	debug_message1("done window_Database\n");
+	return True;
+}
+
+DatabaseMetrics* init_DatabaseMetrics(void)
+/* Counters of a new database, all 0 */
+{
+	DatabaseMetrics* counters= (DatabaseMetrics*) MBR_malloc(sizeof(DatabaseMetrics));
+
+	memset(counters, 0, sizeof(DatabaseMetrics));
+	return counters;
+}
+
+void get_metrics_Database(Database* dba, DatabaseMetrics* counters)
+/* Activity of the database and its copies, from any thread */
+{
+	counters->fetches= read_Counter(metrics(dba)->fetches);
+	counters->missing= read_Counter(metrics(dba)->missing);
+	counters->memory_hits= read_Counter(metrics(dba)->memory_hits);
+	counters->bytes_read= read_Counter(metrics(dba)->bytes_read);
+}
 
 void init_real_frame(DiphoneSynthesis *diph)
 /*
@@ -738,7 +873,7 @@ bool init_common_Database(Database* dba, DiphoneSynthesis *diph)
 	return True;
 }
 
-#ifdef MULTI_CHANNEL
+#if defined(MULTI_CHANNEL) || defined(THREADS)
 
 static void close_DatabaseCopy(Database* dba)
 /*
@@ -810,4 +945,4 @@ Database* copyconstructor_Database(Database* old_dba)
 	return mydba;
 }
 
-#endif /* MULTI_CHANNEL MODE */
+#endif /* MULTI_CHANNEL || THREADS */
@@ -59,6 +59,13 @@
  *            the database mode)
  *            
  *            25% extra space in the hashtable enhances search
+ *
+ * 19/10/26 : rom_image, mapping of a ROM image shared between processes
+ *
+ * 19/10/26 : metrics, activity counters shared with the copies
+ *
+ * 19/10/26 : windowed, Hanning windowed frames built by window_Database or
+ *            stored in ROM images (WINDOWED_MASK)
  */
 
 #ifndef _DATABASE_H
@@ -70,6 +77,8 @@
 
 #define DIPHONE_RAW 1	  /* The diphone wave database is raw */
 #define ROM_MASK 128      /* The Coding tag of the database indicate if it's in ROM */
+#define WINDOWED_MASK 64  /* The ROM image holds windowed frames after the waves */
+#define CODING_MASK 63    /* The Coding tag without the two above */
 
 #define INFO_ESCAPE 0xFF     /* Escape code in database informations (prevents from displaying) */
 
@@ -130,6 +139,11 @@ struct Database
 
 	char *dbaname;          /* name of the diphone file */
 	void *database;         /* diphone wave file or base pointer to wave data, depending on dba type */
+	void *rom_image;        /* Mapping of a shared ROM image (rom_image.c), NULL if none */
+
+	float *windowed;        /* 2*MBRPeriod Hanning windowed samples per pitch mark, NULL if none */
+
+	DatabaseMetrics* metrics; /* Activity counters, shared with the copies */
 };
 
 /* Convenient macros */
@@ -138,6 +152,9 @@ struct Database
 /* Those 2 macros access the same field */
 #define rom_wave_ptr(PDatabase) (PDatabase->database)
 #define database(PDatabase)  ((FILE*)PDatabase->database)
+#define rom_image(PDatabase) (PDatabase->rom_image)
+#define windowed(PDatabase) (PDatabase->windowed)
+#define metrics(PDatabase) (PDatabase->metrics)
 
 #define nb_diphone(PDatabase) PDatabase->nb_diphone
 #define RawOffset(PDatabase) PDatabase->RawOffset
@@ -214,7 +231,7 @@ Database* init_rename_Database(char* dbaname, ZStringList* rename, ZStringList*
 
 #endif /* ROMDATABASE_PURE */
 
-#ifdef MULTICHANNEL_MODE
+#if defined(MULTI_CHANNEL) || defined(THREADS)
 
 Database* copyconstructor_Database(Database* dba);
 /* Creates a copy of a diphone database so that many synthesis engine 
@@ -247,4 +264,21 @@ bool getdiphone_DatabaseBasic(Database* dba, DiphoneSynthesis *ds);
  * Return False in case of error
  */
 
+bool window_Database(Database* dba);
+/*
+ * Window all the frames once with a unit Hanning window, the engine then
+ * adds them and applies the volume to its output. Needs 4 times the size
+ * of the waves. Call it before copying the database or starting engines
+ * on it. Return False in case of error
+ */
+
+DatabaseMetrics* init_DatabaseMetrics(void);
+/* Counters of a new database, all 0 */
+
+void get_metrics_Database(Database* dba, DatabaseMetrics* counters);
+/* 
+ * Activity of the database and its copies, from any thread. Each counter
+ * is read atomically, but not the set
+ */
+
 #endif
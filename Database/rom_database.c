@@ -27,6 +27,17 @@
  *   requires multiple of 4, int16 requires a multiple of 2... 
  *   Otherwise BUS error. Anyway alignment is good for everybody and
  *   adds very little dummy chars.
+ *
+ * 19/10/26 : file_flush_ROM_DatabaseFile for images that aren't plain
+ *   files (shared memory objects)
+ *
+ * 19/10/26 : activity counters of the ROM databases
+ *
+ * 19/10/26 : windowed frames stored after the waves (WINDOWED_MASK), the
+ *   waves stop at SizeRaw bytes so that they can be found
+ *
+ * 19/10/26 : init_ROM_DatabaseBasic reports the coding before closing
+ *   the database, not after
  */
 
 #include "rom_handling.h"
@@ -139,7 +150,7 @@ void file_flush_ROM_DatabaseBasic(Database* dba, FILE* rom_file)
 	/* Align with the forthcoming samples */
 	file_flush_ROM_align16(rom_file);
   
-	/* Read and write the whole WAVE chunk */
+	/* Read and write the whole WAVE chunk, SizeRaw is in bytes */
 	fseek(database(dba), RawOffset(dba), SEEK_SET);
 	pos_read= RawOffset(dba);
   
@@ -147,23 +158,28 @@ void file_flush_ROM_DatabaseBasic(Database* dba, FILE* rom_file)
 			(pos_read < RawOffset(dba)+SizeRaw(dba)))
     {
 		int16 buffer[255];
+		long nb_wanted= (RawOffset(dba)+SizeRaw(dba)-pos_read) / sizeof(int16);
 
 		/* Respect endianness when reading codebook indexes */
-		int nb_read= readl_int16buffer( buffer, 255, database(dba));
+		int nb_read= readl_int16buffer( buffer, (nb_wanted<255) ? nb_wanted : 255, database(dba));
+		if (nb_read==0)
+			break;
 		fwrite(buffer, sizeof(int16), nb_read, rom_file);
-		pos_read+=nb_read;
+		pos_read+= nb_read*sizeof(int16);
     }
-}
 
-void file_flush_ROM_Database(Database* dba, char* out_name)
-/* Dump the database structure into a ROM image */
-{
-	FILE* rom_file= fopen(out_name, "wb");
-	if (rom_file==NULL)
+	/* Frames of window_Database, in the native float format */
+	if (windowed(dba))
     {
-		fatal_message(ERROR_DBNOTFOUND,"FATAL ERROR : cannot save to file %s !\n",out_name);
+		file_flush_ROM_align32(rom_file);
+		file_flush_ROM_array( windowed(dba), sizeof(float),
+							  SizeMrk(dba)*2*MBRPeriod(dba), rom_file);
     }
-  
+}
+
+void file_flush_ROM_DatabaseFile(Database* dba, FILE* rom_file)
+/* Dump the database structure at the beginning of an open file */
+{
 	/* The name of the database... useless, only kept for information purpose */
 	file_flush_ROM_Zstring( dbaname(dba), rom_file);
   
@@ -172,10 +188,26 @@ void file_flush_ROM_Database(Database* dba, char* out_name)
 	file_flush_ROM_array( Magic(dba), sizeof(int32), 2, rom_file);
 	file_flush_ROM_array( Version(dba), sizeof(char), 6, rom_file);
   
-	/* The database code name include a ROM tag */
-	file_flush_ROM_uint8( Coding(dba) | ROM_MASK , rom_file); 
+	/* The database code name include a ROM tag, and a tag for the windowed frames */
+	if (windowed(dba))
+		file_flush_ROM_uint8( Coding(dba) | ROM_MASK | WINDOWED_MASK, rom_file);
+	else
+		file_flush_ROM_uint8( Coding(dba) | ROM_MASK , rom_file); 
  
 	file_flush_ROM_tab[ Coding(dba) ](dba, rom_file);
+}
+
+void file_flush_ROM_Database(Database* dba, char* out_name)
+/* Dump the database structure into a ROM image */
+{
+	FILE* rom_file= fopen(out_name, "wb");
+	if (rom_file==NULL)
+    {
+		fatal_message(ERROR_DBNOTFOUND,"FATAL ERROR : cannot save to file %s !\n",out_name);
+		return;
+    }
+  
+	file_flush_ROM_DatabaseFile(dba, rom_file);
 	fclose(rom_file);
 }
 #endif /* ROMDATABASE_STORE */
@@ -197,7 +229,12 @@ void close_ROM_DatabaseBasic(Database* dba)
   
 	/* No pitch marks, no file, no silence phoneme */
   
+	/* Windowed frames are in ROM, unless window_Database made them */
+	if ( windowed(dba) && !(Coding(dba) & WINDOWED_MASK) )
+		MBR_free(windowed(dba));
+
 	/* The structure itself */
+	MBR_free(metrics(dba));
 	MBR_free(dba);
 }
 
@@ -261,11 +298,11 @@ Database* init_ROM_DatabaseBasic(Database* dba)
 	dba->close_Database= close_ROM_DatabaseBasic;
   
 	/* A basic dba contains RAW waveforms */
-	if ( (Coding(dba) & (ROM_MASK-1)) != DIPHONE_RAW )
+	if ( (Coding(dba) & CODING_MASK) != DIPHONE_RAW )
     {
-		dba->close_Database(dba);
 		fatal_message( ERROR_BINNUMBERFORMAT,
 					   "PANIC: This program can't decode your database %i\n",Coding(dba));
+		dba->close_Database(dba);
 		return NULL;
     }
   
@@ -279,6 +316,15 @@ Database* init_ROM_DatabaseBasic(Database* dba)
   
 	/* Align for INT16 audio samples */
 	ptr_ROM_align16( rom_wave_ptr(dba) );
+
+	/* Windowed frames after the waves */
+	if ( Coding(dba) & WINDOWED_MASK )
+    {
+		void* input_ptr= (char*) rom_wave_ptr(dba) + SizeRaw(dba);
+
+		ptr_ROM_align32(input_ptr);
+		windowed(dba)= (float*) input_ptr;
+    }
   
 	debug_message1("done init_ROM_DatabaseBasic\n");
 	return(dba);
@@ -297,11 +343,14 @@ Database* init_ROM_Database(void* input_ptr)
   
 	my_dba= (Database*) MBR_malloc(sizeof(Database));
 	my_dba->database= NULL;
+	rom_image(my_dba)= NULL;
+	windowed(my_dba)= NULL;
 	sil_phon(my_dba)= NULL;
 	info(my_dba)= NULL;
 	max_frame(my_dba)= 0;
 	pmrk(my_dba)= NULL;
 	diphone_table(my_dba)= NULL;
+	metrics(my_dba)= init_DatabaseMetrics();
 
 	/* will be changed later on, depending on the dba type, it's here for premature exists */
 	my_dba->close_Database= close_ROM_DatabaseBasic; 
@@ -338,8 +387,8 @@ Database* init_ROM_Database(void* input_ptr)
   
 	input_ptr= read_ROM_uint8( &Coding(my_dba), input_ptr);
   
-	/* Remove ROM bit and check we have the decoder */
-	if ( (Coding(my_dba)& (ROM_MASK-1)) > NB_ROM_DATABASE_TYPE )
+	/* Remove ROM and windowed bits and check we have the decoder */
+	if ( (Coding(my_dba)& CODING_MASK) > NB_ROM_DATABASE_TYPE )
     {
 		my_dba->close_Database(my_dba);
 		fatal_message( ERROR_BINNUMBERFORMAT,
@@ -351,7 +400,7 @@ Database* init_ROM_Database(void* input_ptr)
   
 	/* Yes it is that simple !! Watch your step */
 	rom_wave_ptr(my_dba)=input_ptr;
-	return init_ROM_tab[ Coding(my_dba)& (ROM_MASK-1) ](my_dba);
+	return init_ROM_tab[ Coding(my_dba)& CODING_MASK ](my_dba);
 }
 
 #endif
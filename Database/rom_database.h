@@ -27,6 +27,8 @@
  *   requires multiple of 4, int16 requires a multiple of 2... 
  *   Otherwise BUS error. Anyway alignment is good for everybody and
  *   adds very little dummy chars.
+ *
+ * 19/10/26 : file_flush_ROM_DatabaseFile
  */
 
 #ifndef _ROM_DATABASE_H
@@ -38,6 +40,9 @@
 void file_flush_ROM_Database(Database* dba, char* out_name);
 /* Dump the database structure into a ROM image */
 
+void file_flush_ROM_DatabaseFile(Database* dba, FILE* rom_file);
+/* Dump the database structure at the beginning of an open file */
+
 void file_flush_ROM_header(Database* dba, FILE* rom_file);
 /*
  * Dump the core of a database structure into a ROM image 
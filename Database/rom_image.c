@@ -0,0 +1,372 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    rom_image.c
+ * Purpose: ROM images shared between processes (files or POSIX shared memory)
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ * 19/10/26 : is_ROM_Image, images checked against the size of the mapping
+ * 19/10/26 : the windowed frames are checked too
+ * 19/10/26 : every segment is checked before init_ROM_Database parses the
+ *            image, a truncated index no longer faults
+ */
+
+#include "rom_image.h"
+
+#ifdef ROMDATABASE_IMAGE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "rom_database.h"
+#include "rom_handling.h"
+#include "hash_tab.h"
+#include "little_big.h"
+
+/* Mapping of an image, with the destructor of the database built on it */
+typedef struct
+{
+	void* address;
+	size_t size;
+	close_DatabaseFunction close_Database;
+} RomImage;
+
+/* True if the image is a POSIX shared memory object */
+#define is_shm(image_name) (strncmp(image_name, SHM_PREFIX, strlen(SHM_PREFIX))==0)
+
+/* Name of the shared memory object, after the prefix */
+#define shm_name(image_name) (image_name + strlen(SHM_PREFIX))
+
+bool is_ROM_Image(char* dbaname)
+/* True if the database name is a shared memory object or a .rom file */
+{
+	int len= strlen(dbaname);
+	int ext_len= strlen(ROM_EXTENSION);
+
+	return is_shm(dbaname)
+		|| ((len > ext_len) && !strcmp(dbaname+len-ext_len, ROM_EXTENSION));
+}
+
+#ifdef ROMDATABASE_STORE
+
+bool store_ROM_Image(Database* dba, char* image_name)
+/*
+ * Write the ROM image of dba. A file is written under a temporary name
+ * and renamed, so that readers never map a half written image.
+ * Returning False means error (check LastErr)
+ */
+{
+	FILE* rom_file=NULL;
+	char* tmp_name=NULL;
+	bool ok;
+
+	if (is_shm(image_name))
+    {
+		/*
+		 * Shared memory objects can't be renamed: a new object replaces the
+		 * old one (still mapped by its users) and is only readable once full
+		 */
+		int fd;
+
+		shm_unlink(shm_name(image_name));
+		fd= shm_open(shm_name(image_name), O_RDWR|O_CREAT|O_EXCL, 0);
+		if (fd>=0)
+			rom_file= fdopen(fd,"wb");
+    }
+	else
+    {
+		tmp_name= (char*) MBR_malloc(strlen(image_name)+5);
+		sprintf(tmp_name,"%s.tmp",image_name);
+		rom_file= fopen(tmp_name,"wb");
+    }
+
+	if (rom_file==NULL)
+    {
+		if (tmp_name)
+			MBR_free(tmp_name);
+		fatal_message(ERROR_OUTFILE,"FATAL ERROR : cannot save to %s !\n",image_name);
+		return False;
+    }
+
+	file_flush_ROM_DatabaseFile(dba, rom_file);
+
+	ok= (fflush(rom_file)==0) && !ferror(rom_file);
+	if (ok && !tmp_name)
+		ok= (fchmod(fileno(rom_file), 0444)==0);
+	if (fclose(rom_file)!=0)
+		ok=False;
+	if (ok && tmp_name)
+		ok= (rename(tmp_name, image_name)==0);
+
+	if (!ok)
+    {
+		if (tmp_name)
+			remove(tmp_name);
+		else
+			shm_unlink(shm_name(image_name));
+    }
+	if (tmp_name)
+		MBR_free(tmp_name);
+
+	if (!ok)
+    {
+		fatal_message(ERROR_OUTFILE,"FATAL ERROR : cannot save to %s !\n",image_name);
+		return False;
+    }
+	return True;
+}
+
+bool unlink_ROM_Image(char* image_name)
+/* Remove an image, the processes using it keep their mapping */
+{
+	if (is_shm(image_name))
+		return shm_unlink(shm_name(image_name))==0;
+	else
+		return remove(image_name)==0;
+}
+
+#endif /* ROMDATABASE_STORE */
+
+#ifdef ROMDATABASE_INIT
+
+/*
+ * The image is walked segment by segment before init_ROM_Database parses
+ * it: every segment must end inside the mapping, or a truncated image
+ * would fault in the parser or during the synthesis. The walk follows
+ * file_flush_ROM_DatabaseFile, and the alignments are computed on
+ * absolute addresses as in ptr_ROM_align
+ */
+
+static bool skip_ROM(char** pos, char* end, long nb_item, size_t size_item)
+/* Skip nb_item items of size_item, False if they don't fit */
+{
+	if ( (nb_item < 0) || ((size_t) nb_item > (size_t)(end - *pos) / size_item) )
+		return False;
+	*pos+= nb_item * size_item;
+	return True;
+}
+
+static bool align_ROM(char** pos, char* end, size_t round)
+/* Skip the padding to a multiple of round (2 or 4) */
+{
+	char* aligned= (char*) ((((size_t) *pos) + round - 1) & ~(round - 1));
+
+	if (aligned > end)
+		return False;
+	*pos= aligned;
+	return True;
+}
+
+static bool skip_ROM_Zstring(char** pos, char* end)
+/* Skip a zero terminated string */
+{
+	char* zero= (char*) memchr(*pos, 0, end - *pos);
+
+	if (zero == NULL)
+		return False;
+	*pos= zero + 1;
+	return True;
+}
+
+static bool skip_ROM_ZStringList(char** pos, char* end)
+/* Skip a list of strings, as in file_flush_ROM_ZStringList */
+{
+	int16 nb_elem;
+	int i;
+
+	if ( !align_ROM(pos, end, 2) || !skip_ROM(pos, end, 1, sizeof(int16)) )
+		return False;
+	read_ROM_int16(&nb_elem, *pos - sizeof(int16));
+
+	for (i=0; i<nb_elem; i++)
+		if (!skip_ROM_Zstring(pos, end))
+			return False;
+	return True;
+}
+
+static bool check_ROM_Image(void* address, size_t size)
+/*
+ * True if every segment of the image is inside the mapping. An image
+ * with another magic number or coding is left to init_ROM_Database, that
+ * reports it
+ */
+{
+	char* pos= (char*) address;
+	char* end= pos + size;
+	int32 magic[2];
+	uint8 coding, period;
+	int16 nb_item;
+	int32 size_mrk, size_raw;
+
+	/* Name, magic number, version and coding */
+	if ( !skip_ROM_Zstring(&pos, end)
+		 || !align_ROM(&pos, end, 4)
+		 || !skip_ROM(&pos, end, 2, sizeof(int32)) )
+		return False;
+	read_ROM_int32(&magic[0], pos - 2*sizeof(int32));
+	read_ROM_int32(&magic[1], pos - sizeof(int32));
+	if ( !skip_ROM(&pos, end, 6, sizeof(char))
+		 || !skip_ROM(&pos, end, 1, sizeof(uint8)) )
+		return False;
+	read_ROM_uint8(&coding, pos - sizeof(uint8));
+
+	if ( strncmp("MBROLA", (char*) magic, 6) || (magic[0] != MAGIC_HEADER)
+		 || ((coding & CODING_MASK) != DIPHONE_RAW) )
+		return True;
+
+	/* init_ROM_header */
+	if (!skip_ROM(&pos, end, 1, sizeof(uint8)))
+		return False;
+	read_ROM_uint8(&period, pos - sizeof(uint8));
+	if ( !align_ROM(&pos, end, 4)
+		 || !skip_ROM(&pos, end, 2, sizeof(int16))
+		 || !skip_ROM(&pos, end, 3, sizeof(int32)) )
+		return False;
+	read_ROM_int32(&size_mrk, pos - 3*sizeof(int32));
+	read_ROM_int32(&size_raw, pos - 2*sizeof(int32));
+
+	/* Hash table and its phoneme names, then the database information */
+	if ( !align_ROM(&pos, end, 2)
+		 || !skip_ROM(&pos, end, 2, sizeof(int16)) )
+		return False;
+	read_ROM_int16(&nb_item, pos - 2*sizeof(int16));
+	if ( !skip_ROM(&pos, end, nb_item, sizeof(HashInfo))
+		 || !skip_ROM_ZStringList(&pos, end)
+		 || !skip_ROM_ZStringList(&pos, end) )
+		return False;
+
+	/* Pitch marks, max_frame and silence phoneme */
+	if ( (size_mrk < 0)
+		 || !skip_ROM(&pos, end, (size_mrk + 3) / 4, sizeof(FrameType))
+		 || !skip_ROM(&pos, end, 1, sizeof(uint8))
+		 || !skip_ROM_Zstring(&pos, end) )
+		return False;
+
+	/* Samples, SizeRaw is in bytes, then the windowed frames */
+	if ( !align_ROM(&pos, end, 2)
+		 || !skip_ROM(&pos, end, size_raw, sizeof(char)) )
+		return False;
+
+	if (coding & WINDOWED_MASK)
+	{
+		if ( !align_ROM(&pos, end, 4)
+			 || !skip_ROM(&pos, end, size_mrk, 2 * period * sizeof(float)) )
+			return False;
+	}
+	return True;
+}
+
+static void close_ROM_Image(Database* dba)
+/* Close the database, then release its mapping */
+{
+	RomImage* image= (RomImage*) rom_image(dba);
+
+	dba->close_Database= image->close_Database;
+	dba->close_Database(dba);
+
+	munmap(image->address, image->size);
+	MBR_free(image);
+}
+
+Database* init_ROM_Image(char* image_name)
+/*
+ * Map the image read-only and initialize a database on it, the mapping
+ * is released with the database.
+ * Returning NULL means error (check LastErr)
+ */
+{
+	RomImage* image;
+	Database* dba;
+	struct stat status;
+	void* address;
+	int fd;
+
+	if (is_shm(image_name))
+		fd= shm_open(shm_name(image_name), O_RDONLY, 0);
+	else
+		fd= open(image_name, O_RDONLY);
+
+	if (fd<0)
+    {
+		fatal_message(ERROR_DBNOTFOUND,
+					  "FATAL ERROR : cannot find ROM image %s !\n",image_name);
+		return NULL;
+    }
+
+	if ((fstat(fd, &status)<0) || (status.st_size==0))
+    {
+		close(fd);
+		fatal_message(ERROR_DBWRONGVERSION,
+					  "FATAL ERROR : %s is not a ROM image !\n",image_name);
+		return NULL;
+    }
+
+	/* The descriptor isn't needed once mapped */
+	address= mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address==MAP_FAILED)
+    {
+		fatal_message(ERROR_MEMORYOUT,
+					  "FATAL ERROR : cannot map ROM image %s !\n",image_name);
+		return NULL;
+    }
+
+	/*
+	 * The alignments of the image are computed on absolute addresses, as
+	 * if it started on a multiple of 4 (always true for a mapping)
+	 */
+	if (((size_t) address) & 3)
+    {
+		munmap(address, status.st_size);
+		fatal_message(ERROR_DBWRONGVERSION,
+					  "FATAL ERROR : %s is not a ROM image !\n",image_name);
+		return NULL;
+    }
+
+	if (!check_ROM_Image(address, status.st_size))
+    {
+		munmap(address, status.st_size);
+		fatal_message(ERROR_DBWRONGVERSION,
+					  "FATAL ERROR : ROM image %s is truncated !\n",image_name);
+		return NULL;
+    }
+
+	dba= init_ROM_Database(address);
+	if (dba==NULL)
+    {
+		munmap(address, status.st_size);
+		return NULL;
+    }
+
+	image= (RomImage*) MBR_malloc(sizeof(RomImage));
+	image->address= address;
+	image->size= status.st_size;
+	image->close_Database= dba->close_Database;
+
+	rom_image(dba)= image;
+	dba->close_Database= close_ROM_Image;
+	return dba;
+}
+
+#endif /* ROMDATABASE_INIT */
+
+#endif /* ROMDATABASE_IMAGE */
@@ -0,0 +1,76 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    rom_image.h
+ * Purpose: ROM images shared between processes (files or POSIX shared memory)
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ * 19/10/26 : .rom files mapped in place by init_rename_Database, images
+ *            checked against the size of the mapping
+ *
+ *   A loader process writes the ROM image of a database (the layout of
+ *   file_flush_ROM_Database: index, pitch marks and samples, with the
+ *   renamings and clonings already applied) once. Any number of processes
+ *   then map it read-only and use it in place with init_ROM_Database: the
+ *   pages are shared, a process only allocates the small headers.
+ *
+ *   An image name starting with "shm:" is a POSIX shared memory object,
+ *   e.g. "shm:/fr1", any other name is a regular file. Databases named
+ *   shm:/name or ending with .rom are mapped by init_rename_Database.
+ */
+
+#ifndef _ROM_IMAGE_H
+#define _ROM_IMAGE_H
+
+#include "database.h"
+
+#ifdef ROMDATABASE_IMAGE
+
+/* Prefix of the POSIX shared memory image names */
+#define SHM_PREFIX "shm:"
+
+/* Extension of the ROM image files (mbrola -W) */
+#define ROM_EXTENSION ".rom"
+
+bool is_ROM_Image(char* dbaname);
+/* True if the database name is a shared memory object or a .rom file */
+
+#ifdef ROMDATABASE_STORE
+bool store_ROM_Image(Database* dba, char* image_name);
+/*
+ * Write the ROM image of dba. A file is written under a temporary name
+ * and renamed, so that readers never map a half written image.
+ * Returning False means error (check LastErr)
+ */
+
+bool unlink_ROM_Image(char* image_name);
+/* Remove an image, the processes using it keep their mapping */
+#endif
+
+#ifdef ROMDATABASE_INIT
+Database* init_ROM_Image(char* image_name);
+/*
+ * Map the image read-only and initialize a database on it, the mapping
+ * is released with the database. The image must fit in the mapping, and
+ * come from a compatible version and architecture.
+ * Returning NULL means error (check LastErr)
+ */
+#endif
+
+#endif /* ROMDATABASE_IMAGE */
+
+#endif
@@ -25,6 +25,8 @@
  * 09/09/98 : reset_DiphoneSynthesis function
  * 24/03/00 : no more limits on period size -> 
  *                  pass frame size during construction
+ * 19/10/26 : copy_DiphoneSynthesis, real_frame is indexed from 1 to max_pm
+ * 19/10/26 : smoothw in floats
  */
 
 #include "diphone.h"
@@ -39,8 +41,10 @@ DiphoneSynthesis* init_DiphoneSynthesis(int mbr_period, int max_pm, int max_samp
 	LeftPhone(self)=NULL;			  
 	RightPhone(self)=NULL;
   
-	smoothw(self)= (int16*) MBR_malloc(sizeof(int16) * 2*mbr_period);
-	real_frame(self)= (uint8*) MBR_malloc(sizeof(uint8) * max_pm);
+	smoothw(self)= (float*) MBR_malloc(sizeof(float) * 2*mbr_period);
+	real_frame(self)= (uint8*) MBR_malloc(sizeof(uint8) * (max_pm+1));
+	smooth(self)= False;
+	nb_pm(self)= 0;
   
 	/* For ROM RAW databases, no need to alloc a buffer  */
 	if (max_samples)
@@ -50,6 +54,40 @@ DiphoneSynthesis* init_DiphoneSynthesis(int mbr_period, int max_pm, int max_samp
 	return(self);
 }
 
+void copy_DiphoneSynthesis(DiphoneSynthesis* dest, DiphoneSynthesis* src,
+						   int mbr_period, int max_pm, int max_samples)
+/*
+ * Copy the synthesis state of src in dest (built with the same sizes),
+ * the phones of dest are left unchanged
+ */
+{
+	Phone* left= LeftPhone(dest);
+	Phone* right= RightPhone(dest);
+	float* my_smoothw= smoothw(dest);
+	uint8* my_real_frame= real_frame(dest);
+	int16* my_buffer= buffer(dest);
+	bool my_buffer_alloced= buffer_alloced(dest);
+
+	*dest= *src;
+
+	LeftPhone(dest)= left;
+	RightPhone(dest)= right;
+
+	smoothw(dest)= my_smoothw;
+	memcpy(smoothw(dest), smoothw(src), sizeof(float) * 2*mbr_period);
+
+	real_frame(dest)= my_real_frame;
+	memcpy(real_frame(dest), real_frame(src), sizeof(uint8) * (max_pm+1));
+
+	/* ROM databases: the buffer points in the ROM image */
+	buffer_alloced(dest)= my_buffer_alloced;
+	if (my_buffer_alloced)
+    {
+		buffer(dest)= my_buffer;
+		memcpy(buffer(dest), buffer(src), sizeof(int16) * max_samples);
+    }
+}
+
 void reset_DiphoneSynthesis(DiphoneSynthesis* ds)
 /*
  * Forget the diphone in progress
@@ -24,6 +24,7 @@
  * 15/06/98 : Created. Phones, Diphones, ...
  * 09/09/98 : reset_DiphoneSynthesis function
  * 24/03/00 : no more limits on period size -> pass frame size during construction
+ * 19/10/26 : smoothw in floats
  */
 
 #ifndef _DIPHONE_H
@@ -58,7 +59,7 @@ typedef struct
 	uint8 *p_pmrk;		/* Point to the beginning of the pm 1..N interval */
 	uint8 p_pmrk_offset;  /* offset in the 4 bit compressed structure */
   
-	int16 *smoothw;    /* Difference vector between 2 ola frames (2 mbr_period) */
+	float *smoothw;    /* Difference vector between 2 ola frames (2 mbr_period) */
 	bool smooth;		   /* True if Smoothw has a value */
 
 	int16* buffer;     /* To read or uncompress audio data */
@@ -75,6 +76,7 @@ typedef struct
 #define halfseg_diphone(X) X->Descriptor->halfseg
 #define nb_frame_diphone(X) X->Descriptor->nb_frame
 #define pos_wave_diphone(X) X->Descriptor->pos_wave
+#define pos_pm_diphone(X) X->Descriptor->pos_pm
 
 #define left_diphone(MB,X)  auxiliary_tab_val( diphone_table(diph_dba(MB)) , X->Descriptor->left)
 #define right_diphone(MB,X) auxiliary_tab_val( diphone_table(diph_dba(MB)) , X->Descriptor->right)
@@ -100,6 +102,13 @@ typedef struct
 	DiphoneSynthesis* init_DiphoneSynthesis(int mbr_period, int max_pm, int max_sample);
 /* Alloc memory, working and audio buffers for synthesis */
 
+void copy_DiphoneSynthesis(DiphoneSynthesis* dest, DiphoneSynthesis* src,
+						   int mbr_period, int max_pm, int max_samples);
+/*
+ * Copy the synthesis state of src in dest (built with the same sizes),
+ * the phones of dest are left unchanged
+ */
+
 void reset_DiphoneSynthesis(DiphoneSynthesis* ds);
 /*
  * Forget the diphone in progress
@@ -0,0 +1,756 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    kernels.c
+ * Purpose: inner loops of the engine, selected for the CPU at run time
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ *
+ * 19/10/26 : kernels of the windowed frames, and scale for their volume
+ *
+ * 19/10/26 : smooth_vector computes the float smoothing vector of Concat
+ */
+
+#include "common.h"
+#include "kernels.h"
+
+#ifdef X86_KERNELS
+#include <immintrin.h>
+
+/* Instruction sets of a function, whatever the compiler targets */
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+/* Largest sample of clip, as in the 16 bits files */
+#define CLIP_MAX 32765.0f
+
+/*
+ * Portable versions, the others handle the samples left after their
+ * last vector with them
+ */
+
+static void ola_voiced_scalar(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += correction * weight[k] * samples[k] */
+{
+	int k;
+
+	for (k=0; k<nb; k++)
+		ola[k] += correction * weight[k] * (float) samples[k];
+}
+
+static void ola_unvoiced_scalar(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += weight[k] * samples[k] * correction */
+{
+	int k;
+	float tmp;
+
+	for (k=0; k<nb; k++)
+    {
+		tmp = weight[k] * (float) samples[k];
+		tmp *= correction;
+		ola[k] += tmp;
+    }
+}
+
+static void ola_smooth_scalar(float* ola, float* weight, int16* samples, float* smoothw,
+							  float smooth, float correction, int nb)
+/* ola[k] += correction * (weight[k] * samples[k] + smooth * smoothw[k]) */
+{
+	int k;
+
+	for (k=0; k<nb; k++)
+		ola[k] += correction *
+			( weight[k] * (float) samples[k] + smooth * smoothw[k] );
+}
+
+static void ola_add_scalar(float* ola, float* frame, int nb)
+/* ola[k] += frame[k] */
+{
+	int k;
+
+	for (k=0; k<nb; k++)
+		ola[k] += frame[k];
+}
+
+static void ola_frame_scalar(float* ola, float* frame, float correction, int nb)
+/* ola[k] += correction * frame[k] */
+{
+	int k;
+
+	for (k=0; k<nb; k++)
+		ola[k] += correction * frame[k];
+}
+
+static void ola_frame_smooth_scalar(float* ola, float* frame, float* smoothw,
+									float smooth, float correction, int nb)
+/* ola[k] += correction * (frame[k] + smooth * smoothw[k]) */
+{
+	int k;
+
+	for (k=0; k<nb; k++)
+		ola[k] += correction * ( frame[k] + smooth * smoothw[k] );
+}
+
+static void smooth_vector_scalar(float* smoothw, int16* left, int16* right, float* weight, int nb)
+/* smoothw[k]= (left[k] - right[k]) * weight[k] */
+{
+	int k;
+
+	for (k=0; k<nb; k++)
+		smoothw[k]= (float) (left[k] - right[k]) * weight[k];
+}
+
+static bool clip_scalar(float* in, int16* out, int nb)
+/* out[k]= in[k] clipped to +-32765, True if any sample was clipped */
+{
+	bool saturated=False;
+	int k;
+
+	for (k=0; k<nb; k++)
+    {
+		if (in[k] > CLIP_MAX)
+		{
+			saturated=True;
+			out[k]=32765;
+		}
+		else if (in[k] < -CLIP_MAX)
+		{
+			saturated=True;
+			out[k]=-32765;
+		}
+		else
+			out[k]= (int16) in[k];
+    }
+	return saturated;
+}
+
+static void scale_scalar(float* buffer, float ratio, int nb)
+/* buffer[k] *= ratio */
+{
+	int k;
+
+	for (k=0; k<nb; k++)
+		buffer[k] *= ratio;
+}
+
+static KernelSet scalar_kernels=
+{
+	KERNELS_SCALAR,
+	ola_voiced_scalar,
+	ola_unvoiced_scalar,
+	ola_smooth_scalar,
+	ola_add_scalar,
+	ola_frame_scalar,
+	ola_frame_smooth_scalar,
+	smooth_vector_scalar,
+	clip_scalar,
+	scale_scalar
+};
+
+#ifdef X86_KERNELS
+
+/* SSE4.1: 4 samples a vector, sign extension of int16 with pmovsxwd */
+
+static TARGET_SSE41 __m128 load_sse41(int16* samples)
+/* 4 int16 samples as floats */
+{
+	return _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_loadl_epi64((__m128i*) samples)));
+}
+
+static TARGET_SSE41 void ola_voiced_sse41(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += correction * weight[k] * samples[k] */
+{
+	__m128 c= _mm_set1_ps(correction);
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+    {
+		__m128 w= _mm_mul_ps(c, _mm_loadu_ps(&weight[k]));
+		_mm_storeu_ps(&ola[k], _mm_add_ps(_mm_loadu_ps(&ola[k]),
+										  _mm_mul_ps(w, load_sse41(&samples[k]))));
+    }
+	ola_voiced_scalar(&ola[k], &weight[k], &samples[k], correction, nb-k);
+}
+
+static TARGET_SSE41 void ola_unvoiced_sse41(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += weight[k] * samples[k] * correction */
+{
+	__m128 c= _mm_set1_ps(correction);
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+    {
+		__m128 tmp= _mm_mul_ps(_mm_loadu_ps(&weight[k]), load_sse41(&samples[k]));
+		_mm_storeu_ps(&ola[k], _mm_add_ps(_mm_loadu_ps(&ola[k]), _mm_mul_ps(tmp, c)));
+    }
+	ola_unvoiced_scalar(&ola[k], &weight[k], &samples[k], correction, nb-k);
+}
+
+static TARGET_SSE41 void ola_smooth_sse41(float* ola, float* weight, int16* samples, float* smoothw,
+										  float smooth, float correction, int nb)
+/* ola[k] += correction * (weight[k] * samples[k] + smooth * smoothw[k]) */
+{
+	__m128 c= _mm_set1_ps(correction);
+	__m128 s= _mm_set1_ps(smooth);
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+    {
+		__m128 tmp= _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&weight[k]), load_sse41(&samples[k])),
+							   _mm_mul_ps(s, _mm_loadu_ps(&smoothw[k])));
+		_mm_storeu_ps(&ola[k], _mm_add_ps(_mm_loadu_ps(&ola[k]), _mm_mul_ps(c, tmp)));
+    }
+	ola_smooth_scalar(&ola[k], &weight[k], &samples[k], &smoothw[k], smooth, correction, nb-k);
+}
+
+static TARGET_SSE41 void ola_add_sse41(float* ola, float* frame, int nb)
+/* ola[k] += frame[k] */
+{
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+		_mm_storeu_ps(&ola[k], _mm_add_ps(_mm_loadu_ps(&ola[k]), _mm_loadu_ps(&frame[k])));
+	ola_add_scalar(&ola[k], &frame[k], nb-k);
+}
+
+static TARGET_SSE41 void ola_frame_sse41(float* ola, float* frame, float correction, int nb)
+/* ola[k] += correction * frame[k] */
+{
+	__m128 c= _mm_set1_ps(correction);
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+    {
+		__m128 tmp= _mm_mul_ps(c, _mm_loadu_ps(&frame[k]));
+		_mm_storeu_ps(&ola[k], _mm_add_ps(_mm_loadu_ps(&ola[k]), tmp));
+    }
+	ola_frame_scalar(&ola[k], &frame[k], correction, nb-k);
+}
+
+static TARGET_SSE41 void ola_frame_smooth_sse41(float* ola, float* frame, float* smoothw,
+												float smooth, float correction, int nb)
+/* ola[k] += correction * (frame[k] + smooth * smoothw[k]) */
+{
+	__m128 c= _mm_set1_ps(correction);
+	__m128 s= _mm_set1_ps(smooth);
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+    {
+		__m128 tmp= _mm_add_ps(_mm_loadu_ps(&frame[k]), _mm_mul_ps(s, _mm_loadu_ps(&smoothw[k])));
+		_mm_storeu_ps(&ola[k], _mm_add_ps(_mm_loadu_ps(&ola[k]), _mm_mul_ps(c, tmp)));
+    }
+	ola_frame_smooth_scalar(&ola[k], &frame[k], &smoothw[k], smooth, correction, nb-k);
+}
+
+static TARGET_SSE41 void smooth_vector_sse41(float* smoothw, int16* left, int16* right, float* weight, int nb)
+/* smoothw[k]= (left[k] - right[k]) * weight[k] */
+{
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+    {
+		__m128 diff= _mm_sub_ps(load_sse41(&left[k]), load_sse41(&right[k]));
+		_mm_storeu_ps(&smoothw[k], _mm_mul_ps(diff, _mm_loadu_ps(&weight[k])));
+    }
+	smooth_vector_scalar(&smoothw[k], &left[k], &right[k], &weight[k], nb-k);
+}
+
+static TARGET_SSE41 bool clip_sse41(float* in, int16* out, int nb)
+/* out[k]= in[k] clipped to +-32765, True if any sample was clipped */
+{
+	__m128 high= _mm_set1_ps(CLIP_MAX);
+	__m128 low= _mm_set1_ps(-CLIP_MAX);
+	__m128 over= _mm_setzero_ps();
+	bool saturated;
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m128 a= _mm_loadu_ps(&in[k]);
+		__m128 b= _mm_loadu_ps(&in[k+4]);
+
+		over= _mm_or_ps(over, _mm_or_ps(_mm_cmpgt_ps(a, high), _mm_cmplt_ps(a, low)));
+		over= _mm_or_ps(over, _mm_or_ps(_mm_cmpgt_ps(b, high), _mm_cmplt_ps(b, low)));
+		a= _mm_min_ps(_mm_max_ps(a, low), high);
+		b= _mm_min_ps(_mm_max_ps(b, low), high);
+		_mm_storeu_si128((__m128i*) &out[k],
+						 _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+    }
+	saturated= (_mm_movemask_ps(over) != 0);
+	if (clip_scalar(&in[k], &out[k], nb-k))
+		saturated=True;
+	return saturated;
+}
+
+static TARGET_SSE41 void scale_sse41(float* buffer, float ratio, int nb)
+/* buffer[k] *= ratio */
+{
+	__m128 r= _mm_set1_ps(ratio);
+	int k;
+
+	for (k=0; k+4<=nb; k+=4)
+		_mm_storeu_ps(&buffer[k], _mm_mul_ps(_mm_loadu_ps(&buffer[k]), r));
+	scale_scalar(&buffer[k], ratio, nb-k);
+}
+
+static KernelSet sse41_kernels=
+{
+	KERNELS_SSE41,
+	ola_voiced_sse41,
+	ola_unvoiced_sse41,
+	ola_smooth_sse41,
+	ola_add_sse41,
+	ola_frame_sse41,
+	ola_frame_smooth_sse41,
+	smooth_vector_sse41,
+	clip_sse41,
+	scale_sse41
+};
+
+/*
+ * AVX2: 8 samples a vector. The portable loops may be compiled without
+ * VEX encoding: vzeroupper before them, or each SSE instruction waits for
+ * the upper halves of the registers
+ */
+
+static TARGET_AVX2 __m256 load_avx2(int16* samples)
+/* 8 int16 samples as floats */
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*) samples)));
+}
+
+static TARGET_AVX2 void ola_voiced_avx2(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += correction * weight[k] * samples[k] */
+{
+	__m256 c= _mm256_set1_ps(correction);
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m256 w= _mm256_mul_ps(c, _mm256_loadu_ps(&weight[k]));
+		_mm256_storeu_ps(&ola[k], _mm256_add_ps(_mm256_loadu_ps(&ola[k]),
+												_mm256_mul_ps(w, load_avx2(&samples[k]))));
+    }
+	_mm256_zeroupper();
+	ola_voiced_scalar(&ola[k], &weight[k], &samples[k], correction, nb-k);
+}
+
+static TARGET_AVX2 void ola_unvoiced_avx2(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += weight[k] * samples[k] * correction */
+{
+	__m256 c= _mm256_set1_ps(correction);
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m256 tmp= _mm256_mul_ps(_mm256_loadu_ps(&weight[k]), load_avx2(&samples[k]));
+		_mm256_storeu_ps(&ola[k], _mm256_add_ps(_mm256_loadu_ps(&ola[k]), _mm256_mul_ps(tmp, c)));
+    }
+	_mm256_zeroupper();
+	ola_unvoiced_scalar(&ola[k], &weight[k], &samples[k], correction, nb-k);
+}
+
+static TARGET_AVX2 void ola_smooth_avx2(float* ola, float* weight, int16* samples, float* smoothw,
+										float smooth, float correction, int nb)
+/* ola[k] += correction * (weight[k] * samples[k] + smooth * smoothw[k]) */
+{
+	__m256 c= _mm256_set1_ps(correction);
+	__m256 s= _mm256_set1_ps(smooth);
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m256 tmp= _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&weight[k]), load_avx2(&samples[k])),
+								  _mm256_mul_ps(s, _mm256_loadu_ps(&smoothw[k])));
+		_mm256_storeu_ps(&ola[k], _mm256_add_ps(_mm256_loadu_ps(&ola[k]), _mm256_mul_ps(c, tmp)));
+    }
+	_mm256_zeroupper();
+	ola_smooth_scalar(&ola[k], &weight[k], &samples[k], &smoothw[k], smooth, correction, nb-k);
+}
+
+static TARGET_AVX2 void ola_add_avx2(float* ola, float* frame, int nb)
+/* ola[k] += frame[k] */
+{
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+		_mm256_storeu_ps(&ola[k], _mm256_add_ps(_mm256_loadu_ps(&ola[k]), _mm256_loadu_ps(&frame[k])));
+	_mm256_zeroupper();
+	ola_add_scalar(&ola[k], &frame[k], nb-k);
+}
+
+static TARGET_AVX2 void ola_frame_avx2(float* ola, float* frame, float correction, int nb)
+/* ola[k] += correction * frame[k] */
+{
+	__m256 c= _mm256_set1_ps(correction);
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m256 tmp= _mm256_mul_ps(c, _mm256_loadu_ps(&frame[k]));
+		_mm256_storeu_ps(&ola[k], _mm256_add_ps(_mm256_loadu_ps(&ola[k]), tmp));
+    }
+	_mm256_zeroupper();
+	ola_frame_scalar(&ola[k], &frame[k], correction, nb-k);
+}
+
+static TARGET_AVX2 void ola_frame_smooth_avx2(float* ola, float* frame, float* smoothw,
+											  float smooth, float correction, int nb)
+/* ola[k] += correction * (frame[k] + smooth * smoothw[k]) */
+{
+	__m256 c= _mm256_set1_ps(correction);
+	__m256 s= _mm256_set1_ps(smooth);
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m256 tmp= _mm256_add_ps(_mm256_loadu_ps(&frame[k]), _mm256_mul_ps(s, _mm256_loadu_ps(&smoothw[k])));
+		_mm256_storeu_ps(&ola[k], _mm256_add_ps(_mm256_loadu_ps(&ola[k]), _mm256_mul_ps(c, tmp)));
+    }
+	_mm256_zeroupper();
+	ola_frame_smooth_scalar(&ola[k], &frame[k], &smoothw[k], smooth, correction, nb-k);
+}
+
+static TARGET_AVX2 void smooth_vector_avx2(float* smoothw, int16* left, int16* right, float* weight, int nb)
+/* smoothw[k]= (left[k] - right[k]) * weight[k] */
+{
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m256 diff= _mm256_sub_ps(load_avx2(&left[k]), load_avx2(&right[k]));
+		_mm256_storeu_ps(&smoothw[k], _mm256_mul_ps(diff, _mm256_loadu_ps(&weight[k])));
+    }
+	_mm256_zeroupper();
+	smooth_vector_scalar(&smoothw[k], &left[k], &right[k], &weight[k], nb-k);
+}
+
+static TARGET_AVX2 bool clip_avx2(float* in, int16* out, int nb)
+/* out[k]= in[k] clipped to +-32765, True if any sample was clipped */
+{
+	__m256 high= _mm256_set1_ps(CLIP_MAX);
+	__m256 low= _mm256_set1_ps(-CLIP_MAX);
+	__m256 over= _mm256_setzero_ps();
+	bool saturated;
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+    {
+		__m256 a= _mm256_loadu_ps(&in[k]);
+		__m256i value;
+
+		over= _mm256_or_ps(over, _mm256_or_ps(_mm256_cmp_ps(a, high, _CMP_GT_OQ),
+											  _mm256_cmp_ps(a, low, _CMP_LT_OQ)));
+		value= _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(a, low), high));
+		_mm_storeu_si128((__m128i*) &out[k],
+						 _mm_packs_epi32(_mm256_castsi256_si128(value),
+										 _mm256_extracti128_si256(value, 1)));
+    }
+	saturated= (_mm256_movemask_ps(over) != 0);
+	_mm256_zeroupper();
+	if (clip_scalar(&in[k], &out[k], nb-k))
+		saturated=True;
+	return saturated;
+}
+
+static TARGET_AVX2 void scale_avx2(float* buffer, float ratio, int nb)
+/* buffer[k] *= ratio */
+{
+	__m256 r= _mm256_set1_ps(ratio);
+	int k;
+
+	for (k=0; k+8<=nb; k+=8)
+		_mm256_storeu_ps(&buffer[k], _mm256_mul_ps(_mm256_loadu_ps(&buffer[k]), r));
+	_mm256_zeroupper();
+	scale_scalar(&buffer[k], ratio, nb-k);
+}
+
+static KernelSet avx2_kernels=
+{
+	KERNELS_AVX2,
+	ola_voiced_avx2,
+	ola_unvoiced_avx2,
+	ola_smooth_avx2,
+	ola_add_avx2,
+	ola_frame_avx2,
+	ola_frame_smooth_avx2,
+	smooth_vector_avx2,
+	clip_avx2,
+	scale_avx2
+};
+
+/* AVX-512: 16 samples a vector */
+
+static TARGET_AVX512 __m512 load_avx512(int16* samples)
+/* 16 int16 samples as floats */
+{
+	return _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm256_loadu_si256((__m256i*) samples)));
+}
+
+static TARGET_AVX512 void ola_voiced_avx512(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += correction * weight[k] * samples[k] */
+{
+	__m512 c= _mm512_set1_ps(correction);
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+    {
+		__m512 w= _mm512_mul_ps(c, _mm512_loadu_ps(&weight[k]));
+		_mm512_storeu_ps(&ola[k], _mm512_add_ps(_mm512_loadu_ps(&ola[k]),
+												_mm512_mul_ps(w, load_avx512(&samples[k]))));
+    }
+	_mm256_zeroupper();
+	ola_voiced_scalar(&ola[k], &weight[k], &samples[k], correction, nb-k);
+}
+
+static TARGET_AVX512 void ola_unvoiced_avx512(float* ola, float* weight, int16* samples, float correction, int nb)
+/* ola[k] += weight[k] * samples[k] * correction */
+{
+	__m512 c= _mm512_set1_ps(correction);
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+    {
+		__m512 tmp= _mm512_mul_ps(_mm512_loadu_ps(&weight[k]), load_avx512(&samples[k]));
+		_mm512_storeu_ps(&ola[k], _mm512_add_ps(_mm512_loadu_ps(&ola[k]), _mm512_mul_ps(tmp, c)));
+    }
+	_mm256_zeroupper();
+	ola_unvoiced_scalar(&ola[k], &weight[k], &samples[k], correction, nb-k);
+}
+
+static TARGET_AVX512 void ola_smooth_avx512(float* ola, float* weight, int16* samples, float* smoothw,
+											float smooth, float correction, int nb)
+/* ola[k] += correction * (weight[k] * samples[k] + smooth * smoothw[k]) */
+{
+	__m512 c= _mm512_set1_ps(correction);
+	__m512 s= _mm512_set1_ps(smooth);
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+    {
+		__m512 tmp= _mm512_add_ps(_mm512_mul_ps(_mm512_loadu_ps(&weight[k]), load_avx512(&samples[k])),
+								  _mm512_mul_ps(s, _mm512_loadu_ps(&smoothw[k])));
+		_mm512_storeu_ps(&ola[k], _mm512_add_ps(_mm512_loadu_ps(&ola[k]), _mm512_mul_ps(c, tmp)));
+    }
+	_mm256_zeroupper();
+	ola_smooth_scalar(&ola[k], &weight[k], &samples[k], &smoothw[k], smooth, correction, nb-k);
+}
+
+static TARGET_AVX512 void ola_add_avx512(float* ola, float* frame, int nb)
+/* ola[k] += frame[k] */
+{
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+		_mm512_storeu_ps(&ola[k], _mm512_add_ps(_mm512_loadu_ps(&ola[k]), _mm512_loadu_ps(&frame[k])));
+	_mm256_zeroupper();
+	ola_add_scalar(&ola[k], &frame[k], nb-k);
+}
+
+static TARGET_AVX512 void ola_frame_avx512(float* ola, float* frame, float correction, int nb)
+/* ola[k] += correction * frame[k] */
+{
+	__m512 c= _mm512_set1_ps(correction);
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+    {
+		__m512 tmp= _mm512_mul_ps(c, _mm512_loadu_ps(&frame[k]));
+		_mm512_storeu_ps(&ola[k], _mm512_add_ps(_mm512_loadu_ps(&ola[k]), tmp));
+    }
+	_mm256_zeroupper();
+	ola_frame_scalar(&ola[k], &frame[k], correction, nb-k);
+}
+
+static TARGET_AVX512 void ola_frame_smooth_avx512(float* ola, float* frame, float* smoothw,
+												  float smooth, float correction, int nb)
+/* ola[k] += correction * (frame[k] + smooth * smoothw[k]) */
+{
+	__m512 c= _mm512_set1_ps(correction);
+	__m512 s= _mm512_set1_ps(smooth);
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+    {
+		__m512 tmp= _mm512_add_ps(_mm512_loadu_ps(&frame[k]), _mm512_mul_ps(s, _mm512_loadu_ps(&smoothw[k])));
+		_mm512_storeu_ps(&ola[k], _mm512_add_ps(_mm512_loadu_ps(&ola[k]), _mm512_mul_ps(c, tmp)));
+    }
+	_mm256_zeroupper();
+	ola_frame_smooth_scalar(&ola[k], &frame[k], &smoothw[k], smooth, correction, nb-k);
+}
+
+static TARGET_AVX512 void smooth_vector_avx512(float* smoothw, int16* left, int16* right, float* weight, int nb)
+/* smoothw[k]= (left[k] - right[k]) * weight[k] */
+{
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+    {
+		__m512 diff= _mm512_sub_ps(load_avx512(&left[k]), load_avx512(&right[k]));
+		_mm512_storeu_ps(&smoothw[k], _mm512_mul_ps(diff, _mm512_loadu_ps(&weight[k])));
+    }
+	_mm256_zeroupper();
+	smooth_vector_scalar(&smoothw[k], &left[k], &right[k], &weight[k], nb-k);
+}
+
+static TARGET_AVX512 bool clip_avx512(float* in, int16* out, int nb)
+/* out[k]= in[k] clipped to +-32765, True if any sample was clipped */
+{
+	__m512 high= _mm512_set1_ps(CLIP_MAX);
+	__m512 low= _mm512_set1_ps(-CLIP_MAX);
+	__mmask16 over=0;
+	bool saturated;
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+    {
+		__m512 a= _mm512_loadu_ps(&in[k]);
+
+		over|= _mm512_cmp_ps_mask(a, high, _CMP_GT_OQ) | _mm512_cmp_ps_mask(a, low, _CMP_LT_OQ);
+		_mm256_storeu_si256((__m256i*) &out[k],
+							_mm512_cvtsepi32_epi16(_mm512_cvttps_epi32(
+													   _mm512_min_ps(_mm512_max_ps(a, low), high))));
+    }
+	saturated= (over != 0);
+	_mm256_zeroupper();
+	if (clip_scalar(&in[k], &out[k], nb-k))
+		saturated=True;
+	return saturated;
+}
+
+static TARGET_AVX512 void scale_avx512(float* buffer, float ratio, int nb)
+/* buffer[k] *= ratio */
+{
+	__m512 r= _mm512_set1_ps(ratio);
+	int k;
+
+	for (k=0; k+16<=nb; k+=16)
+		_mm512_storeu_ps(&buffer[k], _mm512_mul_ps(_mm512_loadu_ps(&buffer[k]), r));
+	_mm256_zeroupper();
+	scale_scalar(&buffer[k], ratio, nb-k);
+}
+
+static KernelSet avx512_kernels=
+{
+	KERNELS_AVX512,
+	ola_voiced_avx512,
+	ola_unvoiced_avx512,
+	ola_smooth_avx512,
+	ola_add_avx512,
+	ola_frame_avx512,
+	ola_frame_smooth_avx512,
+	smooth_vector_avx512,
+	clip_avx512,
+	scale_avx512
+};
+
+#endif
+
+char* name_KernelLevel(KernelLevel level)
+/* Name of a level, as in MBROLA_KERNELS */
+{
+	static char* names[NB_KERNEL_LEVELS]= { "scalar", "sse4.1", "avx2", "avx512" };
+
+	if ((level < 0) || (level >= NB_KERNEL_LEVELS))
+		return "unknown";
+	return names[level];
+}
+
+int parse_KernelLevel(char* name)
+/* Level of a name, -1 if unknown */
+{
+	int level;
+
+	for (level=0; level<NB_KERNEL_LEVELS; level++)
+		if (strcmp(name, name_KernelLevel((KernelLevel) level)) == 0)
+			return level;
+	return -1;
+}
+
+bool supported_KernelLevel(KernelLevel level)
+/* True if the build and the CPU have the kernels of that level */
+{
+	switch(level)
+    {
+    case KERNELS_SCALAR:
+		return True;
+#ifdef X86_KERNELS
+		/* The CPU and the OS (saved vector registers) */
+    case KERNELS_SSE41:
+		return __builtin_cpu_supports("sse4.1") != 0;
+    case KERNELS_AVX2:
+		return __builtin_cpu_supports("avx2") != 0;
+    case KERNELS_AVX512:
+		return __builtin_cpu_supports("avx512f") != 0;
+#endif
+    default:
+		return False;
+    }
+}
+
+KernelLevel best_KernelLevel(void)
+/* Highest level supported */
+{
+	int level= NB_KERNEL_LEVELS-1;
+
+	while ((level > KERNELS_SCALAR) && !supported_KernelLevel((KernelLevel) level))
+		level--;
+	return (KernelLevel) level;
+}
+
+KernelLevel default_KernelLevel(void)
+/*
+ * Level of a new engine: the highest one, or MBROLA_KERNELS from the
+ * environment if it is lower
+ */
+{
+	KernelLevel level= best_KernelLevel();
+	char* name= getenv("MBROLA_KERNELS");
+
+	if (name)
+    {
+		int wanted= parse_KernelLevel(name);
+
+		if ((wanted >= 0) && (wanted < (int) level))
+			level= (KernelLevel) wanted;
+    }
+	return level;
+}
+
+KernelSet* get_KernelSet(KernelLevel level)
+/* Kernels of a level, NULL if it is not supported */
+{
+	if (!supported_KernelLevel(level))
+		return NULL;
+
+	switch(level)
+    {
+#ifdef X86_KERNELS
+    case KERNELS_SSE41:
+		return &sse41_kernels;
+    case KERNELS_AVX2:
+		return &avx2_kernels;
+    case KERNELS_AVX512:
+		return &avx512_kernels;
+#endif
+    default:
+		return &scalar_kernels;
+    }
+}
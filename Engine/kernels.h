@@ -0,0 +1,112 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    kernels.h
+ * Purpose: inner loops of the engine, selected for the CPU at run time
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ *
+ *   Each kernel has a portable version and, on x86 with GCC or Clang, SSE4.1,
+ *   AVX2 and AVX-512 versions compiled with target attributes: one binary
+ *   runs on any x86 and uses what the CPU has. init_Mbrola picks the best
+ *   level the CPU supports. MBROLA_KERNELS=scalar|sse4.1|avx2|avx512 in the
+ *   environment, or set_kernels_Mbrola, selects a lower one to test or time
+ *   each version. -DNO_KERNEL_DISPATCH keeps the portable versions only.
+ *
+ *   All the versions make the same float operations in the same order
+ *   (no FMA, no reordered sums), so that they give the same samples.
+ *
+ * 19/10/26 : ola_add, ola_frame and ola_frame_smooth for the frames windowed
+ *   by the database (window_Database), scale for the volume they leave out
+ *
+ * 19/10/26 : smooth_vector, the smoothing vector is in floats
+ */
+
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include "common.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(NO_KERNEL_DISPATCH)
+#define X86_KERNELS
+#endif
+
+typedef enum
+{
+	KERNELS_SCALAR=0,
+	KERNELS_SSE41,
+	KERNELS_AVX2,
+	KERNELS_AVX512,
+	NB_KERNEL_LEVELS
+} KernelLevel;
+
+typedef struct
+{
+	KernelLevel level;
+
+	void (*ola_voiced)(float* ola, float* weight, int16* samples, float correction, int nb);
+	/* ola[k] += correction * weight[k] * samples[k] */
+
+	void (*ola_unvoiced)(float* ola, float* weight, int16* samples, float correction, int nb);
+	/* ola[k] += weight[k] * samples[k] * correction */
+
+	void (*ola_smooth)(float* ola, float* weight, int16* samples, float* smoothw,
+					   float smooth, float correction, int nb);
+	/* ola[k] += correction * (weight[k] * samples[k] + smooth * smoothw[k]) */
+
+	void (*ola_add)(float* ola, float* frame, int nb);
+	/* ola[k] += frame[k], frames windowed by the database */
+
+	void (*ola_frame)(float* ola, float* frame, float correction, int nb);
+	/* ola[k] += correction * frame[k] */
+
+	void (*ola_frame_smooth)(float* ola, float* frame, float* smoothw,
+							 float smooth, float correction, int nb);
+	/* ola[k] += correction * (frame[k] + smooth * smoothw[k]) */
+
+	void (*smooth_vector)(float* smoothw, int16* left, int16* right, float* weight, int nb);
+	/* smoothw[k]= (left[k] - right[k]) * weight[k], the smoothing vector of Concat */
+
+	bool (*clip)(float* in, int16* out, int nb);
+	/* out[k]= in[k] clipped to +-32765, True if any sample was clipped */
+
+	void (*scale)(float* buffer, float ratio, int nb);
+	/* buffer[k] *= ratio */
+} KernelSet;
+
+char* name_KernelLevel(KernelLevel level);
+/* Name of a level, as in MBROLA_KERNELS */
+
+int parse_KernelLevel(char* name);
+/* Level of a name, -1 if unknown */
+
+bool supported_KernelLevel(KernelLevel level);
+/* True if the build and the CPU have the kernels of that level */
+
+KernelLevel best_KernelLevel(void);
+/* Highest level supported */
+
+KernelLevel default_KernelLevel(void);
+/*
+ * Level of a new engine: the highest one, or MBROLA_KERNELS from the
+ * environment if it is lower
+ */
+
+KernelSet* get_KernelSet(KernelLevel level);
+/* Kernels of a level, NULL if it is not supported */
+
+#endif
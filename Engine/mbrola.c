@@ -49,6 +49,49 @@
  *
  * 28/03/00 : Rom databases, malloc'ed diphone buffers
  *            Test in Concat for degenerated case "0ms long phonemes"
+ *
+ * 19/10/26 : Library mode keeps a copy of its last error, as the global
+ *            error state is thread local in multithreaded applications
+ *
+ * 19/10/26 : forget_Mbrola to make independent utterances with one engine
+ *
+ * 19/10/26 : Standalone engines may have their own output file
+ *
+ * 19/10/26 : Output through audio sinks, so that the headers are right on
+ *            pipes
+ *
+ * 19/10/26 : push_Mbrola, library output pushed diphone by diphone
+ *
+ * 19/10/26 : FLOAT32 and LIN24 outputs taken from the float OLA buffer,
+ *            without the 16 bits clipping of ola_integer
+ *
+ * 19/10/26 : set_outfreq_Mbrola, output resampled by FlushFile to any
+ *            sample rate
+ *
+ * 19/10/26 : PROFILE times the stages of the synthesis in each engine
+ *
+ * 19/10/26 : activity counters of the engine (get_metrics_Mbrola)
+ *
+ * 19/10/26 : OLA and clipping loops through the kernels of the CPU,
+ *            selected by init_Mbrola (kernels.c)
+ *
+ * 19/10/26 : frames windowed by the database (window_Database) are added
+ *            as they are, the volume is then applied by FlushFile
+ *
+ * 19/10/26 : runs of frames MBRPeriod apart (unmodified pitch) are added
+ *            then flushed at once by OverLapAddFrames
+ *
+ * 19/10/26 : the smoothing vector of Concat is kept in floats, without the
+ *            truncation to 16 bits: the smoothed frames change (by 1 at
+ *            most on 16 bits samples)
+ *
+ * 19/10/26 : smoothed frames counted in the activity counters
+ *
+ * 19/10/26 : a diphone of 0 frames after a run reads again the last frame
+ *            of the run only, as after OverLapAdd
+ *
+ * 19/10/26 : the output buffers (ola, push spans) out of memory are an
+ *            error of readtype_Mbrola and push_Mbrola, not a NULL pointer
  */
 
 #include <math.h>
@@ -61,6 +104,98 @@
 #include "parser.h"
 #include "mbrola.h"
 
+#ifdef PROFILE
+
+#include <time.h>
+
+static double clock_Profile(void)
+/* Monotonic clock, in seconds */
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void begin_stage_Mbrola(Mbrola* mb, Stage stage)
+/* The stage starts, interrupting the one being timed if any */
+{
+	Profile* prof= &profile(mb);
+
+	prof->parent[stage]= prof->active;
+	prof->active= stage;
+	prof->start[stage]= clock_Profile();
+}
+
+static void end_stage_Mbrola(Mbrola* mb, Stage stage)
+/* The stage ends, the interrupted one doesn't count its time */
+{
+	Profile* prof= &profile(mb);
+	double elapsed= clock_Profile() - prof->start[stage];
+
+	prof->stats.seconds[stage]+= elapsed;
+	prof->stats.calls[stage]++;
+	prof->active= prof->parent[stage];
+	if (prof->active >= 0)
+		prof->start[prof->active]+= elapsed;
+}
+
+#define begin_stage(mb, stage) begin_stage_Mbrola(mb, stage)
+#define end_stage(mb, stage) end_stage_Mbrola(mb, stage)
+
+#else
+
+/* Compiled out */
+#define begin_stage(mb, stage)
+#define end_stage(mb, stage)
+
+#endif
+
+char* name_Stage(Stage stage)
+/* Name of a stage of the synthesis, for the reports */
+{
+	static char* names[NB_STAGES]= { "parse", "fetch", "prosody", "concat", "ola", "output" };
+
+	if ((stage < 0) || (stage >= NB_STAGES))
+		return "unknown";
+	return names[stage];
+}
+
+bool get_stats_Mbrola(Mbrola* mb, StageStats* stats)
+/*
+ * Time spent in each stage since init_Mbrola or reset_stats_Mbrola.
+ * False (and zeros) if the engine is compiled without PROFILE
+ */
+{
+#ifdef PROFILE
+	*stats= profile(mb).stats;
+	return True;
+#else
+	memset(stats, 0, sizeof(StageStats));
+	return False;
+#endif
+}
+
+void reset_stats_Mbrola(Mbrola* mb)
+/* Start the timing of the stages again */
+{
+#ifdef PROFILE
+	memset(&profile(mb), 0, sizeof(Profile));
+	profile(mb).active= -1;
+#endif
+}
+
+void get_metrics_Mbrola(Mbrola* mb, EngineMetrics* metrics)
+/* Activity of the engine since init_Mbrola, from any thread */
+{
+	metrics->diphones= read_Counter(counters(mb).diphones);
+	metrics->frames= read_Counter(counters(mb).frames);
+	metrics->samples= read_Counter(counters(mb).samples);
+	metrics->substitutions= read_Counter(counters(mb).substitutions);
+	metrics->saturations= read_Counter(counters(mb).saturations);
+	metrics->smoothed= read_Counter(counters(mb).smoothed);
+}
+
 void init_Hanning(float* table,int size,float ratio)
 /* 
  * Initialize the Hanning weighting window  
@@ -74,17 +209,66 @@ void init_Hanning(float* table,int size,float ratio)
 		table[i]= (float) (ratio * 0.5 * (1.0 - cos((double)i*2*3.14159265358979323846/(float)size)));
 }
 
+static bool update_resampler_Mbrola(Mbrola* mb)
+/* 
+ * Resampler from VoiceFreq to OutFreq, none if they are equal
+ * Return False in case of error
+ */
+{
+	if (resampler(mb))
+    {
+		close_Resampler(resampler(mb));
+		resampler(mb)=NULL;
+    }
+
+	if ((OutFreq(mb)==0) || (OutFreq(mb)==VoiceFreq(mb)))
+		return True;
+
+	resampler(mb)= init_Resampler(VoiceFreq(mb), OutFreq(mb));
+	if (!resampler(mb))
+    {
+		fatal_message(ERROR_OUTFREQ,
+					  "Can't resample from %i to %i Hz\n",
+					  VoiceFreq(mb), OutFreq(mb));
+		return False;
+    }
+	return True;
+}
+
 void set_voicefreq_Mbrola(Mbrola* mb, uint16 OutFreq)
 /* Change the Output Freq and VoiceRatio to change the vocal tract 	*/
 {
 	VoiceFreq(mb)=OutFreq;
 	VoiceRatio(mb)=(float) VoiceFreq(mb) / (float)Freq(diph_dba(mb));
+	update_resampler_Mbrola(mb);
 }
 
 uint16 get_voicefreq_Mbrola(Mbrola* mb)
 /* Get output Frequency */
 { return( VoiceFreq(mb)); }
 
+bool set_outfreq_Mbrola(Mbrola* mb, uint16 OutFreq)
+/* 
+ * Resample the output from VoiceFreq to OutFreq, 0 means no resampling.
+ * Return False in case of error (unsupported ratio)
+ */
+{
+	OutFreq(mb)=OutFreq;
+	if (update_resampler_Mbrola(mb))
+		return True;
+
+	OutFreq(mb)=0;
+	return False;
+}
+
+uint16 get_outfreq_Mbrola(Mbrola* mb)
+/* Freq of the samples: OutFreq, or VoiceFreq without resampling */
+{
+	if (resampler(mb))
+		return OutFreq(mb);
+	return VoiceFreq(mb);
+}
+
 void set_smoothing_Mbrola(Mbrola* mb, bool smoothing)
 /* Spectral smoothing or not */
 { smoothing(mb)= smoothing; }
@@ -102,9 +286,15 @@ bool get_no_error_Mbrola(Mbrola* mb)
 { return no_error(mb); }
 
 void set_volume_ratio_Mbrola(Mbrola* mb, float volume_ratio)
-/* Overall volume */
+/* 
+ * Overall volume, FlushFile applies it when the database has windowed
+ * frames: they can't embed it
+ */
 { 
-	init_Hanning( weight(mb), 2*MBRPeriod(diph_dba(mb)), volume_ratio);
+	if (windowed(diph_dba(mb)))
+		init_Hanning( weight(mb), 2*MBRPeriod(diph_dba(mb)), 1.0f);
+	else
+		init_Hanning( weight(mb), 2*MBRPeriod(diph_dba(mb)), volume_ratio);
 	volume_ratio(mb)= volume_ratio;
 }
 
@@ -112,6 +302,24 @@ float get_volume_ratio_Mbrola(Mbrola* mb)
 /* Overall volume */
 { return volume_ratio(mb); }
 
+bool set_kernels_Mbrola(Mbrola* mb, KernelLevel level)
+/* 
+ * Inner loops of a given level (scalar, SSE4.1...) instead of the default
+ * one. Return False if the CPU doesn't support it
+ */
+{
+	KernelSet* set= get_KernelSet(level);
+
+	if (!set)
+		return False;
+	kernels(mb)= set;
+	return True;
+}
+
+KernelLevel get_kernels_Mbrola(Mbrola* mb)
+/* Level of the inner loops */
+{ return kernels(mb)->level; }
+
 void set_parser_Mbrola(Mbrola* mb, Parser* parser)
 /* drop the current parser for a new one */
 { parser(mb)= parser; }
@@ -129,21 +337,38 @@ Mbrola* init_Mbrola(Database* dba)
 	diph_dba(mb) =dba;
 
 	/* Allocate buffers */
-	ola_win(mb) = MBR_malloc( sizeof(float)* MBRPeriod(dba)* 2 );
+	ola_win(mb) = MBR_malloc( sizeof(float)* MBRPeriod(dba)* (RUN_FRAMES+2) );
 	ola_integer(mb) = MBR_malloc( sizeof(int16)* MBRPeriod(dba)*2 );
+	ola_float(mb) = MBR_malloc( sizeof(float)* MBRPeriod(dba)*2 );
+	ola_size(mb) = MBRPeriod(dba)*2;
 	weight(mb) = MBR_malloc( sizeof(float)* MBRPeriod(dba)*2 );
   
 	/* Default settings ! */
+	kernels(mb)= get_KernelSet(default_KernelLevel());
+	OutFreq(mb)=0;
+	resampler(mb)=NULL;
 	set_voicefreq_Mbrola(mb, Freq(dba)); /* VoiceRatio=1.0 */
 	set_volume_ratio_Mbrola(mb, 1.0f);
 	set_smoothing_Mbrola(mb,True);
 	set_no_error_Mbrola(mb,False);
+	reset_stats_Mbrola(mb);
+	memset(&counters(mb), 0, sizeof(EngineMetrics));
 
 	saturation(mb) =False;
 	audio_length(mb) =0;
 	last_time_crumb(mb) =0;
 #ifdef LIBRARY
 	first_call(mb)=True;
+	eaten(mb)=0;
+	buffer_shift(mb)=0;
+	zero_padding(mb)=0;
+	reset_ErrorState(&last_error(mb));
+	float_output(mb)=False;
+	end_state(mb)=PHO_OK;
+	last_frame(mb) = MBR_malloc( sizeof(float)* MBRPeriod(dba)*2 );
+	last_shift(mb)=0;
+#else
+	out_sink(mb)=NULL;
 #endif
 
 	/* prev_diph points to the previous diphone synthesis structure
@@ -182,7 +407,13 @@ void close_Mbrola(Mbrola* mb)
 	/* Buffers and windows */
 	MBR_free( ola_win(mb) );
 	MBR_free( ola_integer(mb) );
+	MBR_free( ola_float(mb) );
 	MBR_free( weight(mb) );
+	if (resampler(mb))
+		close_Resampler(resampler(mb));
+#ifdef LIBRARY
+	MBR_free( last_frame(mb) );
+#endif
 
 	MBR_free(mb);
 	debug_message1("done close_Mbrola\n");
@@ -199,6 +430,7 @@ bool reset_Mbrola(Mbrola* mb)
  */
 {
 	int i;
+	bool found;
   
 	debug_message1("reset_Mbrola\n");
 
@@ -214,7 +446,10 @@ bool reset_Mbrola(Mbrola* mb)
 	LeftPhone(cur_diph(mb)) = init_Phone( sil_phon(diph_dba(mb)), 0.0); 
 	RightPhone(cur_diph(mb)) = init_Phone( sil_phon(diph_dba(mb)), 0.0); 
   
-	if (!diph_dba(mb)->getdiphone_Database( diph_dba(mb), cur_diph(mb) ))
+	begin_stage(mb, STAGE_FETCH);
+	found= diph_dba(mb)->getdiphone_Database( diph_dba(mb), cur_diph(mb) );
+	end_stage(mb, STAGE_FETCH);
+	if (!found)
     {
 		fatal_message( ERROR_DBNOSILENCE,
 					   "_-_ PANIC with %s!\n",
@@ -229,15 +464,33 @@ bool reset_Mbrola(Mbrola* mb)
 	for (i=0; i< 2*MBRPeriod(diph_dba(mb)); i++)
 		ola_win(mb)[i]=0.0f;
   
+	/* A new utterance for the resampler */
+	if (resampler(mb))
+		reset_Resampler(resampler(mb));
+
 #ifdef LIBRARY
 	/* Indicate that the first call to read_MBR must trigger an initialization */
 	first_call(mb)=True;
+	end_state(mb)=PHO_OK;
+	last_shift(mb)=0;
 #endif
   
 	debug_message1("done reset_Mbrola\n");
 	return True;
 }
 
+void forget_Mbrola(Mbrola* mb)
+/*
+ * Forget what remains of the previous utterances (time rounding, smoothing
+ * bounds), so that the next one is synthesized as by a fresh engine.
+ * To be called before reset_Mbrola
+ */
+{
+	saturation(mb) =False;
+	last_time_crumb(mb) =0;
+	nb_end(mb)=1000; /* same as init_Mbrola */
+}
+
 StatePhone NextDiphone(Mbrola* mb)
 /*
  * Reads a phone from the phonetic command buffer and prepares the next
@@ -250,12 +503,16 @@ StatePhone NextDiphone(Mbrola* mb)
 	int len_anal;	   /* Number of sample in last segment analysed     */
 	Phone* my_phone;
 	StatePhone state;
+	bool found;
   
 	DiphoneSynthesis *temp;
   
 	debug_message1("NextDiphone\n");
   
-	if ((state=parser(mb)->nextphone_Parser(parser(mb),&my_phone))!=PHO_OK)
+	begin_stage(mb, STAGE_PARSE);
+	state=parser(mb)->nextphone_Parser(parser(mb),&my_phone);
+	end_stage(mb, STAGE_PARSE);
+	if (state!=PHO_OK)
     {
 		debug_message1("done NextDiphone PHO_NOT_OK\n");
 		return(state);
@@ -286,7 +543,10 @@ StatePhone NextDiphone(Mbrola* mb)
 	/* 
 	 * Load the diphone from the database !!
 	 */
-	if ( ! diph_dba(mb)->getdiphone_Database( diph_dba(mb), cur_diph(mb)) )
+	begin_stage(mb, STAGE_FETCH);
+	found= diph_dba(mb)->getdiphone_Database( diph_dba(mb), cur_diph(mb));
+	end_stage(mb, STAGE_FETCH);
+	if ( !found )
     {
 		bool success= False; /* then ... we failed */
       
@@ -305,7 +565,11 @@ StatePhone NextDiphone(Mbrola* mb)
 			name_Phone( LeftPhone( cur_diph(mb)))= sil_phon( diph_dba(mb));
 			name_Phone( RightPhone( cur_diph(mb)))= sil_phon(diph_dba(mb));
 	  
+			begin_stage(mb, STAGE_FETCH);
 			success= diph_dba(mb)->getdiphone_Database( diph_dba(mb), cur_diph(mb));
+			end_stage(mb, STAGE_FETCH);
+			if (success)
+				inc_Counter(counters(mb).substitutions, 1);
 	  
 			/* Restore situation */
 			name_Phone( LeftPhone( cur_diph(mb)))= temp_left;
@@ -375,6 +639,7 @@ bool MatchProsody(Mbrola* mb)
 	int old_len1;             /* Length1 in samples before adjustment */
   
 	debug_message1("MatchProsody\n");
+	begin_stage(mb, STAGE_PROSODY);
   
 	/* Modify the length of the 2nd part of a phone if the end of its 1st 
 	   part does not correspond to its theoretical value */
@@ -460,6 +725,7 @@ bool MatchProsody(Mbrola* mb)
 							   "%s-%s Concat : PANIC, check your pitch :-)\n",
 							   name_Phone(LeftPhone(prev_diph(mb))),	
 							   name_Phone(RightPhone(prev_diph(mb))));
+				end_stage(mb, STAGE_PROSODY);
 				return False;
 			}
 		}
@@ -472,6 +738,8 @@ bool MatchProsody(Mbrola* mb)
 	/* total length that should have been synthesized -last effective sample */
 	last_time_crumb(mb)+= (old_len1+Length2(prev_diph(mb))) - frame_pos(mb)[k-1] ;
 
+	inc_Counter(counters(mb).diphones, 1);
+	end_stage(mb, STAGE_PROSODY);
 	debug_message1("done MatchProsody\n");
 	return True;
 }
@@ -495,12 +763,12 @@ void Concat(Mbrola* mb)
 	/* frame of concatenation point             */
 	int16 *buff_left;            /* speech buffer on left of junction  */
 	int16 *buff_right;           /* speech buffer on right of junction */
-	int i,j;
 	int cur_sample;	         /* sample offset in synthesis window        */
 	int maxnconcat;
 	int limitframe;
   
 	debug_message1("Concat\n");
+	begin_stage(mb, STAGE_CONCAT);
 
 	/* We compute the first Olaed frame for cur_diph -> we can't do
 	 * Matchprosody on it yet since we lack pitch points...
@@ -543,12 +811,13 @@ void Concat(Mbrola* mb)
 		buff_right= &buffer(cur_diph(mb))[first_frame];
 		
 		/* For the first half, no problem */
-		for(i=0;i<MBRPeriod(diph_dba(mb));i++)
-			smoothw(cur_diph(mb))[i] = (int) ((buff_left[i]-buff_right[i]) * weight(mb)[i]);
+		kernels(mb)->smooth_vector(smoothw(cur_diph(mb)), buff_left, buff_right,
+								   weight(mb), MBRPeriod(diph_dba(mb)));
 	 
 		/* For the second half, reset counters of looped frames */
-		for(j=0;i<(MBRPeriod(diph_dba(mb))*2); i++,j++)
-			smoothw(cur_diph(mb))[i] = (int) ((buff_left[j]-buff_right[j]) * weight(mb)[i]);
+		kernels(mb)->smooth_vector(&smoothw(cur_diph(mb))[MBRPeriod(diph_dba(mb))],
+								   buff_left, buff_right,
+								   &weight(mb)[MBRPeriod(diph_dba(mb))], MBRPeriod(diph_dba(mb)));
     }
 	else
 		smooth(cur_diph(mb))=False;
@@ -602,41 +871,236 @@ void Concat(Mbrola* mb)
 	if (pmrk_DiphoneSynthesis(cur_diph(mb), 1) != V_REG) 
 		nb_end(mb)=0; 
 
+	end_stage(mb, STAGE_CONCAT);
 	debug_message2("end %i ", nb_end(mb));
 	debug_message1("done Concat\n");
 }
 
-void FlushFile(Mbrola* mb, int shift, int shift_zero)
+#ifndef LIBRARY
+
+void set_output_Mbrola(Mbrola* mb, AudioSink* output)
 /*
- * Flush on file what's computed
+ * Audio output of the engine, so that many engines can write different
+ * files. NULL means back to output_sink
  */
 {
-	int k;
-  
-	for (k=0;k<shift;k++) 
+	out_sink(mb)= output;
+}
+
+static AudioSink* sink_Mbrola(Mbrola* mb)
+/* Output of the engine */
+{
+	if (out_sink(mb))
+		return out_sink(mb);
+	return output_sink;
+}
+
+static int write_Mbrola(Mbrola* mb, int16* buffer, int count)
+/* Write samples on the output of the engine */
+{
+	int nb= write_AudioSink(sink_Mbrola(mb), buffer, count);
+
+	if (nb > 0)
+		inc_Counter(counters(mb).samples, nb);
+	return nb;
+}
+
+static int write_float_Mbrola(Mbrola* mb, float* buffer, int count)
+/* Write float samples (16 bits scale) on the output of the engine */
+{
+	int nb= write_float_AudioSink(sink_Mbrola(mb), buffer, count);
+
+	if (nb > 0)
+		inc_Counter(counters(mb).samples, nb);
+	return nb;
+}
+
+#endif
+
+static void clip_Mbrola(Mbrola* mb, float* in, int16* out, int nb)
+/* Float samples to 16 bits, the clipping raises saturation(mb) */
+{
+	if (kernels(mb)->clip(in, out, nb))
+		saturation(mb)=True;
+}
+
+static bool reserve_Mbrola(Mbrola* mb, int nb)
+/* 
+ * Room for nb samples in ola_integer and ola_float, False if out of
+ * memory (the buffers are kept as they are)
+ */
+{
+	int16* integer;
+	float* flt;
+
+	if (nb <= ola_size(mb))
+		return True;
+
+	integer= (int16*) MBR_realloc(ola_integer(mb), sizeof(int16)*nb);
+	if (integer)
+		ola_integer(mb)= integer;
+	flt= (float*) MBR_realloc(ola_float(mb), sizeof(float)*nb);
+	if (flt)
+		ola_float(mb)= flt;
+	if (!integer || !flt)
     {
-		if (ola_win(mb)[k] > 32765)
-		{
-			saturation(mb)=True;
-			ola_integer(mb)[k]=32765;
-		}
-		else if (ola_win(mb)[k] < -32765)
-		{
-			saturation(mb)=True;
-			ola_integer(mb)[k]=-32765;
-		}
-		else 
-			ola_integer(mb)[k]= (int16) ola_win(mb)[k];
+		fatal_message(ERROR_MEMORYOUT,"FATAL: out of memory for %i samples\n", nb);
+		return False;
     }
+	ola_size(mb)= nb;
+	return True;
+}
+
+static int output_resampled(Mbrola* mb, int nb)
+/* 
+ * Deliver nb resampled samples of ola_float: standalone writes them,
+ * library mode keeps them for the reader
+ */
+{
+#ifdef LIBRARY
+	if (!float_output(mb))
+		clip_Mbrola(mb, ola_float(mb), ola_integer(mb), nb);
+#else
+	/* The sink clips, as for the -J copy */
+	nb= write_float_Mbrola(mb, ola_float(mb), nb);
+	audio_length(mb)+= nb;
+#endif
+	buffer_shift(mb)=nb;
+	zero_padding(mb)=0;
+	return nb;
+}
+
+static bool resample_Mbrola(Mbrola* mb, int shift, int shift_zero)
+/* 
+ * FlushFile through the resampler, the zeros are resampled too. False
+ * if out of memory
+ */
+{
+	Resampler* rs= resampler(mb);
+	int nb;
+
+	if (shift_zero < 0)
+		shift_zero=0;
+#ifdef LIBRARY
+	/* OverLapAddRun flushes more, and keeps its last frame itself */
+	if (shift <= 2*MBRPeriod(diph_dba(mb)))
+	{
+		memcpy(last_frame(mb), ola_win(mb), shift*sizeof(float));
+		last_shift(mb)=shift;
+	}
+#endif
+	if (!reserve_Mbrola(mb, max_output_Resampler(rs, shift + shift_zero)))
+		return False;
+	nb= run_Resampler(rs, ola_win(mb), shift, ola_float(mb));
+	nb+= run_Resampler(rs, NULL, shift_zero, &ola_float(mb)[nb]);
+	output_resampled(mb, nb);
+	return True;
+}
+
+static int drain_Mbrola(Mbrola* mb)
+/* 
+ * End of an utterance: output the last samples held by the resampler,
+ * return their number, or -1 if out of memory
+ */
+{
+	Resampler* rs= resampler(mb);
+	int nb;
+
+	if (!rs)
+		return 0;
+
+	/* Nothing pending leaves the samples of the last flush as they are */
+	begin_stage(mb, STAGE_OUTPUT);
+	if (!reserve_Mbrola(mb, max_output_Resampler(rs, rs->nb_taps)))
+		nb= -1;
+	else if ((nb= drain_Resampler(rs, ola_float(mb))) > 0)
+		nb= output_resampled(mb, nb);
+	end_stage(mb, STAGE_OUTPUT);
+	return nb;
+}
+
+#ifdef LIBRARY
+
+static bool repeat_Mbrola(Mbrola* mb)
+/* 
+ * A diphone of 0 frames reads the last frame again: the resampler gets
+ * its input again, as the samples at the voice frequency hold it twice.
+ * Without resampler the last frame is the tail of the flushed samples.
+ * False if out of memory
+ */
+{
+	Resampler* rs= resampler(mb);
+	bool ok;
+
+	if (!rs)
+	{
+		eaten(mb)= buffer_shift(mb) - last_shift(mb);
+		return True;
+	}
+
+	begin_stage(mb, STAGE_OUTPUT);
+	ok= reserve_Mbrola(mb, max_output_Resampler(rs, last_shift(mb)));
+	if (ok)
+		output_resampled(mb, run_Resampler(rs, last_frame(mb), last_shift(mb), ola_float(mb)));
+	end_stage(mb, STAGE_OUTPUT);
+	return ok;
+}
+
+#endif
+
+bool FlushFile(Mbrola* mb, int shift, int shift_zero)
+/*
+ * Flush on file what's computed, False if out of memory
+ */
+{
+	bool ok;
+
+	begin_stage(mb, STAGE_OUTPUT);
+
+	/* The volume isn't in the windowed frames */
+	if ( windowed(diph_dba(mb)) && (volume_ratio(mb) != 1.0f) )
+		kernels(mb)->scale(ola_win(mb), volume_ratio(mb), shift);
+
+	if (resampler(mb))
+    {
+		ok= resample_Mbrola(mb, shift, shift_zero);
+		end_stage(mb, STAGE_OUTPUT);
+		return ok;
+    }
+
+	/* A run of frames flushes more than 2*MBRPeriod */
+	if (!reserve_Mbrola(mb, shift))
+    {
+		end_stage(mb, STAGE_OUTPUT);
+		return False;
+    }
+
+#ifdef LIBRARY
+	/* The float outputs skip the 16 bits stage */
+	if (float_output(mb))
+		memcpy(ola_float(mb), ola_win(mb), shift*sizeof(float));
+	else
+		clip_Mbrola(mb, ola_win(mb), ola_integer(mb), shift);
+#endif
   
 	/* Amount that has been flushed */
 	buffer_shift(mb)=shift;
+#ifdef LIBRARY
+	last_shift(mb)=shift;
+#endif
 
 	/* Zero padding ! */
 	zero_padding(mb)= shift_zero;  
     
 #ifndef LIBRARY
-	audio_length(mb)+= write_int16s(ola_integer(mb), shift, output_file); 
+	/* The float outputs skip the 16 bits stage */
+	if (sink_sample_type(sink_Mbrola(mb)) != LIN16)
+		audio_length(mb)+= write_float_Mbrola(mb, ola_win(mb), shift);
+	else
+	{
+		clip_Mbrola(mb, ola_win(mb), ola_integer(mb), shift);
+		audio_length(mb)+= write_Mbrola(mb, ola_integer(mb), shift); 
+	}
   
 	/* Fill the gap between 2 frames for extra low pitch */
 	/* No lower limit, but write MBRPeriod buffer each time */
@@ -644,6 +1108,7 @@ void FlushFile(Mbrola* mb, int shift, int shift_zero)
     {		 
 		int shift_mod;						  /* Modulo for shift zero */
 		int written;
+		int k;
 		
 		if (shift_zero>2*MBRPeriod(diph_dba(mb)))
 			shift_mod=2*MBRPeriod(diph_dba(mb));
@@ -653,66 +1118,54 @@ void FlushFile(Mbrola* mb, int shift, int shift_zero)
 		for (k=0; k<shift_mod; k++) ola_integer(mb)[k]=0;
 		while (shift_zero>2*MBRPeriod(diph_dba(mb)))
 		{
-			written= write_int16s(ola_integer(mb), 2*MBRPeriod(diph_dba(mb)), output_file);
+			written= write_Mbrola(mb, ola_integer(mb), 2*MBRPeriod(diph_dba(mb)));
 			buffer_shift(mb)+=written;
 			audio_length(mb)+=written;
 			shift_zero-=written;
 		}
-		written= write_int16s(ola_integer(mb),shift_zero, output_file);
+		written= write_Mbrola(mb, ola_integer(mb), shift_zero);
 		audio_length(mb)+=written;
 		buffer_shift(mb)+=written;
     }
 #endif
+	end_stage(mb, STAGE_OUTPUT);
+	return True;
+}
+
+static void add_frame_Mbrola(Mbrola* mb, float* ola, float* frame, float correction)
+/* Add a frame windowed by the database to the OLA buffer */
+{
+	int size= 2*MBRPeriod(diph_dba(mb));
+
+	if (correction == 1.0f)
+		kernels(mb)->ola_add(ola, frame, size);
+	else
+		kernels(mb)->ola_frame(ola, frame, correction, size);
 }
 
-void OverLapAdd(Mbrola* mb, int frame)
+static void add_Frame(Mbrola* mb, int frame, float* ola, float correction)
 /*
- *  OLA routine
+ * Add a frame to the 2*MBRPeriod samples at ola: played back if unvoiced,
+ * looped and smoothed if voiced
  */
 {
 	int k;
-	float correction;	        /* Energy correction factor */
-	int end_window, add_window;
+	int add_window;
 	int lim_smooth;		/* Beyond this limit -> left smoothing */
 	float tmp;
 	FrameType type;			/* Frame type */
-	int shift_zero;		/* Noman's land between 2 ola filled with 0 */
-	int shift;			/* Shift between pulses */
-  
-	debug_message1("OverLapAdd\n");
+	int period= MBRPeriod(diph_dba(mb));
+	float* frame_win= NULL;	/* Frame windowed by the database, if any */
 
-	shift = frame_pos(mb)[frame]-frame_pos(mb)[frame-1];
-	if ((correction = (float)shift/(float)MBRPeriod(diph_dba(mb)))>=1) correction=1.0f;
-  
-	/* Keep nothing of previous frames as there's no overlap */
-	shift_zero= shift - 2*MBRPeriod(diph_dba(mb));
-	if (shift_zero>0)
-		shift= 2*MBRPeriod(diph_dba(mb));
-  
-	end_window = 2*MBRPeriod(diph_dba(mb)) - shift;
 	add_window =MBRPeriod(diph_dba(mb)) * (real_frame(prev_diph(mb))[frame_number(mb)[frame]]-1);
 	lim_smooth = nb_pm(prev_diph(mb))-nb_end(mb);
 
-	/* Flush on file what's flushable */
-	FlushFile(mb,shift,shift_zero);
-    
-	if (saturation(mb))
-    {
-		warning_message(WARNING_SATURATION,
-						"Saturation on %s-%s\n",
-						name_Phone(LeftPhone(prev_diph(mb))),	
-						name_Phone(RightPhone(prev_diph(mb))));
-		saturation(mb)=False;
-    }
-  
-	/* !! SHIFTING CAN BE REMOVED IN CASE OF STATIC OUTPUT BUFFER !! */
-	/* shift the ola window and completion with 0 */
-	memmove(&ola_win(mb)[0], &ola_win(mb)[shift], end_window*sizeof(ola_win(mb)[0]));
-	for(k=end_window; k<2*MBRPeriod(diph_dba(mb)) ; k++) 
-		ola_win(mb)[k]=0.0f;
-
 	/* Two kinds of OLA depending if the frame is unvoiced */
 	type= pmrk_DiphoneSynthesis(prev_diph(mb), frame_number(mb)[frame] );
+
+	if (windowed(diph_dba(mb)))
+		frame_win= &windowed(diph_dba(mb))[ (pos_pm_diphone(prev_diph(mb))
+											  + frame_number(mb)[frame]-1) * 2*period ];
   
 	debug_message5("Frame type=%i Number=%i Real=%i Smooth=%i\n",
 				   type,
@@ -738,20 +1191,15 @@ void OverLapAdd(Mbrola* mb, int frame)
 				  
 				/* Energy correction  */
 				tmp *= correction;
-				ola_win(mb)[k] += tmp;
+				ola[k] += tmp;
 			}
 		}
+		else if (frame_win)
+			add_frame_Mbrola(mb, ola, frame_win, correction);
 		else		  /* Don't reverse the unvoiced frame */
-		{
-			for (k=0; k< 2*MBRPeriod(diph_dba(mb)) ; k++)
-			{
-				tmp = weight(mb)[k] * (float) buffer(prev_diph(mb))[add_window + k];
-				  
-				/* Energy correction  */
-				tmp *= correction;
-				ola_win(mb)[k] += tmp;
-			}
-		}
+			kernels(mb)->ola_unvoiced(ola, weight(mb),
+									  &buffer(prev_diph(mb))[add_window],
+									  correction, 2*period);
     }
 	else
     { 
@@ -769,16 +1217,25 @@ void OverLapAdd(Mbrola* mb, int frame)
 			/* Left smoothing */
 		{
 			float smooth_left = (float)(nb_begin(mb)-frame+1) / (2*(float)nb_begin(mb));
+
+			inc_Counter(counters(mb).smoothed, 1);
 	  
-			for (k=0; k<MBRPeriod(diph_dba(mb)) ; k++)
-				ola_win(mb)[k] += correction * 
-					( weight(mb)[k] * (float)buffer(prev_diph(mb))[add_window + k]
-					  + smooth_left * smoothw(prev_diph(mb))[k] );
-	  
-			for ( ; k<2*MBRPeriod(diph_dba(mb)) ; k++)
-				ola_win(mb)[k] += correction * 
-					( weight(mb)[k] * (float) buffer(prev_diph(mb)) [add_window + k - MBRPeriod(diph_dba(mb))]
-					  + smooth_left * smoothw(prev_diph(mb))[k] );
+			if (frame_win)
+				kernels(mb)->ola_frame_smooth(ola, frame_win,
+											  smoothw(prev_diph(mb)),
+											  smooth_left, correction, 2*period);
+			else
+			{
+				/* The second half loops on the same period */
+				kernels(mb)->ola_smooth(ola, weight(mb),
+										&buffer(prev_diph(mb))[add_window],
+										smoothw(prev_diph(mb)),
+										smooth_left, correction, period);
+				kernels(mb)->ola_smooth(&ola[period], &weight(mb)[period],
+										&buffer(prev_diph(mb))[add_window],
+										&smoothw(prev_diph(mb))[period],
+										smooth_left, correction, period);
+			}
 		}
 		else if ( (frame>lim_smooth)   && 
 				  smooth(cur_diph(mb)) &&
@@ -788,31 +1245,173 @@ void OverLapAdd(Mbrola* mb, int frame)
 			float smooth_right= (float)(nb_end(mb)-(nb_pm(prev_diph(mb))-frame))
 				/(2*(float)nb_end(mb));
 
-			for (k=0; k<MBRPeriod(diph_dba(mb)) ; k++)
-				ola_win(mb)[k] += correction * 
-					( weight(mb)[k] * (float)buffer(prev_diph(mb))[add_window + k]
-					  - smooth_right * smoothw(cur_diph(mb)) [k]);
-			 
-			for ( ; k<2*MBRPeriod(diph_dba(mb)) ; k++)
-				ola_win(mb)[k] += correction * 
-					( weight(mb)[k] * (float) buffer(prev_diph(mb)) [add_window + k - MBRPeriod(diph_dba(mb))]
-					  - smooth_right * smoothw(cur_diph(mb))[k]);
+			inc_Counter(counters(mb).smoothed, 1);
+
+			/* a - b*c is a + (-b)*c, to the last bit */
+			if (frame_win)
+				kernels(mb)->ola_frame_smooth(ola, frame_win,
+											  smoothw(cur_diph(mb)),
+											  -smooth_right, correction, 2*period);
+			else
+			{
+				kernels(mb)->ola_smooth(ola, weight(mb),
+										&buffer(prev_diph(mb))[add_window],
+										smoothw(cur_diph(mb)),
+										-smooth_right, correction, period);
+				kernels(mb)->ola_smooth(&ola[period], &weight(mb)[period],
+										&buffer(prev_diph(mb))[add_window],
+										&smoothw(cur_diph(mb))[period],
+										-smooth_right, correction, period);
+			}
 		}
+		else if (frame_win)
+			/* No smoothing, the frame loops already */
+			add_frame_Mbrola(mb, ola, frame_win, correction);
 		else 
 			/* No smoothing */
 		{
-			for (k=0; k<MBRPeriod(diph_dba(mb)) ; k++)
-				ola_win(mb)[k] += correction * weight(mb)[k] * 
-					(float)buffer(prev_diph(mb))[add_window + k];
-			for ( ; k<2*MBRPeriod(diph_dba(mb)) ; k++)
-				ola_win(mb)[k] += correction * weight(mb)[k] * 
-					(float) buffer(prev_diph(mb))[add_window + k - MBRPeriod(diph_dba(mb))];
+			kernels(mb)->ola_voiced(ola, weight(mb),
+									&buffer(prev_diph(mb))[add_window],
+									correction, period);
+			kernels(mb)->ola_voiced(&ola[period], &weight(mb)[period],
+									&buffer(prev_diph(mb))[add_window],
+									correction, period);
 		}
     }  
   
 	odd(mb)= !odd(mb);							  /* Flip flop for NV frames */
+}
 
+static void check_saturation(Mbrola* mb)
+/* Warn once per flush if the samples were clipped */
+{
+	if (saturation(mb))
+    {
+		warning_message(WARNING_SATURATION,
+						"Saturation on %s-%s\n",
+						name_Phone(LeftPhone(prev_diph(mb))),	
+						name_Phone(RightPhone(prev_diph(mb))));
+		inc_Counter(counters(mb).saturations, 1);
+		saturation(mb)=False;
+    }
+}
+
+bool OverLapAdd(Mbrola* mb, int frame)
+/*
+ *  OLA routine, False if out of memory
+ */
+{
+	int k;
+	float correction;	        /* Energy correction factor */
+	int end_window;
+	int shift_zero;		/* Noman's land between 2 ola filled with 0 */
+	int shift;			/* Shift between pulses */
+  
+	debug_message1("OverLapAdd\n");
+	begin_stage(mb, STAGE_OLA);
+	inc_Counter(counters(mb).frames, 1);
+
+	shift = frame_pos(mb)[frame]-frame_pos(mb)[frame-1];
+	if ((correction = (float)shift/(float)MBRPeriod(diph_dba(mb)))>=1) correction=1.0f;
+  
+	/* Keep nothing of previous frames as there's no overlap */
+	shift_zero= shift - 2*MBRPeriod(diph_dba(mb));
+	if (shift_zero>0)
+		shift= 2*MBRPeriod(diph_dba(mb));
+  
+	end_window = 2*MBRPeriod(diph_dba(mb)) - shift;
+
+	/* Flush on file what's flushable */
+	if (!FlushFile(mb,shift,shift_zero))
+    {
+		end_stage(mb, STAGE_OLA);
+		return False;
+    }
+	check_saturation(mb);
+  
+	/* !! SHIFTING CAN BE REMOVED IN CASE OF STATIC OUTPUT BUFFER !! */
+	/* shift the ola window and completion with 0 */
+	memmove(&ola_win(mb)[0], &ola_win(mb)[shift], end_window*sizeof(ola_win(mb)[0]));
+	for(k=end_window; k<2*MBRPeriod(diph_dba(mb)) ; k++) 
+		ola_win(mb)[k]=0.0f;
+
+	add_Frame(mb, frame, ola_win(mb), correction);
+
+	end_stage(mb, STAGE_OLA);
 	debug_message1("done OverLapAdd\n");
+	return True;
+}
+
+static int RunLength(Mbrola* mb, int frame)
+/*
+ * Number of frames from frame on that are shifted by exactly MBRPeriod, up
+ * to RUN_FRAMES and to the last frame of the diphone
+ */
+{
+	int period= MBRPeriod(diph_dba(mb));
+	int last= nb_pm(prev_diph(mb));
+	int nb= 0;
+
+	while ( (nb < RUN_FRAMES) &&
+			(frame+nb <= last) &&
+			(frame_pos(mb)[frame+nb]-frame_pos(mb)[frame+nb-1] == period) )
+		nb++;
+	return nb;
+}
+
+static bool OverLapAddRun(Mbrola* mb, int frame, int nb)
+/*
+ * OLA of nb frames MBRPeriod apart: all the frames are added in the ola
+ * buffer, then flushed at once. The samples are those of nb OverLapAdd.
+ * False if out of memory
+ */
+{
+	int period= MBRPeriod(diph_dba(mb));
+	int i;
+
+	debug_message2("OverLapAddRun %i\n", nb);
+	begin_stage(mb, STAGE_OLA);
+	inc_Counter(counters(mb).frames, nb);
+
+	/* The first period holds the previous frames, the rest is new */
+	for (i= 2*period; i < (nb+2)*period; i++)
+		ola_win(mb)[i]= 0.0f;
+
+	for (i=0; i<nb; i++)
+		add_Frame(mb, frame+i, &ola_win(mb)[(i+1)*period], 1.0f);
+
+	if (!FlushFile(mb, nb*period, 0))
+    {
+		end_stage(mb, STAGE_OLA);
+		return False;
+    }
+	check_saturation(mb);
+
+#ifdef LIBRARY
+	/* A diphone of 0 frames repeats the last frame of the run */
+	if (resampler(mb))
+		memcpy(last_frame(mb), &ola_win(mb)[(nb-1)*period], period*sizeof(float));
+	last_shift(mb)= period;
+#endif
+
+	memmove(&ola_win(mb)[0], &ola_win(mb)[nb*period], 2*period*sizeof(ola_win(mb)[0]));
+
+	end_stage(mb, STAGE_OLA);
+	debug_message1("done OverLapAddRun\n");
+	return True;
+}
+
+int OverLapAddFrames(Mbrola* mb, int frame)
+/*
+ * OLA of frame, or of the run of frames from frame on that are MBRPeriod
+ * apart. Returns the number of frames done, 0 if out of memory
+ */
+{
+	int nb= RunLength(mb, frame);
+
+	if (nb < 2)
+		return OverLapAdd(mb, frame) ? 1 : 0;
+	return OverLapAddRun(mb, frame, nb) ? nb : 0;
 }
 
 
@@ -820,6 +1419,64 @@ void OverLapAdd(Mbrola* mb, int frame)
 
 /* LIBRARY mode: synthesis driven by the output */
 
+static int error_Mbrola(Mbrola* mb)
+/* 
+ * Keep a copy of the error raised in the calling thread, so that it can
+ * be retrieved from another one. Return the error code
+ */
+{
+	catch_ErrorState(&last_error(mb));
+	return last_error(mb).code;
+}
+
+int get_last_error_Mbrola(Mbrola* mb)
+/* Code of the last error met by the engine, 0 if none */
+{ return last_error(mb).code; }
+
+int get_last_error_str_Mbrola(Mbrola* mb, char *buffer_err, int nb_wanted)
+/* Message of the last error met by the engine */
+{ return copy_error_message(last_error(mb).message, buffer_err, nb_wanted); }
+
+void reset_last_error_Mbrola(Mbrola* mb)
+/* Forget the last error of the engine */
+{ reset_ErrorState(&last_error(mb)); }
+
+static void output_type_Mbrola(Mbrola* mb, AudioType sample_type)
+/* 
+ * Select the OLA output buffer for sample_type. The last flushed frame is
+ * moved to it, as a diphone of 0 frames reads it again
+ */
+{
+	bool to_float= (sample_type==FLOAT32) || (sample_type==LIN24);
+	int k;
+
+	if (to_float == float_output(mb))
+		return;
+
+	/* Nothing to read again before the first frame */
+	if (first_call(mb))
+		buffer_shift(mb)=0;
+
+	if (to_float)
+		for (k=0; k<buffer_shift(mb); k++)
+			ola_float(mb)[k]= (float) ola_integer(mb)[k];
+	else
+		clip_Mbrola(mb, ola_float(mb), ola_integer(mb), buffer_shift(mb));
+	float_output(mb)= to_float;
+}
+
+static void* move_Mbrola(Mbrola* mb, void* buffer_out, int nb_move, AudioType sample_type)
+/* Convert nb_move samples of the OLA output buffer from eaten(mb) */
+{
+	begin_stage(mb, STAGE_OUTPUT);
+	if (float_output(mb))
+		buffer_out= move_convert_float(buffer_out, &ola_float(mb)[eaten(mb)], nb_move, sample_type);
+	else
+		buffer_out= move_convert(buffer_out, &ola_integer(mb)[eaten(mb)], nb_move, sample_type);
+	end_stage(mb, STAGE_OUTPUT);
+	return buffer_out;
+}
+
 int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sample_type)
 /*
  * Reads nb_wanted samples in an audio buffer
@@ -830,6 +1487,8 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 {
 	int to_go= nb_wanted; /* number of samples to go */
 	int nb_move;
+
+	output_type_Mbrola(mb, sample_type);
     
 	if (first_call(mb))
     {
@@ -839,7 +1498,7 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 		zero_padding(mb)=0;
 		frame_counter(mb)=1;
 		if (!reset_Mbrola(mb))
-			return lasterr_code;
+			return error_Mbrola(mb);
 		
 		/* Test if there is something in the buffer */
 		switch (  NextDiphone(mb) )
@@ -847,14 +1506,14 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 		case PHO_OK: /* go ahead */
 			break;
 		case PHO_ERROR:  /* return error code */
-			return lasterr_code;
+			return error_Mbrola(mb);
 		case PHO_EOF:
 		case PHO_FLUSH:  /* Flush or EOF, 0 samples */
 			return 0;      
 		default:
 			/* panic ! */
 			fatal_message(ERROR_NEXTDIPHONE,"NextDiphone PANIC %i!\n");
-			return ERROR_NEXTDIPHONE ; 
+			return error_Mbrola(mb); 
 		}
 		first_call(mb)=False;
     }
@@ -876,7 +1535,7 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 			 
 			buffer_out= zero_convert( buffer_out,nb_generated, sample_type );
 			if (!buffer_out)
-				return lasterr_code;
+				return error_Mbrola(mb);
 			to_go -= nb_generated;
 		}
 		
@@ -886,15 +1545,24 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 		else
 			nb_move= to_go;
 		
-		buffer_out= move_convert( buffer_out, &ola_integer(mb)[eaten(mb)], nb_move, sample_type );
+		buffer_out= move_Mbrola( mb, buffer_out, nb_move, sample_type );
 		if (!buffer_out)
-			return lasterr_code;
+			return error_Mbrola(mb);
 
 		to_go-= nb_move;
 		eaten(mb)+= nb_move;
 		
 		if (to_go<=0)
 			break;
+
+		/* The tail of the resampler is out, now the flush or EOF */
+		if (end_state(mb) != PHO_OK)
+		{
+			if (end_state(mb) == PHO_FLUSH)
+				first_call(mb)=True;
+			end_state(mb)=PHO_OK;
+			break;
+		}
 		
 		/* Still some frames available in the same diphone ? */
 		if (frame_counter(mb)<nb_pm(prev_diph(mb)))
@@ -909,7 +1577,18 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 			{
 				/* handle errors in the parser */
 				if (stream_state == PHO_ERROR)
-					return lasterr_code;
+					return error_Mbrola(mb);
+
+				/* Read the tail of the resampler first */
+				nb_move= drain_Mbrola(mb);
+				if (nb_move < 0)
+					return error_Mbrola(mb);
+				if (nb_move > 0)
+				{
+					end_state(mb)= stream_state;
+					eaten(mb)=0;
+					continue;
+				}
 	      
 				/* Flush or EOF */
 				if (stream_state == PHO_FLUSH)
@@ -918,7 +1597,7 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 			}
 			 
 			if ( !MatchProsody(mb) )
-				return lasterr_code;
+				return error_Mbrola(mb);
 			 
 			Concat(mb);
 			odd(mb)=0;
@@ -929,12 +1608,229 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 
 		/* condition against phonemes with 0 length */
 		if (frame_counter(mb)<=nb_pm(prev_diph(mb)))
-			OverLapAdd(mb, frame_counter(mb));
+		{
+			nb_move= OverLapAddFrames(mb, frame_counter(mb));
+			if (nb_move == 0)
+				return error_Mbrola(mb);
+			frame_counter(mb)+= nb_move - 1;
+		}
+		else if (!repeat_Mbrola(mb))
+			return error_Mbrola(mb);
     }
+	inc_Counter(counters(mb).samples, nb_wanted - to_go);
 	/* old C++ catch throw  "}  catch(int ret) { return ret;  }"  */
 	return(nb_wanted - to_go);
 }
 
+static char* reserve_Span(char** span, int* capacity, int length, int nb_more, int sample_size)
+/* 
+ * Room for nb_more samples after the length first ones of span, NULL if
+ * out of memory (span is kept as it is)
+ */
+{
+	if (length + nb_more > *capacity)
+    {
+		int new_capacity= 2*(*capacity) + nb_more;
+		char* new_span= (char*) MBR_realloc(*span, new_capacity * sample_size);
+
+		if (!new_span)
+		{
+			fatal_message(ERROR_MEMORYOUT,"FATAL: out of memory for %i samples\n", new_capacity);
+			return NULL;
+		}
+		*span= new_span;
+		*capacity= new_capacity;
+    }
+	return *span + length*sample_size;
+}
+
+int push_Mbrola(Mbrola* mb, PushFunction push, void* user_data, AudioType sample_type)
+/*
+ * Synthesize the available input, push gets the audio of each diphone
+ * in one span as soon as it is rendered, then the flush commands and the
+ * end of the input as events. Same audio as readtype_Mbrola, and both
+ * can be mixed on an engine.
+ *
+ * Returns the number of samples pushed, or the negative error code (also
+ * recorded in last_error(mb)). A push function stopping the synthesis 
+ * gives ERROR_OUTFILE
+ */
+{
+	int sample_size= size_AudioType(sample_type);
+	char* span=NULL;      /* Audio of the current diphone */
+	int length=0;         /* Samples in span */
+	int capacity=0;       /* Allocated samples in span */
+	int total=0;          /* Samples pushed */
+	int nb_zero, nb_move;
+	int result=0;
+	bool done=False;
+	StatePhone stream_state;
+	PushEvent event;
+
+	output_type_Mbrola(mb, sample_type);
+
+	while (!done)
+    {
+		if (first_call(mb))
+		{
+			odd(mb)=0;
+			eaten(mb)=0;
+			buffer_shift(mb)=0;
+			zero_padding(mb)=0;
+			frame_counter(mb)=1;
+			if (!reset_Mbrola(mb))
+			{
+				result= error_Mbrola(mb);
+				break;
+			}
+			stream_state= NextDiphone(mb);
+			if (stream_state != PHO_OK)
+			{
+				if (stream_state == PHO_ERROR)
+				{
+					result= error_Mbrola(mb);
+					break;
+				}
+				/* Nothing before the flush or the end */
+				event= (stream_state == PHO_FLUSH) ? PUSH_FLUSH : PUSH_END;
+				done= (event == PUSH_END);
+				if (push(user_data, event, NULL, 0, sample_type) != 0)
+				{
+					fatal_message(ERROR_OUTFILE,"Push function stopped the synthesis\n");
+					result= error_Mbrola(mb);
+					break;
+				}
+				continue;
+			}
+			first_call(mb)=False;
+		}
+
+		/* Append the output of the last OLA frame, zero padding first */
+		nb_zero= (zero_padding(mb) > 0) ? zero_padding(mb) : 0;
+		nb_move= buffer_shift(mb) - eaten(mb);
+		if (nb_zero + nb_move > 0)
+		{
+			char* pt= reserve_Span(&span, &capacity, length, nb_zero + nb_move, sample_size);
+			
+			if (pt)
+				pt= (char*) zero_convert(pt, nb_zero, sample_type);
+			if (pt)
+				pt= (char*) move_Mbrola(mb, pt, nb_move, sample_type);
+			if (!pt)
+			{
+				result= error_Mbrola(mb);
+				break;
+			}
+			length+= nb_zero + nb_move;
+			zero_padding(mb)-= nb_zero;
+			eaten(mb)= buffer_shift(mb);
+		}
+
+		/* Still some frames available in the same diphone ? */
+		if (frame_counter(mb)<nb_pm(prev_diph(mb)))
+			frame_counter(mb)++;
+		else
+		{ /* Else, the diphone is complete */
+			if (length>0)
+			{
+				if (push(user_data, PUSH_AUDIO, span, length, sample_type) != 0)
+				{
+					fatal_message(ERROR_OUTFILE,"Push function stopped the synthesis\n");
+					result= error_Mbrola(mb);
+					break;
+				}
+				total+= length;
+				inc_Counter(counters(mb).samples, length);
+				length=0;
+			}
+
+			if (end_state(mb) != PHO_OK)
+			{
+				/* The span ended with the tail of the resampler */
+				stream_state= end_state(mb);
+				end_state(mb)=PHO_OK;
+			}
+			else
+				stream_state= NextDiphone(mb);
+			if (stream_state != PHO_OK)
+			{
+				/* handle errors in the parser */
+				if (stream_state == PHO_ERROR)
+				{
+					result= error_Mbrola(mb);
+					break;
+				}
+
+				/* The tail of the resampler goes with the last diphone */
+				nb_move= drain_Mbrola(mb);
+				if (nb_move < 0)
+				{
+					result= error_Mbrola(mb);
+					break;
+				}
+				if (nb_move > 0)
+				{
+					end_state(mb)= stream_state;
+					eaten(mb)=0;
+					continue;
+				}
+
+				/* Flush or EOF */
+				if (stream_state == PHO_FLUSH)
+				{
+					first_call(mb)=True;
+					event= PUSH_FLUSH;
+				}
+				else
+				{
+					event= PUSH_END;
+					done=True;
+				}
+				if (push(user_data, event, NULL, 0, sample_type) != 0)
+				{
+					fatal_message(ERROR_OUTFILE,"Push function stopped the synthesis\n");
+					result= error_Mbrola(mb);
+					break;
+				}
+				continue;
+			}
+
+			if ( !MatchProsody(mb) )
+			{
+				result= error_Mbrola(mb);
+				break;
+			}
+
+			Concat(mb);
+			odd(mb)=0;
+			frame_counter(mb)=1;
+		}
+
+		eaten(mb)=0;
+
+		/* condition against phonemes with 0 length */
+		if (frame_counter(mb)<=nb_pm(prev_diph(mb)))
+		{
+			nb_move= OverLapAddFrames(mb, frame_counter(mb));
+			if (nb_move == 0)
+			{
+				result= error_Mbrola(mb);
+				break;
+			}
+			frame_counter(mb)+= nb_move - 1;
+		}
+		else if (!repeat_Mbrola(mb))
+		{
+			result= error_Mbrola(mb);
+			break;
+		}
+    }
+
+	if (span)
+		MBR_free(span);
+	return (result<0) ? result : total;
+}
+
 #else
 
 /* 
@@ -979,13 +1875,14 @@ void oneshot_Mbrola(Mbrola* mb)
 #endif
   
 	odd(mb)=False;
-	for (frame_counter(mb)=1; frame_counter(mb)<=nb_pm(prev_diph(mb)); frame_counter(mb)++)
+	frame_counter(mb)=1;
+	while (frame_counter(mb)<=nb_pm(prev_diph(mb)))
     {
 #ifdef SIGNAL
 		if (must_flush) /* test if premature return requested (reset signal) */
 			return;
 #endif
-		OverLapAdd(mb,frame_counter(mb));
+		frame_counter(mb)+= OverLapAddFrames(mb,frame_counter(mb));
     }
   
 #ifdef DEBUG
@@ -1048,6 +1945,9 @@ StatePhone Synthesis(Mbrola* mb)
 		must_flush=False; /* reset until next call ! */
     }
 #endif
+
+	/* What the resampler still holds */
+	drain_Mbrola(mb);
   
 	debug_message1("done Synthesis\n");
 	return(stream_state);
@@ -29,11 +29,27 @@
 #include "diphone.h"
 #include "database.h"
 #include "parser.h"
+#include "resample.h"
+#include "kernels.h"
 
 #ifndef LIBRARY
 #include "synth.h"
 #endif
 
+/* Frames MBRPeriod apart that OverLapAddFrames adds and flushes at once */
+#define RUN_FRAMES 32
+
+#ifdef PROFILE
+/* Timing of the stages, a stage run by another one is not counted twice */
+typedef struct
+{
+	StageStats stats;
+	double start[NB_STAGES];  /* Start of the stages being timed */
+	int parent[NB_STAGES];    /* Stage each one interrupted, -1 if none */
+	int active;               /* Stage being timed, -1 if none */
+} Profile;
+#endif
+
 typedef struct 
 {
 	Database* diph_dba;   /* A synth engine is linked to a database */
@@ -66,9 +82,12 @@ typedef struct
 	bool saturation;    /* Saturation in ola_integer */
 	float *ola_win;     /* OLA buffer                  */
 	int16 *ola_integer; /* OLA buffer for file output  */
+	float *ola_float;   /* OLA buffer for float output and resampling */
+	int ola_size;       /* Samples in ola_integer and ola_float */
 
 	float *weight;      /* Hanning weighting window */
 	float volume_ratio; 	       /* 1.0 is default */
+	KernelSet* kernels; /* Inner loops for the CPU */
   
 	/* 
 	 * The following variables are part of the structure for library mode
@@ -84,10 +103,24 @@ typedef struct
 
 	uint16 VoiceFreq;		   /* Freq of the audio output (vocal tract length) */
 	float  VoiceRatio;    /* Freq ratio of the audio output */
+	uint16 OutFreq;       /* Freq of the samples, 0 means VoiceFreq */
+	Resampler* resampler; /* VoiceFreq to OutFreq, NULL if they are equal */
+
+#ifdef PROFILE
+	Profile profile;      /* Time spent in the stages of the synthesis */
+#endif
+	EngineMetrics counters; /* Activity, read from any thread by get_metrics_Mbrola */
 
 #ifdef LIBRARY
 	bool first_call;	/* True if it's the first call to Read_MBR */
 	int eaten;	     /* Samples allready consumed in ola_integer */
+	bool float_output; /* True if FlushFile fills ola_float, not ola_integer */
+	StatePhone end_state; /* Flush or EOF held until the resampler is drained */
+	float* last_frame;    /* Last frame given to the resampler, read again by a 0 frame diphone */
+	int last_shift;       /* Samples of the last frame, at the end of the flushed ones */
+	ErrorState last_error; /* Copy of the last error met by readtype_Mbrola */
+#else
+	AudioSink* out_sink; /* Audio output, NULL means the global output_sink */
 #endif
 
 } Mbrola;
@@ -107,8 +140,11 @@ typedef struct
 #define saturation(mb)  mb->saturation
 #define ola_win(mb)  mb->ola_win
 #define ola_integer(mb)  mb->ola_integer
+#define ola_float(mb)  mb->ola_float
+#define ola_size(mb)  mb->ola_size
 #define weight(mb)  mb->weight
 #define volume_ratio(mb)  mb->volume_ratio
+#define kernels(mb)  mb->kernels
 #define odd(mb)  mb->odd
 #define frame_counter(mb)  mb->frame_counter
 #define buffer_shift(mb)  mb->buffer_shift
@@ -117,8 +153,18 @@ typedef struct
 #define no_error(mb)  mb->no_error
 #define VoiceRatio(pt) (pt->VoiceRatio)
 #define VoiceFreq(pt) (pt->VoiceFreq)
+#define OutFreq(pt) (pt->OutFreq)
+#define resampler(pt) (pt->resampler)
+#define profile(pt) (pt->profile)
+#define counters(pt) (pt->counters)
 #define first_call(pt) (pt->first_call)
 #define eaten(pt) (pt->eaten)
+#define last_error(pt) (pt->last_error)
+#define float_output(pt) (pt->float_output)
+#define end_state(pt) (pt->end_state)
+#define last_frame(pt) (pt->last_frame)
+#define last_shift(pt) (pt->last_shift)
+#define out_sink(pt) (pt->out_sink)
 
 void set_voicefreq_Mbrola(Mbrola* mb, uint16 OutFreq);
 /* Change the Output Freq and VoiceRatio to change the vocal tract   */
@@ -126,6 +172,15 @@ void set_voicefreq_Mbrola(Mbrola* mb, uint16 OutFreq);
 uint16 get_voicefreq_Mbrola(Mbrola* mb);
 /* Get output Frequency */
 
+bool set_outfreq_Mbrola(Mbrola* mb, uint16 OutFreq);
+/* 
+ * Resample the output from VoiceFreq to OutFreq, 0 means no resampling.
+ * Return False in case of error (unsupported ratio)
+ */
+
+uint16 get_outfreq_Mbrola(Mbrola* mb);
+/* Freq of the samples: OutFreq, or VoiceFreq without resampling */
+
 void set_smoothing_Mbrola(Mbrola* mb, bool smoothing);
 /* Spectral smoothing or not */
 
@@ -138,15 +193,48 @@ void set_no_error_Mbrola(Mbrola* mb, bool no_error);
 bool get_no_error_Mbrola(Mbrola* mb);
 /* Spectral smoothing or not */
 
+void init_Hanning(float* table,int size,float ratio);
+/* 
+ * Initialize the Hanning weighting window  
+ * Ratio is used for volume control
+ */
+
 void set_volume_ratio_Mbrola(Mbrola* mb, float volume_ratio);
 /* Overall volume */
 
 float get_volume_ratio_Mbrola(Mbrola* mb);
 /* Overall volume */
 
+bool set_kernels_Mbrola(Mbrola* mb, KernelLevel level);
+/* 
+ * Inner loops of a given level (scalar, SSE4.1...) instead of the default
+ * one. Return False if the CPU doesn't support it
+ */
+
+KernelLevel get_kernels_Mbrola(Mbrola* mb);
+/* Level of the inner loops */
+
 void set_parser_Mbrola(Mbrola* mb, Parser* parser);
 /* drop the current parser for a new one */
 
+char* name_Stage(Stage stage);
+/* Name of a stage of the synthesis, for the reports */
+
+bool get_stats_Mbrola(Mbrola* mb, StageStats* stats);
+/*
+ * Time spent in each stage since init_Mbrola or reset_stats_Mbrola.
+ * False (and zeros) if the engine is compiled without PROFILE
+ */
+
+void reset_stats_Mbrola(Mbrola* mb);
+/* Start the timing of the stages again */
+
+void get_metrics_Mbrola(Mbrola* mb, EngineMetrics* metrics);
+/* 
+ * Activity of the engine since init_Mbrola, from any thread. Each counter
+ * is read atomically, but not the set
+ */
+
 Mbrola* init_Mbrola(Database* dba);
 /* 
  * Connect the database to the synthesis engine, then initialize internal 
@@ -166,6 +254,13 @@ bool reset_Mbrola(Mbrola* mb);
  * return False in case of error
  */
 
+void forget_Mbrola(Mbrola* mb);
+/*
+ * Forget what remains of the previous utterances (time rounding, smoothing
+ * bounds), so that the next one is synthesized as by a fresh engine.
+ * To be called before reset_Mbrola
+ */
+
 StatePhone NextDiphone(Mbrola* mb);
 /*
  * Reads a phone from the phonetic command buffer and prepares the next
@@ -194,9 +289,16 @@ void Concat(Mbrola* mb);
  * of RightPhone(prev_diph).
  */
 
-void OverLapAdd(Mbrola* mb, int frame);
+bool OverLapAdd(Mbrola* mb, int frame);
 /*
- *  OLA routine
+ *  OLA routine, False if out of memory
+ */
+
+int OverLapAddFrames(Mbrola* mb, int frame);
+/*
+ * OverLapAdd of frame, or of up to RUN_FRAMES frames from frame on if
+ * they are MBRPeriod apart: they are added, then flushed at once.
+ * Returns the number of frames done, 0 if out of memory
  */
 
 #ifdef LIBRARY
@@ -207,12 +309,48 @@ int readtype_Mbrola(Mbrola* mb, void *buffer_out, int nb_wanted, AudioType sampl
 /*
  * Reads nb_wanted samples in an audio buffer
  * Returns the effective number of samples read
+ *
+ * In case of error, the negative error code is returned and the error
+ * is also recorded in last_error(mb)
  */
 
+int push_Mbrola(Mbrola* mb, PushFunction push, void* user_data, AudioType sample_type);
+/*
+ * Synthesize the available input, push gets the audio of each diphone
+ * in one span as soon as it is rendered, then the flush commands and the
+ * end of the input as events. Same audio as readtype_Mbrola, and both
+ * can be mixed on an engine.
+ *
+ * Returns the number of samples pushed, or the negative error code (also
+ * recorded in last_error(mb)). A push function stopping the synthesis 
+ * gives ERROR_OUTFILE
+ */
+
+int get_last_error_Mbrola(Mbrola* mb);
+/* Code of the last error met by the engine, 0 if none */
+
+int get_last_error_str_Mbrola(Mbrola* mb, char *buffer_err, int nb_wanted);
+/* Message of the last error met by the engine */
+
+void reset_last_error_Mbrola(Mbrola* mb);
+/* Forget the last error of the engine */
+
 #else
 
 /* STANDALONE MODE: Synthesis driven by the input */
 
+void set_output_Mbrola(Mbrola* mb, AudioSink* output);
+/*
+ * Audio output of the engine, so that many engines can write different
+ * files. NULL means back to output_sink
+ */
+
+void oneshot_Mbrola(Mbrola* mb);
+/*
+ * Completely perform MBROLA synthesis of prev_diph(mb)
+ * Different from audio chunks synthesized on demand in library mode 
+ */
+
 StatePhone Synthesis(Mbrola* mb);
 /*
  * Main loop: performs MBROLA synthesis of all diphones
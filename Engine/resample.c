@@ -0,0 +1,290 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    resample.c
+ * Purpose: polyphase resampling of the audio output
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ */
+
+#include <math.h>
+
+#include "common.h"
+#include "resample.h"
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Zero crossings of the sinc on each side, at the lowest frequency */
+#define RESAMPLE_ZEROS 16
+
+/* Passband, as a fraction of the lowest Nyquist frequency */
+#define RESAMPLE_ROLLOFF 0.91
+
+static int gcd(int a, int b)
+/* Greatest common divisor */
+{
+	while (b != 0)
+    {
+		int r= a % b;
+		a= b;
+		b= r;
+    }
+	return a;
+}
+
+static void design_Resampler(Resampler* rs)
+/*
+ * Blackman windowed sinc, cut at the lowest of the two Nyquist
+ * frequencies. Each phase is normalized to a unit gain
+ */
+{
+	int length= rs->up * rs->nb_taps;  /* Prototype filter, at up*in_freq */
+	double center= (double) length / 2.0;
+	double cutoff;                     /* In cycles per input sample */
+	int phase, k;
+
+	cutoff= 0.5 * RESAMPLE_ROLLOFF;
+	if (rs->up < rs->down)
+		cutoff= cutoff * rs->up / rs->down;
+
+	for (phase=0; phase<rs->up; phase++)
+    {
+		float* coefs= &rs->coefs[phase * rs->nb_taps];
+		double sum=0.0;
+
+		/*
+		 * Tap k of the phase applies to the input sample nb_taps-1-k
+		 * steps in the past
+		 */
+		for (k=0; k<rs->nb_taps; k++)
+		{
+			int n= phase + (rs->nb_taps-1-k) * rs->up;
+			double t= ((double) n - center) / rs->up;  /* In input samples */
+			double x= (double) (n - center) / center;   /* -1 .. 1 */
+			double value= 2.0 * cutoff;
+
+			if (t != 0.0)
+				value= sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+			value*= 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2.0 * M_PI * x);
+			coefs[k]= (float) value;
+			sum+= value;
+		}
+
+		for (k=0; k<rs->nb_taps; k++)
+			coefs[k]= (float) (coefs[k] / sum);
+    }
+}
+
+Resampler* init_Resampler(int in_freq, int out_freq)
+/*
+ * Resampler from in_freq to out_freq Hz
+ * Returning NULL means error (the ratio needs too many phases)
+ */
+{
+	Resampler* rs;
+	int divisor;
+	int up, down;
+	int nb_taps;
+
+	if ((in_freq <= 0) || (out_freq <= 0))
+		return NULL;
+
+	divisor= gcd(in_freq, out_freq);
+	up= out_freq / divisor;
+	down= in_freq / divisor;
+	if (up > RESAMPLE_MAX_PHASES)
+		return NULL;
+
+	/* A longer filter when decimating, to keep the same transition band */
+	nb_taps= 2 * RESAMPLE_ZEROS;
+	if (down > up)
+		nb_taps= (2 * RESAMPLE_ZEROS * down + up - 1) / up;
+	nb_taps= (nb_taps + 3) & ~3;
+
+	rs= (Resampler*) MBR_malloc(sizeof(Resampler));
+	rs->in_freq= in_freq;
+	rs->out_freq= out_freq;
+	rs->up= up;
+	rs->down= down;
+	rs->nb_taps= nb_taps;
+	rs->coefs= (float*) MBR_malloc(up * nb_taps * sizeof(float));
+	design_Resampler(rs);
+
+	rs->capacity= 4 * nb_taps;
+	rs->history= (float*) MBR_malloc(rs->capacity * sizeof(float));
+	reset_Resampler(rs);
+	return rs;
+}
+
+void close_Resampler(Resampler* rs)
+/* Release the memory */
+{
+	MBR_free(rs->history);
+	MBR_free(rs->coefs);
+	MBR_free(rs);
+}
+
+void reset_Resampler(Resampler* rs)
+/*
+ * Forget the input, the next one starts an utterance. The history starts
+ * with nb_taps/2 zeros, the first output is centered on the first input
+ */
+{
+	int i;
+
+	rs->nb_history= rs->nb_taps / 2;
+	for (i=0; i<rs->nb_history; i++)
+		rs->history[i]= 0.0f;
+	rs->position= (long) rs->nb_taps * rs->up;
+	rs->due= 0;
+}
+
+int max_output_Resampler(Resampler* rs, int nb_in)
+/* Largest number of samples given by run_Resampler for nb_in samples */
+{ return (int) (((long) nb_in * rs->up) / rs->down + 2); }
+
+static float dot_product(float* coefs, float* samples, int nb)
+/* Sum of the products, nb is a multiple of 4 */
+{
+#ifdef __SSE__
+	__m128 acc= _mm_setzero_ps();
+	float partial[4];
+	int k;
+
+	for (k=0; k<nb; k+=4)
+		acc= _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&coefs[k]),
+										_mm_loadu_ps(&samples[k])));
+	_mm_storeu_ps(partial, acc);
+	return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+#else
+	float acc[4]= {0.0f, 0.0f, 0.0f, 0.0f};
+	int k;
+
+	/* Four partial sums, as the SSE version */
+	for (k=0; k<nb; k+=4)
+    {
+		acc[0]+= coefs[k] * samples[k];
+		acc[1]+= coefs[k+1] * samples[k+1];
+		acc[2]+= coefs[k+2] * samples[k+2];
+		acc[3]+= coefs[k+3] * samples[k+3];
+    }
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+#endif
+}
+
+static int filter_Resampler(Resampler* rs, float* out, bool draining)
+/*
+ * Output the samples the history allows, while draining only up to the
+ * end of the input. Drop the samples the filter won't use anymore
+ */
+{
+	int nb_out=0;
+	long index;
+	int drop;
+
+	while ( ((index= rs->position / rs->up) < rs->nb_history) &&
+			(!draining || (rs->due > 0)) )
+    {
+		int phase= (int) (rs->position % rs->up);
+
+		out[nb_out++]= dot_product(&rs->coefs[phase * rs->nb_taps],
+								   &rs->history[index - rs->nb_taps + 1],
+								   rs->nb_taps);
+		rs->position+= rs->down;
+		rs->due-= rs->down;
+    }
+
+	drop= (int) (rs->position / rs->up) - rs->nb_taps + 1;
+	if (drop > rs->nb_history)
+		drop= rs->nb_history;
+	if (drop > 0)
+    {
+		memmove(rs->history, &rs->history[drop], (rs->nb_history - drop) * sizeof(float));
+		rs->nb_history-= drop;
+		rs->position-= (long) drop * rs->up;
+    }
+	return nb_out;
+}
+
+static void append_Resampler(Resampler* rs, float* in, int nb_in)
+/* Samples (zeros if in is NULL) at the end of the history */
+{
+	int i;
+
+	if (rs->nb_history + nb_in > rs->capacity)
+    {
+		rs->capacity= 2 * rs->capacity + nb_in;
+		rs->history= (float*) MBR_realloc(rs->history, rs->capacity * sizeof(float));
+    }
+
+	if (in)
+		memcpy(&rs->history[rs->nb_history], in, nb_in * sizeof(float));
+	else
+		for (i=0; i<nb_in; i++)
+			rs->history[rs->nb_history + i]= 0.0f;
+	rs->nb_history+= nb_in;
+}
+
+int run_Resampler(Resampler* rs, float* in, int nb_in, float* out)
+/*
+ * Resample nb_in samples (zeros if in is NULL) in out, which has room for
+ * max_output_Resampler(rs, nb_in) samples. Return the number of samples
+ * written in out
+ */
+{
+	int nb_out=0;
+
+	/* Long inputs go by pieces, the history stays small */
+	while (nb_in > 0)
+    {
+		int nb= (nb_in > 4 * rs->nb_taps) ? 4 * rs->nb_taps : nb_in;
+
+		append_Resampler(rs, in, nb);
+		rs->due+= (long) nb * rs->up;
+		nb_out+= filter_Resampler(rs, &out[nb_out], False);
+
+		if (in)
+			in+= nb;
+		nb_in-= nb;
+    }
+	return nb_out;
+}
+
+int drain_Resampler(Resampler* rs, float* out)
+/*
+ * End of the utterance: the last samples, up to the time of the end of
+ * the input, in out which has room for max_output_Resampler(rs, nb_taps).
+ * The resampler is reset. Return the number of samples written in out
+ */
+{
+	int nb_out=0;
+
+	if (rs->due > 0)
+    {
+		/* The filter looks nb_taps/2 samples ahead, silence after the end */
+		append_Resampler(rs, NULL, rs->nb_taps);
+		nb_out= filter_Resampler(rs, out, True);
+    }
+	reset_Resampler(rs);
+	return nb_out;
+}
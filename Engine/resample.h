@@ -0,0 +1,93 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    resample.h
+ * Purpose: polyphase resampling of the audio output
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ *
+ *   The ratio out_freq/in_freq is reduced to up/down. A windowed sinc
+ *   low-pass filter designed at up*in_freq is split in up phases of
+ *   nb_taps coefficients, and each output sample is the dot product of
+ *   one phase with the last nb_taps input samples. The coefficients of a
+ *   phase are stored in the order of the input samples, so that the
+ *   inner loop runs forward on two arrays (vectorized with SSE when the
+ *   compiler targets it).
+ *
+ *   The filter looks nb_taps/2 input samples ahead: the samples of the
+ *   end of an utterance come out with drain_Resampler. An utterance of n
+ *   input samples gives ceil(n*up/down) output samples.
+ */
+
+#ifndef _RESAMPLE_H
+#define _RESAMPLE_H
+
+#include "common.h"
+
+/* Largest number of phases (up), 441 is enough from 16000 to 44100 Hz */
+#define RESAMPLE_MAX_PHASES 1024
+
+typedef struct
+{
+	int in_freq;
+	int out_freq;
+	int up;            /* out_freq/in_freq = up/down, reduced */
+	int down;
+	int nb_taps;       /* Coefficients of each phase, multiple of 4 */
+	float* coefs;      /* up phases of nb_taps coefficients */
+
+	float* history;    /* Input samples still needed by the filter */
+	int nb_history;
+	int capacity;      /* Allocated samples in history */
+	long position;     /* Next output, in 1/up input samples from history[0] */
+	long due;          /* Input minus output time, in 1/up input samples */
+} Resampler;
+
+/* Convenience macros */
+#define in_freq_Resampler(rs) (rs->in_freq)
+#define out_freq_Resampler(rs) (rs->out_freq)
+
+Resampler* init_Resampler(int in_freq, int out_freq);
+/*
+ * Resampler from in_freq to out_freq Hz
+ * Returning NULL means error (the ratio needs too many phases)
+ */
+
+void close_Resampler(Resampler* rs);
+/* Release the memory */
+
+void reset_Resampler(Resampler* rs);
+/* Forget the input, the next one starts an utterance */
+
+int max_output_Resampler(Resampler* rs, int nb_in);
+/* Largest number of samples given by run_Resampler for nb_in samples */
+
+int run_Resampler(Resampler* rs, float* in, int nb_in, float* out);
+/*
+ * Resample nb_in samples (zeros if in is NULL) in out, which has room for
+ * max_output_Resampler(rs, nb_in) samples. Return the number of samples
+ * written in out
+ */
+
+int drain_Resampler(Resampler* rs, float* out);
+/*
+ * End of the utterance: the last samples, up to the time of the end of
+ * the input, in out which has room for max_output_Resampler(rs, nb_taps).
+ * The resampler is reset. Return the number of samples written in out
+ */
+
+#endif
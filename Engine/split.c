@@ -0,0 +1,516 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    split.c
+ * Purpose: cut the synthesis of a phonemic stream in independent segments
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ */
+
+#include "common.h"
+#include "diphone.h"
+#include "database.h"
+#include "parser.h"
+#include "mbrola.h"
+#include "split.h"
+
+/*
+ * Saved engine state
+ */
+
+struct Snapshot
+{
+	Mbrola engine;           /* Copy of the fields, pointers are not used */
+	DiphoneSynthesis* prev;  /* Copies of prev_diph and cur_diph */
+	DiphoneSynthesis* cur;
+};
+
+static void copy_Phones(DiphoneSynthesis* dest_prev, DiphoneSynthesis* dest_cur,
+						DiphoneSynthesis* prev, DiphoneSynthesis* cur)
+/*
+ * Copy the phones of prev and cur, keep the RightPhone(prev) and
+ * LeftPhone(cur) sharing
+ */
+{
+	LeftPhone(dest_prev)= (LeftPhone(prev)) ? copy_Phone(LeftPhone(prev)) : NULL;
+	RightPhone(dest_prev)= (RightPhone(prev)) ? copy_Phone(RightPhone(prev)) : NULL;
+
+	if (LeftPhone(cur) && (LeftPhone(cur) == RightPhone(prev)))
+		LeftPhone(dest_cur)= RightPhone(dest_prev);
+	else
+		LeftPhone(dest_cur)= (LeftPhone(cur)) ? copy_Phone(LeftPhone(cur)) : NULL;
+	RightPhone(dest_cur)= (RightPhone(cur)) ? copy_Phone(RightPhone(cur)) : NULL;
+}
+
+static void release_Phones(DiphoneSynthesis* prev, DiphoneSynthesis* cur)
+/* Release the phones of a diphone pair, shared or not */
+{
+	if (LeftPhone(cur) == RightPhone(prev))
+		LeftPhone(cur)= NULL;
+	reset_DiphoneSynthesis(cur);
+	reset_DiphoneSynthesis(prev);
+}
+
+static Snapshot* save_Snapshot(Mbrola* mb)
+/* Copy of the state of mb */
+{
+	Database* dba= diph_dba(mb);
+	Snapshot* self= (Snapshot*) MBR_malloc(sizeof(Snapshot));
+
+	self->engine= *mb;
+
+	self->prev= init_DiphoneSynthesis(MBRPeriod(dba), max_frame(dba), max_samples(dba));
+	self->cur= init_DiphoneSynthesis(MBRPeriod(dba), max_frame(dba), max_samples(dba));
+	copy_DiphoneSynthesis(self->prev, prev_diph(mb), MBRPeriod(dba), max_frame(dba), max_samples(dba));
+	copy_DiphoneSynthesis(self->cur, cur_diph(mb), MBRPeriod(dba), max_frame(dba), max_samples(dba));
+	copy_Phones(self->prev, self->cur, prev_diph(mb), cur_diph(mb));
+
+	return self;
+}
+
+static void close_Snapshot(Snapshot* snap)
+/* Release the memory */
+{
+	release_Phones(snap->prev, snap->cur);
+	close_DiphoneSynthesis(snap->prev);
+	close_DiphoneSynthesis(snap->cur);
+	MBR_free(snap);
+}
+
+static void restore_Snapshot(Snapshot* snap, Mbrola* mb)
+/*
+ * Put mb in the saved state. The buffers, database, parser and output of
+ * mb are kept, the OLA window is cleared
+ */
+{
+	Database* dba= diph_dba(mb);
+	Parser* parser= parser(mb);
+	DiphoneSynthesis* prev= prev_diph(mb);
+	DiphoneSynthesis* cur= cur_diph(mb);
+	float* win= ola_win(mb);
+	int16* integer= ola_integer(mb);
+	float* output_float= ola_float(mb);
+	int size= ola_size(mb);
+	uint16 out_freq= OutFreq(mb);
+	Resampler* rs= resampler(mb);
+	float* hanning= weight(mb);
+	int32 length= audio_length(mb);
+	EngineMetrics activity= counters(mb);
+#ifdef PROFILE
+	Profile prof= profile(mb);
+#endif
+#ifdef LIBRARY
+	ErrorState error= last_error(mb);
+	bool float_mode= float_output(mb);
+	float* frame= last_frame(mb);
+#else
+	AudioSink* output= out_sink(mb);
+#endif
+	int i;
+
+	release_Phones(prev, cur);
+
+	*mb= snap->engine;
+
+	diph_dba(mb)= dba;
+	parser(mb)= parser;
+	prev_diph(mb)= prev;
+	cur_diph(mb)= cur;
+	ola_win(mb)= win;
+	ola_integer(mb)= integer;
+	ola_float(mb)= output_float;
+	ola_size(mb)= size;
+	OutFreq(mb)= out_freq;
+	resampler(mb)= rs;
+	weight(mb)= hanning;
+	audio_length(mb)= length;
+	counters(mb)= activity;
+#ifdef PROFILE
+	profile(mb)= prof;
+#endif
+#ifdef LIBRARY
+	last_error(mb)= error;
+	float_output(mb)= float_mode;
+	last_frame(mb)= frame;
+#else
+	out_sink(mb)= output;
+#endif
+
+	copy_DiphoneSynthesis(prev, snap->prev, MBRPeriod(dba), max_frame(dba), max_samples(dba));
+	copy_DiphoneSynthesis(cur, snap->cur, MBRPeriod(dba), max_frame(dba), max_samples(dba));
+	copy_Phones(prev, cur, snap->prev, snap->cur);
+
+	/* The volume is embedded in the Hanning window */
+	set_volume_ratio_Mbrola(mb, volume_ratio(mb));
+
+	for (i=0; i< 2*MBRPeriod(dba); i++)
+		ola_win(mb)[i]=0.0f;
+}
+
+/*
+ * Parsers recording and replaying the phones
+ */
+
+/* Records what the real parser gives to the engine */
+typedef struct
+{
+	Split* sp;
+	Parser* real;
+} Recorder;
+
+static void append_Entry(Split* sp, StatePhone state, Phone* phone)
+/* Record one call to the parser, a copy of the phone is kept */
+{
+	PhoneEntry* entry;
+
+	if (sp->nb_entries == sp->entries_available)
+    {
+		sp->entries_available*= 2;
+		sp->entries= (PhoneEntry*) MBR_realloc(sp->entries,
+											   sp->entries_available * sizeof(PhoneEntry));
+    }
+
+	entry= &sp->entries[sp->nb_entries++];
+	entry->state= state;
+	entry->phone= (state == PHO_OK) ? copy_Phone(phone) : NULL;
+}
+
+static StatePhone nextphone_Recorder(Parser* ps, Phone** ph)
+/* Phone of the real parser, copied in the entries */
+{
+	Recorder* rec= (Recorder*) ps->self;
+	StatePhone state= rec->real->nextphone_Parser(rec->real, ph);
+
+	append_Entry(rec->sp, state, (state == PHO_OK) ? *ph : NULL);
+	return state;
+}
+
+static void reset_Recorder(Parser* ps)
+{
+	Recorder* rec= (Recorder*) ps->self;
+	rec->real->reset_Parser(rec->real);
+}
+
+static void close_Recorder(Parser* ps)
+/* The real parser is not closed */
+{
+	MBR_free(ps->self);
+	MBR_free(ps);
+}
+
+static Parser* init_Recorder(Split* sp, Parser* real)
+{
+	Parser* self= (Parser*) MBR_malloc(sizeof(Parser));
+	Recorder* rec= (Recorder*) MBR_malloc(sizeof(Recorder));
+
+	rec->sp= sp;
+	rec->real= real;
+
+	self->self= (void*) rec;
+	self->reset_Parser= reset_Recorder;
+	self->close_Parser= close_Recorder;
+	self->nextphone_Parser= nextphone_Recorder;
+	return self;
+}
+
+/* Gives back the entries of a segment, then PHO_EOF */
+typedef struct
+{
+	Split* sp;
+	int pos;    /* Next entry */
+	int last;   /* End of the segment */
+} Replay;
+
+static StatePhone nextphone_Replay(Parser* ps, Phone** ph)
+/* The engine gets its own copy of the phone */
+{
+	Replay* rep= (Replay*) ps->self;
+	PhoneEntry* entry;
+
+	if (rep->pos >= rep->last)
+		return PHO_EOF;
+
+	entry= &rep->sp->entries[rep->pos++];
+	if (entry->state == PHO_OK)
+		*ph= copy_Phone(entry->phone);
+	return entry->state;
+}
+
+static void reset_Replay(Parser* ps)
+/* Forget the remaining entries */
+{
+	Replay* rep= (Replay*) ps->self;
+	rep->pos= rep->last;
+}
+
+static void close_Replay(Parser* ps)
+{
+	MBR_free(ps->self);
+	MBR_free(ps);
+}
+
+static Parser* init_Replay(Split* sp, int first, int last)
+{
+	Parser* self= (Parser*) MBR_malloc(sizeof(Parser));
+	Replay* rep= (Replay*) MBR_malloc(sizeof(Replay));
+
+	rep->sp= sp;
+	rep->pos= first;
+	rep->last= last;
+
+	self->self= (void*) rep;
+	self->reset_Parser= reset_Replay;
+	self->close_Parser= close_Replay;
+	self->nextphone_Parser= nextphone_Replay;
+	return self;
+}
+
+/*
+ * Dry pass
+ */
+
+static Segment* append_Segment(Split* sp, int first, bool after_flush,
+							   long warmup, Snapshot* start)
+/* Open a new segment, the previous one ends where this one begins */
+{
+	Segment* seg;
+
+	if (sp->nb_segments == sp->segments_available)
+    {
+		sp->segments_available*= 2;
+		sp->segments= (Segment*) MBR_realloc(sp->segments,
+											 sp->segments_available * sizeof(Segment));
+    }
+
+	seg= &sp->segments[sp->nb_segments++];
+	seg->first= first;
+	seg->last= first;
+	seg->after_flush= after_flush;
+	seg->warmup= warmup;
+	seg->nb_samples= 0;
+	seg->start= start;
+	return seg;
+}
+
+static bool long_silence(Mbrola* mb, Phone* ph, float silence)
+/* True if the phone is a silence lasting at least silence ms */
+{
+	return ( (silence > 0.0f) &&
+			 ph &&
+			 (length_Phone(ph) >= silence) &&
+			 !strcmp(name_Phone(ph), sil_phon(diph_dba(mb))) );
+}
+
+static StatePhone block_Split(Split* sp, Mbrola* mb, float silence)
+/*
+ * Dry pass on the phones up to the next flush, in the same order as
+ * Synthesis (standalone) or readtype_Mbrola (library).
+ * Return the state that stopped it
+ */
+{
+	StatePhone state;
+	Snapshot* candidate;
+	int candidate_entry=0;
+	long samples;
+
+	append_Segment(sp, sp->nb_entries, True, 0, save_Snapshot(mb));
+
+	if (!reset_Mbrola(mb))
+		return PHO_ERROR;
+
+	/* Junk diphone: in standalone mode its return value is ignored */
+	state= NextDiphone(mb);
+#ifdef LIBRARY
+	if (state != PHO_OK)
+		return state;
+#endif
+
+	while (True)
+    {
+		/*
+		 * The diphone ending in a long silence is a possible start: it is
+		 * synthesized on both sides of the cut
+		 */
+		candidate= NULL;
+		if (long_silence(mb, RightPhone(cur_diph(mb)), silence))
+		{
+			candidate= save_Snapshot(mb);
+			candidate_entry= sp->nb_entries;
+		}
+
+		state= NextDiphone(mb);
+		if ((state == PHO_OK) && !MatchProsody(mb))
+			state= PHO_ERROR;
+
+		if (state != PHO_OK)
+		{
+			if (candidate)
+				close_Snapshot(candidate);
+			return state;
+		}
+		Concat(mb);
+
+		samples= frame_pos(mb)[nb_pm(prev_diph(mb))];
+		sp->segments[sp->nb_segments-1].nb_samples+= samples;
+
+		if (candidate)
+		{
+			/* The warmup must push the whole OLA window out */
+			if (samples >= 2*MBRPeriod(diph_dba(mb)))
+			{
+				sp->segments[sp->nb_segments-1].last= sp->nb_entries;
+				append_Segment(sp, candidate_entry, False, samples, candidate);
+			}
+			else
+				close_Snapshot(candidate);
+		}
+    }
+}
+
+Split* init_Split(Mbrola* mb, float silence)
+/*
+ * Dry pass on the parser of mb up to the end of its input. Segments are
+ * cut at flushes, and in silences lasting at least silence ms (0 means
+ * flushes only). The engine is left as after a sequential synthesis,
+ * except for its OLA window.
+ *
+ * Return NULL in case of error
+ */
+{
+	Split* sp= (Split*) MBR_malloc(sizeof(Split));
+	Parser* real= parser(mb);
+	Parser* recorder;
+	StatePhone state;
+	int i, j;
+
+	sp->entries_available= 256;
+	sp->entries= (PhoneEntry*) MBR_malloc(sp->entries_available * sizeof(PhoneEntry));
+	sp->nb_entries= 0;
+	sp->segments_available= 16;
+	sp->segments= (Segment*) MBR_malloc(sp->segments_available * sizeof(Segment));
+	sp->nb_segments= 0;
+	sp->nb_samples= 0;
+
+	recorder= init_Recorder(sp, real);
+	set_parser_Mbrola(mb, recorder);
+
+	do
+    {
+		state= block_Split(sp, mb, silence);
+		sp->segments[sp->nb_segments-1].last= sp->nb_entries;
+    }
+	while ((state != PHO_EOF) && (state != PHO_ERROR));
+
+	set_parser_Mbrola(mb, real);
+	recorder->close_Parser(recorder);
+
+	if (state == PHO_ERROR)
+    {
+		close_Split(sp);
+		return NULL;
+    }
+
+	/* Drop the empty segments */
+	for (i=0, j=0; i<sp->nb_segments; i++)
+    {
+		if (sp->segments[i].nb_samples == 0)
+			close_Snapshot(sp->segments[i].start);
+		else
+		{
+			sp->nb_samples+= sp->segments[i].nb_samples;
+			sp->segments[j++]= sp->segments[i];
+		}
+    }
+	sp->nb_segments= j;
+
+	return sp;
+}
+
+void close_Split(Split* sp)
+/* Release the recorded phones and the saved states */
+{
+	int i;
+
+	for (i=0; i<sp->nb_entries; i++)
+		if (sp->entries[i].phone)
+			close_Phone(sp->entries[i].phone);
+
+	for (i=0; i<sp->nb_segments; i++)
+		close_Snapshot(sp->segments[i].start);
+
+	MBR_free(sp->entries);
+	MBR_free(sp->segments);
+	MBR_free(sp);
+}
+
+Parser* start_Split(Split* sp, int index, Mbrola* mb)
+/*
+ * Put mb in the state of the beginning of the segment index, and connect
+ * it to a parser replaying the phones of the segment. The parser must be
+ * closed once the segment is synthesized
+ */
+{
+	Segment* seg= &sp->segments[index];
+	Parser* replay= init_Replay(sp, seg->first, seg->last);
+
+	restore_Snapshot(seg->start, mb);
+	set_parser_Mbrola(mb, replay);
+
+#ifdef LIBRARY
+	if (seg->after_flush)
+		first_call(mb)=True;
+	else
+    {
+		/* readtype_Mbrola goes on with the next diphone */
+		first_call(mb)=False;
+		frame_counter(mb)= nb_pm(prev_diph(mb));
+		eaten(mb)=0;
+		buffer_shift(mb)=0;
+		zero_padding(mb)=0;
+    }
+#endif
+
+	return replay;
+}
+
+#ifndef LIBRARY
+
+void synthesize_Split(Split* sp, int index, Mbrola* mb)
+/*
+ * Standalone mode: synthesize the segment index on the output of mb,
+ * warmup included
+ */
+{
+	Parser* replay= start_Split(sp, index, mb);
+
+	if (sp->segments[index].after_flush)
+    {
+		/* Same as process_one_file */
+		reset_Mbrola(mb);
+		Synthesis(mb);
+    }
+	else
+    {
+		while (NextDiphone(mb) == PHO_OK)
+			oneshot_Mbrola(mb);
+    }
+
+	set_parser_Mbrola(mb, NULL);
+	replay->close_Parser(replay);
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * File:    split.h
+ * Purpose: cut the synthesis of a phonemic stream in independent segments
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * 19/10/26 : Created
+ *
+ *   A dry pass runs NextDiphone, MatchProsody and Concat on the whole
+ *   stream, without any OverLapAdd. The phones coming out of the parser
+ *   are recorded, and the engine state is saved where a segment may
+ *   start: at each flush, and before the diphone ending in a long silence.
+ *
+ *   Each segment can then be synthesized on any engine built on the same
+ *   database: the state is restored, the recorded phones are replayed,
+ *   and the audio is the same as in a sequential run. Segments starting
+ *   in a silence begin with a warm-up diphone whose samples are thrown
+ *   away: it rebuilds the OLA window that the saved state leaves empty.
+ */
+
+#ifndef _SPLIT_H
+#define _SPLIT_H
+
+#include "mbrola.h"
+
+/* Default shortest silence (ms) where a stream is split */
+#define SPLIT_SILENCE 200.0f
+
+/* Engine state at the start of a segment */
+typedef struct Snapshot Snapshot;
+
+/* Result of one call to the parser during the dry pass */
+typedef struct
+{
+	StatePhone state;
+	Phone* phone;     /* NULL unless state is PHO_OK */
+} PhoneEntry;
+
+/* Part of the stream that can be synthesized independently */
+typedef struct
+{
+	int first;          /* First phone entry to replay */
+	int last;           /* Entries are replayed up to last excluded */
+	bool after_flush;   /* Starts like a new sentence (reset_Mbrola) */
+	long warmup;        /* Samples to throw away at the beginning */
+	long nb_samples;    /* Samples to keep after the warmup */
+	Snapshot* start;    /* Engine state before the first entry */
+} Segment;
+
+typedef struct
+{
+	PhoneEntry* entries;
+	int nb_entries;
+	int entries_available;
+
+	Segment* segments;
+	int nb_segments;
+	int segments_available;
+
+	long nb_samples;    /* Total of the kept samples */
+} Split;
+
+#define nb_segments_Split(sp) (sp->nb_segments)
+#define segment_Split(sp,i) (&sp->segments[i])
+
+Split* init_Split(Mbrola* mb, float silence);
+/*
+ * Dry pass on the parser of mb up to the end of its input. Segments are
+ * cut at flushes, and in silences lasting at least silence ms (0 means
+ * flushes only). The engine is left as after a sequential synthesis,
+ * except for its OLA window.
+ *
+ * Return NULL in case of error
+ */
+
+void close_Split(Split* sp);
+/* Release the recorded phones and the saved states */
+
+Parser* start_Split(Split* sp, int index, Mbrola* mb);
+/*
+ * Put mb in the state of the beginning of the segment index, and connect
+ * it to a parser replaying the phones of the segment. The parser must be
+ * closed once the segment is synthesized.
+ * mb must be built on the database used for the dry pass, or on a copy
+ */
+
+#ifndef LIBRARY
+
+void synthesize_Split(Split* sp, int index, Mbrola* mb);
+/*
+ * Standalone mode: synthesize the segment index on the output of mb,
+ * warmup included
+ */
+
+#endif
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  demo3.c
+ * Purpose: demo of the job scheduler (multichannel library with THREADS)
+ *
+ * 19/10/26: Created
+ * 19/10/26: batch of the prompts gathered in memory
+ * 19/10/26: one long utterance split on the workers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "multichannel.h"
+#include "scheduler.h"
+
+#define NB_PROMPTS 3
+
+static char* prompts[NB_PROMPTS]= {
+	"_ 51 \n b 62  \n o~ 127  50 170 \n Z 110\n u 211 100 200\n R 150 \n_ 9\n",
+	"_ 51 \n Z 80 \n u 150 0 180 100 120\n_ 30\n",
+	"_ 20 \n b 62 \n o~ 200 50 150\n R 80\n_ 20\n#\n_ 20\n Z 110\n u 100\n_ 9\n"
+};
+
+/* The prompts as one long utterance, with pauses the workers can cut at */
+static char* long_prompt=
+	"_ 51 \n b 62  \n o~ 127  50 170 \n Z 110\n u 211 100 200\n R 150 \n_ 400\n"
+	"Z 80 \n u 150 0 180 100 120\n_ 400\n"
+	"b 62 \n o~ 200 50 150\n R 80\n_ 20\n#\n_ 20\n Z 110\n u 100\n_ 9\n";
+
+void handle_error(int Fatal)
+{
+	char err[255];
+
+	lastErrorStr_MBR2(err,sizeof(err));
+
+	printf("Code %i\n%s\n", lastError_MBR2(), err);
+
+	if (Fatal)
+		exit(-1);
+}
+
+int file_sink(void* sink_data, void* buffer, int nb_samples, AudioType sample_type)
+/* Called from the worker threads: write the audio in a file */
+{
+	int size= (sample_type==LIN16) ? 2 : 1;
+
+	if (fwrite(buffer, size, nb_samples, (FILE*) sink_data) != (size_t) nb_samples)
+		return -1;
+	return nb_samples;
+}
+
+int null_sink(void* sink_data, void* buffer, int nb_samples, AudioType sample_type)
+/* Throw the audio away */
+{
+	return nb_samples;
+}
+
+int main(int argc, char **argv)
+{
+	Database* dba;
+	Scheduler* sched;
+	Job** jobs;
+	BatchItem items[NB_PROMPTS];
+	FILE* output;
+	int nb_jobs= 1000;
+	int nb_workers= 0;
+	long total=0;
+	int i;
+
+	if (argc<2)
+	{
+		printf("%s ../fr1 [nb_workers] [nb_jobs]\n", argv[0]);
+		return 1;
+	}
+	if (argc>2)
+		nb_workers= atoi(argv[2]);
+	if (argc>3)
+		nb_jobs= atoi(argv[3]);
+	if (nb_jobs<1)
+		nb_jobs=1;
+
+	/* The database is shared by all the workers */
+	dba= init_DatabaseMBR2(argv[1],NULL,NULL);
+	if (!dba)
+		handle_error(True);
+
+	sched= init_SchedulerMBR2(nb_workers);
+	if (!sched)
+		handle_error(True);
+
+	/* The first job goes to a file, the others are thrown away */
+	output= fopen("res4.raw","wb");
+	jobs= (Job**) malloc(nb_jobs * sizeof(Job*));
+	jobs[0]= submit_JobMBR2(sched, dba, prompts[0], NULL, LIN16, file_sink, output);
+	for (i=1; i<nb_jobs; i++)
+		jobs[i]= submit_JobMBR2(sched, dba, prompts[i%NB_PROMPTS], NULL, LIN16, null_sink, NULL);
+
+	/* Wait for the jobs, and release them */
+	for (i=0; i<nb_jobs; i++)
+	{
+		if (wait_JobMBR2(jobs[i]) != JOB_DONE)
+		{
+			char err[255];
+
+			errorStr_JobMBR2(jobs[i], err, sizeof(err));
+			printf("Job %i: code %i\n%s\n", i, error_JobMBR2(jobs[i]), err);
+		}
+		total+= samples_JobMBR2(jobs[i]);
+		close_JobMBR2(jobs[i]);
+	}
+	printf("%i jobs on %i workers: %li samples\n",
+		   nb_jobs, workers_SchedulerMBR2(sched), total);
+
+	/* The same prompts as a batch, the audio is gathered in memory */
+	for (i=0; i<NB_PROMPTS; i++)
+	{
+		items[i].pho= prompts[i];
+		items[i].sample_type= LIN16;
+		items[i].sink= NULL;
+		items[i].sink_data= NULL;
+	}
+	printf("Batch: %i/%i done\n",
+		   synthesizeBatch_MBR2(sched, dba, items, NB_PROMPTS, NULL), NB_PROMPTS);
+	for (i=0; i<NB_PROMPTS; i++)
+		printf("  prompt %i: %li samples\n", i, items[i].nb_samples);
+	free_BatchMBR2(items, NB_PROMPTS);
+
+	/* One utterance cut in parts synthesized in parallel, same audio */
+	printf("Split: %li samples\n",
+		   synthesizeSplit_MBR2(sched, dba, long_prompt, NULL, LIN16, null_sink, NULL));
+
+	/* The scheduler MUST be closed before the database */
+	close_SchedulerMBR2(sched);
+	close_DatabaseMBR2(dba);
+	fclose(output);
+	free(jobs);
+
+	return(0);
+}
@@ -25,6 +25,11 @@
  * 2/09/98: Created
  *    Used to hide mbrola file structure from the outside when distributing 
  *    lib
+ *
+ * 19/10/26: Job scheduler when compiled with THREADS
+ * 19/10/26: Split synthesis of one utterance on the scheduler
+ * 19/10/26: ROM images shared between processes
+ * 19/10/26: Resampler of the output
  */
 
 #define MULTI_CHANNEL
@@ -51,6 +56,8 @@
 #include "../Engine/diphone.c"
 #include "../Misc/g711.c"
 #include "../Misc/audio.c"
+#include "../Engine/resample.c"
+#include "../Engine/kernels.c"
 #include "../Engine/mbrola.c"
 #include "../Database/diphone_info.c"
 #include "../Database/database_old.c"
@@ -64,6 +71,11 @@
 #include "../LibMultiChannel/multichannel.c"
 #include "../Misc/vp_error.c"
 
+#ifdef THREADS
+#include "../Engine/split.c"
+#include "../LibMultiChannel/scheduler.c"
+#endif
+
 #ifdef BACON
 #include "../Database/database_bacon.c"
 #endif
@@ -76,3 +88,7 @@
 #include "../Database/rom_database.c"
 #include "../Database/rom_handling.c"
 #endif
+
+#ifdef ROMDATABASE_IMAGE
+#include "../Database/rom_image.c"
+#endif
@@ -33,6 +33,14 @@
  *                    and correct a bug with init/reset_MBR2
  * 20/10/98: 3.01g -> pass flush symbol. Avoid the variable "rename" due to
  *           exisiting functions in libraries
+ *
+ * 19/10/26: per engine error accessors for multithreaded applications
+ * 19/10/26: databases from ROM images shared between processes
+ * 19/10/26: push_MBR2, audio pushed to a user function diphone by diphone
+ * 19/10/26: setOutFreq_MBR2, output resampled at any sample rate
+ * 19/10/26: getStageStats_MBR2, time spent in each stage under PROFILE
+ * 19/10/26: getMetrics_MBR2 and getDatabaseMetrics_MBR2, activity counters
+ * 19/10/26: init_DatabaseMBR2 releases its renaming lists
  */
 
 #include "common.h"
@@ -44,6 +52,10 @@
 #include "input_file.h"
 #include "incdll.h"
 
+#ifdef ROMDATABASE_IMAGE
+#include "rom_image.h"
+#endif
+
 Database* DLL_EXPORT init_DatabaseMBR2(char* dbaname, char* rename_string, char* clone_string)
 /* 
  * Give the name of the file containing the database, and parameters to 
@@ -54,6 +66,7 @@ Database* DLL_EXPORT init_DatabaseMBR2(char* dbaname, char* rename_string, char*
 {
 	ZStringList* rename_list=NULL;     /* phoneme renaming */
 	ZStringList* clone_list=NULL;      /* phoneme cloning */
+	Database* dba;
   
 	if (rename_string)
     {
@@ -65,8 +78,44 @@ Database* DLL_EXPORT init_DatabaseMBR2(char* dbaname, char* rename_string, char*
 		clone_list= init_ZStringList();
 		parse_ZStringList(clone_list, clone_string, True);
     }
-	return init_rename_Database(dbaname, rename_list, clone_list);
+	dba= init_rename_Database(dbaname, rename_list, clone_list);
+
+	/* The hash table of the database is built, the lists are not kept */
+	if (rename_list)
+		close_ZStringList(rename_list);
+	if (clone_list)
+		close_ZStringList(clone_list);
+	return dba;
+}
+
+#ifdef ROMDATABASE_IMAGE
+
+#ifdef ROMDATABASE_INIT
+Database* DLL_EXPORT init_ImageDatabaseMBR2(char* image_name)
+/*
+ * Attach a ROM image written by store_ImageDatabaseMBR2 (or mbrola -S),
+ * mapped read-only: the pages are shared by all the processes using it.
+ * "shm:/name" is a POSIX shared memory object, other names are files
+ */
+{
+	return init_ROM_Image(image_name);
 }
+#endif
+
+#ifdef ROMDATABASE_STORE
+int DLL_EXPORT store_ImageDatabaseMBR2(Database* dba, char* image_name)
+/*
+ * Write the ROM image of a database, renamings and clonings included
+ * Return 0, or a negative error code
+ */
+{
+	if (!store_ROM_Image(dba, image_name))
+		return lastError_MBR2();
+	return 0;
+}
+#endif
+
+#endif /* ROMDATABASE_IMAGE */
 
 Database* DLL_EXPORT copyconstructor_DatabaseMBR2(Database* dba)
 /* Creates a copy of a diphone database so that many synthesis engine 
@@ -141,6 +190,14 @@ int DLL_EXPORT readtype_MBR2(Mbrola* mb, void *buffer_out, int nb_wanted, AudioT
  */
 { return readtype_Mbrola(mb, buffer_out, nb_wanted, sample_type); }
 
+int DLL_EXPORT push_MBR2(Mbrola* mb, PushFunction push, void* user_data, AudioType sample_type)
+/*
+ * Synthesize the phonemes available in the parser, push gets each
+ * diphone as soon as it is rendered, then the flushes and the end
+ * Returns the number of samples pushed, negative means error
+ */
+{ return push_Mbrola(mb, push, user_data, sample_type); }
+
 int DLL_EXPORT getDatabaseInfo_MBR2(Mbrola* mb,char *msg,int nb_wanted,int index)
 /* Retrieve the ith info message, NULL means get the size  */ 
 { return(getDatabaseInfo(diph_dba(mb), msg, nb_wanted, index)); }
@@ -153,6 +210,21 @@ int  DLL_EXPORT getFreq_MBR2(Mbrola* mb)
 /* Return the output frequency */
 { return(VoiceFreq(mb)); }
 
+int DLL_EXPORT setOutFreq_MBR2(Mbrola* mb, int freq)
+/* 
+ * Sample rate of the audio, resampled from the voice frequency, 0 means
+ * no resampling. Return 0 if the ratio can't be resampled
+ */
+{
+	if ((freq < 0) || (freq > 65535))
+		return 0;
+	return set_outfreq_Mbrola(mb, (uint16) freq);
+}
+
+int DLL_EXPORT getOutFreq_MBR2(Mbrola* mb)
+/* Sample rate of the audio (the voice frequency if not resampled) */
+{ return get_outfreq_Mbrola(mb); }
+
 void DLL_EXPORT setNoError_MBR2(Mbrola* mb, int no_error)
 /* Tolerance to missing diphones */
 { set_no_error_Mbrola(mb, no_error); }
@@ -179,17 +251,7 @@ int DLL_EXPORT lastError_MBR2()
 
 int DLL_EXPORT lastErrorStr_MBR2(char *buffer_err,int nb_wanted)
 /* Return the last error message available */
-{
-	int length=strlen(errbuffer)+1;
-  
-	if (length<nb_wanted) 
-		nb_wanted=length;
-  
-	memcpy(buffer_err,errbuffer,nb_wanted-1);
-	buffer_err[nb_wanted-1]=0;
-  
-	return nb_wanted;
-}
+{ return copy_error_message(errbuffer, buffer_err, nb_wanted); }
 
 void DLL_EXPORT resetError_MBR2()
 /* Clear the Mbrola error buffer */
@@ -198,6 +260,38 @@ void DLL_EXPORT resetError_MBR2()
 	errbuffer[0]=0;
 }
 
+int DLL_EXPORT getLastError_MBR2(Mbrola* mb)
+/* Return the code of the last error met by this engine, 0 means no error */
+{ return get_last_error_Mbrola(mb); }
+
+int DLL_EXPORT getLastErrorStr_MBR2(Mbrola* mb, char *buffer_err, int nb_wanted)
+/* Return the message of the last error met by this engine */
+{ return get_last_error_str_Mbrola(mb, buffer_err, nb_wanted); }
+
+void DLL_EXPORT resetLastError_MBR2(Mbrola* mb)
+/* Clear the error recorded by this engine */
+{ reset_last_error_Mbrola(mb); }
+
+int DLL_EXPORT getStageStats_MBR2(Mbrola* mb, StageStats* stats)
+/* Time and calls of each stage, 0 if the library is compiled without PROFILE */
+{ return get_stats_Mbrola(mb, stats); }
+
+void DLL_EXPORT resetStageStats_MBR2(Mbrola* mb)
+/* Start the timing of the stages again */
+{ reset_stats_Mbrola(mb); }
+
+char* DLL_EXPORT stageName_MBR2(int stage)
+/* Name of a stage, e.g. "ola" for STAGE_OLA */
+{ return name_Stage((Stage) stage); }
+
+void DLL_EXPORT getMetrics_MBR2(Mbrola* mb, EngineMetrics* metrics)
+/* Activity counters of the engine, from any thread */
+{ get_metrics_Mbrola(mb, metrics); }
+
+void DLL_EXPORT getDatabaseMetrics_MBR2(Database* dba, DatabaseMetrics* metrics)
+/* Activity counters of the database and its copies, from any thread */
+{ get_metrics_Database(dba, metrics); }
+
 int DLL_EXPORT getVersion_MBR2(char *msg,int nb_wanted)
 /* Return the release number, e.g. "2.05a"  */
 {
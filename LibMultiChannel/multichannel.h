@@ -24,6 +24,16 @@
  * 22/06/98: Created. Replace old library.c
  *           One should either use multichannel or onechannel front end
  *           depending on end-user or telecom applications
+ *
+ * 19/10/26: databases from ROM images shared between processes
+ *
+ * 19/10/26: push_MBR2, audio pushed to a user function diphone by diphone
+ *
+ * 19/10/26: setOutFreq_MBR2, output resampled at any sample rate
+ *
+ * 19/10/26: getStageStats_MBR2, time spent in each stage under PROFILE
+ *
+ * 19/10/26: getMetrics_MBR2 and getDatabaseMetrics_MBR2, activity counters
  */
 
 #ifndef _MULTICHANNEL_H
@@ -41,6 +51,27 @@ Database* DLL_EXPORT init_DatabaseMBR2(char* dbaname, char* rename, char* clone)
  * NULL on rename or clone means no modification to the database 
  */
 
+#ifdef ROMDATABASE_IMAGE
+
+#ifdef ROMDATABASE_INIT
+Database* DLL_EXPORT init_ImageDatabaseMBR2(char* image_name);
+/*
+ * Attach a ROM image written by store_ImageDatabaseMBR2 (or mbrola -S),
+ * mapped read-only: the pages are shared by all the processes using it.
+ * "shm:/name" is a POSIX shared memory object, other names are files
+ */
+#endif
+
+#ifdef ROMDATABASE_STORE
+int DLL_EXPORT store_ImageDatabaseMBR2(Database* dba, char* image_name);
+/*
+ * Write the ROM image of a database, renamings and clonings included
+ * Return 0, or a negative error code
+ */
+#endif
+
+#endif /* ROMDATABASE_IMAGE */
+
 Database* DLL_EXPORT copyconstructor_DatabaseMBR2(Database* dba);
 /* Creates a copy of a diphone database so that many synthesis engine 
  * can use the same database at the same time (duplicate the file handler)
@@ -77,6 +108,16 @@ int DLL_EXPORT readtype_MBR2(Mbrola* mb, void *buffer_out, int nb_wanted, AudioT
  * Returns the effective number of samples read
  */
 
+int DLL_EXPORT push_MBR2(Mbrola* mb, PushFunction push, void* user_data, AudioType sample_type);
+/*
+ * Push mode, instead of reading: synthesize the phonemes available in 
+ * the parser. push receives the audio of each diphone as soon as it is
+ * rendered (PUSH_AUDIO), then a PUSH_FLUSH for each flush command and 
+ * PUSH_END when the input is exhausted. Same audio as readtype_MBR2.
+ * Returns the number of samples pushed, negative means error
+ * (ERROR_OUTFILE if push returned non-zero)
+ */
+
 int DLL_EXPORT getDatabaseInfo_MBR2(Mbrola* mb,char *msg,int nb_wanted,int index);
 /* Retrieve the ith info message, NULL means get the size  */ 
 
@@ -86,6 +127,15 @@ void DLL_EXPORT setFreq_MBR2(Mbrola* mb,int freq);
 int  DLL_EXPORT getFreq_MBR2(Mbrola* mb);
 /* Return the output frequency */
 
+int DLL_EXPORT setOutFreq_MBR2(Mbrola* mb, int freq);
+/* 
+ * Sample rate of the audio, resampled from the voice frequency, 0 means
+ * no resampling. Return 0 if the ratio can't be resampled
+ */
+
+int DLL_EXPORT getOutFreq_MBR2(Mbrola* mb);
+/* Sample rate of the audio (the voice frequency if not resampled) */
+
 void DLL_EXPORT setSmoothing_MBR2(Mbrola* mb, int smoothing);
 /* Spectral smoothing or not */
 
@@ -108,13 +158,55 @@ void DLL_EXPORT set_parser_MBR2(Mbrola* mb, Parser* parser);
 /* drop the current parser for a new one */
 
 int DLL_EXPORT lastError_MBR2();
-/* Return the last error code */
+/* 
+ * Return the last error code
+ * When compiled with THREADS, the error state is local to the calling thread
+ */
 
 int DLL_EXPORT lastErrorStr_MBR2(char *buffer_err,int nb_wanted);
-/* Return the last error message available */
+/* Return the last error message available (of the calling thread) */
+
+void DLL_EXPORT resetError_MBR2();
+/* Clear the Mbrola error buffer (of the calling thread) */
+
+int DLL_EXPORT getLastError_MBR2(Mbrola* mb);
+/* 
+ * Return the code of the last error met by readtype_MBR2 on this engine,
+ * whatever the thread it ran on. 0 means no error
+ */
+
+int DLL_EXPORT getLastErrorStr_MBR2(Mbrola* mb, char *buffer_err, int nb_wanted);
+/* Return the message of the last error met by this engine */
+
+void DLL_EXPORT resetLastError_MBR2(Mbrola* mb);
+/* Clear the error recorded by this engine */
 
-void DLL_EXPORT reset_error_MBR2();
-/* Clear the Mbrola error buffer */
+int DLL_EXPORT getStageStats_MBR2(Mbrola* mb, StageStats* stats);
+/* 
+ * Time (seconds) and calls of each stage of the synthesis on this engine,
+ * since init_MBR2 or resetStageStats_MBR2. A stage doesn't count the time
+ * of the stages it calls. Return 0 (and zeros) when the library is
+ * compiled without PROFILE
+ */
+
+void DLL_EXPORT resetStageStats_MBR2(Mbrola* mb);
+/* Start the timing of the stages again */
+
+char* DLL_EXPORT stageName_MBR2(int stage);
+/* Name of a stage, e.g. "ola" for STAGE_OLA */
+
+void DLL_EXPORT getMetrics_MBR2(Mbrola* mb, EngineMetrics* metrics);
+/* 
+ * Activity counters of the engine since init_MBR2 (see incdll.h). Can be
+ * called from a monitoring thread while the engine synthesizes: each
+ * counter is read atomically, without locking
+ */
+
+void DLL_EXPORT getDatabaseMetrics_MBR2(Database* dba, DatabaseMetrics* metrics);
+/* 
+ * Activity counters of the database, summed over all its copies (one per
+ * engine), from any thread
+ */
 
 int DLL_EXPORT getVersion_MBR2(char *msg,int nb_wanted);
 /* Return the release number, e.g. "2.05a"  */
@@ -0,0 +1,1093 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  scheduler.c
+ * Purpose: worker threads running synthesis jobs on a pool of engines
+ *
+ * 19/10/26: Created
+ * 19/10/26: synthesizeBatch_MBR2, audio of the items gathered in memory
+ * 19/10/26: synthesizeSplit_MBR2, segments of one utterance as jobs
+ * 19/10/26: comment and flush symbols of the jobs
+ * 19/10/26: FLOAT32 and LIN24 jobs
+ * 19/10/26: resampled jobs, split ones resampled when delivered
+ * 19/10/26: forget_DatabaseMBR2 releases the engines of a database
+ * 19/10/26: the end of the input is tested with empty_Fifo
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "common.h"
+#include "mbrola.h"
+#include "audio.h"
+#include "database.h"
+#include "fifo.h"
+#include "input_fifo.h"
+#include "parser_input.h"
+#include "phonbuff.h"
+#include "multichannel.h"
+#include "split.h"
+#include "scheduler.h"
+
+/* Number of samples synthesized between 2 calls to the sink */
+#define JOB_CHUNK 4096
+
+/* An engine of the pool, with its own database copy and input stream */
+typedef struct PoolEngine
+{
+	Database* model;  /* Shared database the engine was built for */
+	Database* dba;    /* Private copy of the model (file handler) */
+	Fifo* fifo;       /* Phonemic input of the jobs */
+	Input* input;     /* Input stream on the fifo */
+	Mbrola* mb;       /* The engine */
+	struct PoolEngine* next;
+} PoolEngine;
+
+struct Job
+{
+	Scheduler* sched;
+	Database* dba;          /* Shared database */
+	char* pho;              /* Phonemic input */
+	Split* split;           /* Or segment of a split utterance */
+	int segment;
+	JobSettings settings;
+	AudioType sample_type;
+	SinkFunction sink;
+	void* sink_data;
+
+	volatile int cancel;    /* Cancellation request, polled by the worker */
+	JobState state;         /* Protected by the lock of the scheduler */
+	long nb_samples;        /* Samples delivered to the sink */
+	ErrorState error;       /* Copy of the error of the worker */
+
+	Job* prev;              /* Links in the queue of a worker */
+	Job* next;
+};
+
+/* A worker thread with its queue of jobs and its pool of engines */
+typedef struct
+{
+	Scheduler* sched;
+	int index;
+	pthread_t thread;
+	pthread_mutex_t lock;   /* Protects the queue */
+	Job* head;              /* Oldest job, popped by the worker */
+	Job* tail;              /* Newest job, stolen by the others */
+	PoolEngine* engines;    /* Used by the worker thread, changed with lock */
+} Worker;
+
+struct Scheduler
+{
+	int nb_workers;
+	Worker* workers;
+
+	pthread_mutex_t lock;      /* Protects the fields below and the job states */
+	pthread_cond_t work_cond;  /* Signaled when a job is queued */
+	pthread_cond_t done_cond;  /* Broadcast when a job is finished */
+	int nb_queued;             /* Jobs waiting in the queues */
+	int nb_unfinished;         /* Jobs submitted and not finished */
+	int next_worker;           /* Round robin dispatch */
+	bool closing;              /* Ask the workers to terminate */
+};
+
+/*
+ * Queue handling: the owner pops the oldest job, thieves take the newest
+ */
+
+static void push_Worker(Worker* w, Job* job)
+/* Append a job at the tail of the queue */
+{
+	pthread_mutex_lock(&w->lock);
+	job->next=NULL;
+	job->prev=w->tail;
+	if (w->tail)
+		w->tail->next=job;
+	else
+		w->head=job;
+	w->tail=job;
+	pthread_mutex_unlock(&w->lock);
+}
+
+static Job* pop_Worker(Worker* w, bool steal)
+/* Remove a job from the head (or from the tail if steal), NULL if empty */
+{
+	Job* job;
+
+	pthread_mutex_lock(&w->lock);
+	job= (steal) ? w->tail : w->head;
+	if (job)
+	{
+		if (job->prev)
+			job->prev->next=job->next;
+		else
+			w->head=job->next;
+
+		if (job->next)
+			job->next->prev=job->prev;
+		else
+			w->tail=job->prev;
+		job->prev= job->next= NULL;
+	}
+	pthread_mutex_unlock(&w->lock);
+	return job;
+}
+
+/*
+ * Engine pool of a worker
+ */
+
+static void close_PoolEngine(PoolEngine* pe)
+/* Release an engine of the pool */
+{
+	close_Mbrola(pe->mb);
+	pe->input->close_Input(pe->input);
+	close_Fifo(pe->fifo);
+	pe->dba->close_Database(pe->dba);
+	MBR_free(pe);
+}
+
+static PoolEngine* engine_Worker(Worker* w, Database* model)
+/*
+ * Return the engine of the worker for this database, create it the first
+ * time. NULL in case of error
+ */
+{
+	PoolEngine* pe;
+	Database* dba;
+
+	pthread_mutex_lock(&w->lock);
+	for (pe= w->engines; pe; pe= pe->next)
+		if (pe->model == model)
+			break;
+	pthread_mutex_unlock(&w->lock);
+	if (pe)
+		return pe;
+
+	dba= copyconstructor_Database(model);
+	if (!dba)
+		return NULL;
+
+	pe= (PoolEngine*) MBR_malloc(sizeof(PoolEngine));
+	pe->model= model;
+	pe->dba= dba;
+	pe->fifo= init_Fifo(FIFO_SIZE);
+	pe->input= init_InputFifo(pe->fifo);
+	pe->mb= init_Mbrola(dba);
+
+	pthread_mutex_lock(&w->lock);
+	pe->next= w->engines;
+	w->engines= pe;
+	pthread_mutex_unlock(&w->lock);
+	return pe;
+}
+
+/*
+ * Job processing
+ */
+
+static void finish_Job(Job* job, JobState state)
+/* Record the final state of the job and wake up the waiters */
+{
+	Scheduler* sched= job->sched;
+
+	pthread_mutex_lock(&sched->lock);
+	job->state= state;
+	sched->nb_unfinished--;
+	pthread_cond_broadcast(&sched->done_cond);
+	pthread_mutex_unlock(&sched->lock);
+}
+
+static Parser* setup_Engine(Mbrola* mb, Database* dba, Input* input,
+							JobSettings* settings)
+/*
+ * Fresh parser and settings of a job: duration and pitch ratios are local
+ * to the job. The engine doesn't depend on the previous jobs
+ */
+{
+	Parser* parser;
+
+	parser= init_ParserInput(input,
+							 sil_phon(dba),
+							 (float)Freq(dba) / (float)MBRPeriod(dba),
+							 settings->time_ratio, settings->freq_ratio,
+							 (settings->comment) ? settings->comment : ";",
+							 settings->flush);
+	set_parser_Mbrola(mb, parser);
+
+	if (settings->voice_freq > 0)
+		set_voicefreq_Mbrola(mb, (uint16) settings->voice_freq);
+	else
+		set_voicefreq_Mbrola(mb, Freq(dba));
+	set_volume_ratio_Mbrola(mb, settings->volume_ratio);
+	set_smoothing_Mbrola(mb, settings->smoothing);
+	set_no_error_Mbrola(mb, settings->no_error);
+
+	forget_Mbrola(mb);
+	return parser;
+}
+
+static void write_Pho(Fifo* fifo, Parser* parser, char* pho)
+/* Phonemic input of a job, followed by a flush */
+{
+	PhoneBuff* pb= (PhoneBuff*) parser->self;
+	char* flush;
+
+	/* The flush symbol is stored as a sscanf target "#%n" */
+	flush= MBR_strdup(flush_symbol(pb));
+	flush[strlen(flush)-2]=0;
+
+	write_Fifo(fifo, pho);
+	write_Fifo(fifo, "\n");
+	write_Fifo(fifo, flush);
+	write_Fifo(fifo, "\n");
+	MBR_free(flush);
+}
+
+static JobState synthesize_Job(PoolEngine* pe, Job* job, void* buffer)
+/* Synthesize the whole phonemic input of the job on the engine */
+{
+	Mbrola* mb= pe->mb;
+	Parser* parser;
+	int nb_read;
+	JobState state= JOB_DONE;
+
+	parser= setup_Engine(mb, pe->dba, pe->input, &job->settings);
+	if ( !setOutFreq_MBR2(mb, job->settings.out_freq)
+		 || !reset_MBR2(mb) )
+    {
+		catch_ErrorState(&job->error);
+		set_parser_Mbrola(mb, NULL);
+		parser->close_Parser(parser);
+		return JOB_ERROR;
+    }
+	write_Pho(pe->fifo, parser, job->pho);
+
+	while (True)
+    {
+		if (job->cancel)
+		{
+			state= JOB_CANCELLED;
+			break;
+		}
+
+		nb_read= readtype_MBR2(mb, buffer, JOB_CHUNK, job->sample_type);
+		if (nb_read < 0)
+		{
+			job->error= last_error(mb);
+			state= JOB_ERROR;
+			break;
+		}
+
+		if (nb_read == 0)
+		{
+			/* flush reached, the job is over when the input is exhausted */
+			if (empty_Fifo(pe->fifo))
+				break;
+			continue;
+		}
+
+		if (job->sink(job->sink_data, buffer, nb_read, job->sample_type) < 0)
+		{
+			fatal_message(ERROR_OUTFILE, "Audio sink failure\n");
+			catch_ErrorState(&job->error);
+			state= JOB_ERROR;
+			break;
+		}
+		job->nb_samples+= nb_read;
+    }
+
+	/* Leave a clean engine for the next job */
+	if (state != JOB_DONE)
+		reset_MBR2(mb);
+
+	set_parser_Mbrola(mb, NULL);
+	parser->close_Parser(parser);
+	return state;
+}
+
+static JobState synthesize_Segment(PoolEngine* pe, Job* job, void* buffer)
+/* Synthesize a segment of a split utterance, its warmup is not delivered */
+{
+	Mbrola* mb= pe->mb;
+	Segment* seg= segment_Split(job->split, job->segment);
+	long to_skip= seg->warmup;
+	int size= size_AudioType(job->sample_type);
+	Parser* replay;
+	int nb_read;
+	int skip;
+	JobState state= JOB_DONE;
+
+	/* Segments come out at the voice frequency, see deliver_Split */
+	set_outfreq_Mbrola(mb, 0);
+	replay= start_Split(job->split, job->segment, mb);
+
+	while (True)
+    {
+		if (job->cancel)
+		{
+			state= JOB_CANCELLED;
+			break;
+		}
+
+		nb_read= readtype_MBR2(mb, buffer, JOB_CHUNK, job->sample_type);
+		if (nb_read < 0)
+		{
+			job->error= last_error(mb);
+			state= JOB_ERROR;
+			break;
+		}
+
+		/* The replayed phones end with PHO_EOF */
+		if (nb_read == 0)
+			break;
+
+		skip= (to_skip > nb_read) ? nb_read : (int) to_skip;
+		to_skip-= skip;
+		if (skip == nb_read)
+			continue;
+
+		if (job->sink(job->sink_data, (char*) buffer + skip*size,
+					  nb_read - skip, job->sample_type) < 0)
+		{
+			fatal_message(ERROR_OUTFILE, "Audio sink failure\n");
+			catch_ErrorState(&job->error);
+			state= JOB_ERROR;
+			break;
+		}
+		job->nb_samples+= nb_read - skip;
+    }
+
+	set_parser_Mbrola(mb, NULL);
+	replay->close_Parser(replay);
+	return state;
+}
+
+static void run_Job(Worker* w, Job* job, void* buffer)
+/* Process one job taken from a queue */
+{
+	Scheduler* sched= w->sched;
+	PoolEngine* pe;
+
+	pthread_mutex_lock(&sched->lock);
+	sched->nb_queued--;
+	if (job->cancel)
+    {
+		pthread_mutex_unlock(&sched->lock);
+		finish_Job(job, JOB_CANCELLED);
+		return;
+    }
+	job->state= JOB_RUNNING;
+	pthread_mutex_unlock(&sched->lock);
+
+	pe= engine_Worker(w, job->dba);
+	if (!pe)
+    {
+		catch_ErrorState(&job->error);
+		finish_Job(job, JOB_ERROR);
+		return;
+    }
+
+	if (job->split)
+		finish_Job(job, synthesize_Segment(pe, job, buffer));
+	else
+		finish_Job(job, synthesize_Job(pe, job, buffer));
+}
+
+static Job* find_Job(Worker* w)
+/* Own queue first, then steal from the others. NULL if nothing to do */
+{
+	Scheduler* sched= w->sched;
+	Job* job;
+	int i;
+
+	job= pop_Worker(w, False);
+	for (i=1; !job && i<sched->nb_workers; i++)
+		job= pop_Worker(&sched->workers[ (w->index + i) % sched->nb_workers ], True);
+
+	return job;
+}
+
+static void* main_Worker(void* arg)
+/* Main loop of a worker thread */
+{
+	Worker* w= (Worker*) arg;
+	Scheduler* sched= w->sched;
+	void* buffer= MBR_malloc(JOB_CHUNK * sizeof(float)); /* the largest sample */
+	Job* job;
+
+	while (True)
+    {
+		job= find_Job(w);
+		if (job)
+		{
+			run_Job(w, job, buffer);
+			continue;
+		}
+
+		/* Nothing in the queues, sleep until something is submitted */
+		pthread_mutex_lock(&sched->lock);
+		while ((sched->nb_queued <= 0) && !sched->closing)
+			pthread_cond_wait(&sched->work_cond, &sched->lock);
+
+		if ((sched->nb_queued <= 0) && sched->closing)
+		{
+			pthread_mutex_unlock(&sched->lock);
+			break;
+		}
+		pthread_mutex_unlock(&sched->lock);
+    }
+
+	/* Release the engine pool */
+	while (w->engines)
+    {
+		PoolEngine* pe= w->engines;
+		w->engines= pe->next;
+		close_PoolEngine(pe);
+    }
+	MBR_free(buffer);
+	return NULL;
+}
+
+static Job* queue_Job(Scheduler* sched, Database* dba, char* pho,
+					  Split* split, int segment,
+					  JobSettings* settings, AudioType sample_type,
+					  SinkFunction sink, void* sink_data)
+/* Build a job for a phonemic string or a segment, and dispatch it */
+{
+	Job* job= (Job*) MBR_malloc(sizeof(Job));
+	Worker* w;
+
+	job->sched= sched;
+	job->dba= dba;
+	job->pho= (pho) ? MBR_strdup(pho) : NULL;
+	job->split= split;
+	job->segment= segment;
+	if (settings)
+		job->settings= *settings;
+	else
+		default_JobSettingsMBR2(&job->settings);
+	if (job->settings.comment)
+		job->settings.comment= MBR_strdup(job->settings.comment);
+	if (job->settings.flush)
+		job->settings.flush= MBR_strdup(job->settings.flush);
+	job->sample_type= sample_type;
+	job->sink= sink;
+	job->sink_data= sink_data;
+	job->cancel= False;
+	job->state= JOB_QUEUED;
+	job->nb_samples= 0;
+	reset_ErrorState(&job->error);
+
+	pthread_mutex_lock(&sched->lock);
+	w= &sched->workers[sched->next_worker];
+	sched->next_worker= (sched->next_worker+1) % sched->nb_workers;
+	sched->nb_unfinished++;
+	pthread_mutex_unlock(&sched->lock);
+
+	push_Worker(w, job);
+
+	pthread_mutex_lock(&sched->lock);
+	sched->nb_queued++;
+	pthread_cond_signal(&sched->work_cond);
+	pthread_mutex_unlock(&sched->lock);
+
+	return job;
+}
+
+/*
+ * Batch: items with no sink gather their audio in memory
+ */
+
+/* Growing audio buffer of a batch item */
+typedef struct
+{
+	BatchItem* item;
+	long capacity;   /* in samples */
+} MemorySink;
+
+static int memory_sink(void* sink_data, void* buffer, int nb_samples, AudioType sample_type)
+/* Append the samples to the buffer of the item, doubling it when full */
+{
+	MemorySink* ms= (MemorySink*) sink_data;
+	BatchItem* item= ms->item;
+	int size= size_AudioType(sample_type);
+
+	if (item->nb_samples + nb_samples > ms->capacity)
+    {
+		long capacity= 2*ms->capacity;
+		void* audio;
+
+		if (capacity < item->nb_samples + nb_samples)
+			capacity= item->nb_samples + nb_samples;
+
+		audio= MBR_realloc(item->audio, capacity*size);
+		if (!audio)
+			return -1;
+		item->audio= audio;
+		ms->capacity= capacity;
+    }
+
+	memcpy((char*)item->audio + item->nb_samples*size, buffer, nb_samples*size);
+	item->nb_samples+= nb_samples;
+	return nb_samples;
+}
+
+/*
+ * Public interface
+ */
+
+void DLL_EXPORT default_JobSettingsMBR2(JobSettings* settings)
+/* Fill the structure with the default values */
+{
+	settings->time_ratio= 1.0f;
+	settings->freq_ratio= 1.0f;
+	settings->volume_ratio= 1.0f;
+	settings->voice_freq= 0;
+	settings->out_freq= 0;
+	settings->smoothing= True;
+	settings->no_error= False;
+	settings->comment= NULL;
+	settings->flush= NULL;
+}
+
+Scheduler* DLL_EXPORT init_SchedulerMBR2(int nb_workers)
+/*
+ * Start nb_workers threads (0 or less means one per processor when it
+ * can be found). NULL in case of error
+ */
+{
+	Scheduler* sched;
+	int i;
+
+	if (nb_workers <= 0)
+    {
+#ifdef _SC_NPROCESSORS_ONLN
+		nb_workers= (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		if (nb_workers <= 0)
+			nb_workers= 1;
+    }
+
+	sched= (Scheduler*) MBR_malloc(sizeof(Scheduler));
+	sched->nb_workers= nb_workers;
+	sched->nb_queued= 0;
+	sched->nb_unfinished= 0;
+	sched->next_worker= 0;
+	sched->closing= False;
+	pthread_mutex_init(&sched->lock, NULL);
+	pthread_cond_init(&sched->work_cond, NULL);
+	pthread_cond_init(&sched->done_cond, NULL);
+
+	sched->workers= (Worker*) MBR_malloc(nb_workers * sizeof(Worker));
+	for (i=0; i<nb_workers; i++)
+    {
+		Worker* w= &sched->workers[i];
+		w->sched= sched;
+		w->index= i;
+		w->head= w->tail= NULL;
+		w->engines= NULL;
+		pthread_mutex_init(&w->lock, NULL);
+    }
+
+	for (i=0; i<nb_workers; i++)
+    {
+		if (pthread_create(&sched->workers[i].thread, NULL,
+						   main_Worker, &sched->workers[i]) != 0)
+		{
+			fatal_message(ERROR_MEMORYOUT, "Can't create worker thread %i\n", i);
+
+			/* Stop the threads allready started */
+			sched->nb_workers= i;
+			close_SchedulerMBR2(sched);
+			return NULL;
+		}
+    }
+	return sched;
+}
+
+void DLL_EXPORT wait_SchedulerMBR2(Scheduler* sched)
+/* Wait until all the submitted jobs are finished */
+{
+	pthread_mutex_lock(&sched->lock);
+	while (sched->nb_unfinished > 0)
+		pthread_cond_wait(&sched->done_cond, &sched->lock);
+	pthread_mutex_unlock(&sched->lock);
+}
+
+void DLL_EXPORT close_SchedulerMBR2(Scheduler* sched)
+/*
+ * Wait for the submitted jobs, stop the threads, and release the engines.
+ */
+{
+	int i;
+
+	wait_SchedulerMBR2(sched);
+
+	pthread_mutex_lock(&sched->lock);
+	sched->closing= True;
+	pthread_cond_broadcast(&sched->work_cond);
+	pthread_mutex_unlock(&sched->lock);
+
+	for (i=0; i<sched->nb_workers; i++)
+		pthread_join(sched->workers[i].thread, NULL);
+
+	for (i=0; i<sched->nb_workers; i++)
+		pthread_mutex_destroy(&sched->workers[i].lock);
+
+	pthread_cond_destroy(&sched->done_cond);
+	pthread_cond_destroy(&sched->work_cond);
+	pthread_mutex_destroy(&sched->lock);
+	MBR_free(sched->workers);
+	MBR_free(sched);
+}
+
+void DLL_EXPORT forget_DatabaseMBR2(Scheduler* sched, Database* dba)
+/*
+ * Release the engines the workers built for dba, before closing it. No
+ * job using dba must be queued or running
+ */
+{
+	int i;
+
+	for (i=0; i<sched->nb_workers; i++)
+    {
+		Worker* w= &sched->workers[i];
+		PoolEngine** link;
+		PoolEngine* unused=NULL;
+
+		pthread_mutex_lock(&w->lock);
+		link= &w->engines;
+		while (*link)
+		{
+			PoolEngine* pe= *link;
+
+			if (pe->model == dba)
+			{
+				*link= pe->next;
+				pe->next= unused;
+				unused= pe;
+			}
+			else
+				link= &pe->next;
+		}
+		pthread_mutex_unlock(&w->lock);
+
+		while (unused)
+		{
+			PoolEngine* pe= unused;
+
+			unused= pe->next;
+			close_PoolEngine(pe);
+		}
+    }
+}
+
+int DLL_EXPORT workers_SchedulerMBR2(Scheduler* sched)
+/* Number of worker threads */
+{ return sched->nb_workers; }
+
+Job* DLL_EXPORT submit_JobMBR2(Scheduler* sched, Database* dba, char* pho,
+							   JobSettings* settings, AudioType sample_type,
+							   SinkFunction sink, void* sink_data)
+/*
+ * Queue the synthesis of the phonemic string pho (copied, a final flush
+ * is implied) with the database dba. NULL settings means default ones
+ */
+{
+	return queue_Job(sched, dba, pho, NULL, 0, settings, sample_type, sink, sink_data);
+}
+
+JobState DLL_EXPORT wait_JobMBR2(Job* job)
+/* Wait for the end of the job, and return its final state */
+{
+	Scheduler* sched= job->sched;
+	JobState state;
+
+	pthread_mutex_lock(&sched->lock);
+	while (job->state < JOB_DONE)
+		pthread_cond_wait(&sched->done_cond, &sched->lock);
+	state= job->state;
+	pthread_mutex_unlock(&sched->lock);
+	return state;
+}
+
+JobState DLL_EXPORT state_JobMBR2(Job* job)
+/* Current state of the job (doesn't wait) */
+{
+	JobState state;
+
+	pthread_mutex_lock(&job->sched->lock);
+	state= job->state;
+	pthread_mutex_unlock(&job->sched->lock);
+	return state;
+}
+
+void DLL_EXPORT cancel_JobMBR2(Job* job)
+/*
+ * Ask for the cancellation of the job: dropped if still in a queue,
+ * otherwise the engine is reset (reset_MBR2) before the next audio chunk
+ */
+{
+	pthread_mutex_lock(&job->sched->lock);
+	job->cancel= True;
+	pthread_mutex_unlock(&job->sched->lock);
+}
+
+long DLL_EXPORT samples_JobMBR2(Job* job)
+/* Number of samples delivered to the sink so far */
+{ return job->nb_samples; }
+
+int DLL_EXPORT error_JobMBR2(Job* job)
+/* Error code of a job in JOB_ERROR state, 0 otherwise */
+{
+	if (state_JobMBR2(job) != JOB_ERROR)
+		return 0;
+	return job->error.code;
+}
+
+int DLL_EXPORT errorStr_JobMBR2(Job* job, char *buffer_err, int nb_wanted)
+/* Error message of a job in JOB_ERROR state */
+{
+	if (state_JobMBR2(job) != JOB_ERROR)
+		return copy_error_message("", buffer_err, nb_wanted);
+	return copy_error_message(job->error.message, buffer_err, nb_wanted);
+}
+
+void DLL_EXPORT close_JobMBR2(Job* job)
+/* Release the job, cancel and wait for it if it's not finished */
+{
+	if (state_JobMBR2(job) < JOB_DONE)
+    {
+		cancel_JobMBR2(job);
+		wait_JobMBR2(job);
+    }
+	MBR_free(job->pho);
+	if (job->settings.comment)
+		MBR_free(job->settings.comment);
+	if (job->settings.flush)
+		MBR_free(job->settings.flush);
+	MBR_free(job);
+}
+
+int DLL_EXPORT synthesizeBatch_MBR2(Scheduler* sched, Database* dba,
+									BatchItem* items, int nb_items,
+									JobSettings* settings)
+/*
+ * Synthesize the items in parallel with the database dba, and wait for
+ * them. NULL sched means a scheduler started (and stopped) for this batch.
+ * Return the number of items in JOB_DONE state
+ */
+{
+	Scheduler* own_sched= NULL;
+	MemorySink* memories;
+	Job** jobs;
+	int nb_done=0;
+	int i;
+
+	if (nb_items <= 0)
+		return 0;
+
+	if (!sched)
+    {
+		own_sched= init_SchedulerMBR2(0);
+		if (!own_sched)
+			return 0;
+		sched= own_sched;
+    }
+
+	jobs= (Job**) MBR_malloc(nb_items * sizeof(Job*));
+	memories= (MemorySink*) MBR_malloc(nb_items * sizeof(MemorySink));
+
+	for (i=0; i<nb_items; i++)
+    {
+		BatchItem* item= &items[i];
+
+		item->state= JOB_QUEUED;
+		item->error_code= 0;
+		item->audio= NULL;
+		item->nb_samples= 0;
+
+		if (item->sink)
+			jobs[i]= submit_JobMBR2(sched, dba, item->pho, settings,
+									item->sample_type, item->sink, item->sink_data);
+		else
+		{
+			memories[i].item= item;
+			memories[i].capacity= 0;
+			jobs[i]= submit_JobMBR2(sched, dba, item->pho, settings,
+									item->sample_type, memory_sink, &memories[i]);
+		}
+    }
+
+	for (i=0; i<nb_items; i++)
+    {
+		BatchItem* item= &items[i];
+
+		item->state= wait_JobMBR2(jobs[i]);
+		item->error_code= error_JobMBR2(jobs[i]);
+		if (item->sink)
+			item->nb_samples= samples_JobMBR2(jobs[i]);
+
+		if (item->state == JOB_DONE)
+			nb_done++;
+		close_JobMBR2(jobs[i]);
+    }
+
+	MBR_free(memories);
+	MBR_free(jobs);
+	if (own_sched)
+		close_SchedulerMBR2(own_sched);
+
+	return nb_done;
+}
+
+void DLL_EXPORT free_BatchMBR2(BatchItem* items, int nb_items)
+/* Release the audio gathered for the items with a NULL sink */
+{
+	int i;
+
+	for (i=0; i<nb_items; i++)
+		if (items[i].audio)
+			MBR_free(items[i].audio);
+}
+
+static long deliver_Resampled(Resampler* rs, float* audio, long nb_samples, bool drain,
+							  AudioType sample_type, SinkFunction sink, void* sink_data)
+/*
+ * Resample FLOAT32 samples of a segment and deliver them in sample_type,
+ * with the tail of the previous utterance first if drain (and nothing
+ * else if audio is NULL). Return the number of samples delivered, or -1
+ * if the sink failed
+ */
+{
+	int room= max_output_Resampler(rs, (JOB_CHUNK > rs->nb_taps) ? JOB_CHUNK : rs->nb_taps);
+	float* in= (float*) MBR_malloc(JOB_CHUNK * sizeof(float));
+	float* out= (float*) MBR_malloc(room * sizeof(float));
+	int16* clipped= (int16*) MBR_malloc(room * sizeof(int16));
+	void* converted= MBR_malloc(room * sizeof(float));  /* the largest sample */
+	long done=0;
+	long total=0;
+	int nb, nb_out, k;
+
+	while (total >= 0)
+    {
+		if (drain)
+		{
+			nb_out= drain_Resampler(rs, out);
+			drain= False;
+		}
+		else if (audio && (done < nb_samples))
+		{
+			/* Back to the 16 bits scale of the engine */
+			nb= (nb_samples - done > JOB_CHUNK) ? JOB_CHUNK : (int) (nb_samples - done);
+			for (k=0; k<nb; k++)
+				in[k]= audio[done+k] * 32768.0f;
+			done+= nb;
+			nb_out= run_Resampler(rs, in, nb, out);
+		}
+		else
+			break;
+
+		if (nb_out == 0)
+			continue;
+
+		/* Same conversions as readtype_Mbrola */
+		if ((sample_type == FLOAT32) || (sample_type == LIN24))
+			move_convert_float(converted, out, nb_out, sample_type);
+		else
+		{
+			for (k=0; k<nb_out; k++)
+			{
+				if (out[k] > 32765)
+					clipped[k]= 32765;
+				else if (out[k] < -32765)
+					clipped[k]= -32765;
+				else
+					clipped[k]= (int16) out[k];
+			}
+			move_convert(converted, clipped, nb_out, sample_type);
+		}
+
+		if (sink(sink_data, converted, nb_out, sample_type) < 0)
+			total= -1;
+		else
+			total+= nb_out;
+    }
+
+	MBR_free(converted);
+	MBR_free(clipped);
+	MBR_free(out);
+	MBR_free(in);
+	return total;
+}
+
+long DLL_EXPORT synthesizeSplit_MBR2(Scheduler* sched, Database* dba, char* pho,
+									 JobSettings* settings, AudioType sample_type,
+									 SinkFunction sink, void* sink_data)
+/*
+ * Synthesize one long utterance on all the workers, see scheduler.h
+ * Return the number of samples, or a negative error code
+ */
+{
+	JobSettings defaults;
+	Database* my_dba;
+	Fifo* fifo;
+	Input* input;
+	Parser* parser;
+	Mbrola* mb;
+	Split* sp= NULL;
+	BatchItem* items;
+	MemorySink* memories;
+	Job** jobs;
+	Resampler* rs= NULL;
+	AudioType segment_type= sample_type;
+	int voice_freq;
+	long total=0;
+	long delivered;
+	int nb_segments;
+	int i;
+
+	if (!settings)
+    {
+		default_JobSettingsMBR2(&defaults);
+		settings= &defaults;
+    }
+
+	/* 
+	 * The segments are resampled in order when delivered, as the utterances
+	 * can't be cut in the resampler
+	 */
+	voice_freq= (settings->voice_freq > 0) ? settings->voice_freq : Freq(dba);
+	if ((settings->out_freq > 0) && (settings->out_freq != voice_freq))
+    {
+		rs= init_Resampler(voice_freq, settings->out_freq);
+		if (!rs)
+		{
+			fatal_message(ERROR_OUTFREQ, "Can't resample from %i to %i Hz\n",
+						  voice_freq, settings->out_freq);
+			return ERROR_OUTFREQ;
+		}
+		segment_type= FLOAT32;
+    }
+
+	/* Dry pass in the calling thread, on an engine set up as a job */
+	my_dba= copyconstructor_Database(dba);
+	if (!my_dba)
+		return lastError_MBR2();
+
+	fifo= init_Fifo(FIFO_SIZE);
+	input= init_InputFifo(fifo);
+	mb= init_Mbrola(my_dba);
+	parser= setup_Engine(mb, my_dba, input, settings);
+	if (reset_MBR2(mb))
+    {
+		write_Pho(fifo, parser, pho);
+		sp= init_Split(mb, SPLIT_SILENCE);
+    }
+
+	set_parser_Mbrola(mb, NULL);
+	parser->close_Parser(parser);
+	close_Mbrola(mb);
+	input->close_Input(input);
+	close_Fifo(fifo);
+	my_dba->close_Database(my_dba);
+
+	if (!sp)
+    {
+		if (rs)
+			close_Resampler(rs);
+		return lastError_MBR2();
+    }
+
+	/* The segments are gathered in memory by the workers */
+	nb_segments= nb_segments_Split(sp);
+	items= (BatchItem*) MBR_malloc((nb_segments+1) * sizeof(BatchItem));
+	memories= (MemorySink*) MBR_malloc((nb_segments+1) * sizeof(MemorySink));
+	jobs= (Job**) MBR_malloc((nb_segments+1) * sizeof(Job*));
+
+	for (i=0; i<nb_segments; i++)
+    {
+		items[i].audio= NULL;
+		items[i].nb_samples= 0;
+		memories[i].item= &items[i];
+		memories[i].capacity= 0;
+		jobs[i]= queue_Job(sched, dba, NULL, sp, i, settings,
+						   segment_type, memory_sink, &memories[i]);
+    }
+
+	/* Deliver in order, as soon as possible */
+	for (i=0; i<nb_segments; i++)
+    {
+		if ( (total >= 0) &&
+			 (wait_JobMBR2(jobs[i]) != JOB_DONE) )
+		{
+			fatal_message(jobs[i]->error.code, "%s", jobs[i]->error.message);
+			total= jobs[i]->error.code;
+		}
+
+		if (total >= 0)
+		{
+			if (rs)
+				delivered= deliver_Resampled(rs, (float*) items[i].audio, items[i].nb_samples,
+											 (i > 0) && segment_Split(sp, i)->after_flush,
+											 sample_type, sink, sink_data);
+			else if ( (items[i].nb_samples > 0) &&
+					  (sink(sink_data, items[i].audio, (int) items[i].nb_samples, sample_type) < 0) )
+				delivered= -1;
+			else
+				delivered= items[i].nb_samples;
+
+			if (delivered < 0)
+			{
+				fatal_message(ERROR_OUTFILE, "Audio sink failure\n");
+				total= ERROR_OUTFILE;
+			}
+			else
+				total+= delivered;
+		}
+
+		/* After an error, the remaining jobs are cancelled */
+		close_JobMBR2(jobs[i]);
+		if (items[i].audio)
+			MBR_free(items[i].audio);
+    }
+
+	/* The end of the last utterance */
+	if (rs)
+    {
+		if (total >= 0)
+		{
+			delivered= deliver_Resampled(rs, NULL, 0, True, sample_type, sink, sink_data);
+			if (delivered < 0)
+			{
+				fatal_message(ERROR_OUTFILE, "Audio sink failure\n");
+				total= ERROR_OUTFILE;
+			}
+			else
+				total+= delivered;
+		}
+		close_Resampler(rs);
+    }
+
+	MBR_free(jobs);
+	MBR_free(memories);
+	MBR_free(items);
+	close_Split(sp);
+	return total;
+}
@@ -0,0 +1,185 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  scheduler.h
+ * Purpose: worker threads running synthesis jobs on a pool of engines
+ *
+ * 19/10/26: Created. Needs THREADS
+ * 19/10/26: synthesizeBatch_MBR2 for many independent utterances
+ * 19/10/26: synthesizeSplit_MBR2 for one long utterance
+ * 19/10/26: comment and flush symbols in the JobSettings
+ * 19/10/26: out_freq in the JobSettings, audio resampled by the engines
+ * 19/10/26: forget_DatabaseMBR2 to close a database before the scheduler
+ * 19/10/26: stops the compilation of its users without THREADS
+ *
+ *   A Scheduler owns N worker threads. Each worker keeps its own pool of
+ *   engines, one per database it has been asked to use: engines are built
+ *   on copies of the shared database (see copyconstructor_DatabaseMBR2)
+ *   and are reused from one job to the next.
+ *
+ *   A Job turns a phonemic string into audio delivered to a sink function.
+ *   Jobs are dispatched round robin in the queues of the workers, an idle
+ *   worker steals the most recent job in the queue of another one.
+ */
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#ifndef THREADS
+#error "The job scheduler needs THREADS, see the THREAD SECTION of the Makefile"
+#endif
+
+#include "database.h"
+#include "mbrola.h"
+
+/* Opaque types */
+typedef struct Scheduler Scheduler;
+typedef struct Job Job;
+
+/* State of a job, JOB_DONE and beyond means finished */
+typedef enum {
+	JOB_QUEUED,     /* waiting in the queue of a worker */
+	JOB_RUNNING,    /* a worker is synthesizing it */
+	JOB_DONE,       /* audio completely delivered */
+	JOB_CANCELLED,  /* cancel_JobMBR2 was called before the end */
+	JOB_ERROR       /* synthesis or sink error, see error_JobMBR2 */
+} JobState;
+
+/*
+ * Receives the audio of a job, nb_samples of the requested type.
+ * Called from a worker thread. A negative return value aborts the job
+ */
+typedef int (*SinkFunction)(void* sink_data, void* buffer, int nb_samples, AudioType sample_type);
+
+/* Synthesis parameters of a job */
+typedef struct
+{
+	float time_ratio;     /* Ratio for the durations of the phones, 1.0 is default */
+	float freq_ratio;     /* Ratio for the pitch of the phones, 1.0 is default */
+	float volume_ratio;   /* Overall volume, 1.0 is default */
+	int voice_freq;       /* Output frequency, 0 means database frequency */
+	int out_freq;         /* Sample rate, 0 means voice_freq (no resampling) */
+	bool smoothing;       /* Spectral smoothing (True is default) */
+	bool no_error;        /* Tolerance to missing diphones (False is default) */
+	char* comment;        /* Comment symbol of the input, NULL means ";" */
+	char* flush;          /* Flush symbol of the input, NULL means "#" */
+} JobSettings;
+
+void DLL_EXPORT default_JobSettingsMBR2(JobSettings* settings);
+/* Fill the structure with the default values */
+
+Scheduler* DLL_EXPORT init_SchedulerMBR2(int nb_workers);
+/*
+ * Start nb_workers threads (0 or less means one per processor when it
+ * can be found). NULL in case of error
+ */
+
+void DLL_EXPORT close_SchedulerMBR2(Scheduler* sched);
+/*
+ * Wait for the submitted jobs, stop the threads, and release the engines.
+ * Jobs must still be released with close_JobMBR2. Databases given to
+ * submit_JobMBR2 must be closed AFTER the scheduler
+ */
+
+void DLL_EXPORT forget_DatabaseMBR2(Scheduler* sched, Database* dba);
+/*
+ * Release the engines the workers built for dba, before closing it. No
+ * job using dba must be queued or running
+ */
+
+int DLL_EXPORT workers_SchedulerMBR2(Scheduler* sched);
+/* Number of worker threads */
+
+void DLL_EXPORT wait_SchedulerMBR2(Scheduler* sched);
+/* Wait until all the submitted jobs are finished */
+
+Job* DLL_EXPORT submit_JobMBR2(Scheduler* sched, Database* dba, char* pho,
+							   JobSettings* settings, AudioType sample_type,
+							   SinkFunction sink, void* sink_data);
+/*
+ * Queue the synthesis of the phonemic string pho (copied, a final flush
+ * is implied) with the database dba (from init_DatabaseMBR2, shared
+ * among the workers). NULL settings means default ones, the strings of
+ * the settings are copied too
+ */
+
+JobState DLL_EXPORT wait_JobMBR2(Job* job);
+/* Wait for the end of the job, and return its final state */
+
+JobState DLL_EXPORT state_JobMBR2(Job* job);
+/* Current state of the job (doesn't wait) */
+
+void DLL_EXPORT cancel_JobMBR2(Job* job);
+/*
+ * Ask for the cancellation of the job: dropped if still in a queue,
+ * otherwise the engine is reset (reset_MBR2) before the next audio chunk
+ */
+
+long DLL_EXPORT samples_JobMBR2(Job* job);
+/* Number of samples delivered to the sink so far */
+
+int DLL_EXPORT error_JobMBR2(Job* job);
+/* Error code of a job in JOB_ERROR state, 0 otherwise */
+
+int DLL_EXPORT errorStr_JobMBR2(Job* job, char *buffer_err, int nb_wanted);
+/* Error message of a job in JOB_ERROR state */
+
+void DLL_EXPORT close_JobMBR2(Job* job);
+/* Release the job, cancel and wait for it if it's not finished */
+
+/* One utterance of a batch */
+typedef struct
+{
+	/* Given by the caller */
+	char* pho;              /* Phonemic input (a final flush is implied) */
+	AudioType sample_type;  /* Type of the output samples */
+	SinkFunction sink;      /* Audio output, NULL means gathered in audio */
+	void* sink_data;
+
+	/* Filled by synthesizeBatch_MBR2 */
+	JobState state;         /* JOB_DONE or JOB_ERROR */
+	long nb_samples;        /* Samples produced */
+	int error_code;         /* Error code of a JOB_ERROR item */
+	void* audio;            /* Samples of a NULL sink, see free_BatchMBR2 */
+} BatchItem;
+
+int DLL_EXPORT synthesizeBatch_MBR2(Scheduler* sched, Database* dba,
+									BatchItem* items, int nb_items,
+									JobSettings* settings);
+/*
+ * Synthesize the items in parallel with the database dba, and wait for
+ * them. The engines of the workers are reused from one item to the next.
+ * NULL sched means a scheduler started (and stopped) for this batch.
+ * Return the number of items in JOB_DONE state
+ */
+
+void DLL_EXPORT free_BatchMBR2(BatchItem* items, int nb_items);
+/* Release the audio gathered for the items with a NULL sink */
+
+long DLL_EXPORT synthesizeSplit_MBR2(Scheduler* sched, Database* dba, char* pho,
+									 JobSettings* settings, AudioType sample_type,
+									 SinkFunction sink, void* sink_data);
+/*
+ * Synthesize one long utterance on all the workers: pho is cut at its
+ * flushes and in its long silences, the parts are synthesized in parallel
+ * and delivered in order to the sink, from the calling thread (which also
+ * resamples them for out_freq). The audio is the same as with submit_JobMBR2.
+ * Return the number of samples, or a negative error code
+ */
+
+#endif
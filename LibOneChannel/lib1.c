@@ -27,6 +27,9 @@
  *    lib
  *
  * 27/03/99: Romdatabases
+ *
+ * 19/10/26: ROM images mapped in place (.rom files, shared memory)
+ * 19/10/26: Resampler of the output
  */
 
 #undef MULTI_CHANNEL
@@ -55,6 +58,8 @@
 #include "../Engine/diphone.c"
 #include "../Misc/g711.c"
 #include "../Misc/audio.c"
+#include "../Engine/resample.c"
+#include "../Engine/kernels.c"
 #include "../Engine/mbrola.c"
 #include "../Database/diphone_info.c"
 #include "../Database/database_old.c"
@@ -81,3 +86,7 @@
 #include "../Database/rom_database.c"
 #include "../Database/rom_handling.c"
 #endif
+
+#ifdef ROMDATABASE_IMAGE
+#include "../Database/rom_image.c"
+#endif
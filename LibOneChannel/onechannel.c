@@ -55,6 +55,22 @@
  *                    and correct a bug with init/reset_MBR
  * 
  * 20/10/98: 3.01f -> flush_MBR corrected for renaming.
+ *
+ * 19/10/26: the input fifo grows on demand, write_MBR accepts strings 
+ *           of any size
+ *           Error messages are truncated to the user buffer size
+ *
+ * 19/10/26: Handle based API (_MBRH functions): the objects of a channel
+ *           are gathered in OneChannel, so that a process can run many
+ *           voices at the same time on different threads. The original
+ *           _MBR API works on a single global channel
+ *
+ * 19/10/26: push_MBR, the audio is pushed to a user function diphone by 
+ *           diphone instead of being read
+ *
+ * 19/10/26: setOutFreq_MBR, output resampled at any sample rate
+ *
+ * 19/10/26: getMetrics_MBR, activity counters of the engine and database
  */
 
 #include "common.h"
@@ -80,42 +96,48 @@ void close_InputFifo(Input* in)
 #endif
 
 /* 
- * Globals:  main objects of the channel one 
+ * A synthesis channel gathers all the objects needed to go from a phoneme
+ * string to audio. Channels are independent: many of them can work at the
+ * same time on different threads
  */
-Fifo* my_fifo;     /* the char fifo for the input stream */
-Input* my_input;   /* the fifo input stream for the parser */
-Parser* my_parse;  /* the parser   */
+struct OneChannel
+{
+	Fifo* fifo;     /* the char fifo for the input stream */
+	Input* input;   /* the fifo input stream for the parser */
+	Parser* parse;  /* the parser   */
 
-Database* my_dba;  /* the database */
-Mbrola* my_brole;  /* the engine   */
+	Database* dba;  /* the database */
+	Mbrola* brole;  /* the engine   */
+};
 
+/* 
+ * Global: the channel of the original API (one voice per process)
+ */
+static OneChannel* my_channel=NULL;
 
-int DLL_EXPORT init_rename_MBR(char *dbaname,char* rename_string,char* clone_string)
+OneChannel* DLL_EXPORT init_rename_MBRH(char *dbaname,char* rename_string,char* clone_string)
 /* 
- * Reads the diphone database
+ * Reads the diphone database, and creates a synthesis channel
  * Rename and clone the list parsed from the parameter strings
  *
- * 0 if ok, error code otherwise
+ * NULL in case of error (see lastError_MBR)
  */
 {
+	OneChannel* ch;
 	float my_pitch;
 	float freq_ratio=1.0;
 	float time_ratio=1.0;
 	char* comment_symbol=";";
 	ZStringList* rename_list=NULL;     /* phoneme renaming */
 	ZStringList* clone_list=NULL;      /* phoneme cloning */
-
-#ifdef DEBUG
-	/* Log file for the DLL */
-	freopen("mbrola.log","wt",stderr);
-#endif
+	Database* dba;
 
 	if (rename_string)
     {
 		rename_list= init_ZStringList();
 		parse_ZStringList(rename_list, rename_string, False);
 		if (!rename_list)
-			return lastError_MBR();
+			return NULL;
     }
   
 	if (clone_string)
@@ -123,55 +145,58 @@ int DLL_EXPORT init_rename_MBR(char *dbaname,char* rename_string,char* clone_str
 		clone_list= init_ZStringList();
 		parse_ZStringList(clone_list, clone_string, True);
 		if (!clone_list)
-			return lastError_MBR();
+			return NULL;
     }
   
-	my_dba= init_rename_Database(dbaname,rename_list,clone_list);
+	dba= init_rename_Database(dbaname,rename_list,clone_list);
   
-	if (my_dba==NULL)
-		return lastError_MBR();
-
 	/* not usefull after initialization */
 	if (rename_list)
 		close_ZStringList(rename_list);
 	if (clone_list)
 		close_ZStringList(clone_list);
 
-	my_pitch= (float)Freq(my_dba) / (float)MBRPeriod(my_dba);
+	if (dba==NULL)
+		return NULL;
+
+	my_pitch= (float)Freq(dba) / (float)MBRPeriod(dba);
   
-	my_fifo= init_Fifo(FIFO_SIZE);
-	my_input= init_InputFifo(my_fifo);
-	my_parse= init_ParserInput(my_input,
-							   sil_phon(my_dba), 
-							   my_pitch, 
-							   time_ratio, freq_ratio,
-							   comment_symbol, NULL );
+	ch= (OneChannel*) MBR_malloc(sizeof(OneChannel));
+	ch->dba= dba;
+	ch->fifo= init_Fifo(FIFO_SIZE);
+	ch->input= init_InputFifo(ch->fifo);
+	ch->parse= init_ParserInput(ch->input,
+								sil_phon(dba), 
+								my_pitch, 
+								time_ratio, freq_ratio,
+								comment_symbol, NULL );
     
-	my_brole= init_Mbrola(my_dba);
-	set_parser_Mbrola(my_brole,my_parse);
-	return 0;
+	ch->brole= init_Mbrola(dba);
+	set_parser_Mbrola(ch->brole,ch->parse);
+	return ch;
 }
 
-int DLL_EXPORT init_MBR(char *dbaname)
+OneChannel* DLL_EXPORT init_MBRH(char *dbaname)
 /* 
- * Reads the diphone database
- * 0 if ok, error code otherwise
+ * Reads the diphone database, and creates a synthesis channel
+ * NULL in case of error (see lastError_MBR)
  */
 {
-	return init_rename_MBR(dbaname,NULL,NULL);
+	return init_rename_MBRH(dbaname,NULL,NULL);
 }
 
-void DLL_EXPORT close_MBR(void)
-/*	Free all the allocated memory */
+void DLL_EXPORT close_MBRH(OneChannel* ch)
+/*	Free all the allocated memory of the channel */
 {
-	close_Mbrola(my_brole);
-	my_parse->close_Parser(my_parse);   /* ... the parser   */
-	close_InputFifo(my_input);
-	close_Fifo(my_fifo);
-	my_dba->close_Database(my_dba); /* ... the database */
+	close_Mbrola(ch->brole);
+	ch->parse->close_Parser(ch->parse);   /* ... the parser   */
+	close_InputFifo(ch->input);
+	close_Fifo(ch->fifo);
+	ch->dba->close_Database(ch->dba); /* ... the database */
+	MBR_free(ch);
 }
 
-int DLL_EXPORT reset_MBR() 
+int DLL_EXPORT reset_MBRH(OneChannel* ch) 
 /* 
  * Reset the pho buffer with residual commands -> may be used as a kind of
  * "panic" flush when a sentence is interrupted
@@ -179,44 +204,49 @@ int DLL_EXPORT reset_MBR()
  * Return 0 if fail
  */
 {  
-	if (!reset_Mbrola(my_brole))
+	if (!reset_Mbrola(ch->brole))
 		return False;
   
-	my_parse->reset_Parser(my_parse);
+	ch->parse->reset_Parser(ch->parse);
 	return True;
 }
 
-int DLL_EXPORT readtype_MBR(void *buffer_out, int nb_wanted, AudioType sample_type)
+int DLL_EXPORT readtype_MBRH(OneChannel* ch, void *buffer_out, int nb_wanted, AudioType sample_type)
 /*
  * Reads nb_wanted samples in an audio buffer
  * Returns the effective number of samples read
  * or negative error code
  */
-{ return readtype_Mbrola(my_brole,buffer_out,nb_wanted,sample_type); }
-
+{ return readtype_Mbrola(ch->brole,buffer_out,nb_wanted,sample_type); }
 
-int DLL_EXPORT read_MBR(void *buffer_out, int nb_wanted)
+int DLL_EXPORT read_MBRH(OneChannel* ch, void *buffer_out, int nb_wanted)
 /*
  * Reads nb_wanted samples in an audio buffer
  * Returns the effective number of samples read or 
  * negative error code
  */
-{ return readtype_Mbrola(my_brole,buffer_out,nb_wanted,LIN16); }
+{ return readtype_Mbrola(ch->brole,buffer_out,nb_wanted,LIN16); }
 
+int DLL_EXPORT push_MBRH(OneChannel* ch, PushFunction push, void* user_data, AudioType sample_type)
+/*
+ * Synthesize the phonemes written so far, push gets each diphone as
+ * soon as it is rendered, then the flushes and the end of the input
+ * Returns the number of samples pushed or negative error code
+ */
+{ return push_Mbrola(ch->brole,push,user_data,sample_type); }
 
-int DLL_EXPORT write_MBR(char *buffer_in)
+int DLL_EXPORT write_MBRH(OneChannel* ch, char *buffer_in)
 /* Write in the handmade fifo ! */
-{ return write_Fifo(my_fifo,buffer_in) ; }
-
+{ return write_Fifo(ch->fifo,buffer_in) ; }
 
-int DLL_EXPORT flush_MBR()
+int DLL_EXPORT flush_MBRH(OneChannel* ch)
 /*
  * Write a flush command in the stream (0 means fail). Used by client 
  * applications in case the flush symbol has been renamed
  */
 {
 	/* Got to break encapsulation here :-/ */
-	PhoneBuff* pb= (PhoneBuff*) my_parse->self; /* my_parse comes from init_ParserInput */
+	PhoneBuff* pb= (PhoneBuff*) ch->parse->self; /* parse comes from init_ParserInput */
 	char* flush_symbol= flush_symbol(pb);
   
 	if (flush_symbol)
@@ -229,44 +259,210 @@ int DLL_EXPORT flush_MBR()
 		/* because of sprintf(flush_symbol,"%s%%n",flush); */
 		local[length-2]=0;
 		strcat(local,"\n");
-		code=write_MBR(local);
+		code=write_MBRH(ch,local);
 		MBR_free(local);
 		return(code);
     }
 	return(0);
 }
 
+int DLL_EXPORT getDatabaseInfo_MBRH(OneChannel* ch, char *msg,int nb_wanted,int index)
+/* Retrieve the ith info message, NULL means get the size  */ 
+{ return getDatabaseInfo(ch->dba, msg, nb_wanted, index); }
+
+void DLL_EXPORT setFreq_MBRH(OneChannel* ch, int freq)
+/* Set the freq and voice ratio (change the voice tone) */
+{ set_voicefreq_Mbrola(ch->brole,freq); }
+
+int  DLL_EXPORT getFreq_MBRH(OneChannel* ch)
+/* Return the output frequency (to update soundcard) */
+{ return VoiceFreq(ch->brole); }
+
+int DLL_EXPORT setOutFreq_MBRH(OneChannel* ch, int freq)
+/* 
+ * Sample rate of the audio, resampled from the voice frequency, 0 means
+ * no resampling. Return 0 if the ratio can't be resampled
+ */
+{
+	if ((freq < 0) || (freq > 65535))
+		return 0;
+	return set_outfreq_Mbrola(ch->brole, (uint16) freq);
+}
+
+int DLL_EXPORT getOutFreq_MBRH(OneChannel* ch)
+/* Sample rate of the audio (the voice frequency if not resampled) */
+{ return get_outfreq_Mbrola(ch->brole); }
+
+void DLL_EXPORT setNoError_MBRH(OneChannel* ch, int no_error)
+/* Tolerance to missing diphones */
+{ set_no_error_Mbrola(ch->brole, no_error); }
+
+int DLL_EXPORT getNoError_MBRH(OneChannel* ch)
+/* Tolerance to missing diphones */
+{ return get_no_error_Mbrola(ch->brole); }
+
+void DLL_EXPORT setVolumeRatio_MBRH(OneChannel* ch, float volume_ratio)
+/* Overall volume */
+{ set_volume_ratio_Mbrola(ch->brole, volume_ratio); }
+
+float DLL_EXPORT getVolumeRatio_MBRH(OneChannel* ch)
+/* Overall volume */
+{ return get_volume_ratio_Mbrola(ch->brole); }
+
+void DLL_EXPORT getMetrics_MBRH(OneChannel* ch, EngineMetrics* engine, DatabaseMetrics* dba)
+/* Activity counters of the engine and of the database, from any thread */
+{
+	if (engine)
+		get_metrics_Mbrola(ch->brole, engine);
+	if (dba)
+		get_metrics_Database(ch->dba, dba);
+}
+
+int DLL_EXPORT lastError_MBRH(OneChannel* ch)
+/* Return the code of the last error met while reading audio, 0 if none */
+{ return get_last_error_Mbrola(ch->brole); }
+
+int DLL_EXPORT lastErrorStr_MBRH(OneChannel* ch, char *buffer_err,int nb_wanted)
+/* Return the message of the last error met while reading audio */
+{ return get_last_error_str_Mbrola(ch->brole, buffer_err, nb_wanted); }
+
+void DLL_EXPORT resetError_MBRH(OneChannel* ch)
+/* Clear the error recorded by the channel */
+{ reset_last_error_Mbrola(ch->brole); }
+
+
+/* 
+ * Original API, working on the global channel
+ */
+
+int DLL_EXPORT init_rename_MBR(char *dbaname,char* rename_string,char* clone_string)
+/* 
+ * Reads the diphone database
+ * Rename and clone the list parsed from the parameter strings
+ *
+ * 0 if ok, error code otherwise
+ */
+{
+#ifdef DEBUG
+	/* Log file for the DLL */
+	freopen("mbrola.log","wt",stderr);
+#endif
+
+	my_channel= init_rename_MBRH(dbaname, rename_string, clone_string);
+	if (my_channel==NULL)
+		return lastError_MBR();
+	return 0;
+}
+
+int DLL_EXPORT init_MBR(char *dbaname)
+/* 
+ * Reads the diphone database
+ * 0 if ok, error code otherwise
+ */
+{
+	return init_rename_MBR(dbaname,NULL,NULL);
+}
+
+void DLL_EXPORT close_MBR(void)
+/*	Free all the allocated memory */
+{
+	close_MBRH(my_channel);
+	my_channel=NULL;
+}
+
+int DLL_EXPORT reset_MBR() 
+/* 
+ * Reset the pho buffer with residual commands -> may be used as a kind of
+ * "panic" flush when a sentence is interrupted
+ *
+ * Return 0 if fail
+ */
+{ return reset_MBRH(my_channel); }
+
+int DLL_EXPORT readtype_MBR(void *buffer_out, int nb_wanted, AudioType sample_type)
+/*
+ * Reads nb_wanted samples in an audio buffer
+ * Returns the effective number of samples read
+ * or negative error code
+ */
+{ return readtype_MBRH(my_channel,buffer_out,nb_wanted,sample_type); }
+
+int DLL_EXPORT push_MBR(PushFunction push, void* user_data, AudioType sample_type)
+/*
+ * Synthesize the phonemes written so far, push gets each diphone as
+ * soon as it is rendered, then the flushes and the end of the input
+ * Returns the number of samples pushed or negative error code
+ */
+{ return push_MBRH(my_channel,push,user_data,sample_type); }
+
+
+int DLL_EXPORT read_MBR(void *buffer_out, int nb_wanted)
+/*
+ * Reads nb_wanted samples in an audio buffer
+ * Returns the effective number of samples read or 
+ * negative error code
+ */
+{ return read_MBRH(my_channel,buffer_out,nb_wanted); }
+
+
+int DLL_EXPORT write_MBR(char *buffer_in)
+/* Write in the handmade fifo ! */
+{ return write_MBRH(my_channel,buffer_in) ; }
+
+
+int DLL_EXPORT flush_MBR()
+/*
+ * Write a flush command in the stream (0 means fail). Used by client 
+ * applications in case the flush symbol has been renamed
+ */
+{ return flush_MBRH(my_channel); }
+
 int DLL_EXPORT getDatabaseInfo_MBR(char *msg,int nb_wanted,int index)
 /* Retrieve the ith info message, NULL means get the size  */ 
-{ return getDatabaseInfo(diph_dba(my_brole), msg, nb_wanted, index); }
+{ return getDatabaseInfo_MBRH(my_channel, msg, nb_wanted, index); }
 
 void DLL_EXPORT setFreq_MBR(int freq)
 /* Set the freq and voice ratio (change the voice tone) */
-{ set_voicefreq_Mbrola(my_brole,freq); }
+{ setFreq_MBRH(my_channel,freq); }
 
 int  DLL_EXPORT getFreq_MBR()
 /* Return the output frequency (to update soundcard) */
-{ return VoiceFreq(my_brole); }
+{ return getFreq_MBRH(my_channel); }
+
+int DLL_EXPORT setOutFreq_MBR(int freq)
+/* 
+ * Sample rate of the audio, resampled from the voice frequency, 0 means
+ * no resampling. Return 0 if the ratio can't be resampled
+ */
+{ return setOutFreq_MBRH(my_channel, freq); }
+
+int DLL_EXPORT getOutFreq_MBR()
+/* Sample rate of the audio (the voice frequency if not resampled) */
+{ return getOutFreq_MBRH(my_channel); }
 
 void DLL_EXPORT setNoError_MBR(int no_error)
 /* Tolerance to missing diphones */
-{ set_no_error_Mbrola(my_brole, no_error); }
+{ setNoError_MBRH(my_channel, no_error); }
 
 int DLL_EXPORT getNoError_MBR()
 /* Spectral smoothing or not */
-{ return get_no_error_Mbrola(my_brole); }
+{ return getNoError_MBRH(my_channel); }
 
 void DLL_EXPORT setVolumeRatio_MBR(float volume_ratio)
 /* Overall volume */
-{ set_volume_ratio_Mbrola(my_brole, volume_ratio); }
+{ setVolumeRatio_MBRH(my_channel, volume_ratio); }
 
 float DLL_EXPORT getVolumeRatio_MBR()
 /* Overall volume */
-{ return get_volume_ratio_Mbrola(my_brole); }
+{ return getVolumeRatio_MBRH(my_channel); }
+
+void DLL_EXPORT getMetrics_MBR(EngineMetrics* engine, DatabaseMetrics* dba)
+/* Activity counters of the engine and of the database, from any thread */
+{ getMetrics_MBRH(my_channel, engine, dba); }
 
 void DLL_EXPORT setParser_MBR(Parser* parser)
 /* drop the current parser for a new one */
-{ set_parser_Mbrola(my_brole, parser); }
+{ set_parser_Mbrola(my_channel->brole, parser); }
 
 int DLL_EXPORT lastError_MBR()
 /* Return the last error code */
@@ -274,17 +470,7 @@ int DLL_EXPORT lastError_MBR()
 
 int DLL_EXPORT lastErrorStr_MBR(char *buffer_err,int nb_wanted)
 /* Return the last error message available */
-{
-	int length=strlen(errbuffer)+1;
-
-	if (length<nb_wanted) 
-		nb_wanted=length;
-  
-	memcpy(buffer_err,errbuffer,nb_wanted-1);
-	buffer_err[nb_wanted-1]=0;
-
-	return nb_wanted;
-}
+{ return copy_error_message(errbuffer, buffer_err, nb_wanted); }
 
 void DLL_EXPORT resetError_MBR()
 /* Clear the Mbrola error buffer */
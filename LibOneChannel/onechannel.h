@@ -24,6 +24,14 @@
  *
  * 10/01/97: Created -> library compilation mode 
  *           No main function but a Read/Write scheme
+ *
+ * 19/10/26: Handle based API, one OneChannel object per voice
+ *
+ * 19/10/26: push_MBR, audio pushed to a user function diphone by diphone
+ *
+ * 19/10/26: setOutFreq_MBR, output resampled at any sample rate
+ *
+ * 19/10/26: getMetrics_MBR, activity counters of the engine and database
  */
 
 #ifndef _ONECHANNEL_H
@@ -59,7 +67,7 @@ int DLL_EXPORT readtype_MBR(void *buffer_out, int nb_wanted, AudioType  sample_t
  * return the effective number of samples read
  * or the negative error code we catch
  *
- * The sample_type may be LIN16, LIN8, ULAW, ALAW
+ * The sample_type may be LIN16, LIN8, ULAW, ALAW, LIN24, FLOAT32
  */
 
 int DLL_EXPORT read_MBR(void *buffer_out, int nb_wanted);
@@ -71,11 +79,23 @@ int DLL_EXPORT read_MBR(void *buffer_out, int nb_wanted);
  * Kept for compatibility
  */
 
+int DLL_EXPORT push_MBR(PushFunction push, void* user_data, AudioType sample_type);
+/*
+ * Push mode, instead of reading: synthesize the phonemes written so far.
+ * push receives the audio of each diphone as soon as it is rendered
+ * (PUSH_AUDIO), then a PUSH_FLUSH for each flush command and PUSH_END
+ * when the input is exhausted. The audio is the same as with readtype_MBR
+ * and both can be mixed.
+ *
+ * return the number of samples pushed or the negative error code we 
+ * catch (ERROR_OUTFILE if push returned non-zero)
+ */
+
 int DLL_EXPORT write_MBR(char *buffer_in);
 /*
  * Write a string of phoneme in the input buffer
  * Return the number of chars actually written
- * 0 mean not enough space in the buffer
+ * The buffer grows on demand, 0 means out of memory
  */
 
 int  DLL_EXPORT flush_MBR();
@@ -93,6 +113,15 @@ void DLL_EXPORT setFreq_MBR(int freq);
 int  DLL_EXPORT getFreq_MBR();
 /* Return the output frequency */
 
+int DLL_EXPORT setOutFreq_MBR(int freq);
+/* 
+ * Sample rate of the audio, resampled from the voice frequency, 0 means
+ * no resampling. Return 0 if the ratio can't be resampled
+ */
+
+int DLL_EXPORT getOutFreq_MBR();
+/* Sample rate of the audio (the voice frequency if not resampled) */
+
 void DLL_EXPORT setNoError_MBR(int no_error);
 /* Tolerance to missing diphones */
 
@@ -105,6 +134,12 @@ void DLL_EXPORT setVolumeRatio_MBR(float volume_ratio);
 float DLL_EXPORT getVolumeRatio_MBR();
 /* Overall volume */
 
+void DLL_EXPORT getMetrics_MBR(EngineMetrics* engine, DatabaseMetrics* dba);
+/* 
+ * Activity counters of the engine and of the database, from any thread
+ * (see incdll.h). Either pointer can be NULL
+ */
+
 void DLL_EXPORT setParser_MBR(Parser* parser);
 /* drop the current parser for a new one */
 
@@ -120,4 +155,103 @@ void DLL_EXPORT resetError_MBR();
 int DLL_EXPORT getVersion_MBR(char *msg,int nb_wanted);
 /* Return the release number, e.g. "2.05a"  */
 
+
+/* 
+ * Handle based API: same functions as above on an explicit channel.
+ * Each channel has its own database, fifo, parser and engine, so that 
+ * channels can be used at the same time from different threads (one 
+ * channel shouldn't be used by two threads at the same time).
+ */
+typedef struct OneChannel OneChannel;
+
+OneChannel* DLL_EXPORT init_MBRH(char *dbaname);
+/* 
+ * Reads the diphone database, and creates a synthesis channel
+ * NULL in case of error (see lastError_MBR)
+ */
+
+OneChannel* DLL_EXPORT init_rename_MBRH(char *dbaname,char* rename,char* clone);
+/* 
+ * Reads the diphone database, and creates a synthesis channel
+ * Rename and clone the list parsed from the parameter strings
+ *
+ * NULL in case of error (see lastError_MBR)
+ */
+
+void DLL_EXPORT close_MBRH(OneChannel* ch);
+/*	Free all the allocated memory of the channel */
+
+int DLL_EXPORT reset_MBRH(OneChannel* ch);
+/* 
+ * Reset the pho buffer with residual commands -> may be used as a kind of
+ * "panic" flush when a sentence is interrupted
+ * 0 means fail
+ */
+
+int DLL_EXPORT readtype_MBRH(OneChannel* ch, void *buffer_out, int nb_wanted, AudioType sample_type);
+/*
+ * Read nb_wanted samples in an audio buffer
+ * return the effective number of samples read
+ * or the negative error code we catch
+ */
+
+int DLL_EXPORT read_MBRH(OneChannel* ch, void *buffer_out, int nb_wanted);
+/* Same as readtype_MBRH with LIN16 samples */
+
+int DLL_EXPORT push_MBRH(OneChannel* ch, PushFunction push, void* user_data, AudioType sample_type);
+/* Same as push_MBR on a channel */
+
+int DLL_EXPORT write_MBRH(OneChannel* ch, char *buffer_in);
+/*
+ * Write a string of phoneme in the input buffer
+ * Return the number of chars actually written
+ * The buffer grows on demand, 0 means out of memory
+ */
+
+int DLL_EXPORT flush_MBRH(OneChannel* ch);
+/* Write a flush command in the stream (0 means fail) */
+
+int DLL_EXPORT getDatabaseInfo_MBRH(OneChannel* ch, char *msg,int nb_wanted,int index);
+/* Retrieve the ith info message, NULL means get the size */ 
+
+void DLL_EXPORT setFreq_MBRH(OneChannel* ch, int freq);
+/* Set the freq and voice ratio */
+
+int DLL_EXPORT getFreq_MBRH(OneChannel* ch);
+/* Return the output frequency */
+
+int DLL_EXPORT setOutFreq_MBRH(OneChannel* ch, int freq);
+/* Sample rate of the audio, 0 means no resampling (0 means fail) */
+
+int DLL_EXPORT getOutFreq_MBRH(OneChannel* ch);
+/* Sample rate of the audio */
+
+void DLL_EXPORT setNoError_MBRH(OneChannel* ch, int no_error);
+/* Tolerance to missing diphones */
+
+int DLL_EXPORT getNoError_MBRH(OneChannel* ch);
+/* Tolerance to missing diphones */
+
+void DLL_EXPORT setVolumeRatio_MBRH(OneChannel* ch, float volume_ratio);
+/* Overall volume */
+
+float DLL_EXPORT getVolumeRatio_MBRH(OneChannel* ch);
+/* Overall volume */
+
+void DLL_EXPORT getMetrics_MBRH(OneChannel* ch, EngineMetrics* engine, DatabaseMetrics* dba);
+/* Activity counters of the engine and of the database, from any thread */
+
+int DLL_EXPORT lastError_MBRH(OneChannel* ch);
+/* 
+ * Return the code of the last error met while reading audio, 0 if none
+ * Errors of write_MBRH and init_MBRH are given by lastError_MBR in the
+ * calling thread
+ */
+
+int DLL_EXPORT lastErrorStr_MBRH(OneChannel* ch, char *buffer_err,int nb_wanted);
+/* Return the message of the last error met while reading audio */
+
+void DLL_EXPORT resetError_MBRH(OneChannel* ch);
+/* Clear the error recorded by the channel */
+
 #endif
@@ -27,6 +27,17 @@
  * 
  * 17/06/98 : linear16to8 corrected (gave alaw result )
  *
+ * 19/10/26 : swap_format and put_header don't touch audio_swapped, so that
+ *            several threads can write different audio files
+ * 19/10/26 : headers built in memory by make_header, stream headers with
+ *            an unknown length. Audio sinks (file, pipe, memory, callback)
+ *            rewriting the header at the end only when they can
+ * 19/10/26 : table driven mulaw/alaw conversion, SSE2 linear8 conversion
+ * 19/10/26 : float32 and linear24 samples, in the library buffers and
+ *            in the audio sinks (wav, au, aif for 24 bits, raw)
+ * 19/10/26 : the sample rate of aif headers is the real one, not 16000
+ * 19/10/26 : write_header, put_header, write_int16s and audio_swapped
+ *            removed, the audio sinks write all the files
  */
 
 #include "common.h"
@@ -34,8 +45,59 @@
 #include "little_big.h"
 #include "g711.h"
 
-/* True if the format of the current output needs byte swapping */
-bool audio_swapped;
+#if defined(LIBRARY) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Largest linear 24 bits sample */
+#define LIN24_MAX 8388607
+
+static int32 float2lin24(float sample)
+/* Sample on the 16 bits scale to linear 24 bits, clipped */
+{
+	float value= sample * 256.0f;
+
+	if (value >= (float) LIN24_MAX)
+		return LIN24_MAX;
+	if (value <= (float) -LIN24_MAX)
+		return -LIN24_MAX;
+	return (int32) value;
+}
+
+int size_AudioType(AudioType sample_type)
+/* Size of a sample in bytes */
+{
+	switch(sample_type)
+    {
+    case LIN16:
+		return sizeof(int16);
+    case LIN24:
+		return 3;
+    case FLOAT32:
+		return sizeof(float);
+    default:
+		return 1;
+    }
+}
+
+bool header_AudioType(WaveType file_format, AudioType sample_type)
+/* 
+ * True if the file format can hold the sample type: LIN16 anywhere, 
+ * LIN24 in all formats, FLOAT32 in raw, wav and au files
+ */
+{
+	switch(sample_type)
+    {
+    case LIN16:
+    case LIN24:
+		return True;
+    case FLOAT32:
+		return (file_format==RAW_FORMAT) || (file_format==WAV_FORMAT)
+			|| (file_format==AU_FORMAT);
+    default:
+		return False;
+    }
+}
 
 #ifdef LIBRARY
 
@@ -55,30 +117,92 @@ int8 linear2lin8(int16 lin)
 int8* conv_LIN8fromLIN16( int8 *out, int16 *in, int nb_move)
 /* linear 16bits to linear8 */
 {
-	int i;
-	for(i=0; i<nb_move; i++)
+	int i=0;
+#ifdef __SSE2__
+	/* 16 samples at a time: high byte, then offset by 128 (sign bit flip) */
+	__m128i offset= _mm_set1_epi8((char) 0x80);
+
+	for(; i+16<=nb_move; i+=16)
+    {
+		__m128i low= _mm_loadu_si128((__m128i*) &in[i]);
+		__m128i high= _mm_loadu_si128((__m128i*) &in[i+8]);
+
+		low= _mm_srai_epi16(low, 8);
+		high= _mm_srai_epi16(high, 8);
+		_mm_storeu_si128((__m128i*) &out[i],
+						 _mm_xor_si128(_mm_packs_epi16(low, high), offset));
+    }
+#endif
+	for(; i<nb_move; i++)
 		out[i]= linear2lin8(in[i]);
 	return( &out[i]);
 }
 
 int8* conv_ULAWfromLIN16( int8 *out,	int16 *in, int nb_move)
-/* linear 16bits to mulaw */
+/* linear 16bits to mulaw (table driven) */
+{
+	linear2ulaw_buffer((unsigned char*) out, in, nb_move);
+	return( &out[nb_move] );
+}
+
+/* linear 16bits to alaw */
+int8* conv_ALAWfromLIN16( int8 *out, int16 *in, int nb_move)
+{
+	linear2alaw_buffer((unsigned char*) out, in, nb_move);
+	return( &out[nb_move] );
+}
+
+static int8* put_lin24(int8 *out, int32 value)
+/* One linear 24bits sample on 3 bytes, native byte order */
+{
+#ifdef BIG_ENDIAN
+	out[0]= (int8) ((value >> 16) & 0xFF);
+	out[1]= (int8) ((value >> 8) & 0xFF);
+	out[2]= (int8) (value & 0xFF);
+#else
+	out[0]= (int8) (value & 0xFF);
+	out[1]= (int8) ((value >> 8) & 0xFF);
+	out[2]= (int8) ((value >> 16) & 0xFF);
+#endif
+	return out+3;
+}
+
+int8* conv_LIN24fromLIN16( int8 *out, int16 *in, int nb_move)
+/* linear 16bits to linear24 */
 {
 	int i;
 	for(i=0; i<nb_move; i++)
-		out[i]= linear2ulaw(in[i]);
+		out= put_lin24(out, ((int32) in[i]) * 256);
+	return( out );
+}
+
+float* conv_FLOAT32fromLIN16( float *out, int16 *in, int nb_move)
+/* linear 16bits to float32 */
+{
+	int i;
+	for(i=0; i<nb_move; i++)
+		out[i]= (float) in[i] * (1.0f/32768.0f);
 	return( &out[i] );
 }
 
-/* linear 16bits to alaw */
-int8* conv_ALAWfromLIN16( int8 *out, int16 *in, int nb_move)
+float* conv_FLOAT32fromFLOAT( float *out, float *in, int nb_move)
+/* OLA samples to float32, full scale 1.0 */
 {
 	int i;
 	for(i=0; i<nb_move; i++)
-		out[i]= linear2alaw(in[i]);
+		out[i]= in[i] * (1.0f/32768.0f);
 	return( &out[i] );
 }
 
+int8* conv_LIN24fromFLOAT( int8 *out, float *in, int nb_move)
+/* OLA samples to linear24, 8 more bits than linear16 */
+{
+	int i;
+	for(i=0; i<nb_move; i++)
+		out= put_lin24(out, float2lin24(in[i]));
+	return( out );
+}
+
 void* zero_convert(void* buffer_out, int nb_move, AudioType sample_type)
 /*
  * Output zeros in a buffer according to the sample_type
@@ -98,6 +222,15 @@ void* zero_convert(void* buffer_out, int nb_move, AudioType sample_type)
 			((int16*)buffer_out)[i]=0;
 		
 		return ( &(((int16*)buffer_out)[i]) );
+
+    case FLOAT32 :
+		for(i=0 ; i<nb_move; i++) 
+			((float*)buffer_out)[i]=0.0f;
+		return ( &(((float*)buffer_out)[i]) );
+
+    case LIN24 :
+		memset(buffer_out, 0, 3*nb_move);
+		return ( &(((int8*)buffer_out)[3*nb_move]) );
 		
 		/* Convert the type */
     case LIN8 :
@@ -134,6 +267,7 @@ void* move_convert(void* buffer_out,int16* buffer_in,int nb_move, AudioType samp
  * linear 16bits to linear8 
  * linear 16bits to mulaw 
  * linear 16bits to alaw 
+ * linear 16bits to float32 and linear24
  *
  * Returning NULL means fatal error
  */
@@ -159,114 +293,524 @@ void* move_convert(void* buffer_out,int16* buffer_in,int nb_move, AudioType samp
 		return( (void*) conv_ALAWfromLIN16( (int8 *)buffer_out,
 											buffer_in,
 											nb_move));
+    case FLOAT32 :
+		return( (void*) conv_FLOAT32fromLIN16( (float *)buffer_out,
+											   buffer_in,
+											   nb_move));
+    case LIN24 :
+		return( (void*) conv_LIN24fromLIN16( (int8 *)buffer_out,
+											 buffer_in,
+											 nb_move));
     default:
 		fatal_message(WARNING_UPGRADE,"Unknown sample type");
 		return NULL; /* to please the compiler */
     }
 }
 
+void* move_convert_float(void* buffer_out,float* buffer_in,int nb_move, AudioType sample_type)
+/* 
+ * Same as move_convert from the float OLA samples (16 bits scale), for 
+ * FLOAT32 (not clipped) and LIN24 
+ *
+ * Returning NULL means fatal error
+ */
+{
+	switch(sample_type)
+    {
+    case FLOAT32 :
+		return( (void*) conv_FLOAT32fromFLOAT( (float *)buffer_out,
+											   buffer_in,
+											   nb_move));
+    case LIN24 :
+		return( (void*) conv_LIN24fromFLOAT( (int8 *)buffer_out,
+											 buffer_in,
+											 nb_move));
+    default:
+		fatal_message(WARNING_UPGRADE,"Unknown float sample type");
+		return NULL;
+    }
+}
+
 #endif
 
-int write_int16s(int16 *buffer,int count,FILE *file)
-/* Write a buffer of int16 */
+bool swap_format(WaveType file_format)
+/* True if the samples of this file format must be byte swapped */
 {
-	if (audio_swapped)
-		swab( (char *) buffer, (char *) buffer, count*2);
-  
-	return(fwrite(buffer, sizeof(int16), count, file));
+	switch(file_format)
+    {
+    case WAV_FORMAT: 
+#ifdef BIG_ENDIAN
+		return True;
+#else
+		return False;
+#endif
+
+    case AIF_FORMAT:
+    case AIFF_FORMAT:
+    case AU_FORMAT:
+#ifdef BIG_ENDIAN
+		return False;
+#else
+		return True;
+#endif
+
+    default: 
+		return False; /* Raw is the format of the machine= no swap */
+    }
 }
 
-void write_header(WaveType file_format, int32 audio_length, uint16 samp_rate, FILE *output_file)
-/* Write the header corresponding to the output audio format */
+static char* put_l32(char* pt, unsigned int value)
+/* Little endian 32 bits in a header buffer */
 {
+	pt[0]= (char) (value & 0xFF);
+	pt[1]= (char) ((value >> 8) & 0xFF);
+	pt[2]= (char) ((value >> 16) & 0xFF);
+	pt[3]= (char) ((value >> 24) & 0xFF);
+	return pt+4;
+}
+
+static char* put_l16(char* pt, uint16 value)
+/* Little endian 16 bits in a header buffer */
+{
+	pt[0]= (char) (value & 0xFF);
+	pt[1]= (char) ((value >> 8) & 0xFF);
+	return pt+2;
+}
+
+static char* put_b32(char* pt, unsigned int value)
+/* Big endian 32 bits in a header buffer */
+{
+	pt[0]= (char) ((value >> 24) & 0xFF);
+	pt[1]= (char) ((value >> 16) & 0xFF);
+	pt[2]= (char) ((value >> 8) & 0xFF);
+	pt[3]= (char) (value & 0xFF);
+	return pt+4;
+}
+
+static char* put_b16(char* pt, uint16 value)
+/* Big endian 16 bits in a header buffer */
+{
+	pt[0]= (char) ((value >> 8) & 0xFF);
+	pt[1]= (char) (value & 0xFF);
+	return pt+2;
+}
+
+static char* put_extended(char* pt, uint16 value)
+/* 
+ * Integer as the big endian 80 bits IEEE extended float of aif headers:
+ * 15 bits biased exponent, and a 64 bits mantissa with an explicit 1
+ */
+{
+	unsigned int mantissa= value;
+	int exponent= 16383+31;
+
+	if (value==0)
+		exponent= 0;
+	else
+		/* Shift the leading 1 to the top bit of the mantissa */
+		while (!(mantissa & 0x80000000))
+		{
+			mantissa<<= 1;
+			exponent--;
+		}
+
+	pt= put_b16(pt, (uint16) exponent);
+	pt= put_b32(pt, mantissa);
+	return put_b32(pt, 0);
+}
+
+static char* put_tag(char* pt, const char* tag)
+/* Four characters in a header buffer */
+{
+	memcpy(pt, tag, 4);
+	return pt+4;
+}
+
+int make_header(WaveType file_format, AudioType sample_type, int32 audio_length, uint16 samp_rate, char *header)
+/* 
+ * Write the header of the audio format in a buffer of AUDIO_MAX_HEADER
+ * bytes, return its size (the same whatever the length)
+ */
+{
+	char* pt= header;
+	bool unknown= (audio_length == AUDIO_UNKNOWN_LENGTH);
+	int size= size_AudioType(sample_type);
+
 	switch(file_format)
     {
-		/* 
-		 * RAW= Write nothing ! 
-		 */
-    case RAW_FORMAT: 
-		audio_swapped=False; /* Raw is the format of the machine= no swap */
-		return;	  
-		
 		/* 
 		 * Write a WAV file for PCs 
 		 */
     case WAV_FORMAT: 
-#ifdef BIG_ENDIAN
-		audio_swapped=True;
-#else
-		audio_swapped=False;
-#endif
-		fputs("RIFF", output_file);
-		writel_int32(audio_length*sizeof(int16)+44-8, output_file);	/* total len */
-		fputs("WAVE", output_file);
-		fputs("fmt ", output_file);
-		writel_int32(16, output_file);		  /* fmt chunk size */
-		writel_int16(1, output_file);	        /* FormatTag: WAVE_FORMAT_PCM */
-		writel_int16(1, output_file);         /*  channels"\001\000"        */
-		writel_int32(samp_rate, output_file); /* SamplesPerSec             */
-		writel_int32(samp_rate*2, output_file); /*  Average Bytes/sec        */
-		writel_int16(2, output_file);         /*  BlockAlign "\002\000"    */
-		writel_int16(16, output_file);	     /* BitsPerSample  "\020\000" */ 
-		fputs("data", output_file);
-		writel_int32(audio_length*sizeof(int16),output_file);  /* data chunk size */
-		return;
+		pt= put_tag(pt, "RIFF");
+		if (unknown)
+			pt= put_l32(pt, 0xFFFFFFFF);	  /* streamed: read up to the end */
+		else
+			pt= put_l32(pt, audio_length*size+44-8);	/* total len */
+		pt= put_tag(pt, "WAVE");
+		pt= put_tag(pt, "fmt ");
+		pt= put_l32(pt, 16);		      /* fmt chunk size */
+		if (sample_type==FLOAT32)
+			pt= put_l16(pt, 3);	          /* FormatTag: WAVE_FORMAT_IEEE_FLOAT */
+		else
+			pt= put_l16(pt, 1);	          /* FormatTag: WAVE_FORMAT_PCM */
+		pt= put_l16(pt, 1);             /*  channels"\001\000"        */
+		pt= put_l32(pt, samp_rate);     /* SamplesPerSec             */
+		pt= put_l32(pt, samp_rate*size);   /*  Average Bytes/sec        */
+		pt= put_l16(pt, size);          /*  BlockAlign "\002\000"    */
+		pt= put_l16(pt, 8*size);	     /* BitsPerSample  "\020\000" */ 
+		pt= put_tag(pt, "data");
+		if (unknown)
+			pt= put_l32(pt, 0xFFFFFFFF);
+		else
+			pt= put_l32(pt, audio_length*size);  /* data chunk size */
+		break;
 
 		/* 
-		 * Write an AIF file for SGIs
+		 * Write an AIF file for SGIs, no convention for streams: the
+		 * largest sizes
 		 */
     case AIF_FORMAT:
     case AIFF_FORMAT:
-#ifdef BIG_ENDIAN
-		audio_swapped=False;
-#else
-		audio_swapped=True;
-#endif
-		fputs ("FORM",output_file);  /* MAGIC of AIF files */
-		writeb_int32 (audio_length*sizeof(int16)+54-8, output_file); /* Form size */
-		fputs ("AIFF",output_file);  /* Form type */
-
-		fputs ("COMM",output_file);  /* Common chunk */
-		writeb_int32 (18, output_file); /* Chunk size */
-		writeb_int16(0x1,output_file);	  /* Number of channels */
-		writeb_int32 (audio_length, output_file);	/* Num of samples */
-		writeb_int16 (16, output_file); /* Sample size */
-
-		/* Write FS=16000 Hertz  */
-		writeb_int32 (0x400cfa00 , output_file);	/* Sample rate= extended 80bits */
-		writeb_int32 (0x00000000 , output_file); /* Sample rate= extended 80bits */
-		writeb_int16 (0x0000 , output_file);  /* Sample rate= extended 80bits */
-
-		fputs ("SSND",output_file);  /* Sound chunk */
-		writeb_int32(audio_length*sizeof(int16)+8, output_file); /* Chunk size */
-		writeb_int32(0x0 , output_file); /* Offset */
-		writeb_int32(0x0 , output_file); /* Block size */
-		return;
+		if (unknown)
+			audio_length= AUDIO_MAX_BYTES / size;
+		pt= put_tag(pt, "FORM");  /* MAGIC of AIF files */
+		pt= put_b32(pt, audio_length*size+54-8); /* Form size */
+		pt= put_tag(pt, "AIFF");  /* Form type */
+
+		pt= put_tag(pt, "COMM");  /* Common chunk */
+		pt= put_b32(pt, 18);      /* Chunk size */
+		pt= put_b16(pt, 0x1);	    /* Number of channels */
+		pt= put_b32(pt, audio_length);	/* Num of samples */
+		pt= put_b16(pt, 8*size);  /* Sample size */
+		pt= put_extended(pt, samp_rate); /* Sample rate= extended 80bits */
+
+		pt= put_tag(pt, "SSND");  /* Sound chunk */
+		pt= put_b32(pt, audio_length*size+8); /* Chunk size */
+		pt= put_b32(pt, 0x0);     /* Offset */
+		pt= put_b32(pt, 0x0);     /* Block size */
+		break;
 
 		/* 
 		 * Write a AU file for SUNs and NEXTs
 		 */
     case AU_FORMAT:
-#ifdef BIG_ENDIAN
-		audio_swapped=False;
-#else
-		audio_swapped=True;
-#endif
-		fputs(".snd", output_file);                  /* MAGIC of AU files */
-		writeb_int32( 7*sizeof(int32), output_file); /* Header size */
-		if (audio_length==0)		 
-			writeb_int32( ((unsigned)(~0)), output_file); /* AUDIO_UNKNOWN_SIZE */
+		pt= put_tag(pt, ".snd");              /* MAGIC of AU files */
+		pt= put_b32(pt, 7*sizeof(int32));    /* Header size */
+		if ((audio_length==0) || unknown)		 
+			pt= put_b32(pt, 0xFFFFFFFF);       /* AUDIO_UNKNOWN_SIZE */
 		else
-			writeb_int32(audio_length*sizeof(int16), output_file); 
-		writeb_int32( 3 , output_file);     /*  16-bit linear PCM */
-		writeb_int32( samp_rate, output_file);	/* sample rate */
-		writeb_int32( 1 , output_file);	   /* channels */
-		fputs("MBRP", output_file);         /* optional text information */
-		return;
+			pt= put_b32(pt, audio_length*size); 
+		if (sample_type==FLOAT32)
+			pt= put_b32(pt, 6);        /*  32-bit IEEE float */
+		else if (sample_type==LIN24)
+			pt= put_b32(pt, 4);        /*  24-bit linear PCM */
+		else
+			pt= put_b32(pt, 3);        /*  16-bit linear PCM */
+		pt= put_b32(pt, samp_rate);	 /* sample rate */
+		pt= put_b32(pt, 1);	         /* channels */
+		pt= put_tag(pt, "MBRP");     /* optional text information */
+		break;
 
+		/* 
+		 * RAW= Write nothing ! 
+		 */
     default: 
+		break;
+    }
+	return (int) (pt - header);
+}
+
+/*
+ * Audio sinks
+ */
+
+static AudioSink* init_AudioSink(SinkType type, WaveType file_format, AudioType sample_type, uint16 samp_rate)
+/* Common part of the constructors, NULL if the format can't hold the type */
+{
+	AudioSink* sink;
+
+	if ( ((sample_type!=LIN16) && (sample_type!=LIN24) && (sample_type!=FLOAT32))
+		 || !header_AudioType(file_format, sample_type))
+		return NULL;
+
+	sink= (AudioSink*) MBR_malloc(sizeof(AudioSink));
+	sink->type= type;
+	sink->file_format= file_format;
+	sink->sample_type= sample_type;
+	sink->samp_rate= samp_rate;
+	sink->swapped= swap_format(file_format);
+	sink->audio_length= 0;
+	sink->failed= False;
+	sink->file= NULL;
+	sink->seekable= False;
+	sink->header_pos= 0;
+	sink->memory= NULL;
+	sink->size= 0;
+	sink->capacity= 0;
+	sink->write= NULL;
+	sink->user_data= NULL;
+	return sink;
+}
+
+static void write_bytes_AudioSink(AudioSink* sink, void* buffer, int nb_bytes)
+/* Send bytes to the output of the sink, a short write is a failure */
+{
+	int written=0;
+
+	if (nb_bytes==0)
 		return;
+
+	switch(sink->type)
+    {
+    case FILE_SINK:
+		written= fwrite(buffer, 1, nb_bytes, sink->file);
+		break;
+
+    case MEMORY_SINK:
+		if (sink->size + nb_bytes > sink->capacity)
+		{
+			sink->capacity= 2*sink->capacity + nb_bytes;
+			sink->memory= (char*) MBR_realloc(sink->memory, sink->capacity);
+		}
+		memcpy(sink->memory + sink->size, buffer, nb_bytes);
+		sink->size+= nb_bytes;
+		written= nb_bytes;
+		break;
+
+    case CALLBACK_SINK:
+		written= sink->write(sink->user_data, buffer, nb_bytes);
+		break;
     }
+
+	if (written!=nb_bytes)
+		sink->failed= True;
+}
+
+static void start_AudioSink(AudioSink* sink)
+/* The header of a stream, the length comes with end_AudioSink */
+{
+	char header[AUDIO_MAX_HEADER];
+	int size= make_header(sink->file_format, sink->sample_type, AUDIO_UNKNOWN_LENGTH, sink->samp_rate, header);
+
+	write_bytes_AudioSink(sink, header, size);
+}
+
+AudioSink* init_FileAudioSink(FILE* file, WaveType file_format, AudioType sample_type, uint16 samp_rate)
+/* 
+ * Audio file written at the current position of file. The header is
+ * rewritten at the end only if file is seekable (not a pipe)
+ */
+{
+	AudioSink* sink= init_AudioSink(FILE_SINK, file_format, sample_type, samp_rate);
+
+	if (!sink)
+		return NULL;
+	sink->file= file;
+	sink->header_pos= ftell(file);
+	sink->seekable= (sink->header_pos >= 0)
+		&& (fseek(file, sink->header_pos, SEEK_SET) == 0);
+	start_AudioSink(sink);
+	return sink;
+}
+
+AudioSink* init_MemoryAudioSink(WaveType file_format, AudioType sample_type, uint16 samp_rate)
+/* Audio file built in memory, see sink_memory and sink_size */
+{
+	AudioSink* sink= init_AudioSink(MEMORY_SINK, file_format, sample_type, samp_rate);
+
+	if (!sink)
+		return NULL;
+	sink->seekable= True;
+	start_AudioSink(sink);
+	return sink;
+}
+
+AudioSink* init_CallbackAudioSink(AudioWriteFunction write, void* user_data,
+								  WaveType file_format, AudioType sample_type, uint16 samp_rate)
+/* Audio file sent to write, header included, as it is produced */
+{
+	AudioSink* sink= init_AudioSink(CALLBACK_SINK, file_format, sample_type, samp_rate);
+
+	if (!sink)
+		return NULL;
+	sink->write= write;
+	sink->user_data= user_data;
+	start_AudioSink(sink);
+	return sink;
+}
+
+/* Samples encoded at once by write_float_AudioSink */
+#define SINK_CHUNK 512
+
+static void encode_sample(AudioSink* sink, char* out, float sample)
+/* One sample on the 16 bits scale in the sample type and byte order of the sink */
+{
+	char bytes[4];
+	int size= size_AudioType(sink->sample_type);
+	int i;
+
+	switch(sink->sample_type)
+    {
+    case LIN24:
+		{
+			int32 value= float2lin24(sample);
+#ifdef BIG_ENDIAN
+			bytes[0]= (char) ((value >> 16) & 0xFF);
+			bytes[1]= (char) ((value >> 8) & 0xFF);
+			bytes[2]= (char) (value & 0xFF);
+#else
+			bytes[0]= (char) (value & 0xFF);
+			bytes[1]= (char) ((value >> 8) & 0xFF);
+			bytes[2]= (char) ((value >> 16) & 0xFF);
+#endif
+		}
+		break;
+
+    case FLOAT32:
+		{
+			float value= sample / 32768.0f;
+			memcpy(bytes, &value, sizeof(float));
+		}
+		break;
+
+    default:
+		{
+			int16 value;
+			if (sample >= 32767.0f)
+				value= 32767;
+			else if (sample <= -32767.0f)
+				value= -32767;
+			else
+				value= (int16) sample;
+			memcpy(bytes, &value, sizeof(int16));
+		}
+		break;
+    }
+
+	/* bytes holds the native order, the file may want the other one */
+	for (i=0; i<size; i++)
+		out[i]= sink->swapped ? bytes[size-1-i] : bytes[i];
+}
+
+int write_float_AudioSink(AudioSink* sink, float *buffer, int count)
+/* 
+ * Write count samples on the 16 bits scale (clipped to the sample type
+ * unless FLOAT32), return the number of samples written
+ */
+{
+	char chunk[SINK_CHUNK * 4];
+	int size= size_AudioType(sink->sample_type);
+	int done, i;
+
+	for (done=0; (done<count) && !sink->failed; done+=SINK_CHUNK)
+	{
+		int nb= count - done;
+
+		if (nb > SINK_CHUNK)
+			nb= SINK_CHUNK;
+		for (i=0; i<nb; i++)
+			encode_sample(sink, &chunk[i*size], buffer[done+i]);
+		write_bytes_AudioSink(sink, chunk, nb*size);
+	}
+
+	if (sink->failed)
+		return 0;
+	sink->audio_length+= count;
+	return count;
+}
+
+int write_AudioSink(AudioSink* sink, int16 *buffer, int count)
+/* 
+ * Write count samples (byte swapped in place if needed for LIN16 sinks), 
+ * return the number of samples written
+ */
+{
+	if (sink->failed)
+		return 0;
+
+	if (sink->sample_type!=LIN16)
+	{
+		float chunk[SINK_CHUNK];
+		int done, i;
+
+		for (done=0; done<count; done+=SINK_CHUNK)
+		{
+			int nb= count - done;
+
+			if (nb > SINK_CHUNK)
+				nb= SINK_CHUNK;
+			for (i=0; i<nb; i++)
+				chunk[i]= (float) buffer[done+i];
+			if (write_float_AudioSink(sink, chunk, nb) != nb)
+				return 0;
+		}
+		return count;
+	}
+
+	if (sink->swapped)
+		swab( (char *) buffer, (char *) buffer, count*2);
+	write_bytes_AudioSink(sink, buffer, count*sizeof(int16));
+
+	if (sink->failed)
+		return 0;
+	sink->audio_length+= count;
+	return count;
+}
+
+bool flush_AudioSink(AudioSink* sink)
+/* Push the buffered samples to the reader, False means error */
+{
+	if ((sink->type==FILE_SINK) && (fflush(sink->file)!=0))
+		sink->failed= True;
+	return !sink->failed;
+}
+
+bool end_AudioSink(AudioSink* sink)
+/* 
+ * No more samples: rewrite the header with the real length if possible.
+ * Returning False means that a write failed
+ */
+{
+	char header[AUDIO_MAX_HEADER];
+	int32 length= sink->audio_length;
+	int size;
+	long end;
+
+	if (length > AUDIO_MAX_BYTES / size_AudioType(sink->sample_type))
+		length= AUDIO_UNKNOWN_LENGTH;
+	size= make_header(sink->file_format, sink->sample_type, length, sink->samp_rate, header);
+
+	switch(sink->type)
+    {
+    case FILE_SINK:
+		if (!flush_AudioSink(sink) || !sink->seekable || (size==0))
+			break;
+		end= ftell(sink->file);
+		if ( (end < 0)
+			 || (fseek(sink->file, sink->header_pos, SEEK_SET) != 0)
+			 || (fwrite(header, 1, size, sink->file) != (size_t) size)
+			 || (fseek(sink->file, end, SEEK_SET) != 0)
+			 || (fflush(sink->file) != 0) )
+			sink->failed= True;
+		break;
+
+    case MEMORY_SINK:
+		memcpy(sink->memory, header, size);
+		break;
+
+    case CALLBACK_SINK:
+		break;
+    }
+	return !sink->failed;
+}
+
+void close_AudioSink(AudioSink* sink)
+/* Release the sink and its memory, a file stays open */
+{
+	if (sink->memory)
+		MBR_free(sink->memory);
+	MBR_free(sink);
 }
 
 void LowerCase(char *string,char *lower_case)
@@ -39,11 +39,124 @@ typedef enum {
   AIFF_FORMAT 
 } WaveType;
 
-int write_int16s(int16 *buffer,int count,FILE *file);
-/* Write a buffer of int16 */
+bool swap_format(WaveType file_format);
+/* True if the samples of this file format must be byte swapped */
 
-void write_header(WaveType file_format, int32 audio_length, uint16 samp_rate, FILE *output_file);
-/* Write the header corresponding to the output audio format */
+/*
+ * audio_length of a header written before the end of the audio: the
+ * length fields get the conventions of the format for streams (AU: the
+ * unknown size, WAV: 0xFFFFFFFF, AIFF: the largest sizes)
+ */
+#define AUDIO_UNKNOWN_LENGTH (-1)
+
+/* Size of the largest header */
+#define AUDIO_MAX_HEADER 54
+
+/* Largest audio size a header can give, longer audio keeps a stream header */
+#define AUDIO_MAX_BYTES ((int32) (0x7FFFFFFF - AUDIO_MAX_HEADER))
+
+int size_AudioType(AudioType sample_type);
+/* Size of a sample in bytes */
+
+bool header_AudioType(WaveType file_format, AudioType sample_type);
+/* 
+ * True if the file format can hold the sample type: LIN16 anywhere, 
+ * LIN24 in all formats, FLOAT32 in raw, wav and au files
+ */
+
+int make_header(WaveType file_format, AudioType sample_type, int32 audio_length, uint16 samp_rate, char *header);
+/* 
+ * Write the header of the audio format in a buffer of AUDIO_MAX_HEADER
+ * bytes, return its size (the same whatever the length)
+ */
+
+/*
+ * Audio sinks: where the samples of an audio file go, with its header.
+ * The header is written first with an unknown length, so that the audio
+ * streams through pipes and callbacks, and rewritten with the real length
+ * at the end when the sink allows it (seekable files and memory)
+ */
+
+typedef int (*AudioWriteFunction)(void* user_data, void* buffer, int nb_bytes);
+/* Output of a callback sink, return the number of bytes written */
+
+typedef enum {
+	FILE_SINK,       /* FILE* : regular file, pipe, stdout... */
+	MEMORY_SINK,     /* Growing buffer */
+	CALLBACK_SINK    /* User function */
+} SinkType;
+
+typedef struct
+{
+	SinkType type;
+	WaveType file_format;
+	AudioType sample_type;  /* LIN16, LIN24 or FLOAT32 */
+	uint16 samp_rate;
+	bool swapped;           /* True if the samples are byte swapped */
+	int32 audio_length;     /* Number of samples written */
+	bool failed;            /* True after a failed write */
+
+	FILE* file;             /* FILE_SINK, not closed with the sink */
+	bool seekable;          /* True if the header can be rewritten */
+	long header_pos;        /* Position of the header in file */
+
+	char* memory;           /* MEMORY_SINK: header then samples */
+	long size;              /* Bytes in memory */
+	long capacity;          /* Allocated bytes */
+
+	AudioWriteFunction write;  /* CALLBACK_SINK */
+	void* user_data;
+} AudioSink;
+
+/* Convenience macros */
+#define sink_audio_length(pt) (pt->audio_length)
+#define sink_failed(pt) (pt->failed)
+#define sink_seekable(pt) (pt->seekable)
+#define sink_memory(pt) (pt->memory)
+#define sink_size(pt) (pt->size)
+#define sink_sample_type(pt) (pt->sample_type)
+
+/*
+ * The constructors return NULL if the file format can't hold the sample
+ * type (see header_AudioType)
+ */
+
+AudioSink* init_FileAudioSink(FILE* file, WaveType file_format, AudioType sample_type, uint16 samp_rate);
+/* 
+ * Audio file written at the current position of file. The header is
+ * rewritten at the end only if file is seekable (not a pipe)
+ */
+
+AudioSink* init_MemoryAudioSink(WaveType file_format, AudioType sample_type, uint16 samp_rate);
+/* Audio file built in memory, see sink_memory and sink_size */
+
+AudioSink* init_CallbackAudioSink(AudioWriteFunction write, void* user_data,
+								  WaveType file_format, AudioType sample_type, uint16 samp_rate);
+/* Audio file sent to write, header included, as it is produced */
+
+int write_AudioSink(AudioSink* sink, int16 *buffer, int count);
+/* 
+ * Write count samples (byte swapped in place if needed for LIN16 sinks), 
+ * return the number of samples written
+ */
+
+int write_float_AudioSink(AudioSink* sink, float *buffer, int count);
+/* 
+ * Write count samples on the 16 bits scale (clipped to the sample type
+ * unless FLOAT32), return the number of samples written
+ */
+
+bool flush_AudioSink(AudioSink* sink);
+/* Push the buffered samples to the reader, False means error */
+
+bool end_AudioSink(AudioSink* sink);
+/* 
+ * No more samples: rewrite the header with the real length if possible.
+ * Returning False means that a write failed
+ */
+
+void close_AudioSink(AudioSink* sink);
+/* Release the sink and its memory, a file stays open */
 
 WaveType find_file_format(char *name);
 /* Find the file format corresponding to the name's extension  
@@ -72,6 +185,15 @@ void* move_convert(void* buffer_out,int16* buffer_in,int nb_move, AudioType samp
  * linear 16bits to linear8 
  * linear 16bits to mulaw 
  * linear 16bits to alaw 
+ * linear 16bits to float32 and linear24
+ *
+ * Returning NULL means fatal error
+ */
+
+void* move_convert_float(void* buffer_out,float* buffer_in,int nb_move, AudioType sample_type);
+/* 
+ * Same as move_convert from the float OLA samples (16 bits scale), for 
+ * FLOAT32 (not clipped) and LIN24 
  *
  * Returning NULL means fatal error
  */
@@ -187,4 +187,31 @@ typedef char* PhonemeName;
 typedef uint16 PhonemeCode;
 #define MAX_PHONEME_NUMBER 65000
 
+/*
+ * Counters read by monitoring threads (incdll.h): relaxed atomic loads
+ * and stores where the compiler has them, no barrier nor lock.
+ * inc_Counter is for a counter with a single writer (an engine),
+ * add_Counter for one shared by threads (a database and its copies):
+ * an atomic add of the compiler or of Win32 (a Counter is 32 bits
+ * there), plain arithmetic only without THREADS
+ */
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+#define read_Counter(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#define inc_Counter(counter, nb) __atomic_store_n(&(counter), (counter) + (nb), __ATOMIC_RELAXED)
+#define add_Counter(counter, nb) ((void) __atomic_fetch_add(&(counter), (nb), __ATOMIC_RELAXED))
+#else
+#define read_Counter(counter) (*(volatile Counter*) &(counter))
+#define inc_Counter(counter, nb) ((counter)+= (nb))
+#if !defined(THREADS)
+#define add_Counter(counter, nb) ((counter)+= (nb))
+#elif defined(__GNUC__)
+#define add_Counter(counter, nb) ((void) __sync_fetch_and_add(&(counter), (nb)))
+#elif defined(_MSC_VER)
+# include "windows.h"
+#define add_Counter(counter, nb) ((void) InterlockedExchangeAdd((volatile LONG*) &(counter), (LONG) (nb)))
+#else
+# error "THREADS needs an atomic add for the shared counters (add_Counter)"
+#endif
+#endif
+
 #endif
@@ -264,3 +264,67 @@ unsigned char ulaw2alaw(unsigned char	uval)
 	return (uint8) ((uval & 0x80) ? (0xD5 ^ (_u2a[0xFF ^ uval] - 1)) :
 					(0x55 ^ (_u2a[0x7F ^ uval] - 1)));
 }
+
+/*
+ * Table driven conversion of buffers (MBROLA, 19/10/26)
+ *
+ * Both laws only depend on the sign and on the 13 top bits of the 
+ * magnitude: the 2 low bits are below the smallest quantization step 
+ * (the u-law bias 0x84 and the A-law offset 8 are multiples of 4). So a 
+ * 16K entries table indexed by sign|magnitude>>2 gives the same codes as 
+ * the segment search. -32768 is clipped to -32767, both saturate.
+ */
+#define	LAW_TABLE_SIZE	(1 << 14)
+#define	LAW_SIGN	(1 << 13)
+
+static unsigned char ulaw_table[LAW_TABLE_SIZE];
+static unsigned char alaw_table[LAW_TABLE_SIZE];
+
+static void init_law_tables(void)
+/* A representative sample of each entry goes through the reference code */
+{
+	int i;
+
+	for (i = 0; i < LAW_SIGN; i++) {
+		ulaw_table[i] = linear2ulaw(i << 2);
+		alaw_table[i] = linear2alaw(i << 2);
+		ulaw_table[LAW_SIGN | i] = linear2ulaw(-((i << 2) + 1));
+		alaw_table[LAW_SIGN | i] = linear2alaw(-((i << 2) + 1));
+	}
+}
+
+#ifdef THREADS
+#include <pthread.h>
+static pthread_once_t law_tables_once = PTHREAD_ONCE_INIT;
+#define	check_law_tables()	pthread_once(&law_tables_once, init_law_tables)
+#else
+static int law_tables_ready = 0;
+#define	check_law_tables()	if (!law_tables_ready) { init_law_tables(); law_tables_ready = 1; }
+#endif
+
+/* Table index of a 16-bit linear sample, without branch */
+#define	law_index(pcm, sign, mag) \
+	( sign = (pcm) >> 15, \
+	  mag = ((pcm) ^ sign) - sign, \
+	  mag -= mag >> 15, \
+	  (sign & LAW_SIGN) | (mag >> 2) )
+
+void linear2ulaw_buffer(unsigned char *out, short *in, int nb_samples)
+{
+	int	i;
+	int	sign, mag;
+
+	check_law_tables();
+	for (i = 0; i < nb_samples; i++)
+		out[i] = ulaw_table[law_index((int) in[i], sign, mag)];
+}
+
+void linear2alaw_buffer(unsigned char *out, short *in, int nb_samples)
+{
+	int	i;
+	int	sign, mag;
+
+	check_law_tables();
+	for (i = 0; i < nb_samples; i++)
+		out[i] = alaw_table[law_index((int) in[i], sign, mag)];
+}
@@ -33,3 +33,15 @@ unsigned char linear2alaw(int pcm_val);
  * linear2ulaw() - Convert a 16-bit linear PCM to an Mu-law value
  */
 unsigned char linear2ulaw(int	pcm_val);
+
+/*
+ * linear2ulaw_buffer() - Convert nb_samples 16-bit linear PCM to Mu-law,
+ * same codes as linear2ulaw through a table
+ */
+void linear2ulaw_buffer(unsigned char *out, short *in, int nb_samples);
+
+/*
+ * linear2alaw_buffer() - Convert nb_samples 16-bit linear PCM to A-law,
+ * same codes as linear2alaw through a table
+ */
+void linear2alaw_buffer(unsigned char *out, short *in, int nb_samples);
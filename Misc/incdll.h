@@ -33,7 +33,71 @@ typedef enum {
 	LIN16=0,     /* same as intern computation format: 16 bits linear  */
 	LIN8,        /* unsigned linear 8 bits, worse than telephone        */
 	ULAW,        /* MU law -> 8bits, telephone. Roughly equ. to 12bits */
-	ALAW         /* A law  -> 8bits, equivallent to mulaw              */
+	ALAW,        /* A law  -> 8bits, equivallent to mulaw              */
+	FLOAT32,     /* 32 bits float, full scale is 1.0, never clipped    */
+	LIN24        /* linear 24 bits on 3 bytes, native byte order       */
 } AudioType;
 
+/* 
+ * What the engine gives to a push function (push_MBR)
+ */
+typedef enum {
+	PUSH_AUDIO=0,  /* nb_samples of audio in buffer: a rendered diphone     */
+	PUSH_FLUSH,    /* Flush command in the input, the utterance is complete */
+	PUSH_END       /* End of the input available so far                     */
+} PushEvent;
+
+typedef int (*PushFunction)(void* user_data, PushEvent event, void* buffer, int nb_samples, AudioType sample_type);
+/* 
+ * Receive the output of the engine, buffer is only valid during the call
+ * (NULL and 0 samples for PUSH_FLUSH and PUSH_END). Return 0 to go on, 
+ * anything else stops the synthesis
+ */
+
+/*
+ * Stages of the synthesis, timed in each engine when compiled with
+ * PROFILE (getStageStats_MBR2)
+ */
+typedef enum {
+	STAGE_PARSE=0, /* Phonemic input: nextphone_Parser, FillCommandBuffer   */
+	STAGE_FETCH,   /* Diphones read from the database: getdiphone_Database */
+	STAGE_PROSODY, /* Frames selected for the duration and pitch          */
+	STAGE_CONCAT,  /* Smoothing bounds at the concatenation points        */
+	STAGE_OLA,     /* Overlap and add of the frames, output excluded       */
+	STAGE_OUTPUT,  /* Clipping, resampling and conversion of the samples  */
+	NB_STAGES
+} Stage;
+
+typedef struct
+{
+	double seconds[NB_STAGES];  /* Time spent in each stage */
+	long calls[NB_STAGES];      /* Number of times each stage was run */
+} StageStats;
+
+/*
+ * Activity counters of an engine and of a database (getMetrics_MBR2,
+ * getDatabaseMetrics_MBR2). They only grow, and wrap around: a monitor
+ * reads them from any thread without locking, and computes rates from
+ * the difference of two readings
+ */
+typedef unsigned long Counter;
+
+typedef struct
+{
+	Counter diphones;       /* Diphones rendered */
+	Counter frames;         /* Frames overlapped and added */
+	Counter samples;        /* Samples emitted, at the output rate */
+	Counter substitutions;  /* Unknown diphones replaced with _-_ (no_error) */
+	Counter saturations;    /* Diphones with clipped samples */
+	Counter smoothed;       /* Frames smoothed at a diphone junction */
+} EngineMetrics;
+
+typedef struct
+{
+	Counter fetches;        /* Diphones loaded, by all the engines using the database */
+	Counter missing;        /* Diphones asked that the database doesn't have */
+	Counter memory_hits;    /* Diphones served from memory (ROM database or image) */
+	Counter bytes_read;     /* Samples read from the disk, in bytes */
+} DatabaseMetrics;
+
 #endif
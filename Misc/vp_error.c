@@ -33,14 +33,36 @@
  *           debug_message... consequence the call is still here in the
  *           generated code in non debug mode. This I do not wish -> MACROs 
  *           with size dependent names :-(
+ *
+ * 19/10/26: Bounded formatting of messages, thread local error state
+ *           with THREADS, and ErrorState copies
  */
 
 #include "common.h"
 #include "vp_error.h"
 
 /* buffer cumulating error messages when in lib or dll mode */
-char errbuffer[300];	
-int lasterr_code;				  /* Code of the last error */
+THREAD_LOCAL char errbuffer[ERRBUFFER_SIZE];	
+THREAD_LOCAL int lasterr_code;				  /* Code of the last error */
+
+#ifdef LIBRARY
+static void format_error(const char *format, va_list ap)
+/*
+ * Print the message in errbuffer, truncated if too long
+ */
+{
+#if defined(_MSC_VER)
+	_vsnprintf(errbuffer, ERRBUFFER_SIZE-1, format, ap);
+	errbuffer[ERRBUFFER_SIZE-1]=0;
+#elif defined(THREADS) || (defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L))
+	/* THREADS compilation requests POSIX or C99 for vsnprintf */
+	vsnprintf(errbuffer, ERRBUFFER_SIZE, format, ap);
+#else
+	/* Plain ANSI C has no bounded vsprintf */
+	vsprintf(errbuffer, format, ap);
+#endif
+}
+#endif
 
 void fatal_message(const int code, const char *format, /* args */ ...)
 /*
@@ -54,7 +76,7 @@ void fatal_message(const int code, const char *format, /* args */ ...)
 	lasterr_code=code;
   
 #ifdef LIBRARY
-	vsprintf(errbuffer, format, ap);
+	format_error(format, ap);
 	va_end(ap);
 #else
 	vfprintf(stderr, format, ap);
@@ -75,7 +97,7 @@ void warning_message(const int code, const char *format, /* args */ ...)
 	lasterr_code=code;
   
 #ifdef LIBRARY
-	vsprintf(errbuffer, format, ap);
+	format_error(format, ap);
 	va_end(ap);
 #else
 	vfprintf(stderr, format, ap);
@@ -83,6 +105,40 @@ void warning_message(const int code, const char *format, /* args */ ...)
 #endif 
 }
 
+void catch_ErrorState(ErrorState* err)
+/* Copy the error state of the calling thread */
+{
+	err->code= lasterr_code;
+	copy_error_message(errbuffer, err->message, ERRBUFFER_SIZE);
+}
+
+void reset_ErrorState(ErrorState* err)
+/* Forget the error */
+{
+	err->code=0;
+	err->message[0]=0;
+}
+
+int copy_error_message(const char* message, char *buffer_err, int nb_wanted)
+/* 
+ * Copy an error message in a user buffer of nb_wanted chars (truncate
+ * if needed). Return the number of chars copied, including the final 0
+ */
+{
+	int length=strlen(message)+1;
+  
+	if (nb_wanted<=0)
+		return 0;
+
+	if (length<nb_wanted) 
+		nb_wanted=length;
+  
+	memcpy(buffer_err,message,nb_wanted-1);
+	buffer_err[nb_wanted-1]=0;
+  
+	return nb_wanted;
+}
+
 #ifdef DEBUG
 
 void debug_message(char const *format, /* args */ ...)
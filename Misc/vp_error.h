@@ -33,6 +33,12 @@
  *           debug_message... consequence the call is still here in the
  *           generated code in non debug mode. This I do not wish -> MACROs 
  *           with size dependent names !
+ *
+ * 19/10/26: With THREADS the error state is local to each thread, and the
+ *           messages are truncated to the size of errbuffer. ErrorState 
+ *           keeps a copy of an error for a given object (e.g. an engine)
+ *
+ * 19/10/26: ERROR_OUTFREQ for the output frequencies the resampler refuses
  */
 
 #ifndef _VP_ERROR_H
@@ -51,6 +57,7 @@
 #define ERROR_OUTFILE              -5
 #define ERROR_RENAMING             -6
 #define ERROR_NEXTDIPHONE          -7
+#define ERROR_OUTFREQ              -8
  
 #define ERROR_PRGWRONGVERSION		-10
  
@@ -80,9 +87,45 @@
 #define WARNING_UPGRADE -80
 #define WARNING_SATURATION -81
 
+/* Size of the error message buffer */
+#define ERRBUFFER_SIZE 300
+
+/* 
+ * Thread local storage class: each thread get its own error state,
+ * so that engines running on different threads don't mix their errors
+ */
+#ifdef THREADS
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+#else
+#define THREAD_LOCAL
+#endif
+
 /* buffer cumulating error messages when in lib or dll mode */
-extern char errbuffer[]; 
-extern int lasterr_code;			  /* Code of the last error */
+extern THREAD_LOCAL char errbuffer[]; 
+extern THREAD_LOCAL int lasterr_code;			  /* Code of the last error */
+
+/* A copy of the error state, kept by objects that outlive a thread call */
+typedef struct
+{
+	int code;                     /* Code of the last error, 0 if none */
+	char message[ERRBUFFER_SIZE]; /* Corresponding message */
+} ErrorState;
+
+void catch_ErrorState(ErrorState* err);
+/* Copy the error state of the calling thread */
+
+void reset_ErrorState(ErrorState* err);
+/* Forget the error */
+
+int copy_error_message(const char* message, char *buffer_err, int nb_wanted);
+/* 
+ * Copy an error message in a user buffer of nb_wanted chars (truncate
+ * if needed). Return the number of chars copied, including the final 0
+ */
 
 void fatal_message(const int code, const char *format, /* args */ ...);
 /*
@@ -22,72 +22,124 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  *
  * 18/06/98 : Created
+ *
+ * 19/10/26 : Growable contiguous buffer. write_Fifo doesn't fail any more
+ *   on large strings, readline_Fifo looks for the line end with memchr and
+ *   copies the line with a single memcpy
+ *
+ * 19/10/26 : the size of the buffer is bounded by INT_MAX, write_Fifo
+ *   fails beyond
+ *
+ * 19/10/26 : empty_Fifo
  */
 
+#include <limits.h>
+
 #include "fifo.h"
 #include "common.h"
 
 int readline_Fifo(Fifo* ff, char *line, int size)
 /* 
- * Read a line from the circular input buffer
+ * Read a line from the input buffer
  * Return 0 if there's nothing to read
  */
 {
-	int i=0;
-	char last=0;
-  
-	while ( (i<size-1) && 
-			(last!=LINE_FEED) &&
-			(buffer_pos(ff)!=buffer_end(ff)))
+	int i= buffer_end(ff) - buffer_pos(ff);
+	char* start= charbuff(ff) + buffer_pos(ff);
+	char* last;
+
+	if (i > size-1)
+		i= size-1;
+
+	if (i > 0)
 	{
-		last=line[i]=charbuff(ff)[buffer_pos(ff)];
-		buffer_pos(ff)++;
-		i++;
-		
-		/* Circular buffer */
-		if (buffer_pos(ff)==buffer_size(ff))
-			buffer_pos(ff)=0;
+		/* Stop right after the line feed, if any */
+		last= (char*) memchr(start, LINE_FEED, i);
+		if (last)
+			i= (int) (last - start) + 1;
+
+		memcpy(line, start, i);
+		buffer_pos(ff)+= i;
 	}
+	else
+		i=0;
+
+	/* Empty: next write may start from the beginning of the buffer */
+	if (empty_Fifo(ff))
+		reset_Fifo(ff);
+
 	line[i]=0;
 	return(i);
 }
 
+int empty_Fifo(Fifo* ff)
+/*
+ * Non zero if there's nothing left to read
+ */
+{
+	return(buffer_pos(ff)==buffer_end(ff));
+}
+
 int write_Fifo(Fifo* ff, char *buffer_in)
 /*
- * Write a string of phoneme in the input buffer
- * Return the number of chars actually written
+ * Write a string of phoneme in the input buffer, the buffer grows if needed
+ * Return the number of chars actually written (0 if out of memory, or if
+ * the pending chars would pass INT_MAX)
  */
 {
-	int i=0;
-	int available=buffer_pos(ff)-buffer_end(ff);
-  
-	if (available<=0)
-		available+= buffer_size(ff);
-  
-	/* Fail to write */
-	if ( (int) strlen(buffer_in) >= available)
+	size_t string_length= strlen(buffer_in);
+	int used= buffer_end(ff) - buffer_pos(ff);
+	int length;
+
+	if (string_length > (size_t) (INT_MAX - used))
+	{
+		fatal_message(ERROR_MEMORYOUT,"Fifo: string too long\n");
 		return(0);
+	}
+	length= (int) string_length;
   
-	while (buffer_in[i]!=0)
+	if (length > buffer_size(ff) - buffer_end(ff))
 	{
-		/* Check overflow */
-		if (buffer_end(ff)==buffer_pos(ff)-1)
-			return(i);
-		
-		charbuff(ff)[buffer_end(ff)]=buffer_in[i];
-		i++;
-		buffer_end(ff)++;
+		/* Move pending data to the front of the buffer */
+		if (buffer_pos(ff) > 0)
+		{
+			memmove(charbuff(ff), charbuff(ff) + buffer_pos(ff), used);
+			buffer_pos(ff)= 0;
+			buffer_end(ff)= used;
+		}
 		
-		/* Circular buffer */
-		if (buffer_end(ff)==buffer_size(ff))
-			buffer_end(ff)=0;
+		/* Still not enough room -> grow at least twice the size */
+		if (used + length > buffer_size(ff))
+		{
+			int new_size;
+			char* new_buff;
+			
+			if (buffer_size(ff) > INT_MAX/2)
+				new_size= INT_MAX;
+			else
+				new_size= 2*buffer_size(ff);
+			if (new_size < used + length)
+				new_size= used + length;
+			
+			new_buff= (char*) MBR_realloc(charbuff(ff), new_size);
+			if (new_buff==NULL)
+			{
+				fatal_message(ERROR_MEMORYOUT,"Fifo: out of memory\n");
+				return(0);
+			}
+			charbuff(ff)= new_buff;
+			buffer_size(ff)= new_size;
+		}
 	}
-	return(i);
+  
+	memcpy(charbuff(ff) + buffer_end(ff), buffer_in, length);
+	buffer_end(ff)+= length;
+	return(length);
 }
 
 void reset_Fifo(Fifo* ff)
 /*
- * Forget previously entered data in the circular buffer
+ * Forget previously entered data in the buffer
  */
 {
 	buffer_pos(ff)=0;
@@ -105,10 +157,13 @@ void close_Fifo(Fifo* ff)
 
 Fifo* init_Fifo(int size)
 /*
- * Constructor with size of the buffer
+ * Constructor with the initial size of the buffer
  */
 {
 	Fifo* self=(Fifo*) MBR_malloc( sizeof(Fifo) );
+
+	if (size<1)
+		size=1;
 	charbuff(self)= (char*) MBR_malloc(size);
 	buffer_size(self)=size;
 	reset_Fifo(self);
@@ -22,22 +22,29 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  *
  * 18/06/98 : Created
+ *
+ * 19/10/26 : The fifo grows on demand instead of rejecting large writes.
+ *   Data is kept in one contiguous span (moved to the front of the buffer
+ *   when a write doesn't fit after it, and reset once read to the end) so
+ *   that lines are found with memchr and moved with memcpy
+ *
+ * 19/10/26 : empty_Fifo, for the readers that wait for the end of the input
  */
 
 #ifndef FIFO_H
 #define FIFO_H
 
-/* Size of the standard phonetic input buffer */
+/* Initial size of the standard phonetic input buffer (grows on demand) */
 #define FIFO_SIZE 8192
 
 #define LINE_FEED 0x0a
 
 typedef struct 
 {
-	char* charbuff;		 /* circular buffer for phonetic input */
+	char* charbuff;		 /* buffer for phonetic input */
 	int buffer_pos;			 /* Current position */
 	int buffer_end;			 /* Last available phoneme */
-	int buffer_size;		 /* number of chars in Phobuffer */
+	int buffer_size;		 /* number of chars allocated in charbuff */
 } Fifo;
 
 #define charbuff(ff) ff->charbuff
@@ -47,19 +54,25 @@ typedef struct
 
 int readline_Fifo(Fifo* ff, char *line, int size);
 /* 
- * Read a line from the input stream in a circular buffer
+ * Read a line from the input buffer (at most size-1 chars)
  * Return 0 if there's nothing to read
  */
 
+int empty_Fifo(Fifo* ff);
+/*
+ * Non zero if there's nothing left to read
+ */
+
 int write_Fifo(Fifo* ff, char *buffer_in);
 /*
- * Write a string of phoneme in the input buffer
- * Return the number of chars actually written
+ * Write a string of phoneme in the input buffer, the buffer grows if needed
+ * Return the number of chars actually written (0 if out of memory, or if
+ * the pending chars would pass INT_MAX)
  */
 
 void reset_Fifo(Fifo* ff);
 /*
- * Forget previously entered data in the circular buffer
+ * Forget previously entered data in the buffer
  */
 
 void  close_Fifo(Fifo* ff); 
@@ -69,7 +82,7 @@ void  close_Fifo(Fifo* ff);
 
 Fifo* init_Fifo(int size);
 /*
- * Constructor with size of the buffer
+ * Constructor with the initial size of the buffer
  */
 
 #endif
@@ -21,6 +21,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  *
  * 22/06/98 : Created
+ * 19/10/26 : readline_InputFifo returns a long, as readline_InputFunction
  */
 
 
@@ -32,7 +33,7 @@
    directly call with self for all functions, except Close
 */
 
-static int readline_InputFifo(Input* in, char *line, int size)
+static long readline_InputFifo(Input* in, char *line, int size)
 {
 	return( readline_Fifo((Fifo*) in->self,line,size) );
 }
@@ -32,6 +32,8 @@
  *
  * 15/09/98 : appendf0_Phone now enlarge the pitch point table if it's
  *    too small (no more "fatal_error").
+ *
+ * 19/10/26 : copy_Phone
  */
 
 #include "phone.h"
@@ -61,6 +63,17 @@ Phone* DLL_EXPORT init_Phone(char* name, float length)
  */
 { return initSized_Phone(name,length,2);  }
 
+Phone* copy_Phone(Phone* ph)
+/* Deep copy of a phoneme and its pitch points */
+{
+	Phone* self= initSized_Phone(name_Phone(ph), length_Phone(ph), pp_available(ph));
+
+	NPitchPatternPoints(self)= NPitchPatternPoints(ph);
+	memcpy(PitchPattern(self), PitchPattern(ph),
+		   sizeof(PitchPatternPoint) * pp_available(ph));
+	return(self);
+}
+
 void DLL_EXPORT reset_Phone(Phone *ph)
 /* Reset the pitch pattern list of a phoneme */
 {
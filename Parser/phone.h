@@ -80,6 +80,9 @@ Phone* DLL_EXPORT init_Phone(char* name, float length);
  * 2 pitch points is the default (one at 0 one at 100)
  */
 
+Phone* copy_Phone(Phone* ph);
+/* Deep copy of a phoneme and its pitch points */
+
 void DLL_EXPORT reset_Phone(Phone *ph);
 /* Reset the pitch pattern list of a phoneme */
 
@@ -0,0 +1,508 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  client.c
+ * Purpose: mbrola-client, load generator for mbrola-server
+ *
+ * 19/10/26: Created
+ * 19/10/26: LIN24 and FLOAT32 samples
+ * 19/10/26: -r sample rate of the audio
+ *
+ *   Opens N connections to the server, each one sending the same phonemic
+ *   file R times in a row, and reports the latency of the first audio
+ *   chunk, the duration of the requests and the overall throughput.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define DEFAULT_SOCKET "/tmp/mbrola.sock"
+#define LINE_SIZE 1024
+
+/* Timing of one request, in ms */
+typedef struct
+{
+	double first_audio;   /* Up to the first audio chunk */
+	double total;         /* Up to the end of the answer */
+} Timing;
+
+/* Parameters shared by the connections */
+static char* socket_path= DEFAULT_SOCKET;
+static int nb_connections=1;
+static int nb_requests=1;
+static char* commands=NULL;      /* Sent once at the beginning, may be NULL */
+static char* request=NULL;       /* PHO command with its input */
+static int sample_size=2;
+static FILE* output=NULL;        /* Audio of the first request */
+
+/* Results */
+static Timing* timings;          /* nb_connections*nb_requests */
+static double* audio_seconds;    /* Per connection */
+static int* nb_errors;           /* Per connection */
+
+/* Client side of a connection */
+typedef struct
+{
+	int id;
+	int fd;
+	char buffer[4096];
+	int pos;
+	int end;
+} Client;
+
+static double now()
+/* Monotonic clock in ms */
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000.0 + ts.tv_nsec/1000000.0;
+}
+
+static int write_all(int fd, char* data, int size)
+/* Send size bytes, 0 if the server is gone */
+{
+	while (size>0)
+    {
+		int nb= write(fd, data, size);
+
+		if (nb<0 && errno==EINTR)
+			continue;
+		if (nb<=0)
+			return 0;
+		data+= nb;
+		size-= nb;
+    }
+	return 1;
+}
+
+static int read_bytes(Client* cl, char* data, int size)
+/* Receive size bytes (data may be NULL to skip them), 0 at the end */
+{
+	while (size>0)
+    {
+		int nb;
+
+		if (cl->pos==cl->end)
+		{
+			nb= read(cl->fd, cl->buffer, sizeof(cl->buffer));
+			if (nb<0 && errno==EINTR)
+				continue;
+			if (nb<=0)
+				return 0;
+			cl->pos=0;
+			cl->end=nb;
+		}
+
+		nb= cl->end - cl->pos;
+		if (nb>size)
+			nb=size;
+		if (data)
+		{
+			memcpy(data, cl->buffer+cl->pos, nb);
+			data+= nb;
+		}
+		cl->pos+= nb;
+		size-= nb;
+    }
+	return 1;
+}
+
+static int read_line(Client* cl, char* line, int size)
+/* Receive one line without its end of line, 0 at the end */
+{
+	int len=0;
+	char c;
+
+	do
+    {
+		if (!read_bytes(cl, &c, 1))
+			return 0;
+		if (c!='\n' && len<size-1)
+			line[len++]=c;
+    }
+	while (c!='\n');
+
+	line[len]=0;
+	return 1;
+}
+
+static int expect_ok(Client* cl)
+/* Read the answer to a command */
+{
+	char line[LINE_SIZE];
+
+	if (!read_line(cl, line, sizeof(line)))
+		return 0;
+	if (strncmp(line,"OK",2)!=0)
+    {
+		fprintf(stderr,"Connection %i: %s\n",cl->id,line);
+		return 0;
+    }
+	return 1;
+}
+
+static int run_request(Client* cl, Timing* timing, FILE* out)
+/*
+ * Send the utterance and read the audio back. Return 0 if the connection
+ * is lost, -1 if the server answers with an error, 1 otherwise
+ */
+{
+	char line[LINE_SIZE];
+	double start= now();
+	long nb_samples=0;
+	char* audio=NULL;
+	int audio_size=0;
+	int freq;
+
+	timing->first_audio= timing->total= 0.0;
+
+	if (!write_all(cl->fd, request, strlen(request))
+		|| !read_line(cl, line, sizeof(line)))
+		return 0;
+	if (sscanf(line,"OK %i",&freq)!=1)
+    {
+		fprintf(stderr,"Connection %i: %s\n",cl->id,line);
+		return -1;
+    }
+
+	while (1)
+    {
+		int nb;
+
+		if (!read_line(cl, line, sizeof(line)))
+		{
+			free(audio);
+			return 0;
+		}
+
+		if (sscanf(line,"AUDIO %i",&nb)==1)
+		{
+			if (nb_samples==0)
+				timing->first_audio= now()-start;
+			if (out && nb*sample_size > audio_size)
+			{
+				audio_size= nb*sample_size;
+				audio= (char*) realloc(audio, audio_size);
+			}
+			if (!read_bytes(cl, (out) ? audio : NULL, nb*sample_size))
+			{
+				free(audio);
+				return 0;
+			}
+			if (out)
+				fwrite(audio, sample_size, nb, out);
+			nb_samples+= nb;
+		}
+		else
+			break;
+    }
+	free(audio);
+
+	if (strncmp(line,"DONE",4)!=0)
+    {
+		fprintf(stderr,"Connection %i: %s\n",cl->id,line);
+		return -1;
+    }
+	timing->total= now()-start;
+	audio_seconds[cl->id]+= (double) nb_samples / freq;
+	return 1;
+}
+
+static void* client_thread(void* data)
+/* One connection: send the commands, then the requests in a row */
+{
+	Client* cl= (Client*) data;
+	struct sockaddr_un address;
+	int i;
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family= AF_UNIX;
+	strncpy(address.sun_path, socket_path, sizeof(address.sun_path)-1);
+
+	cl->fd= socket(AF_UNIX, SOCK_STREAM, 0);
+	if (cl->fd<0
+		|| connect(cl->fd, (struct sockaddr*) &address, sizeof(address))<0)
+    {
+		perror(socket_path);
+		nb_errors[cl->id]= nb_requests;
+		return NULL;
+    }
+
+	/* One answer per command line */
+	if (commands)
+    {
+		char* pos;
+
+		if (!write_all(cl->fd, commands, strlen(commands)))
+			nb_errors[cl->id]= nb_requests;
+		for (pos=commands; *pos && nb_errors[cl->id]==0; pos++)
+			if (*pos=='\n' && !expect_ok(cl))
+				nb_errors[cl->id]= nb_requests;
+    }
+
+	for (i=0; i<nb_requests && nb_errors[cl->id]<nb_requests; i++)
+    {
+		FILE* out= (cl->id==0 && i==0) ? output : NULL;
+		int result= run_request(cl, &timings[cl->id*nb_requests+i], out);
+
+		if (result<=0)
+			nb_errors[cl->id]++;
+		if (result==0)
+		{
+			fprintf(stderr,"Connection %i lost\n",cl->id);
+			nb_errors[cl->id]= nb_requests;
+		}
+    }
+
+	write_all(cl->fd, "QUIT\n", 5);
+	close(cl->fd);
+	return NULL;
+}
+
+static char* read_file(char* name)
+/* Whole content of a text file */
+{
+	FILE* file= fopen(name,"r");
+	char* content;
+	long size;
+
+	if (file==NULL)
+    {
+		perror(name);
+		exit(1);
+    }
+	fseek(file, 0, SEEK_END);
+	size= ftell(file);
+	fseek(file, 0, SEEK_SET);
+	content= (char*) malloc(size+1);
+	size= fread(content, 1, size, file);
+	content[size]=0;
+	fclose(file);
+	return content;
+}
+
+static char* add_command(char* list, char* line)
+/* Append one command line */
+{
+	int len= (list) ? strlen(list) : 0;
+
+	list= (char*) realloc(list, len + strlen(line) + 2);
+	sprintf(list+len,"%s\n",line);
+	return list;
+}
+
+static char* init_commands(char* list, char* name)
+/*
+ * Commands of an initialization file of mbrola (-I), whatever precedes
+ * the command on a line is skipped like in mbrola
+ */
+{
+	static char* keywords[]= { "RENAME", "CLONE", "FLUSH", "COMMENT", "TIME",
+							   "FREQ", "VOLUME", "VOICE", "IGNORE", NULL };
+	char* content= read_file(name);
+	char* line;
+
+	for (line=strtok(content,"\r\n"); line; line=strtok(NULL,"\r\n"))
+    {
+		int i;
+
+		for (i=0; keywords[i]; i++)
+			if (strstr(line,keywords[i]))
+			{
+				list= add_command(list, strstr(line,keywords[i]));
+				break;
+			}
+    }
+	free(content);
+	return list;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+	double x= *(double*) a;
+	double y= *(double*) b;
+
+	return (x<y) ? -1 : (x>y);
+}
+
+static void report(char* title, double* values, int nb)
+/* Mean and percentiles of the values */
+{
+	double sum=0.0;
+	int i;
+
+	if (nb==0)
+		return;
+	qsort(values, nb, sizeof(double), compare_double);
+	for (i=0; i<nb; i++)
+		sum+= values[i];
+	printf("%-24s mean %8.1f  p50 %8.1f  p95 %8.1f  max %8.1f\n",
+		   title, sum/nb, values[nb/2], values[(nb*95)/100], values[nb-1]);
+}
+
+static void usage(char* name)
+{
+	fprintf(stderr,
+			"USAGE: %s [options] pho_file\n"
+			"\t-s socket : path of the server socket (default %s)\n"
+			"\t-c N      : number of concurrent connections (default 1)\n"
+			"\t-n N      : requests per connection (default 1)\n"
+			"\t-d name   : database to use\n"
+			"\t-t type   : LIN16 (default), LIN8, ULAW, ALAW, LIN24 or FLOAT32\n"
+			"\t-r rate   : sample rate of the audio (default the voice frequency)\n"
+			"\t-I file   : initialization file, as with mbrola\n"
+			"\t-o file   : save the raw audio of the first request\n",
+			name, DEFAULT_SOCKET);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t* threads;
+	Client* clients;
+	double start, elapsed, total_audio=0.0;
+	double* values;
+	char line[LINE_SIZE];
+	char* pho;
+	int total_errors=0;
+	int nb_values;
+	int i;
+
+	for (i=1; i<argc && argv[i][0]=='-'; i++)
+    {
+		if (i+1==argc)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		if (strcmp(argv[i],"-s")==0)
+			socket_path= argv[++i];
+		else if (strcmp(argv[i],"-c")==0)
+			nb_connections= atoi(argv[++i]);
+		else if (strcmp(argv[i],"-n")==0)
+			nb_requests= atoi(argv[++i]);
+		else if (strcmp(argv[i],"-d")==0)
+		{
+			sprintf(line,"DATABASE %.1000s",argv[++i]);
+			commands= add_command(commands, line);
+		}
+		else if (strcmp(argv[i],"-t")==0)
+		{
+			i++;
+			if (strcmp(argv[i],"LIN16")==0)
+				sample_size= 2;
+			else if (strcmp(argv[i],"LIN24")==0)
+				sample_size= 3;
+			else if (strcmp(argv[i],"FLOAT32")==0)
+				sample_size= 4;
+			else
+				sample_size= 1;
+			sprintf(line,"TYPE %.1000s",argv[i]);
+			commands= add_command(commands, line);
+		}
+		else if (strcmp(argv[i],"-r")==0)
+		{
+			sprintf(line,"RATE %.1000s",argv[++i]);
+			commands= add_command(commands, line);
+		}
+		else if (strcmp(argv[i],"-I")==0)
+			commands= init_commands(commands, argv[++i]);
+		else if (strcmp(argv[i],"-o")==0)
+		{
+			output= fopen(argv[++i],"wb");
+			if (output==NULL)
+			{
+				perror(argv[i]);
+				return 1;
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+    }
+	if (i+1!=argc || nb_connections<=0 || nb_requests<=0)
+    {
+		usage(argv[0]);
+		return 1;
+    }
+
+	/* A line with a single dot would end the input early */
+	pho= read_file(argv[i]);
+	request= (char*) malloc(strlen(pho) + 16);
+	sprintf(request,"PHO\n%s\n.\n",pho);
+	free(pho);
+
+	timings= (Timing*) calloc(nb_connections*nb_requests, sizeof(Timing));
+	audio_seconds= (double*) calloc(nb_connections, sizeof(double));
+	nb_errors= (int*) calloc(nb_connections, sizeof(int));
+	threads= (pthread_t*) malloc(nb_connections*sizeof(pthread_t));
+	clients= (Client*) calloc(nb_connections, sizeof(Client));
+
+	start= now();
+	for (i=0; i<nb_connections; i++)
+    {
+		clients[i].id= i;
+		pthread_create(&threads[i], NULL, client_thread, &clients[i]);
+    }
+	for (i=0; i<nb_connections; i++)
+    {
+		pthread_join(threads[i], NULL);
+		total_audio+= audio_seconds[i];
+		total_errors+= nb_errors[i];
+    }
+	elapsed= (now()-start)/1000.0;
+
+	if (output)
+		fclose(output);
+
+	printf("%i connections x %i requests, %i errors\n",
+		   nb_connections, nb_requests, total_errors);
+	printf("%.2f s of audio in %.2f s: %.1f x real time, %.1f requests/s\n",
+		   total_audio, elapsed, total_audio/elapsed,
+		   (nb_connections*nb_requests - total_errors)/elapsed);
+
+	/* Statistics of the successful requests */
+	values= (double*) malloc(nb_connections*nb_requests*sizeof(double));
+	for (nb_values=0, i=0; i<nb_connections*nb_requests; i++)
+		if (timings[i].total>0.0)
+			values[nb_values++]= timings[i].first_audio;
+	report("first audio (ms)", values, nb_values);
+	for (nb_values=0, i=0; i<nb_connections*nb_requests; i++)
+		if (timings[i].total>0.0)
+			values[nb_values++]= timings[i].total;
+	report("request (ms)", values, nb_values);
+
+	free(values);
+	free(clients);
+	free(threads);
+	free(nb_errors);
+	free(audio_seconds);
+	free(timings);
+	free(request);
+	free(commands);
+	return (total_errors>0);
+}
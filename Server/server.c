@@ -0,0 +1,846 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  server.c
+ * Purpose: mbrola-server, synthesis daemon on a Unix domain socket
+ *
+ * 19/10/26: Created. Needs THREADS (built on the job scheduler)
+ * 19/10/26: databases from shared ROM images (shm:/name or .rom files)
+ * 19/10/26: LIN24 and FLOAT32 samples
+ * 19/10/26: RATE command, resampled output
+ * 19/10/26: VOICE bounded like mbrola -l, PHO input bounded to PHO_SIZE,
+ *           at most MAX_VOICES unused databases stay loaded, and only a
+ *           socket is removed from the socket path
+ *
+ *   The databases given on the command line are loaded once. Each client
+ *   connection gets its own thread, and its utterances are jobs of a
+ *   scheduler shared by all the connections.
+ *
+ *   The protocol is line based. A connection sends commands, each one is
+ *   answered by a single line "OK" or "ERROR <code> <message>":
+ *
+ *     DATABASE name    voice to use (base name or path given to the server)
+ *     TYPE t           LIN16 (default), LIN8, ULAW, ALAW, LIN24 or FLOAT32
+ *     RENAME a A ...   rename phonemes
+ *     CLONE a A ...    clone phonemes
+ *     TIME r           duration ratio
+ *     FREQ r           pitch ratio
+ *     VOLUME r         volume ratio
+ *     VOICE f          output frequency (Hz), 1000 to 48000
+ *     RATE f           sample rate of the audio sent (Hz), 0 for VOICE
+ *     IGNORE           tolerance to missing diphones
+ *     FLUSH s          flush symbol
+ *     COMMENT s        comment symbol
+ *     RESET            back to the default settings
+ *     QUIT             close the connection
+ *
+ *   which are the commands of the -I initialization file of mbrola, plus
+ *   a few ones. RENAME and CLONE accumulate, the database is loaded again
+ *   with them the first time a list of renamings is used. The least
+ *   recently used of these loaded databases are closed when more than
+ *   MAX_VOICES of them are loaded and not used by any utterance.
+ *
+ *   Databases named shm:/name or ending with .rom are ROM images written
+ *   by mbrola -S, mapped read-only and shared with the other processes.
+ *
+ *   An utterance is sent as a line "PHO", the phonemic input, and a line
+ *   holding a single ".", at most PHO_SIZE bytes in between. A final
+ *   flush is implied. The answer is
+ *   "OK <frequency>", followed by audio chunks "AUDIO <nb_samples>" each
+ *   one followed by the samples in the native byte order, and finally
+ *   "DONE <nb_samples>" or "ERROR <code> <message>".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "common.h"
+#include "database.h"
+#include "audio.h"
+#include "multichannel.h"
+#include "scheduler.h"
+
+#define DEFAULT_SOCKET "/tmp/mbrola.sock"
+
+/* Longest command line */
+#define LINE_SIZE 1024
+
+/* Longest phonemic input of a PHO command */
+#define PHO_SIZE (1024*1024)
+
+/* Loaded databases kept while no utterance uses them */
+#define MAX_VOICES 16
+
+/* Error codes of the protocol, other ones are the ERROR_* of mbrola */
+#define SERVER_SYNTAX   1   /* Unknown command or bad argument */
+#define SERVER_NODBA    2   /* No database selected, or unknown name */
+#define SERVER_TOOLONG  3   /* Phonemic input longer than PHO_SIZE */
+
+/* A database, loaded for a given list of renamings and clonings */
+typedef struct Voice
+{
+	char* path;        /* File of the database, from the command line */
+	char* rename;      /* Renaming list, NULL if none */
+	char* clone;       /* Cloning list, NULL if none */
+	Database* dba;
+	int users;         /* Utterances being synthesized with it */
+	struct Voice* next;
+} Voice;
+
+/* State of a client connection */
+typedef struct Connection
+{
+	int fd;
+	char buffer[LINE_SIZE];  /* Received bytes not read yet */
+	int pos;
+	int end;
+
+	bool gone;               /* An answer couldn't be sent */
+
+	char* voice_name;        /* NULL until a DATABASE command */
+	char* rename;
+	char* clone;
+	JobSettings settings;
+	AudioType sample_type;
+
+	struct Connection* next;
+} Connection;
+
+static Scheduler* sched=NULL;
+
+static char** voice_paths;       /* Databases given on the command line */
+static int nb_voice_paths;
+static Voice* voices=NULL;       /* Loaded databases, most recent first */
+static int nb_voices=0;
+static pthread_mutex_t voice_lock;
+
+static Connection* connections=NULL; /* Open connections */
+static int nb_connections=0;
+static pthread_mutex_t connection_lock;
+static pthread_cond_t connection_closed;
+
+static volatile sig_atomic_t stopping=0;
+
+static void stop_handler(int sig)
+/* SIGINT or SIGTERM: stop accepting connections */
+{
+	stopping=1;
+}
+
+static char* base_name(char* path)
+/* Name of a database without its directory */
+{
+	char* pos= strrchr(path,'/');
+
+	return (pos) ? pos+1 : path;
+}
+
+static bool same_list(char* a, char* b)
+/* Compare two renaming lists, NULL being the empty one */
+{
+	if (a==NULL || b==NULL)
+		return a==b;
+	return strcmp(a,b)==0;
+}
+
+static char* find_path(char* name)
+/* Database of the command line called name (path or base name), or NULL */
+{
+	int i;
+
+	for (i=0; i<nb_voice_paths; i++)
+		if (strcmp(voice_paths[i],name)==0
+			|| strcmp(base_name(voice_paths[i]),name)==0)
+			return voice_paths[i];
+	return NULL;
+}
+
+static void free_Voice(Voice* voice)
+/* Close a database and its renaming lists */
+{
+	close_DatabaseMBR2(voice->dba);
+	if (voice->rename)
+		MBR_free(voice->rename);
+	if (voice->clone)
+		MBR_free(voice->clone);
+	MBR_free(voice);
+}
+
+static void trim_Voices()
+/*
+ * Close the least recently used databases nobody uses while more than
+ * MAX_VOICES are loaded. Called with voice_lock held
+ */
+{
+	while (nb_voices > MAX_VOICES)
+    {
+		Voice** link;
+		Voice** unused=NULL;
+
+		for (link=&voices; *link; link=&(*link)->next)
+			if ((*link)->users==0)
+				unused= link;
+		if (unused==NULL)
+			return;
+
+		{
+			Voice* voice= *unused;
+
+			*unused= voice->next;
+			nb_voices--;
+			if (sched)
+				forget_DatabaseMBR2(sched, voice->dba);
+			free_Voice(voice);
+		}
+    }
+}
+
+static Voice* get_Voice(char* name, char* rename, char* clone, char* msg, int size)
+/*
+ * Database called name with the renamings, loaded if needed. Return NULL
+ * in case of error, with the message in msg. The voice is used until
+ * release_Voice
+ */
+{
+	Voice** link;
+	Voice* voice;
+	char* path= find_path(name);
+
+	if (path==NULL)
+    {
+		sprintf(msg,"%i unknown database %s",SERVER_NODBA,name);
+		return NULL;
+    }
+
+	pthread_mutex_lock(&voice_lock);
+	for (link=&voices; *link; link=&(*link)->next)
+		if ((*link)->path==path
+			&& same_list((*link)->rename,rename)
+			&& same_list((*link)->clone,clone))
+		{
+			/* Move it to the front of the list */
+			voice= *link;
+			*link= voice->next;
+			voice->next= voices;
+			voices= voice;
+			voice->users++;
+			pthread_mutex_unlock(&voice_lock);
+			return voice;
+		}
+
+	voice= (Voice*) MBR_malloc(sizeof(Voice));
+	voice->dba= init_DatabaseMBR2(path, rename, clone);
+	if (voice->dba==NULL)
+    {
+		char err[255];
+
+		lastErrorStr_MBR2(err,sizeof(err));
+		sprintf(msg,"%i ", lastError_MBR2());
+		strncat(msg, err, size-strlen(msg)-1);
+		MBR_free(voice);
+		pthread_mutex_unlock(&voice_lock);
+		return NULL;
+    }
+	voice->path= path;
+	voice->rename= (rename) ? MBR_strdup(rename) : NULL;
+	voice->clone= (clone) ? MBR_strdup(clone) : NULL;
+	voice->users= 1;
+	voice->next= voices;
+	voices= voice;
+	nb_voices++;
+	trim_Voices();
+	pthread_mutex_unlock(&voice_lock);
+
+	return voice;
+}
+
+static void release_Voice(Voice* voice)
+/* An utterance doesn't use the voice anymore */
+{
+	pthread_mutex_lock(&voice_lock);
+	voice->users--;
+	trim_Voices();
+	pthread_mutex_unlock(&voice_lock);
+}
+
+static void close_Voices()
+/* Release all the loaded databases */
+{
+	while (voices)
+    {
+		Voice* voice= voices;
+
+		voices= voice->next;
+		free_Voice(voice);
+    }
+	nb_voices=0;
+}
+
+static bool write_all(int fd, void* data, int size)
+/* Send size bytes, False if the client is gone */
+{
+	char* pos= (char*) data;
+
+	while (size>0)
+    {
+		int nb= write(fd, pos, size);
+
+		if (nb<0 && errno==EINTR)
+			continue;
+		if (nb<=0)
+			return False;
+		pos+= nb;
+		size-= nb;
+    }
+	return True;
+}
+
+static bool reply(Connection* conn, char* line)
+/* Send one line of answer */
+{
+	return write_all(conn->fd, line, strlen(line))
+		&& write_all(conn->fd, "\n", 1);
+}
+
+static int read_line(Connection* conn, char* line, int size)
+/*
+ * Next line sent by the client, without its end of line. Longer lines
+ * are truncated. Return -1 if the connection is closed
+ */
+{
+	int len=0;
+
+	while (True)
+    {
+		char c;
+
+		if (conn->pos==conn->end)
+		{
+			int nb= read(conn->fd, conn->buffer, sizeof(conn->buffer));
+
+			if (nb<0 && errno==EINTR)
+				continue;
+			if (nb<=0)
+				return -1;
+			conn->pos=0;
+			conn->end=nb;
+		}
+
+		c= conn->buffer[conn->pos++];
+		if (c=='\n')
+			break;
+		if (len<size-1)
+			line[len++]=c;
+    }
+
+	if (len>0 && line[len-1]=='\r')
+		len--;
+	line[len]=0;
+	return len;
+}
+
+static int socket_sink(void* sink_data, void* buffer, int nb_samples, AudioType sample_type)
+/* Called from a worker: send one audio chunk to the client */
+{
+	Connection* conn= (Connection*) sink_data;
+	int size= size_AudioType(sample_type);
+	char header[32];
+
+	sprintf(header,"AUDIO %i\n",nb_samples);
+	if (!write_all(conn->fd, header, strlen(header))
+		|| !write_all(conn->fd, buffer, nb_samples*size))
+    {
+		conn->gone= True;
+		return -1;
+    }
+	return nb_samples;
+}
+
+static char* append_list(char* list, char* pairs)
+/* Add renaming pairs at the end of a list */
+{
+	char* result= (char*) MBR_malloc( ((list) ? strlen(list) : 0) + strlen(pairs) + 2);
+
+	if (list)
+    {
+		sprintf(result,"%s %s",list,pairs);
+		MBR_free(list);
+    }
+	else
+		strcpy(result,pairs);
+	return result;
+}
+
+static void reset_Connection(Connection* conn)
+/* Default settings of a new connection */
+{
+	if (conn->voice_name)
+		MBR_free(conn->voice_name);
+	if (conn->rename)
+		MBR_free(conn->rename);
+	if (conn->clone)
+		MBR_free(conn->clone);
+	if (conn->settings.comment)
+		MBR_free(conn->settings.comment);
+	if (conn->settings.flush)
+		MBR_free(conn->settings.flush);
+
+	conn->voice_name=NULL;
+	conn->rename=NULL;
+	conn->clone=NULL;
+	default_JobSettingsMBR2(&conn->settings);
+	conn->sample_type=LIN16;
+
+	/* A database given alone on the command line is selected by default */
+	if (nb_voice_paths==1)
+		conn->voice_name= MBR_strdup(voice_paths[0]);
+}
+
+static bool synthesize(Connection* conn)
+/* Read the phonemic input after a PHO command and send the audio back */
+{
+	char line[LINE_SIZE];
+	char answer[LINE_SIZE];
+	char* pho;
+	int pho_size=0;
+	int pho_available=LINE_SIZE;
+	bool too_long=False;
+	Voice* voice=NULL;
+	Job* job;
+
+	/* Gather the input up to the final dot, skip it past PHO_SIZE */
+	pho= (char*) MBR_malloc(pho_available);
+	pho[0]=0;
+	while (True)
+    {
+		int len= read_line(conn, line, sizeof(line));
+
+		if (len<0)
+		{
+			MBR_free(pho);
+			return False;
+		}
+		if (strcmp(line,".")==0)
+			break;
+
+		if (too_long || pho_size+len+2 > PHO_SIZE)
+		{
+			too_long= True;
+			continue;
+		}
+		if (pho_size+len+2 > pho_available)
+		{
+			pho_available= 2*pho_available + len;
+			if (pho_available > PHO_SIZE)
+				pho_available= PHO_SIZE;
+			pho= (char*) MBR_realloc(pho, pho_available);
+		}
+		strcpy(pho+pho_size, line);
+		pho_size+= len;
+		pho[pho_size++]='\n';
+		pho[pho_size]=0;
+    }
+
+	if (too_long)
+		sprintf(answer,"ERROR %i phonemic input longer than %i bytes",
+				SERVER_TOOLONG,PHO_SIZE);
+	else if (conn->voice_name==NULL)
+		sprintf(answer,"ERROR %i no database selected",SERVER_NODBA);
+	else
+    {
+		strcpy(answer,"ERROR ");
+		voice= get_Voice(conn->voice_name, conn->rename, conn->clone,
+						 answer+6, sizeof(answer)-6);
+    }
+	if (voice==NULL)
+    {
+		MBR_free(pho);
+		return reply(conn,answer);
+    }
+
+	if (conn->settings.out_freq>0)
+		sprintf(answer,"OK %i",conn->settings.out_freq);
+	else
+		sprintf(answer,"OK %i",
+				(conn->settings.voice_freq>0) ? conn->settings.voice_freq : Freq(voice->dba));
+	if (!reply(conn,answer))
+    {
+		release_Voice(voice);
+		MBR_free(pho);
+		return False;
+    }
+
+	job= submit_JobMBR2(sched, voice->dba, pho, &conn->settings,
+						conn->sample_type, socket_sink, conn);
+	MBR_free(pho);
+
+	if (wait_JobMBR2(job)==JOB_DONE)
+		sprintf(answer,"DONE %li",samples_JobMBR2(job));
+	else
+    {
+		char err[255];
+
+		errorStr_JobMBR2(job, err, sizeof(err));
+		sprintf(answer,"ERROR %i %s", error_JobMBR2(job), err);
+    }
+	close_JobMBR2(job);
+	release_Voice(voice);
+
+	/* Error messages are sometimes multi lines */
+	{
+		char* pos;
+
+		for (pos=answer; *pos; pos++)
+			if (*pos=='\n' || *pos=='\r')
+				*pos=' ';
+	}
+
+	return !conn->gone && reply(conn,answer);
+}
+
+static bool command(Connection* conn, char* line)
+/* Execute one command, False when the connection must be closed */
+{
+	char keyword[LINE_SIZE];
+	char arg[LINE_SIZE];
+	char answer[LINE_SIZE];
+	char* rest;
+	int nb_args;
+	float value;
+
+	if (line[0]==0)
+		return True;
+
+	keyword[0]= arg[0]= 0;
+	nb_args= sscanf(line,"%s %s",keyword,arg);
+	rest= strstr(line,keyword) + strlen(keyword);
+	while (*rest==' ' || *rest=='\t')
+		rest++;
+
+	strcpy(answer,"OK");
+
+	if (strcmp(keyword,"PHO")==0)
+		return synthesize(conn);
+	else if (strcmp(keyword,"QUIT")==0)
+    {
+		reply(conn,answer);
+		return False;
+    }
+	else if (strcmp(keyword,"RESET")==0)
+		reset_Connection(conn);
+	else if (strcmp(keyword,"IGNORE")==0)
+		conn->settings.no_error= True;
+	else if (nb_args<2)
+		sprintf(answer,"ERROR %i syntax error: %.900s",SERVER_SYNTAX,line);
+	else if (strcmp(keyword,"DATABASE")==0)
+    {
+		if (find_path(arg)==NULL)
+			sprintf(answer,"ERROR %i unknown database %.900s",SERVER_NODBA,arg);
+		else
+		{
+			if (conn->voice_name)
+				MBR_free(conn->voice_name);
+			conn->voice_name= MBR_strdup(arg);
+		}
+    }
+	else if (strcmp(keyword,"TYPE")==0)
+    {
+		if (strcmp(arg,"LIN16")==0)
+			conn->sample_type=LIN16;
+		else if (strcmp(arg,"LIN8")==0)
+			conn->sample_type=LIN8;
+		else if (strcmp(arg,"ULAW")==0)
+			conn->sample_type=ULAW;
+		else if (strcmp(arg,"ALAW")==0)
+			conn->sample_type=ALAW;
+		else if (strcmp(arg,"LIN24")==0)
+			conn->sample_type=LIN24;
+		else if (strcmp(arg,"FLOAT32")==0)
+			conn->sample_type=FLOAT32;
+		else
+			sprintf(answer,"ERROR %i unknown type %.900s",SERVER_SYNTAX,arg);
+    }
+	else if (strcmp(keyword,"RENAME")==0)
+		conn->rename= append_list(conn->rename, rest);
+	else if (strcmp(keyword,"CLONE")==0)
+		conn->clone= append_list(conn->clone, rest);
+	else if (strcmp(keyword,"FLUSH")==0)
+    {
+		if (conn->settings.flush)
+			MBR_free(conn->settings.flush);
+		conn->settings.flush= MBR_strdup(arg);
+    }
+	else if (strcmp(keyword,"COMMENT")==0)
+    {
+		if (conn->settings.comment)
+			MBR_free(conn->settings.comment);
+		conn->settings.comment= MBR_strdup(arg);
+    }
+	else if (strcmp(keyword,"VOICE")==0)
+    {
+		/* A sampling frequency, as mbrola -l */
+		if ((atoi(arg)<1000) || (atoi(arg)>48000))
+			sprintf(answer,"ERROR %i bad frequency %.900s",SERVER_SYNTAX,arg);
+		else
+			conn->settings.voice_freq= atoi(arg);
+    }
+	else if (strcmp(keyword,"RATE")==0)
+    {
+		if ((atoi(arg)<0) || (atoi(arg)>65535))
+			sprintf(answer,"ERROR %i bad frequency %.900s",SERVER_SYNTAX,arg);
+		else
+			conn->settings.out_freq= atoi(arg);
+    }
+	else if ((value= (float) atof(arg)) <= 0.0f)
+		sprintf(answer,"ERROR %i syntax error: %.900s",SERVER_SYNTAX,line);
+	else if (strcmp(keyword,"TIME")==0)
+		conn->settings.time_ratio= value;
+	else if (strcmp(keyword,"FREQ")==0)
+		conn->settings.freq_ratio= value;
+	else if (strcmp(keyword,"VOLUME")==0)
+		conn->settings.volume_ratio= value;
+	else
+		sprintf(answer,"ERROR %i unknown command %.900s",SERVER_SYNTAX,keyword);
+
+	return reply(conn,answer);
+}
+
+static void* connection_thread(void* data)
+/* Serve one client up to the end of its connection */
+{
+	Connection* conn= (Connection*) data;
+	Connection** link;
+	char line[LINE_SIZE];
+
+	while (read_line(conn, line, sizeof(line))>=0
+		   && command(conn, line))
+		;
+
+	pthread_mutex_lock(&connection_lock);
+	for (link=&connections; *link!=conn; link=&(*link)->next)
+		;
+	*link= conn->next;
+	nb_connections--;
+	pthread_cond_signal(&connection_closed);
+	pthread_mutex_unlock(&connection_lock);
+
+	close(conn->fd);
+	reset_Connection(conn);
+	if (conn->voice_name)
+		MBR_free(conn->voice_name);
+	MBR_free(conn);
+	return NULL;
+}
+
+static bool remove_socket(char* path)
+/*
+ * Remove the socket left at path by a previous server. False if path is
+ * something else, which is kept
+ */
+{
+	struct stat status;
+
+	if (lstat(path, &status)<0)
+		return True;
+	if (!S_ISSOCK(status.st_mode))
+		return False;
+	unlink(path);
+	return True;
+}
+
+static void usage(char* name)
+{
+	fprintf(stderr,
+			"USAGE: %s [-s socket] [-j workers] database1 [database2 ...]\n"
+			"\t-s socket : path of the Unix socket (default %s)\n"
+			"\t-j N      : number of synthesis threads (default: number of CPUs)\n"
+			"Send SIGINT or SIGTERM to stop the server\n",
+			name, DEFAULT_SOCKET);
+}
+
+int main(int argc, char **argv)
+{
+	char* socket_path= DEFAULT_SOCKET;
+	int nb_workers=0;
+	struct sockaddr_un address;
+	struct sigaction action;
+	sigset_t stop_signals;
+	int listen_fd;
+	int i;
+
+	for (i=1; i<argc && argv[i][0]=='-'; i++)
+    {
+		if (strcmp(argv[i],"-s")==0 && i+1<argc)
+			socket_path= argv[++i];
+		else if (strcmp(argv[i],"-j")==0 && i+1<argc)
+			nb_workers= atoi(argv[++i]);
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+    }
+	if (i==argc)
+    {
+		usage(argv[0]);
+		return 1;
+    }
+	voice_paths= argv+i;
+	nb_voice_paths= argc-i;
+
+	pthread_mutex_init(&voice_lock, NULL);
+	pthread_mutex_init(&connection_lock, NULL);
+	pthread_cond_init(&connection_closed, NULL);
+
+	/* Check the databases now rather than at the first request */
+	for (i=0; i<nb_voice_paths; i++)
+    {
+		char msg[LINE_SIZE];
+		Voice* voice= get_Voice(voice_paths[i], NULL, NULL, msg, sizeof(msg));
+
+		if (voice==NULL)
+		{
+			fprintf(stderr,"%s: %s\n",voice_paths[i],msg);
+			return 1;
+		}
+		release_Voice(voice);
+    }
+
+	/* Only the main thread must be interrupted by SIGINT or SIGTERM */
+	sigemptyset(&stop_signals);
+	sigaddset(&stop_signals, SIGINT);
+	sigaddset(&stop_signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+
+	sched= init_SchedulerMBR2(nb_workers);
+	if (sched==NULL)
+    {
+		fprintf(stderr,"Can't start the scheduler\n");
+		return 1;
+    }
+
+	/* A client leaving in the middle of an answer is not fatal */
+	action.sa_handler= SIG_IGN;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags=0;
+	sigaction(SIGPIPE, &action, NULL);
+
+	/* No SA_RESTART: accept returns with EINTR */
+	action.sa_handler= stop_handler;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	pthread_sigmask(SIG_UNBLOCK, &stop_signals, NULL);
+
+	if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+		fprintf(stderr,"Socket path too long: %s\n",socket_path);
+		return 1;
+    }
+	memset(&address, 0, sizeof(address));
+	address.sun_family= AF_UNIX;
+	strcpy(address.sun_path, socket_path);
+
+	if (!remove_socket(socket_path))
+    {
+		fprintf(stderr,"%s exists and is not a socket\n",socket_path);
+		return 1;
+    }
+	listen_fd= socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd<0
+		|| bind(listen_fd, (struct sockaddr*) &address, sizeof(address))<0
+		|| listen(listen_fd, 64)<0)
+    {
+		perror(socket_path);
+		return 1;
+    }
+	fprintf(stderr,"mbrola-server listening on %s\n",socket_path);
+
+	while (!stopping)
+    {
+		Connection* conn;
+		pthread_t thread;
+		pthread_attr_t attr;
+		int created;
+		int fd= accept(listen_fd, NULL, NULL);
+
+		if (fd<0)
+		{
+			if (errno!=EINTR)
+				perror("accept");
+			continue;
+		}
+
+		conn= (Connection*) MBR_malloc(sizeof(Connection));
+		memset(conn, 0, sizeof(Connection));
+		conn->fd= fd;
+		reset_Connection(conn);
+
+		pthread_mutex_lock(&connection_lock);
+		conn->next= connections;
+		connections= conn;
+		nb_connections++;
+		pthread_mutex_unlock(&connection_lock);
+
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+		created= pthread_create(&thread, &attr, connection_thread, conn);
+		pthread_sigmask(SIG_UNBLOCK, &stop_signals, NULL);
+		if (created!=0)
+		{
+			/* Only this loop adds connections: conn is still the first */
+			perror("pthread_create");
+			pthread_mutex_lock(&connection_lock);
+			connections= conn->next;
+			nb_connections--;
+			pthread_mutex_unlock(&connection_lock);
+			close(fd);
+			reset_Connection(conn);
+			MBR_free(conn->voice_name);
+			MBR_free(conn);
+		}
+		pthread_attr_destroy(&attr);
+    }
+
+	/* Wake up the connections waiting for a command, and wait for them */
+	close(listen_fd);
+	remove_socket(socket_path);
+	pthread_mutex_lock(&connection_lock);
+	{
+		Connection* conn;
+
+		for (conn=connections; conn; conn=conn->next)
+			shutdown(conn->fd, SHUT_RDWR);
+	}
+	while (nb_connections>0)
+		pthread_cond_wait(&connection_closed, &connection_lock);
+	pthread_mutex_unlock(&connection_lock);
+
+	close_SchedulerMBR2(sched);
+	close_Voices();
+	fprintf(stderr,"mbrola-server stopped\n");
+	return 0;
+}
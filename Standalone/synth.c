@@ -36,6 +36,31 @@
  *
  * 27/03/00: Rom databases dumping + initialization from ROM image for
  *           debugging purposes
+ *
+ * 19/10/26: -j N processes "pho_file output_file" pairs on N threads
+ *
+ * 19/10/26: -J N splits each pho_file at flushes and long silences, and
+ *           synthesizes the parts on N threads
+ *
+ * 19/10/26: -S image stores a ROM image shared between processes, and a
+ *           database named shm:/name is attached from shared memory
+ *
+ * 19/10/26: -w maps the .rom image instead of reading it in memory
+ *
+ * 19/10/26: output through an audio sink: the header is only rewritten
+ *           when the output is seekable, a pipe gets a stream header
+ *
+ * 19/10/26: -b 24 or -b float for 24 bits or float32 samples, taken from
+ *           the float OLA buffer without the 16 bits clipping
+ *
+ * 19/10/26: -r SR resamples the output at any sample rate
+ *
+ * 19/10/26: -P reports the time spent in each stage (PROFILE)
+ *
+ * 19/10/26: -H windows the frames of the database once, ROM images
+ *           stored with -W or -S keep them
+ *
+ * 19/10/26: -j and -J without THREADS say that they need them
  */
 
 #include "common.h"
@@ -72,10 +97,20 @@
 #include "rom_database.h"
 #endif
 
+#ifdef ROMDATABASE_IMAGE
+#include "rom_image.h"
+#endif
+
+#ifdef THREADS
+#include <pthread.h>
+#include <time.h>
+#include "split.h"
+#endif
+
 /* 
  * In standalone mode, input and ouput through files
  */
-FILE *output_file;  /* Audio output file (can be stdout)  */
+AudioSink *output_sink;  /* Audio output (file, can be stdout)  */
 
 /* main objects */
 Database* my_dba;
@@ -92,8 +127,21 @@ char* comment_symbol=NULL;   /* init from command line */
 char* flush_symbol=NULL;     /* init from rename file  */
 float my_pitch;              /* default pitch value */
 uint16 voice_len=0;          /* Voice sampling rate */
+AudioType output_type=LIN16; /* -b, samples of the output files */
+uint16 out_freq=0;           /* -r, sample rate of the output, 0 means voice rate */
 ZStringList* rename_list;     /* phoneme renaming */
 ZStringList* clone_list;      /* phoneme cloning */
+#ifdef THREADS
+int nb_workers=0;            /* -j N, 0 means sequential */
+int nb_split=0;              /* -J N, 0 means no split of the pho files */
+#endif
+#ifdef PROFILE
+bool profile_report=False;   /* -P, time of the stages on stderr */
+StageStats profile_total;    /* Stages timed by all the engines */
+#ifdef THREADS
+pthread_mutex_t profile_lock= PTHREAD_MUTEX_INITIALIZER;
+#endif
+#endif
 
 #ifdef SIGNAL
 
@@ -250,6 +298,260 @@ void parse_init_file(char* rename_file_name)
     }
 }
 
+#ifdef PROFILE
+
+void add_profile(Mbrola* mb)
+/* Add the stages timed by an engine to the total, before closing it */
+{
+	StageStats stats;
+	int i;
+
+	get_stats_Mbrola(mb, &stats);
+#ifdef THREADS
+	pthread_mutex_lock(&profile_lock);
+#endif
+	for (i=0; i<NB_STAGES; i++)
+    {
+		profile_total.seconds[i]+= stats.seconds[i];
+		profile_total.calls[i]+= stats.calls[i];
+    }
+#ifdef THREADS
+	pthread_mutex_unlock(&profile_lock);
+#endif
+}
+
+void print_profile()
+/* Time of each stage on stderr, summed on the threads */
+{
+	double total=0.0;
+	int i;
+
+	for (i=0; i<NB_STAGES; i++)
+		total+= profile_total.seconds[i];
+
+	fprintf(stderr, "%-8s %10s %10s %6s\n", "stage", "seconds", "calls", "%");
+	for (i=0; i<NB_STAGES; i++)
+		fprintf(stderr, "%-8s %10.4f %10li %5.1f%%\n",
+				name_Stage((Stage) i), profile_total.seconds[i], profile_total.calls[i],
+				(total>0.0) ? 100.0*profile_total.seconds[i]/total : 0.0);
+	fprintf(stderr, "%-8s %10.4f\n", "total", total);
+}
+
+#endif /* PROFILE */
+
+#ifdef THREADS
+
+Mbrola* worker_Mbrola(Database* dba)
+/* Engine of a worker thread, with the settings of the command line */
+{
+	Mbrola* mb= init_Mbrola(dba);
+
+	set_volume_ratio_Mbrola(mb,volume_ratio);
+	set_smoothing_Mbrola(mb,smoothing);
+	set_no_error_Mbrola(mb,no_error);
+	if (voice_len!=0)
+		set_voicefreq_Mbrola(mb,voice_len);
+	return mb;
+}
+
+/*
+ * Split mode: the segments of a pho file are synthesized by nb_split
+ * threads in temporary files (raw native samples), then copied in order
+ * on the output
+ */
+
+/* Segments shared by the workers */
+typedef struct
+{
+	Split* sp;
+	FILE** files;          /* Temporary file where each segment went */
+	long* offsets;         /* Position of each segment in its file */
+	int next;              /* Next segment to synthesize */
+	pthread_mutex_t lock;
+} SegmentList;
+
+AudioType segment_type()
+/* 
+ * Samples of the temporary files of the segments, float if they are
+ * resampled when copied
+ */
+{
+	return ((output_type==LIN16) && !resampler(my_brole)) ? LIN16 : FLOAT32;
+}
+
+void* split_worker(void* arg)
+/* Take the segments one by one, return the temporary file */
+{
+	SegmentList* list= (SegmentList*) arg;
+	Database* dba;
+	Mbrola* mb;
+	FILE* tmp;
+	AudioSink* sink;
+	Segment* seg;
+	int index;
+
+	if ((tmp=tmpfile()) == NULL)
+		fatal_message(ERROR_OUTFILE,"Can't create a temporary file\n");
+
+	dba= copyconstructor_Database(my_dba);
+	mb= worker_Mbrola(dba);
+	/* Float segments keep the samples of a float output unclipped */
+	sink= init_FileAudioSink(tmp, RAW_FORMAT, segment_type(), get_voicefreq_Mbrola(mb));
+	set_output_Mbrola(mb, sink);
+
+	while (True)
+    {
+		pthread_mutex_lock(&list->lock);
+		index= list->next++;
+		pthread_mutex_unlock(&list->lock);
+
+		if (index >= nb_segments_Split(list->sp))
+			break;
+
+		seg= segment_Split(list->sp, index);
+		list->files[index]= tmp;
+		list->offsets[index]= ftell(tmp);
+		synthesize_Split(list->sp, index, mb);
+
+		if (ftell(tmp) - list->offsets[index] !=
+			(long) size_AudioType(segment_type()) * (seg->warmup + seg->nb_samples))
+			fatal_message(ERROR_OUTFILE,"Segment %i has a wrong length\n", index);
+    }
+
+	close_AudioSink(sink);
+#ifdef PROFILE
+	add_profile(mb);
+#endif
+	close_Mbrola(mb);
+	dba->close_Database(dba);
+	return tmp;
+}
+
+void process_split(Mbrola* mb)
+/*
+ * Synthesize what remains in the parser of mb on nb_split threads, the
+ * output is the same as with Synthesis up to the end of file
+ */
+{
+	SegmentList list;
+	pthread_t* threads;
+	FILE** tmps;
+	AudioSink* output= (out_sink(mb)) ? out_sink(mb) : output_sink;
+	int16 buffer[2048];
+	float buffer_float[2048];
+	AudioType type= segment_type();
+	Resampler* rs= resampler(mb);     /* The workers don't resample */
+	float* resampled= NULL;
+	int nb_threads= nb_split;
+	int nb_segments;
+	int nb_out;
+	int i;
+
+	/* Errors are fatal in standalone mode */
+	list.sp= init_Split(mb, SPLIT_SILENCE);
+	nb_segments= nb_segments_Split(list.sp);
+	if (nb_segments == 0)
+    {
+		close_Split(list.sp);
+		return;
+    }
+
+	list.files= (FILE**) MBR_malloc(nb_segments * sizeof(FILE*));
+	list.offsets= (long*) MBR_malloc(nb_segments * sizeof(long));
+	list.next= 0;
+	pthread_mutex_init(&list.lock, NULL);
+
+	if (nb_threads > nb_segments)
+		nb_threads= nb_segments;
+
+	threads= (pthread_t*) MBR_malloc(nb_threads * sizeof(pthread_t));
+	tmps= (FILE**) MBR_malloc(nb_threads * sizeof(FILE*));
+	for (i=0; i<nb_threads; i++)
+		if (pthread_create(&threads[i], NULL, split_worker, &list) != 0)
+			fatal_message(ERROR_MEMORYOUT, "Can't create worker thread %i\n", i);
+
+	for (i=0; i<nb_threads; i++)
+		pthread_join(threads[i], (void**) &tmps[i]);
+
+	if (rs)
+    {
+		nb_out= max_output_Resampler(rs, 2048);
+		if (nb_out < max_output_Resampler(rs, rs->nb_taps))
+			nb_out= max_output_Resampler(rs, rs->nb_taps);
+		resampled= (float*) MBR_malloc(nb_out * sizeof(float));
+		reset_Resampler(rs);
+    }
+
+	/* Copy the segments in order, without their warmup */
+	for (i=0; i<nb_segments; i++)
+    {
+		Segment* seg= segment_Split(list.sp, i);
+		int32 to_copy= seg->nb_samples;
+
+		/* A flush ends the utterance, as at the end of Synthesis */
+		if (rs && (i > 0) && seg->after_flush)
+		{
+			nb_out= drain_Resampler(rs, resampled);
+			if (write_float_AudioSink(output, resampled, nb_out) != nb_out)
+				fatal_message(ERROR_OUTFILE,"Can't copy segment %i\n", i);
+			audio_length(mb)+= nb_out;
+		}
+
+		fseek(list.files[i], list.offsets[i] + seg->warmup * size_AudioType(type), SEEK_SET);
+		while (to_copy > 0)
+		{
+			int nb= (to_copy > 2048) ? 2048 : to_copy;
+			bool copied;
+			int k;
+
+			if (type==LIN16)
+				copied= (fread(buffer, sizeof(int16), nb, list.files[i]) == (size_t) nb)
+					&& (write_AudioSink(output, buffer, nb) == nb);
+			else
+			{
+				/* Back from full scale 1.0 to the 16 bits scale of the sinks */
+				copied= (fread(buffer_float, sizeof(float), nb, list.files[i]) == (size_t) nb);
+				for (k=0; k<nb; k++)
+					buffer_float[k]*= 32768.0f;
+				if (rs)
+				{
+					nb_out= run_Resampler(rs, buffer_float, nb, resampled);
+					copied= copied && (write_float_AudioSink(output, resampled, nb_out) == nb_out);
+					audio_length(mb)+= nb_out;
+				}
+				else
+					copied= copied && (write_float_AudioSink(output, buffer_float, nb) == nb);
+			}
+			if (!copied)
+				fatal_message(ERROR_OUTFILE,"Can't copy segment %i\n", i);
+			to_copy-= nb;
+		}
+		if (!rs)
+			audio_length(mb)+= seg->nb_samples;
+    }
+
+	if (rs)
+    {
+		nb_out= drain_Resampler(rs, resampled);
+		if (write_float_AudioSink(output, resampled, nb_out) != nb_out)
+			fatal_message(ERROR_OUTFILE,"Can't copy segment %i\n", nb_segments-1);
+		audio_length(mb)+= nb_out;
+		MBR_free(resampled);
+    }
+
+	for (i=0; i<nb_threads; i++)
+		fclose(tmps[i]);
+
+	pthread_mutex_destroy(&list.lock);
+	MBR_free(tmps);
+	MBR_free(threads);
+	MBR_free(list.offsets);
+	MBR_free(list.files);
+	close_Split(list.sp);
+}
+
+#endif /* THREADS */
+
 void process_one_file(Mbrola* mb, char *file_name)
 /*
  * Send one file on the output
@@ -278,11 +580,16 @@ void process_one_file(Mbrola* mb, char *file_name)
 							   time_ratio, freq_ratio,
 							   comment_symbol, flush_symbol);
 	set_parser_Mbrola(mb,my_parse);
+#ifdef THREADS
+	if (nb_split>0)
+		process_split(mb);
+	else
+#endif
 	do
     {
 		reset_Mbrola(mb);
 		stream_eof=Synthesis(mb);
-		fflush(output_file);
+		flush_AudioSink((out_sink(mb)) ? out_sink(mb) : output_sink);
     }
 	while (stream_eof!=PHO_EOF);
   
@@ -291,6 +598,172 @@ void process_one_file(Mbrola* mb, char *file_name)
 	if (command_file!=stdin) fclose(command_file);
 }
 
+#ifdef THREADS
+
+/*
+ * Parallel mode: each pho_file gives its own output_file. The workers
+ * share my_dba through database copies, and have their own engine
+ */
+
+/* One pho_file -> output_file job */
+typedef struct
+{
+	char* pho_name;
+	char* out_name;
+	int32 nb_samples;
+	double seconds;      /* Processing time */
+} SynthJob;
+
+/* Job list shared by the workers */
+typedef struct
+{
+	SynthJob* jobs;
+	int nb_jobs;
+	int next;              /* Next job to process */
+	pthread_mutex_t lock;
+} JobList;
+
+double now_seconds()
+/* Monotonic clock */
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void process_one_job(Mbrola* mb, SynthJob* job)
+/* Synthesize one pho file in its own audio file, with a correct header */
+{
+	WaveType file_format= find_file_format(job->out_name);
+	FILE* output;
+	AudioSink* sink;
+	double start= now_seconds();
+
+	if ((output=fopen(job->out_name,"wb")) == NULL)
+		fatal_message(ERROR_OUTFILE,"Error with %s output file !\n",job->out_name);
+
+	/* Same audio as a sequential run on a fresh engine */
+	audio_length(mb)=0;
+	forget_Mbrola(mb);
+	sink= init_FileAudioSink(output, file_format, output_type, get_outfreq_Mbrola(mb));
+	if (!sink)
+		fatal_message(ERROR_OUTFILE,"%s can't hold these samples, try -h for help\n",job->out_name);
+	set_output_Mbrola(mb, sink);
+
+	process_one_file(mb, job->pho_name);
+
+	/* Now the length is known */
+	if (!end_AudioSink(sink) || (fclose(output)!=0))
+		fatal_message(ERROR_OUTFILE,"Error writing %s output file !\n",job->out_name);
+	close_AudioSink(sink);
+	set_output_Mbrola(mb, NULL);
+
+	job->nb_samples= audio_length(mb);
+	job->seconds= now_seconds() - start;
+}
+
+void* main_worker(void* arg)
+/* Take the jobs one by one until the list is exhausted */
+{
+	JobList* list= (JobList*) arg;
+	Database* dba;
+	Mbrola* mb;
+	int index;
+
+	/* Private file handler on the shared database */
+	dba= copyconstructor_Database(my_dba);
+	mb= worker_Mbrola(dba);
+	set_outfreq_Mbrola(mb,out_freq);
+
+	while (True)
+    {
+		pthread_mutex_lock(&list->lock);
+		index= list->next++;
+		pthread_mutex_unlock(&list->lock);
+
+		if (index >= list->nb_jobs)
+			break;
+		process_one_job(mb, &list->jobs[index]);
+    }
+
+#ifdef PROFILE
+	add_profile(mb);
+#endif
+	close_Mbrola(mb);
+	dba->close_Database(dba);
+	return NULL;
+}
+
+void process_parallel(char** names, int nb_names)
+/*
+ * names are pho_file output_file pairs, processed on nb_workers threads.
+ * The throughput is reported on stderr
+ */
+{
+	JobList list;
+	pthread_t* threads;
+	int32 total=0;
+	double start;
+	double seconds;
+	int i;
+
+	if ((nb_names==0) || (nb_names%2 != 0))
+		fatal_message(ERROR_COMMANDLINE,
+					  "-j needs pho_file output_file pairs, try -h for help\n");
+
+	list.nb_jobs= nb_names/2;
+	list.jobs= (SynthJob*) MBR_malloc(list.nb_jobs * sizeof(SynthJob));
+	list.next= 0;
+	pthread_mutex_init(&list.lock, NULL);
+
+	for (i=0; i<list.nb_jobs; i++)
+    {
+		list.jobs[i].pho_name= names[2*i];
+		list.jobs[i].out_name= names[2*i+1];
+		list.jobs[i].nb_samples= 0;
+		list.jobs[i].seconds= 0.0;
+
+		/* Concurrent outputs can't be a pipe, and need their header patched */
+		if (!strncmp(list.jobs[i].out_name,PIPESYMB,1))
+			fatal_message(ERROR_COMMANDLINE,
+						  "No " PIPESYMB " output with -j, try -h for help\n");
+    }
+
+	if (nb_workers > list.nb_jobs)
+		nb_workers= list.nb_jobs;
+
+	start= now_seconds();
+	threads= (pthread_t*) MBR_malloc(nb_workers * sizeof(pthread_t));
+	for (i=0; i<nb_workers; i++)
+		if (pthread_create(&threads[i], NULL, main_worker, &list) != 0)
+			fatal_message(ERROR_MEMORYOUT, "Can't create worker thread %i\n", i);
+
+	for (i=0; i<nb_workers; i++)
+		pthread_join(threads[i], NULL);
+	seconds= now_seconds() - start;
+
+	/* Per job and aggregate throughput, x real time */
+	for (i=0; i<list.nb_jobs; i++)
+    {
+		SynthJob* job= &list.jobs[i];
+		double audio= (double) job->nb_samples / get_outfreq_Mbrola(my_brole);
+
+		fprintf(stderr, "%s: %li samples in %.3fs (%.1fx)\n",
+				job->out_name, (long) job->nb_samples, job->seconds,
+				(job->seconds>0.0) ? audio/job->seconds : 0.0);
+		total+= job->nb_samples;
+    }
+	fprintf(stderr, "%i files on %i threads: %li samples in %.3fs (%.1fx)\n",
+			list.nb_jobs, nb_workers, (long) total, seconds,
+			(seconds>0.0) ? (double) total / get_outfreq_Mbrola(my_brole) / seconds : 0.0);
+
+	pthread_mutex_destroy(&list.lock);
+	MBR_free(threads);
+	MBR_free(list.jobs);
+}
+
+#endif /* THREADS */
 
 /* 
  * Function name says all !
@@ -301,11 +774,16 @@ int main(int argc, char **argv)
 	int argpos;
 	int c;
 	bool info=False;           /* True if textual information requested */
+	bool hanning=False;        /* True to window the frames at loading */
 
 #ifdef ROMDATABASE_STORE
 	bool romdatabase_store= False; /* True if we build a ROM dump */ 
 #endif
 
+#if defined(ROMDATABASE_IMAGE) && defined(ROMDATABASE_STORE)
+	char* image_store= NULL;       /* Name of the shared ROM image to build */
+#endif
+
 #ifdef ROMDATABASE_INIT
 	void *romdatabase_pointer=NULL; /* Pointer to a ROM dump: used for debugging */
 	bool romdatabase_init= False;   /* True if the dba is a ROM dump */
@@ -366,7 +844,7 @@ int main(int argc, char **argv)
     }
 
 	/* Read the switches */
-	while ((c=getopt(argc, argv, "+v:t:f:l:c:F:R:C:I:shiewW"))>0)
+	while ((c=getopt(argc, argv, "+v:t:f:l:b:r:c:F:R:C:I:j:J:S:shiewWPH"))>0)
 		switch(c)
 		{
 		case 'i':
@@ -401,6 +879,29 @@ int main(int argc, char **argv)
 			set_voice_len(optarg);
 			break;
 
+		case 'b':
+			if (strcmp(optarg,"16")==0)
+				output_type=LIN16;
+			else if (strcmp(optarg,"24")==0)
+				output_type=LIN24;
+			else if (strcmp(optarg,"float")==0)
+				output_type=FLOAT32;
+			else
+			{
+				printf("Error in the sample type : %s\n",optarg);
+				return 1;
+			}
+			break;
+
+		case 'r':
+			if ( (atoi(optarg)<1000) || (atoi(optarg)>65535) )
+			{
+				printf("Error in the sample rate : %s\n",optarg);
+				return 1;
+			}
+			out_freq= (uint16) atoi(optarg);
+			break;
+
 		case 'C':
 			parse_ZStringList(clone_list, optarg, True);
 			break;
@@ -416,6 +917,39 @@ int main(int argc, char **argv)
 		case 's':
 			smoothing=False;
 			break;
+
+		case 'H':
+			hanning=True;
+			break;
+
+#ifdef THREADS
+		case 'j':
+			if ((nb_workers=atoi(optarg))<=0)
+			{
+				printf("Error in the number of threads : %s\n",optarg);
+				return 1;
+			}
+			break;
+
+		case 'J':
+			if ((nb_split=atoi(optarg))<=0)
+			{
+				printf("Error in the number of threads : %s\n",optarg);
+				return 1;
+			}
+			break;
+#else
+		case 'j':
+		case 'J':
+			printf("Error, option %c needs a build with THREADS\n",c);
+			return 1;
+#endif
+
+#ifdef PROFILE
+		case 'P':
+			profile_report=True;
+			break;
+#endif
 		  
 		case 'h':
 			printf("\n"
@@ -431,17 +965,37 @@ int main(int argc, char **argv)
 				   "-v VR = VOLUME ratio, float ratio applied to ouput samples\n", argv[0]);
             printf("-f FR = FREQ ratio, float ratio applied to pitch points\n"
 				   "-t TR = TIME ratio, float ratio applied to phone durations\n"
-				   "-l VF = VOICE freq, target freq for voice quality\n"
+				   "-l VF = VOICE freq, target freq for voice quality\n");
+			printf("-b BT = samples of the output: 16 (default), 24 or float\n"
+				   "        (float in raw, wav and au files only)\n"
+				   "-r SR = sample rate of the output, resampled from the voice freq\n"
 				   "-R RL = Phoneme RENAME list of the form ""a A b B ...""\n"
 				   "-C CL = Phoneme CLONE list of the form ""a A b B ...""\n\n"
 				   "-I IF = Initialization file containing one command per line\n"
 				   "        CLONE, RENAME, VOICE, TIME, FREQ, VOLUME, FLUSH, COMMENT,\n"
-				   "        and IGNORE are available\n"
+				   "        and IGNORE are available\n");
+			printf("-H    = window the frames of the database once at loading:\n"
+				   "        faster, but 4 times the memory of the waves\n");
+			printf(
+#ifdef THREADS
+				   "-j N  = N threads, the arguments are then pho_file output_file pairs\n"
+				   "-J N  = N threads for each pho_file, split at flushes and long silences\n"
+#endif
+#ifdef PROFILE
+				   "-P    = time spent in each stage of the synthesis, on stderr\n"
+#endif
 #ifdef ROMDATABASE_STORE
 				   "-W    = store the datbase in ROM format\n"
 #endif
 #ifdef ROMDATABASE_INIT
 				   "-w    = the database in a ROM dump\n"
+#endif
+#if defined(ROMDATABASE_IMAGE) && defined(ROMDATABASE_STORE)
+				   "-S IM = store the database in a ROM image shared between\n"
+				   "        processes: a file, or shm:/name for shared memory\n"
+#endif
+#if defined(ROMDATABASE_IMAGE) && defined(ROMDATABASE_INIT)
+				   "A database named shm:/name or file.rom is a mapped ROM image\n"
 #endif
 				   "\n");
 			return 0;
@@ -454,6 +1008,11 @@ int main(int argc, char **argv)
 		case 'w':
 			romdatabase_init=True;
 			break;
+#endif
+#if defined(ROMDATABASE_IMAGE) && defined(ROMDATABASE_STORE)
+		case 'S':
+			image_store= optarg;
+			break;
 #endif
 		default:
 			printf("Error, option %c not recognized, try -h for help\n",c);
@@ -466,7 +1025,17 @@ int main(int argc, char **argv)
 		fatal_message(ERROR_COMMANDLINE,
 					  "Not enough arguments, try -h for help\n");
   
-#ifdef ROMDATABASE_INIT
+#if defined(ROMDATABASE_INIT) && defined(ROMDATABASE_IMAGE)
+	if (romdatabase_init)
+    {
+		char out_name[1024];
+		sprintf( out_name, "%s.rom", argv[argpos] );
+
+		/* Mapped read-only and used in place, pages shared with other processes */
+		my_dba= init_ROM_Image(out_name);
+    }
+	else
+#elif defined(ROMDATABASE_INIT)
 	if (romdatabase_init)
     {
 		long rom_size;
@@ -491,8 +1060,8 @@ int main(int argc, char **argv)
 		my_dba= init_ROM_Database(romdatabase_pointer);
     }
 	else
-		/* else normal initialization */
 #endif
+		/* else normal initialization (maps shm:/name and .rom images) */
     {
 #ifndef ROMDATABASE_PURE
 		/* initialize the database with rename and clone */
@@ -506,6 +1075,10 @@ int main(int argc, char **argv)
 					  "All database initializations failed\n");
     }
   
+	/* Before any copy or ROM dump of the database */
+	if (hanning && !window_Database(my_dba))
+		fatal_message(ERROR_PHOREADING, "Can't window the frames of %s\n", dbaname(my_dba));
+
 	/* not usefull anymore */
 	if (rename_list)
 		close_ZStringList(rename_list);
@@ -523,6 +1096,15 @@ int main(int argc, char **argv)
 		fprintf(stderr, "ROM image saved in %s\n", out_name);      
     }
 #endif  /* ROMDATABASE_STORE */
+
+#if defined(ROMDATABASE_IMAGE) && defined(ROMDATABASE_STORE)
+	if (image_store)
+    {
+		/* Written once, mapped by any number of processes */
+		if (store_ROM_Image( my_dba, image_store))
+			fprintf(stderr, "ROM image saved in %s\n", image_store);
+    }
+#endif
   
 	/* do not connect any parser yet */
 	my_pitch= (float)Freq(my_dba) / (float)MBRPeriod(my_dba);
@@ -533,6 +1115,9 @@ int main(int argc, char **argv)
   
 	if (voice_len!=0)
 		set_voicefreq_Mbrola(my_brole,voice_len);
+
+	/* Fatal if the ratio can't be resampled */
+	set_outfreq_Mbrola(my_brole,out_freq);
   
 	if (info)
     {
@@ -553,6 +1138,11 @@ int main(int argc, char **argv)
 		}
     }
   
+#ifdef THREADS
+	if (nb_workers>0)
+		process_parallel(&argv[argpos+1], argc-argpos-1);
+	else
+#endif
 	if (argpos+2 >= argc)
     {
 		/* Not fatal so that we close everything before leaping */
@@ -561,6 +1151,8 @@ int main(int argc, char **argv)
     }
 	else
     {
+		FILE* output_file;
+
 		/* A - as output file means STDOUT -> may be followed by a format switch */
 		if (!strncmp(argv[argc-1],PIPESYMB,1))
 			output_file=stdout;
@@ -571,11 +1163,12 @@ int main(int argc, char **argv)
 		 * The stream header ( length is unknown at this time )
 		 */
 		file_format=find_file_format(argv[argc-1]);
-      
-		write_header(file_format,
-					 audio_length(my_brole),
-					 get_voicefreq_Mbrola(my_brole),
-					 output_file);
+		output_sink= init_FileAudioSink(output_file,
+										file_format,
+										output_type,
+										get_outfreq_Mbrola(my_brole));
+		if (!output_sink)
+			fatal_message(ERROR_OUTFILE,"%s can't hold these samples, try -h for help\n",argv[argc-1]);
       
 		/* Process the files one by one */
 		argpos++;  
@@ -583,21 +1176,21 @@ int main(int argc, char **argv)
 			process_one_file(my_brole, argv[argpos++]);
       
 		/* 
-		 * Close the streams and make correction on the header if possible
+		 * Make correction on the header if the output is seekable (a 
+		 * redirected stdout may be), then close the streams
 		 */
-		if (output_file!=stdout) 
-		{ /* Go to the begining of the output and write the complete header 
-		   *	( we now know the audio_length)
-		   */
-			fseek(output_file,0,SEEK_SET); 
-			write_header(file_format,
-						 audio_length(my_brole),
-						 get_voicefreq_Mbrola(my_brole),
-						 output_file);
-			fclose(output_file);
-		}
+		if (!end_AudioSink(output_sink) 
+			|| ((output_file!=stdout) && (fclose(output_file)!=0)))
+			fatal_message(ERROR_OUTFILE,"Error writing %s output file !\n",argv[argc-1]);
+		close_AudioSink(output_sink);
+		output_sink=NULL;
     }
   
+#ifdef PROFILE
+	add_profile(my_brole);
+	if (profile_report)
+		print_profile();
+#endif
 	close_Mbrola(my_brole);		       /* Close the engine */
 	my_dba->close_Database(my_dba);  /* ... the database */
   
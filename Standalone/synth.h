@@ -25,12 +25,13 @@
 #define _SYNTH_H
 
 #include "common.h"
+#include "audio.h"
 
 /* 
  * In standalone mode, input and ouput through files
  */
 extern FILE *command_file; /* File providing the phonetic input (can be stdin) */ 
-extern FILE *output_file;  /* Audio output file (can be stdout)  */
+extern AudioSink *output_sink;  /* Audio output (file, can be stdout)  */
 
 /* used in standalone compilation mode */
 extern int main(int argc, char **argv);
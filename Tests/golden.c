@@ -0,0 +1,736 @@
+/*
+ * FPMs-TCTS SOFTWARE LIBRARY
+ *
+ * Copyright (c) 1995-2018 Faculte Polytechnique de Mons (TCTS lab)
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * File:  golden.c
+ * Purpose: regression test of the audio against golden outputs
+ *
+ * 19/10/26: Created
+ *
+ *   USAGE: golden [-u] [-s dir] [-c dir] [-t snr] mbrola voice workdir
+ *                 golden.txt corpus.pho+
+ *
+ *   Synthesizes each corpus with the library (readtype_MBR and push_MBR,
+ *   the LIBRARY build of the engine) for every AudioType, and with the
+ *   standalone program for every sample type and file format, plain,
+ *   resampled, louder (saturated), split on threads (-J) and with windowed
+ *   frames (-H). Each output must have the CRC-32 and length stored in
+ *   golden.txt (-u writes them instead), and be close enough to another
+ *   output of the same run: identical samples for the same type by another
+ *   path (push_MBR, the standalone files), or at least a signal to noise
+ *   ratio for another type (e.g. 30 dB for ULAW against LIN16). The maximum
+ *   difference and the SNR are reported for the failures. The library
+ *   must have smoothed some frames at the diphone junctions (the smoothed
+ *   OLA kernels are tested too).
+ *
+ *   The golden CRCs are those of a little endian build with IEEE floats.
+ *   For an optimization that can't be bit exact, save the outputs of the
+ *   reference build with -s dir, then check the new build with -c dir: a
+ *   new CRC is accepted when the SNR against the saved output is at least
+ *   -t snr dB (90 by default).
+ *
+ * 19/10/26: fails when the corpus smooths no frame (EngineMetrics.smoothed)
+ * 19/10/26: resampled aif file, the sample rate of its header is checked
+ * 19/10/26: the -J cases are skipped without THREADS, as mbrola -J, and
+ *           -u keeps their golden CRCs
+ * 19/10/26: diphones of 0 frames in the corpus, the resampled mbrola has
+ *           no library reference
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "common.h"
+#include "parser_export.h"
+#include "audio.h"
+#include "onechannel.h"
+
+/* Read samples in one go */
+#define CHUNK 4096
+
+/* How an output is compared with the reference case */
+#define IDENTICAL 0.0       /* Same samples */
+#define NO_CHECK -1.0       /* Golden CRC only */
+
+typedef struct
+{
+	char* name;          /* Case in the golden file, after the corpus */
+	bool cli;            /* Standalone program, or the library */
+	char* format;        /* raw, wav, au or aif; read or push for the library */
+	AudioType type;
+	int out_freq;        /* Resampling, 0 means the voice freq */
+	float volume;
+	char* options;       /* More switches of the standalone program */
+	char* reference;     /* Case compared with, NULL if none */
+	double min_snr;      /* dB against the reference, or IDENTICAL, NO_CHECK */
+} Case;
+
+static Case cases[]= {
+	{ "lib-lin16",       False, "read", LIN16,   0,     1.0f, "",      NULL,              NO_CHECK },
+	{ "lib-float",       False, "read", FLOAT32, 0,     1.0f, "",      "lib-lin16",       60.0 },
+	{ "lib-lin24",       False, "read", LIN24,   0,     1.0f, "",      "lib-float",       100.0 },
+	{ "lib-lin8",        False, "read", LIN8,    0,     1.0f, "",      "lib-lin16",       15.0 },
+	{ "lib-ulaw",        False, "read", ULAW,    0,     1.0f, "",      "lib-lin16",       30.0 },
+	{ "lib-alaw",        False, "read", ALAW,    0,     1.0f, "",      "lib-lin16",       30.0 },
+	{ "lib-push-lin16",  False, "push", LIN16,   0,     1.0f, "",      "lib-lin16",       IDENTICAL },
+	{ "lib-push-float",  False, "push", FLOAT32, 0,     1.0f, "",      "lib-float",       IDENTICAL },
+	{ "lib-r22050-lin16",False, "read", LIN16,   22050, 1.0f, "",      NULL,              NO_CHECK },
+	{ "lib-r22050-float",False, "read", FLOAT32, 22050, 1.0f, "",      "lib-r22050-lin16",60.0 },
+	{ "lib-loud-lin16",  False, "read", LIN16,   0,     6.0f, "",      NULL,              NO_CHECK },
+	{ "lib-loud-float",  False, "read", FLOAT32, 0,     6.0f, "",      NULL,              NO_CHECK },
+	/*
+	 * The LIBRARY build pads the periods longer than the frames at
+	 * another place than the standalone program (see OverLapAdd), and
+	 * reads again the last frame for a diphone of 0 frames, so mbrola
+	 * has its own references
+	 */
+	{ "cli-raw-16",      True,  "raw",  LIN16,   0,     1.0f, "",      NULL,              NO_CHECK },
+	{ "cli-raw-float",   True,  "raw",  FLOAT32, 0,     1.0f, "",      "cli-raw-16",      60.0 },
+	{ "cli-raw-24",      True,  "raw",  LIN24,   0,     1.0f, "",      "cli-raw-float",   100.0 },
+	{ "cli-wav-16",      True,  "wav",  LIN16,   0,     1.0f, "",      "cli-raw-16",      IDENTICAL },
+	{ "cli-wav-24",      True,  "wav",  LIN24,   0,     1.0f, "",      "cli-raw-24",      IDENTICAL },
+	{ "cli-wav-float",   True,  "wav",  FLOAT32, 0,     1.0f, "",      "cli-raw-float",   IDENTICAL },
+	{ "cli-au-16",       True,  "au",   LIN16,   0,     1.0f, "",      "cli-raw-16",      IDENTICAL },
+	{ "cli-au-24",       True,  "au",   LIN24,   0,     1.0f, "",      "cli-raw-24",      IDENTICAL },
+	{ "cli-au-float",    True,  "au",   FLOAT32, 0,     1.0f, "",      "cli-raw-float",   IDENTICAL },
+	{ "cli-aif-16",      True,  "aif",  LIN16,   0,     1.0f, "",      "cli-raw-16",      IDENTICAL },
+	{ "cli-aif-24",      True,  "aif",  LIN24,   0,     1.0f, "",      "cli-raw-24",      IDENTICAL },
+	{ "cli-r22050-16",   True,  "raw",  LIN16,   22050, 1.0f, "",      NULL,              NO_CHECK },
+	{ "cli-aif-r22050-16",True, "aif",  LIN16,   22050, 1.0f, "",      "cli-r22050-16",   IDENTICAL },
+	{ "cli-loud-16",     True,  "raw",  LIN16,   0,     6.0f, "",      NULL,              NO_CHECK },
+	{ "cli-J2-16",       True,  "raw",  LIN16,   0,     1.0f, "-J 2 ", "cli-raw-16",      IDENTICAL },
+	{ "cli-J2-r22050-16",True,  "raw",  LIN16,   22050, 1.0f, "-J 2 ", "cli-r22050-16",   IDENTICAL },
+	/* Frames windowed at loading, the volume comes after the OLA */
+	{ "cli-H-16",        True,  "raw",  LIN16,   0,     1.0f, "-H ",   "cli-raw-16",      90.0 },
+	{ "cli-H-loud-16",   True,  "raw",  LIN16,   0,     6.0f, "-H ",   "cli-loud-16",     90.0 },
+	{ NULL }
+};
+
+/* Output of a case */
+typedef struct
+{
+	char* bytes;         /* Whole file, or the samples of the library */
+	long size;
+	long offset;         /* Position of the samples in bytes */
+	bool big_endian;     /* Samples of au and aif files */
+	long rate;           /* Sample rate in an aif header, 0 if none */
+	Counter smoothed;    /* Frames smoothed by the library */
+} Output;
+
+/* Golden CRCs */
+typedef struct
+{
+	char name[128];
+	unsigned long crc;
+	long size;
+} Golden;
+
+static Golden* goldens=NULL;
+static int nb_goldens=0;
+
+static unsigned long crc32(char* bytes, long size)
+/* CRC-32 of zlib and PNG */
+{
+	static unsigned long table[256];
+	static bool ready=False;
+	unsigned long crc=0xFFFFFFFFUL;
+	long i;
+
+	if (!ready)
+	{
+		int n, k;
+
+		for (n=0; n<256; n++)
+		{
+			unsigned long c= (unsigned long) n;
+
+			for (k=0; k<8; k++)
+				c= (c & 1) ? (0xEDB88320UL ^ (c >> 1)) : (c >> 1);
+			table[n]= c;
+		}
+		ready=True;
+	}
+
+	for (i=0; i<size; i++)
+		crc= table[(crc ^ (unsigned char) bytes[i]) & 0xFF] ^ (crc >> 8);
+	return (crc ^ 0xFFFFFFFFUL) & 0xFFFFFFFFUL;
+}
+
+static char* read_file(char* name, long* size)
+/* Whole content of a file, NULL if it can't be read */
+{
+	FILE* input= fopen(name, "rb");
+	char* bytes;
+
+	if (!input)
+		return NULL;
+
+	fseek(input, 0, SEEK_END);
+	*size= ftell(input);
+	fseek(input, 0, SEEK_SET);
+
+	bytes= (char*) malloc(*size + 1);
+	if (fread(bytes, 1, *size, input) != (size_t) *size)
+	{
+		free(bytes);
+		bytes= NULL;
+	}
+	else
+		bytes[*size]= 0;
+
+	fclose(input);
+	return bytes;
+}
+
+static void append(Output* out, void* samples, long nb_bytes)
+/* Library samples at the end of the output */
+{
+	out->bytes= (char*) realloc(out->bytes, out->size + nb_bytes);
+	memcpy(out->bytes + out->size, samples, nb_bytes);
+	out->size+= nb_bytes;
+}
+
+static int push_output(void* user_data, PushEvent event, void* buffer, int nb_samples, AudioType sample_type)
+/* Audio of each diphone at the end of the output */
+{
+	if (event == PUSH_AUDIO)
+		append((Output*) user_data, buffer, (long) nb_samples * size_AudioType(sample_type));
+	return 0;
+}
+
+static bool flushed(char* text)
+/* True if the last line of the text is a flush */
+{
+	char* end= text + strlen(text);
+
+	while ((end > text) && ((end[-1] == '\n') || (end[-1] == '\r') || (end[-1] == ' ')))
+		end--;
+	while ((end > text) && (end[-1] != '\n'))
+		end--;
+	return *end == '#';
+}
+
+static bool run_library(Case* c, char* voice, char* pho, Output* out)
+/*
+ * The corpus through LibOneChannel, False on error. The end of the file
+ * is a flush for mbrola, not for the library
+ */
+{
+	bool ok=True;
+	bool flush= !flushed(pho);
+
+	if (init_MBR(voice) < 0)
+		return False;
+	setNoError_MBR(1);
+	setVolumeRatio_MBR(c->volume);
+	if (!setOutFreq_MBR(c->out_freq))
+	{
+		close_MBR();
+		return False;
+	}
+
+	if (strcmp(c->format, "push") == 0)
+		ok= (write_MBR(pho) == (int) strlen(pho))
+			&& (!flush || (write_MBR("\n#\n") == 3))
+			&& (push_MBR(push_output, out, c->type) >= 0);
+	else
+	{
+		/* One utterance at a time, readtype_MBR stops at the flushes */
+		char buffer[CHUNK * sizeof(float)];
+		char* start= pho;
+
+		while (ok && *start)
+		{
+			char* end= strstr(start, "\n#");
+			char saved;
+			int nb;
+
+			end= (end) ? strchr(end + 1, '\n') : NULL;
+			end= (end) ? end + 1 : start + strlen(start);
+			saved= *end;
+			*end= 0;
+			ok= (write_MBR(start) == (int) strlen(start));
+			*end= saved;
+			if (ok && flush && !*end)
+				ok= (write_MBR("\n#\n") == 3);
+
+			while (ok && ((nb= readtype_MBR(buffer, CHUNK, c->type)) > 0))
+				append(out, buffer, (long) nb * size_AudioType(c->type));
+			ok= ok && (nb == 0);
+			start= end;
+		}
+	}
+
+	if (ok)
+	{
+		EngineMetrics metrics;
+
+		getMetrics_MBR(&metrics, NULL);
+		out->smoothed= metrics.smoothed;
+	}
+	close_MBR();
+	return ok;
+}
+
+static long find_chunk(Output* out, char* tag, bool big_endian, long* size)
+/* Position of the content of a RIFF or IFF chunk, 0 if none */
+{
+	long pos=12;
+
+	while (pos + 8 <= out->size)
+	{
+		unsigned char* p= (unsigned char*) out->bytes + pos + 4;
+
+		*size= (big_endian)
+			? ((long) p[0] << 24) | ((long) p[1] << 16) | ((long) p[2] << 8) | p[3]
+			: ((long) p[3] << 24) | ((long) p[2] << 16) | ((long) p[1] << 8) | p[0];
+		if (strncmp(out->bytes + pos, tag, 4) == 0)
+			return pos + 8;
+		pos+= 8 + *size + (*size & 1);
+	}
+	return 0;
+}
+
+static bool run_cli(Case* c, char* mbrola, char* voice, char* pho_name,
+					char* workdir, Output* out)
+/* The corpus through the standalone program, False on error */
+{
+	static char* types[]= { "16", "", "", "", "float", "24" };
+	char command[4096];
+	char name[1024];
+	long size;
+
+	sprintf(name, "%s/golden.%s", workdir, c->format);
+	sprintf(command, "%s -e -b %s -v %g %s", mbrola, types[c->type], c->volume, c->options);
+	if (c->out_freq)
+		sprintf(command + strlen(command), " -r %i", c->out_freq);
+	sprintf(command + strlen(command), " %s %s %s", voice, pho_name, name);
+
+	remove(name);
+	if (system(command) != 0)
+		return False;
+
+	out->bytes= read_file(name, &out->size);
+	remove(name);
+	if (!out->bytes)
+		return False;
+
+	/* Skip the header */
+	if (strcmp(c->format, "wav") == 0)
+		out->offset= find_chunk(out, "data", False, &size);
+	else if (strcmp(c->format, "aif") == 0)
+	{
+		long comm;
+
+		out->big_endian= True;
+		out->offset= find_chunk(out, "SSND", True, &size);
+		if (out->offset)
+			out->offset+= 8;   /* offset and block size */
+
+		/* 80 bits extended rate after the channels, frames and sample size */
+		comm= find_chunk(out, "COMM", True, &size);
+		if (comm && (size >= 18))
+		{
+			unsigned char* p= (unsigned char*) out->bytes + comm + 8;
+			int exponent= ((p[0] & 0x7F) << 8) | p[1];
+			unsigned long mantissa= ((unsigned long) p[2] << 24) | ((unsigned long) p[3] << 16)
+				| ((unsigned long) p[4] << 8) | p[5];
+
+			if ((exponent >= 16383) && (exponent <= 16383+31))
+				out->rate= (long) (mantissa >> (16383+31-exponent));
+		}
+	}
+	else if (strcmp(c->format, "au") == 0)
+	{
+		unsigned char* p= (unsigned char*) out->bytes + 4;
+
+		out->big_endian= True;
+		out->offset= ((long) p[0] << 24) | ((long) p[1] << 16) | ((long) p[2] << 8) | p[3];
+	}
+	return (out->offset >= 0) && (out->offset <= out->size)
+		&& ((strcmp(c->format, "raw") == 0) || (out->offset > 0));
+}
+
+static bool native_big_endian(void)
+{
+	int16 one=1;
+	return *(char*) &one == 0;
+}
+
+static double ulaw_value(unsigned char code)
+/* G.711 mu-law decoder */
+{
+	int t;
+
+	code= ~code;
+	t= ((code & 0x0F) << 3) + 0x84;
+	t<<= (code & 0x70) >> 4;
+	return (code & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+static double alaw_value(unsigned char code)
+/* G.711 A-law decoder */
+{
+	int t, seg;
+
+	code^= 0x55;
+	t= (code & 0x0F) << 4;
+	seg= (code & 0x70) >> 4;
+	if (seg == 0)
+		t+= 8;
+	else
+		t= (t + 0x108) << (seg - 1);
+	return (code & 0x80) ? t : -t;
+}
+
+static double* decode(Case* c, Output* out, long* nb)
+/* Samples of the output on the 16 bits scale */
+{
+	int size= size_AudioType(c->type);
+	unsigned char* p= (unsigned char*) out->bytes + out->offset;
+	bool swap= (out->big_endian != native_big_endian());
+	double* samples;
+	long i;
+
+	*nb= (out->size - out->offset) / size;
+	samples= (double*) malloc((*nb + 1) * sizeof(double));
+
+	for (i=0; i<*nb; i++, p+=size)
+	{
+		unsigned char b[4];
+		int k;
+
+		for (k=0; k<size; k++)
+			b[k]= (swap) ? p[size-1-k] : p[k];
+
+		switch (c->type)
+		{
+		case LIN16:
+		{
+			int16 value;
+			memcpy(&value, b, 2);
+			samples[i]= value;
+			break;
+		}
+		case LIN8:
+			samples[i]= ((int) b[0] - 128) * 256.0;
+			break;
+		case ULAW:
+			samples[i]= ulaw_value(b[0]);
+			break;
+		case ALAW:
+			samples[i]= alaw_value(b[0]);
+			break;
+		case FLOAT32:
+		{
+			float value;
+			memcpy(&value, b, 4);
+			samples[i]= value * 32768.0;
+			break;
+		}
+		case LIN24:
+		{
+			/* Native order on 3 bytes, most significant first in big endian */
+			long value= (native_big_endian())
+				? ((long) b[0] << 16) | ((long) b[1] << 8) | b[2]
+				: ((long) b[2] << 16) | ((long) b[1] << 8) | b[0];
+			if (value & 0x800000L)
+				value-= 0x1000000L;
+			samples[i]= value / 256.0;
+			break;
+		}
+		}
+	}
+	return samples;
+}
+
+static bool compare(Case* c, Output* out, Case* ref_case, Output* ref,
+					double* max_diff, double* snr)
+/* Max difference and SNR of the output against the reference, False if the lengths differ */
+{
+	long nb, nb_ref, i;
+	double* samples= decode(c, out, &nb);
+	double* reference= decode(ref_case, ref, &nb_ref);
+	double signal=0.0, noise=0.0;
+
+	*max_diff=0.0;
+	for (i=0; (i<nb) && (i<nb_ref); i++)
+	{
+		double diff= fabs(samples[i] - reference[i]);
+
+		if (diff > *max_diff)
+			*max_diff= diff;
+		signal+= reference[i] * reference[i];
+		noise+= diff * diff;
+	}
+	*snr= (noise > 0.0) ? 10.0 * log10(signal / noise) : 999.0;
+
+	free(samples);
+	free(reference);
+	return nb == nb_ref;
+}
+
+static Golden* find_golden(char* name)
+{
+	int i;
+
+	for (i=0; i<nb_goldens; i++)
+		if (strcmp(goldens[i].name, name) == 0)
+			return &goldens[i];
+	return NULL;
+}
+
+static void read_goldens(char* name)
+/* Lines "corpus/case crc size", # starts a comment */
+{
+	FILE* input= fopen(name, "r");
+	char line[256];
+
+	if (!input)
+		return;
+	while (fgets(line, sizeof(line), input))
+	{
+		Golden g;
+
+		if ((line[0] != '#') && (sscanf(line, "%127s %lx %li", g.name, &g.crc, &g.size) == 3))
+		{
+			goldens= (Golden*) realloc(goldens, (nb_goldens + 1) * sizeof(Golden));
+			goldens[nb_goldens++]= g;
+		}
+	}
+	fclose(input);
+}
+
+static char* base_name(char* path)
+/* File name without directory nor extension, in a static buffer */
+{
+	static char name[256];
+	char* start= strrchr(path, '/');
+	char* dot;
+
+	strncpy(name, (start) ? start + 1 : path, sizeof(name) - 1);
+	name[sizeof(name) - 1]= 0;
+	dot= strrchr(name, '.');
+	if (dot)
+		*dot= 0;
+	return name;
+}
+
+int main(int argc, char **argv)
+{
+	bool update=False;
+	char* save_dir=NULL;
+	char* compare_dir=NULL;
+	double min_snr=90.0;
+	char *mbrola, *voice, *workdir, *golden_name;
+	FILE* golden_out=NULL;
+	int nb_cases=0, nb_failed=0;
+	int first, f, i;
+
+	for (first=1; (first < argc) && (argv[first][0] == '-'); first++)
+	{
+		switch (argv[first][1])
+		{
+		case 'u': update=True; break;
+		case 's': save_dir= argv[++first]; break;
+		case 'c': compare_dir= argv[++first]; break;
+		case 't': min_snr= atof(argv[++first]); break;
+		default: first= argc; break;
+		}
+	}
+
+	if (argc - first < 5)
+	{
+		fprintf(stderr, "USAGE: %s [-u] [-s dir] [-c dir] [-t snr] mbrola voice workdir golden.txt corpus.pho+\n",
+				argv[0]);
+		return 1;
+	}
+	mbrola= argv[first];
+	voice= argv[first+1];
+	workdir= argv[first+2];
+	golden_name= argv[first+3];
+
+	/* Read before -u rewrites it: the cases this build skips keep their CRCs */
+	read_goldens(golden_name);
+	if (update)
+	{
+		golden_out= fopen(golden_name, "w");
+		if (!golden_out)
+		{
+			fprintf(stderr, "Can't write %s\n", golden_name);
+			return 1;
+		}
+		fprintf(golden_out, "# Golden outputs of Tests/golden.c: corpus/case CRC-32 bytes\n");
+	}
+
+	for (f=first+4; f<argc; f++)
+	{
+		Output outputs[sizeof(cases) / sizeof(cases[0])];
+		char corpus[256];
+		long size;
+		char* pho= read_file(argv[f], &size);
+
+		if (!pho)
+		{
+			fprintf(stderr, "Can't read %s\n", argv[f]);
+			return 1;
+		}
+		strcpy(corpus, base_name(argv[f]));
+
+		for (i=0; cases[i].name; i++)
+		{
+			Case* c= &cases[i];
+			Output* out= &outputs[i];
+			char name[512];
+			char message[4096];
+			unsigned long crc;
+			bool ok, failed=False;
+			Golden* golden;
+
+			sprintf(name, "%s/%s", corpus, c->name);
+			memset(out, 0, sizeof(Output));
+			message[0]= 0;
+
+#ifndef THREADS
+			/* mbrola -J needs THREADS, as this build */
+			if (strstr(c->options, "-J"))
+			{
+				printf("skip %s: no THREADS\n", name);
+				if (update && (golden= find_golden(name)))
+					fprintf(golden_out, "%s %08lx %li\n", name, golden->crc, golden->size);
+				continue;
+			}
+#endif
+			nb_cases++;
+
+			ok= (c->cli) ? run_cli(c, mbrola, voice, argv[f], workdir, out)
+				: run_library(c, voice, pho, out);
+			if (!ok)
+			{
+				printf("FAIL %s: synthesis error\n", name);
+				nb_failed++;
+				if (!out->bytes)
+					out->bytes= (char*) malloc(1);
+				continue;
+			}
+			crc= crc32(out->bytes, out->size);
+
+			/* The corpus must reach the smoothed OLA, or it isn't tested */
+			if (!c->cli && (out->smoothed == 0))
+			{
+				sprintf(message, "no frame smoothed");
+				failed=True;
+			}
+
+			/* The header must give the rate of the resampled samples */
+			if (!failed && c->cli && c->out_freq && (strcmp(c->format, "aif") == 0)
+				&& (out->rate != c->out_freq))
+			{
+				sprintf(message, "sample rate %li in the header", out->rate);
+				failed=True;
+			}
+
+			/* Against another output of the run */
+			if (!failed && c->reference && (c->min_snr != NO_CHECK))
+			{
+				int r;
+				double max_diff, snr;
+
+				for (r=0; strcmp(cases[r].name, c->reference) != 0; r++)
+					;
+				if (!compare(c, out, &cases[r], &outputs[r], &max_diff, &snr))
+				{
+					sprintf(message, "length differs from %s", c->reference);
+					failed=True;
+				}
+				else if ((c->min_snr == IDENTICAL) ? (max_diff > 0.0) : (snr < c->min_snr))
+				{
+					sprintf(message, "max diff %g, SNR %.1f dB against %s", max_diff, snr, c->reference);
+					failed=True;
+				}
+			}
+
+			/* Against the golden CRC, or the saved output */
+			if (update)
+				fprintf(golden_out, "%s %08lx %li\n", name, crc, out->size);
+			else if (!failed && (!(golden= find_golden(name))
+								 || (golden->crc != crc) || (golden->size != out->size)))
+			{
+				char saved_name[1024];
+				Output saved;
+				double max_diff, snr;
+
+				sprintf(message, "CRC %08lx, %li bytes", crc, out->size);
+				if (golden)
+					sprintf(message + strlen(message), " instead of %08lx, %li bytes",
+							golden->crc, golden->size);
+				else
+					strcat(message, ", not in the golden file");
+				failed=True;
+
+				sprintf(saved_name, "%s/%s-%s.out", compare_dir, corpus, c->name);
+				memcpy(&saved, out, sizeof(Output));
+				if (compare_dir && (saved.bytes= read_file(saved_name, &saved.size)))
+				{
+					if (compare(c, out, c, &saved, &max_diff, &snr) && (snr >= min_snr))
+						failed=False;
+					sprintf(message + strlen(message), ", max diff %g, SNR %.1f dB against %s",
+							max_diff, snr, saved_name);
+					free(saved.bytes);
+				}
+			}
+
+			if (save_dir)
+			{
+				char saved_name[1024];
+				FILE* saved;
+
+				sprintf(saved_name, "%s/%s-%s.out", save_dir, corpus, c->name);
+				if (!(saved= fopen(saved_name, "wb"))
+					|| (fwrite(out->bytes, 1, out->size, saved) != (size_t) out->size))
+					fprintf(stderr, "Can't write %s\n", saved_name);
+				if (saved)
+					fclose(saved);
+			}
+
+			if (failed)
+			{
+				printf("FAIL %s: %s\n", name, message);
+				nb_failed++;
+			}
+			else if (message[0])
+				printf("ok   %s: %s\n", name, message);
+			else
+				printf("ok   %s %08lx\n", name, crc);
+		}
+
+		for (i=0; cases[i].name; i++)
+			free(outputs[i].bytes);
+		free(pho);
+	}
+
+	if (golden_out)
+	{
+		fclose(golden_out);
+		printf("%i cases written in %s\n", nb_cases, golden_name);
+		return 0;
+	}
+
+	printf("%i cases, %i failed\n", nb_cases, nb_failed);
+	return (nb_failed > 0) ? 1 : 0;
+}
@@ -129,6 +129,10 @@ SOURCE=..\..\Parser\input_file.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Engine\kernels.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Database\little_big.c
 # End Source File
 # Begin Source File
@@ -153,6 +157,10 @@ SOURCE=..\..\Parser\phone.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Engine\resample.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Database\rom_database.c
 # End Source File
 # Begin Source File
@@ -161,6 +169,10 @@ SOURCE=..\..\Database\rom_handling.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Engine\split.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Standalone\synth.c
 # End Source File
 # Begin Source File
@@ -51,14 +51,17 @@ CLEAN :
 	-@erase "$(INTDIR)\hash_tab.obj"
 	-@erase "$(INTDIR)\input_fifo.obj"
 	-@erase "$(INTDIR)\input_file.obj"
+	-@erase "$(INTDIR)\kernels.obj"
 	-@erase "$(INTDIR)\little_big.obj"
 	-@erase "$(INTDIR)\mbralloc.obj"
 	-@erase "$(INTDIR)\mbrola.obj"
 	-@erase "$(INTDIR)\parser_input.obj"
 	-@erase "$(INTDIR)\phonbuff.obj"
 	-@erase "$(INTDIR)\phone.obj"
+	-@erase "$(INTDIR)\resample.obj"
 	-@erase "$(INTDIR)\rom_database.obj"
 	-@erase "$(INTDIR)\rom_handling.obj"
+	-@erase "$(INTDIR)\split.obj"
 	-@erase "$(INTDIR)\synth.obj"
 	-@erase "$(INTDIR)\vc60.idb"
 	-@erase "$(INTDIR)\vp_error.obj"
@@ -87,14 +90,17 @@ LINK32_OBJS= \
 	"$(INTDIR)\hash_tab.obj" \
 	"$(INTDIR)\input_fifo.obj" \
 	"$(INTDIR)\input_file.obj" \
+	"$(INTDIR)\kernels.obj" \
 	"$(INTDIR)\little_big.obj" \
 	"$(INTDIR)\mbralloc.obj" \
 	"$(INTDIR)\mbrola.obj" \
 	"$(INTDIR)\parser_input.obj" \
 	"$(INTDIR)\phonbuff.obj" \
 	"$(INTDIR)\phone.obj" \
+	"$(INTDIR)\resample.obj" \
 	"$(INTDIR)\rom_database.obj" \
 	"$(INTDIR)\rom_handling.obj" \
+	"$(INTDIR)\split.obj" \
 	"$(INTDIR)\synth.obj" \
 	"$(INTDIR)\vp_error.obj" \
 	"$(INTDIR)\zstring_list.obj"
@@ -127,14 +133,17 @@ CLEAN :
 	-@erase "$(INTDIR)\hash_tab.obj"
 	-@erase "$(INTDIR)\input_fifo.obj"
 	-@erase "$(INTDIR)\input_file.obj"
+	-@erase "$(INTDIR)\kernels.obj"
 	-@erase "$(INTDIR)\little_big.obj"
 	-@erase "$(INTDIR)\mbralloc.obj"
 	-@erase "$(INTDIR)\mbrola.obj"
 	-@erase "$(INTDIR)\parser_input.obj"
 	-@erase "$(INTDIR)\phonbuff.obj"
 	-@erase "$(INTDIR)\phone.obj"
+	-@erase "$(INTDIR)\resample.obj"
 	-@erase "$(INTDIR)\rom_database.obj"
 	-@erase "$(INTDIR)\rom_handling.obj"
+	-@erase "$(INTDIR)\split.obj"
 	-@erase "$(INTDIR)\synth.obj"
 	-@erase "$(INTDIR)\vc60.idb"
 	-@erase "$(INTDIR)\vc60.pdb"
@@ -166,14 +175,17 @@ LINK32_OBJS= \
 	"$(INTDIR)\hash_tab.obj" \
 	"$(INTDIR)\input_fifo.obj" \
 	"$(INTDIR)\input_file.obj" \
+	"$(INTDIR)\kernels.obj" \
 	"$(INTDIR)\little_big.obj" \
 	"$(INTDIR)\mbralloc.obj" \
 	"$(INTDIR)\mbrola.obj" \
 	"$(INTDIR)\parser_input.obj" \
 	"$(INTDIR)\phonbuff.obj" \
 	"$(INTDIR)\phone.obj" \
+	"$(INTDIR)\resample.obj" \
 	"$(INTDIR)\rom_database.obj" \
 	"$(INTDIR)\rom_handling.obj" \
+	"$(INTDIR)\split.obj" \
 	"$(INTDIR)\synth.obj" \
 	"$(INTDIR)\vp_error.obj" \
 	"$(INTDIR)\zstring_list.obj"
@@ -292,6 +304,12 @@ SOURCE=..\..\Parser\input_file.c
 	$(CPP) $(CPP_PROJ) $(SOURCE)
 
 
+SOURCE=..\..\Engine\kernels.c
+
+"$(INTDIR)\kernels.obj" : $(SOURCE) "$(INTDIR)"
+	$(CPP) $(CPP_PROJ) $(SOURCE)
+
+
 SOURCE=..\..\Database\little_big.c
 
 "$(INTDIR)\little_big.obj" : $(SOURCE) "$(INTDIR)"
@@ -328,6 +346,12 @@ SOURCE=..\..\Parser\phone.c
 	$(CPP) $(CPP_PROJ) $(SOURCE)
 
 
+SOURCE=..\..\Engine\resample.c
+
+"$(INTDIR)\resample.obj" : $(SOURCE) "$(INTDIR)"
+	$(CPP) $(CPP_PROJ) $(SOURCE)
+
+
 SOURCE=..\..\Database\rom_database.c
 
 "$(INTDIR)\rom_database.obj" : $(SOURCE) "$(INTDIR)"
@@ -340,6 +364,12 @@ SOURCE=..\..\Database\rom_handling.c
 	$(CPP) $(CPP_PROJ) $(SOURCE)
 
 
+SOURCE=..\..\Engine\split.c
+
+"$(INTDIR)\split.obj" : $(SOURCE) "$(INTDIR)"
+	$(CPP) $(CPP_PROJ) $(SOURCE)
+
+
 SOURCE=..\..\Standalone\synth.c
 
 "$(INTDIR)\synth.obj" : $(SOURCE) "$(INTDIR)"
@@ -139,6 +139,10 @@ SOURCE=..\..\Parser\input_file.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Engine\kernels.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Database\little_big.c
 # End Source File
 # Begin Source File
@@ -171,6 +175,10 @@ SOURCE=..\..\Parser\phone.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\Engine\resample.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\Misc\vp_error.c
 # End Source File
 # Begin Source File
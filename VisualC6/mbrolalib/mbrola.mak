@@ -53,6 +53,7 @@ CLEAN :
 	-@erase "$(INTDIR)\hash_tab.obj"
 	-@erase "$(INTDIR)\input_fifo.obj"
 	-@erase "$(INTDIR)\input_file.obj"
+	-@erase "$(INTDIR)\kernels.obj"
 	-@erase "$(INTDIR)\little_big.obj"
 	-@erase "$(INTDIR)\mbralloc.obj"
 	-@erase "$(INTDIR)\mbrola.obj"
@@ -61,6 +62,7 @@ CLEAN :
 	-@erase "$(INTDIR)\parser_input.obj"
 	-@erase "$(INTDIR)\phonbuff.obj"
 	-@erase "$(INTDIR)\phone.obj"
+	-@erase "$(INTDIR)\resample.obj"
 	-@erase "$(INTDIR)\vc60.idb"
 	-@erase "$(INTDIR)\vp_error.obj"
 	-@erase "$(INTDIR)\zstring_list.obj"
@@ -95,6 +97,7 @@ LINK32_OBJS= \
 	"$(INTDIR)\hash_tab.obj" \
 	"$(INTDIR)\input_fifo.obj" \
 	"$(INTDIR)\input_file.obj" \
+	"$(INTDIR)\kernels.obj" \
 	"$(INTDIR)\little_big.obj" \
 	"$(INTDIR)\mbralloc.obj" \
 	"$(INTDIR)\mbrola.obj" \
@@ -102,6 +105,7 @@ LINK32_OBJS= \
 	"$(INTDIR)\parser_input.obj" \
 	"$(INTDIR)\phonbuff.obj" \
 	"$(INTDIR)\phone.obj" \
+	"$(INTDIR)\resample.obj" \
 	"$(INTDIR)\vp_error.obj" \
 	"$(INTDIR)\zstring_list.obj" \
 	"$(INTDIR)\mbrola.res"
@@ -135,6 +139,7 @@ CLEAN :
 	-@erase "$(INTDIR)\hash_tab.obj"
 	-@erase "$(INTDIR)\input_fifo.obj"
 	-@erase "$(INTDIR)\input_file.obj"
+	-@erase "$(INTDIR)\kernels.obj"
 	-@erase "$(INTDIR)\little_big.obj"
 	-@erase "$(INTDIR)\mbralloc.obj"
 	-@erase "$(INTDIR)\mbrola.obj"
@@ -143,6 +148,7 @@ CLEAN :
 	-@erase "$(INTDIR)\parser_input.obj"
 	-@erase "$(INTDIR)\phonbuff.obj"
 	-@erase "$(INTDIR)\phone.obj"
+	-@erase "$(INTDIR)\resample.obj"
 	-@erase "$(INTDIR)\vc60.idb"
 	-@erase "$(INTDIR)\vc60.pdb"
 	-@erase "$(INTDIR)\vp_error.obj"
@@ -180,6 +186,7 @@ LINK32_OBJS= \
 	"$(INTDIR)\hash_tab.obj" \
 	"$(INTDIR)\input_fifo.obj" \
 	"$(INTDIR)\input_file.obj" \
+	"$(INTDIR)\kernels.obj" \
 	"$(INTDIR)\little_big.obj" \
 	"$(INTDIR)\mbralloc.obj" \
 	"$(INTDIR)\mbrola.obj" \
@@ -187,6 +194,7 @@ LINK32_OBJS= \
 	"$(INTDIR)\parser_input.obj" \
 	"$(INTDIR)\phonbuff.obj" \
 	"$(INTDIR)\phone.obj" \
+	"$(INTDIR)\resample.obj" \
 	"$(INTDIR)\vp_error.obj" \
 	"$(INTDIR)\zstring_list.obj" \
 	"$(INTDIR)\mbrola.res"
@@ -310,6 +318,12 @@ SOURCE=..\..\Parser\input_file.c
 	$(CPP) $(CPP_PROJ) $(SOURCE)
 
 
+SOURCE=..\..\Engine\kernels.c
+
+"$(INTDIR)\kernels.obj" : $(SOURCE) "$(INTDIR)"
+	$(CPP) $(CPP_PROJ) $(SOURCE)
+
+
 SOURCE=..\..\Database\little_big.c
 
 "$(INTDIR)\little_big.obj" : $(SOURCE) "$(INTDIR)"
@@ -352,6 +366,12 @@ SOURCE=..\..\Parser\phone.c
 	$(CPP) $(CPP_PROJ) $(SOURCE)
 
 
+SOURCE=..\..\Engine\resample.c
+
+"$(INTDIR)\resample.obj" : $(SOURCE) "$(INTDIR)"
+	$(CPP) $(CPP_PROJ) $(SOURCE)
+
+
 SOURCE=..\..\Misc\vp_error.c
 
 "$(INTDIR)\vp_error.obj" : $(SOURCE) "$(INTDIR)"